@@ -14,7 +14,9 @@ std::unique_ptr<LAC> uPtr_Lac;
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_example_testlac_MainActivity_initLac(JNIEnv *env, jobject thiz, jstring model_path) {
-    std::unique_ptr<LAC> lac(new LAC(env->GetStringUTFChars(model_path, 0), 1));
+    const char *path = env->GetStringUTFChars(model_path, 0);
+    std::unique_ptr<LAC> lac(new LAC(path, CODE_UTF8, BACKEND_LITE));
+    env->ReleaseStringUTFChars(model_path, path);
     uPtr_Lac = std::move(lac);
 }
 
@@ -50,7 +52,7 @@ Java_com_example_testlac_MainActivity_stringCutFromJNI(JNIEnv *env, jobject thiz
     env->ReleaseStringUTFChars(source_text, utf8);
 
 
-    auto result = uPtr_Lac->lexer(str_source_text);
+    auto result = uPtr_Lac->run(str_source_text);
     std::string output_str = "";
     for (int i=0; i<result.size(); i++) {
         if(result[i].tag.length() == 0){
@@ -18,21 +18,26 @@ limitations under the License. */
 #include<vector>
 #include<utility>
 #include<string>
+#include<cstdint>
+#include<functional>
+#include<unordered_map>
 
-/* AC自动机树结点 */
+/* AC自动机树结点，字符以char_code的编码表示 */
 struct Node{
     std::vector<Node*> next;    
-    std::string key;            // 当前结点的字符
+    uint32_t key;               // 当前结点的字符
     int value;                  // 结点对应的value，-1表示无
+    int depth;                  // 结点对应的字符串的长度
+    int count;                  // 以该结点为前缀的item数，由make_fail计算
     Node* fail;                 // ac自动机的fail指针
 
-    Node():value(-1),fail(NULL){}
+    Node():key(0),value(-1),depth(0),count(0),fail(NULL){}
 
-    /* 返回子结点中，字符为str的结点，找不到返回NULL */
-    Node* get_child(const std::string &str);
+    /* 返回子结点中，字符为key的结点，找不到返回NULL；子结点按字符有序排列 */
+    Node* get_child(uint32_t key);
 
-    /* 添加字符为str的子结点并返回，若已存在则直接返回原子结点 */
-    Node* add_child(const std::string &str);
+    /* 添加字符为key的子结点并返回，若已存在则直接返回原子结点 */
+    Node* add_child(uint32_t key);
 };
 
 /* AC自动机 */
@@ -40,21 +45,76 @@ class AhoCorasick{
     private:
     Node * _root;
 
+    // 根结点的子结点按首字索引：各首字的子树互不相交，批量插入时按首字分区并行构建
+    std::unordered_map<uint32_t, Node*> _root_index;
+
+    // 可作为item首字的字符，按编码散列的位图：查询中没有任何字符命中时不可能有匹配，由make_fail生成
+    static const uint32_t FIRST_CHAR_BITS = 1 << 16;
+    std::vector<uint64_t> _first_chars;
+
+    // 由make_fail统计的结点数及估计的内存占用
+    size_t _node_count;
+    size_t _memory_bytes;
+
+    /* 结点node下字符为key的子结点，根结点经索引查找 */
+    Node* child(Node *node, uint32_t key) const;
+
+    /* 根结点下字符为key的子结点，不存在时添加 */
+    Node* root_child(uint32_t key);
+
+    static uint32_t first_char_bit(uint32_t key){
+        return (key ^ (key >> 16)) & (FIRST_CHAR_BITS - 1);
+    }
+
     public:
-    AhoCorasick(){
+    AhoCorasick():_node_count(1),_memory_bytes(0){
         _root = new Node();
     }
 
     ~AhoCorasick();
     
-    /* 添加AC自动机item */
-    void insert(const std::vector<std::string> &chars, int value);
+    /* 添加AC自动机item，chars为各字的编码 */
+    void insert(const std::vector<uint32_t> &chars, int value);
+
+    /* 批量添加，第i个item的value为first_value + i，同一个item以后出现的为准
+     * 按首字分区，由threads个线程(0为CPU核数)并行插入各分区 */
+    void insert(const std::vector<std::vector<uint32_t>> &items, int first_value, int threads);
+
+    /* 生成AC自动机的fail指针：子结点的fail只依赖上一层结点，逐层由threads个线程并行计算 */
+    void make_fail(int threads = 1);
+
+    /* 结点数(含根结点) */
+    size_t node_count() const{
+        return _node_count;
+    }
+
+    /* 结点、子结点数组和首字索引的估计内存占用(字节) */
+    size_t memory_bytes() const{
+        return _memory_bytes;
+    }
+
+    /* 字符key可能是某个item的首字，为false时一定不是 */
+    bool may_start(uint32_t key) const{
+        uint32_t bit = first_char_bit(key);
+        return !_first_chars.empty() && (_first_chars[bit >> 6] >> (bit & 63) & 1);
+    }
+
+    /* 查询返回多模匹配结果，sentence为各字的编码 */
+    int search (const std::vector<uint32_t> &sentence, std::vector<std::pair<int, int>> &res, bool backtrack = false);
+
+    /* 初始状态 */
+    Node* root() const{
+        return _root;
+    }
+
+    /* 从状态state读入字符key后的状态，与search的转移一致，供多个自动机同步查询 */
+    Node* next_state(Node *state, uint32_t key) const;
 
-    /* 生成AC自动机的fail指针 */
-    void make_fail();
+    /* 返回item对应的value，不存在时返回-1；path非空时存放item经过的结点(不含根结点) */
+    int find(const std::vector<uint32_t> &chars, std::vector<Node*> *path = NULL) const;
 
-    /* 查询返回多模匹配结果 */
-    int search (const std::vector<std::string> &sentence, std::vector<std::pair<int, int>> &res, bool backtrack = false);
+    /* 深度优先遍历所有item */
+    void for_each(const std::function<void(const std::vector<uint32_t>&, int)> &visit) const;
 };
 
 #endif  // BAIDU_LAC_AHOCORASICK_H
\ No newline at end of file
@@ -19,7 +19,7 @@ limitations under the License. */
 #include <memory>
 #include <string>
 #include <vector>
-#include "paddle_inference_api.h"
+#include "lac_backend.h"
 
 /* 编码设置 */
 enum CODE_TYPE
@@ -33,17 +33,104 @@ struct OutputItem
     std::string word;
     std::string tag;
     int rank;  // 添加rank字段
+    int offset;     // 词在query中的字节偏移
+    int length;     // 词的字节长度
 
     // 初始化构造函数
-    OutputItem() : word(""), tag(""), rank(0) {}
+    OutputItem() : word(""), tag(""), rank(0), offset(0), length(0) {}
 };
 
+/* 基于偏移的输出：词在原始query中的位置，不生成词和词性字符串 */
+struct WordSpan
+{
+    int offset;         // 词在query中的字节偏移
+    int length;         // 词的字节长度
+    int char_offset;    // 词的首字在切分结果中的下标
+    int char_length;    // 词包含的字数
+    int tag_id;         // 词性编号，对应LAC::tag_names()；RunOptions不输出词性时为-1
+    int rank;           // rank模式下的词权重
+
+    WordSpan() : offset(0), length(0), char_offset(0), char_length(0), tag_id(0), rank(0) {}
+};
+
+/* 输出字段，RunOptions::fields为其组合 */
+enum OUTPUT_FIELD
+{
+    FIELD_WORD = 1,     // 词字符串
+    FIELD_TAG = 2,      // 词性
+    FIELD_RANK = 4,     // 词语重要性，运行rank预测器，需已开启rank模式
+    FIELD_OFFSET = 8,   // 词的字节偏移和长度，OutputItem和WordSpan中总是填写，只影响JSON输出
+};
+
+class Customization;
+
+/* 按顺序叠加的用户词典，后面的词典覆盖前面词典的干预结果，如基础词典加租户词典 */
+typedef std::vector<std::shared_ptr<Customization>> CustomizationLayers;
+
+/* 词性过滤的位图，第tag_id位为1的词性保留，由compile_tag_filter生成 */
+typedef std::vector<uint64_t> TagMask;
+
+/* 将词性名称集合编译为按tag_names下标的位图，不在tag_names中的名称不匹配任何词 */
+TagMask compile_tag_filter(const std::vector<std::string>& tag_names, const std::vector<std::string>& tags);
+
+/* 单次调用的选项：未开启的功能及未请求的字段，对应的处理阶段不执行 */
+struct RunOptions
+{
+    bool customization;     // 进行用户词典干预(已装载时)
+    bool segment_only;      // 只分词，同Python的mode='seg'：不输出词性，尽可能不生成标签字符串
+    int fields;             // 输出字段，OUTPUT_FIELD的组合
+    TagMask tag_filter;     // 非空时只输出词性在其中的词，在解码时过滤，其余的词不生成
+    CustomizationLayers dicts;  // 非空时代替LAC装载的用户词典，按顺序叠加干预
+
+    RunOptions() : customization(true), segment_only(false), fields(FIELD_WORD | FIELD_TAG) {}
+
+    bool want(OUTPUT_FIELD field) const
+    {
+        return (fields & field) && !(field == FIELD_TAG && segment_only);
+    }
+
+    /* 词性编号为tag_id的词是否通过tag_filter */
+    bool keep(int tag_id) const
+    {
+        return tag_filter.empty() || (tag_id >= 0 && (size_t)tag_id / 64 < tag_filter.size() &&
+                                      (tag_filter[tag_id / 64] >> (tag_id % 64) & 1));
+    }
+};
+
+/* 处理阶段，供分析工具统计各阶段的耗时与内存申请 */
+enum LAC_STAGE
+{
+    STAGE_TOKENIZE = 0,     // 切分、全角转半角、查词表
+    STAGE_PREDICT,          // LAC预测器
+    STAGE_RANK_PREDICT,     // rank预测器
+    STAGE_DECODE,           // 标签解码
+    STAGE_CUSTOMIZATION,    // 用户词典干预
+    STAGE_OUTPUT,           // 生成输出结果
+    STAGE_NUM,
+};
+
+/* 阶段回调：进入每个阶段时调用 */
+typedef void (*StageHook)(LAC_STAGE stage, void *context);
+
+
+/* 预热配置：按给定的句长和batch大小构造合成query运行预测器 */
+struct WarmupConfig
+{
+    std::vector<int> lengths;       // 合成query的字数
+    std::vector<int> batch_sizes;   // 合成batch的大小
+    bool on_clone;                  // 拷贝构造出的新实例是否自动预热
+
+    WarmupConfig() : lengths({1, 16, 64, 256}), batch_sizes({1, 16}), on_clone(false) {}
+};
 
 #ifndef LAC_CLASS
 #define LAC_CLASS
 
 // 前向声明, 去除头文件依赖
-class Customization;
+class ConstraintMasks;
+class LabelTable;
+class Segment;
+class SegmentSession;
 
 class LAC
 {
@@ -54,51 +141,247 @@ private:
     std::shared_ptr<std::unordered_map<std::string, std::string>> _q2b_dict;
     std::shared_ptr<std::unordered_map<std::string, int64_t>> _word2id_dict;
     int64_t _oov_id;
-    paddle::PaddlePlace _place;
-    std::shared_ptr<paddle_infer::Predictor> _predictor;
-    std::shared_ptr<paddle_infer::Tensor> _input_tensor;
-    std::shared_ptr<paddle_infer::Tensor> _output_tensor;
-    std::vector<std::string> _seq_words;
+    std::shared_ptr<LACBackend> _backend;
     std::vector<std::vector<std::string>> _seq_words_batch;
     std::vector<std::string> _labels;
-    std::vector<OutputItem> _results;
     std::vector<std::vector<OutputItem>> _results_batch;
+    std::vector<const char *> _query_texts;
+    std::vector<int> _query_lens;
+    std::vector<int64_t> _input_ids;
+    const int64_t *_output_data;
+    size_t _output_size;
+
+    // 词性表：标签(如"n-B")到词性编号的映射
+    std::vector<std::string> _tag_names;
+    std::unordered_map<std::string, int> _tag2id;
+    std::unordered_map<std::string, int> _label2tag;
+
+    // 各标签编号的词首标记及词性编号，不需要标签字符串时直接按编号切分
+    std::vector<char> _label_begins;
+    std::vector<int> _label_tags;
+
+    // 用户词典在标签编号上干预：各会话各自的标签编号表，干预后的标签编号及各字的编码
+    std::shared_ptr<LabelTable> _label_table;
+    std::vector<int64_t> _label_ids;
+    std::vector<uint32_t> _char_codes;
+
+    // 按RunOptions运行时的中间结果
+    std::vector<WordSpan> _option_spans;
+    std::vector<size_t> _option_span_lod;
+
+    // 用户词典匹配结果的缓冲区
+    std::vector<std::pair<int, int>> _ac_res;
+
+    // 后端支持时在Viterbi解码中施加用户词典约束：各会话共享的约束表及逐字的约束
+    // 约束表包含模型的所有词性，任意用户词典均可使用
+    std::shared_ptr<const ConstraintMasks> _constraint_masks;
+    std::vector<const float *> _char_masks;
+
+    // 只含custom的单层词典，options未指定词典时使用
+    CustomizationLayers _custom_layers;
+
+    // 阶段回调
+    StageHook _stage_hook;
+    void *_stage_context;
+
+    // 单条query调用时复用的输入
+    std::vector<std::string> _single_query;
+
+    // 降级分词会话，词典由拷贝出的实例共享
+    std::shared_ptr<SegmentSession> _segment;
 
     // Rank mode properties
     bool _rank_mode;
-    std::shared_ptr<paddle_infer::Predictor> _rank_predictor;
-    std::shared_ptr<paddle_infer::Tensor> _rank_output_tensor;
+    bool _rank_fused;       // _rank_backend为LAC与rank合并的模型，一次运行同时输出标签和rank权重
+    std::shared_ptr<LACBackend> _rank_backend;
+    const int64_t *_rank_output_data;
+    size_t _rank_output_size;
+    std::vector<std::vector<std::string>> _tags_for_rank_batch;
+    std::vector<int> _merged_weights;
 
     // 添加word_length相关的成员变量
     std::vector<std::vector<int>> _words_length_batch;
 
+    // 预热配置及最近一次预热的耗时
+    WarmupConfig _warmup_config;
+    double _warmup_ms;
+
+    /* 根据id2label构造词性表 */
+    void init_tag_names();
+
+    /* 为干预时追加到_label_table的标签补充词首标记和词性编号 */
+    void sync_label_table();
+
+    /* 后端支持解码约束时按模型的标签构造约束表 */
+    void init_constraint_masks();
+
+    /* 本次调用进行干预的各层词典，不干预时返回NULL */
+    const CustomizationLayers *custom_layers();
+    const CustomizationLayers *custom_layers(const RunOptions& options);
+
+    void enter_stage(LAC_STAGE stage)
+    {
+        if (_stage_hook)
+        {
+            _stage_hook(stage, _stage_context);
+        }
+    }
+
+    void set_query_views(const std::vector<std::string>& querys);
+
+    /* 对已送入的数据运行预测器，rank为true时同时运行rank预测器(合并模型时只运行一次)
+     * layers为NULL时不施加用户词典的解码约束 */
+    int predict(bool rank, const CustomizationLayers *layers);
+    int predict_fused();
+
+    /* 预测失败时将结果置为count个空结果 */
+    void clear_results(size_t count, std::vector<std::vector<OutputItem>>& results);
+
+    /* 解码第sent_index个句子的标签并依次以layers中的词典干预，结果为标签编号_label_ids */
+    void decode_labels(size_t sent_index, bool rank, const CustomizationLayers *layers);
+
+    /* 将_label_ids转为标签字符串存于_labels */
+    void fill_labels();
+
+    /* 将第sent_index个句子的词追加到spans：from_labels为true时按干预后的_label_ids切分，否则按模型输出的标签编号切分
+     * 只保留通过options.tag_filter的词，weights非空时按词的序号填写rank */
+    void append_spans(size_t sent_index, bool from_labels, const RunOptions& options,
+                      const std::vector<int> *weights, std::vector<WordSpan>& spans);
+
+    /* 按options运行，结果为spans，RunOptions的各输出接口由此转换 */
+    int run_spans(const char *const *texts, const int *lens, size_t count, const RunOptions& options,
+                  std::vector<WordSpan>& spans, std::vector<size_t>& span_lod);
+
+    int parse_spans(const int64_t *label_ids,
+                    const std::vector<std::string>& words,
+                    std::vector<WordSpan>& spans);
+    int label_tag_id(const std::string& label);
+    int label_tag(int64_t label_id);
+
+    const int64_t *rank_output_data();
+    void merge_sentence_rank_weights(const std::vector<std::string>& tags,
+                                     const int64_t *rank_weights, size_t weight_size);
+    void merge_sentence_rank_ids(size_t sent_index, const int64_t *rank_output);
+
 public:
-    LAC(const std::string& model_path, CODE_TYPE type = CODE_TYPE::CODE_UTF8);
+    /* 词典位于model_path/conf下，不存在时直接位于model_path下(如Android assets)
+     * 模型由backend指定的推理后端装载，各后端共享切分、解码、干预和rank合并 */
+    LAC(const std::string& model_path, CODE_TYPE type = CODE_TYPE::CODE_UTF8,
+        LAC_BACKEND backend = default_backend());
     LAC(LAC&);
     int load_customization(const std::string& customization_file);
+
+    /* 将词性预先加入词性表，使拷贝出的各会话的词性编号一致，如CustomizationRegistry中各词典的词性 */
+    void add_tags(const std::vector<std::string>& tags);
+
     int feed_data(const std::vector<std::string>& querys);
+    int feed_data(const char *const *texts, const int *lens, size_t count);
     int parse_targets(const std::vector<std::string>& tags,
                       const std::vector<std::string>& words,
                       std::vector<OutputItem>& result);
     std::vector<OutputItem> run(const std::string& query);
     std::vector<std::vector<OutputItem>> run(const std::vector<std::string>& query);
 
+    /* 结果写入调用方提供的容器，容器中已有的内存会被复用 */
+    int run(const std::string& query, std::vector<OutputItem>& result);
+    int run(const std::vector<std::string>& querys, std::vector<std::vector<OutputItem>>& results);
+
+    /* 基于偏移输出：所有句子的词依次存于spans，第i个句子的词为spans[span_lod[i], span_lod[i+1]) */
+    int run_offsets(const std::vector<std::string>& querys,
+                    std::vector<WordSpan>& spans, std::vector<size_t>& span_lod);
+    int run_rank_offsets(const std::vector<std::string>& querys,
+                         std::vector<WordSpan>& spans, std::vector<size_t>& span_lod);
+
+    /* 同上，输入为count个(地址, 长度)，不拷贝query */
+    int run_offsets(const char *const *texts, const int *lens, size_t count,
+                    std::vector<WordSpan>& spans, std::vector<size_t>& span_lod);
+    int run_rank_offsets(const char *const *texts, const int *lens, size_t count,
+                         std::vector<WordSpan>& spans, std::vector<size_t>& span_lod);
+
+    /* 按options运行：关闭或选择用户词典干预、只分词、按需运行rank预测器，只生成请求的字段
+     * 未请求的word、tag为空，rank为0 */
+    int run(const std::vector<std::string>& querys, const RunOptions& options,
+            std::vector<std::vector<OutputItem>>& results);
+    int run_offsets(const std::vector<std::string>& querys, const RunOptions& options,
+                    std::vector<WordSpan>& spans, std::vector<size_t>& span_lod);
+    int run_offsets(const char *const *texts, const int *lens, size_t count, const RunOptions& options,
+                    std::vector<WordSpan>& spans, std::vector<size_t>& span_lod);
+
+    /* 按options运行并返回JSON，每个词只含请求的字段(word、tag、rank、offset和length) */
+    std::string run_json(const std::string& query, const RunOptions& options);
+    std::string run_json(const std::vector<std::string>& querys, const RunOptions& options);
+
+    /* 词性表，WordSpan::tag_id为其下标 */
+    const std::vector<std::string>& tag_names() const { return _tag_names; }
+
+    /* 按当前词性表编译RunOptions::tag_filter，用户词典中的新词性须在装载词典后编译 */
+    TagMask compile_tag_filter(const std::vector<std::string>& tags) const
+    {
+        return ::compile_tag_filter(_tag_names, tags);
+    }
+
+    /* 设置阶段回调，hook为NULL时关闭；回调只对当前实例生效，不随拷贝构造传递 */
+    void set_stage_hook(StageHook hook, void *context)
+    {
+        _stage_hook = hook;
+        _stage_context = context;
+    }
+
     // Rank mode methods
     void enable_rank_mode(const std::string& rank_model_path);
     std::vector<OutputItem> run_rank(const std::string& query);
     std::vector<std::vector<OutputItem>> run_rank(const std::vector<std::string>& query);
-    int merge_rank_weights(const std::vector<std::vector<std::string>>& tags_for_rank_batch);
+    int run_rank(const std::string& query, std::vector<OutputItem>& result);
+    int run_rank(const std::vector<std::string>& querys, std::vector<std::vector<OutputItem>>& results);
     std::string escape_json_string(const std::string& word);
     std::string results_to_json(const std::vector<OutputItem>& results);
     std::string results_to_json(const std::vector<std::vector<OutputItem>>& results_batch);
-    int merge_rank_weights_with_word_length(const std::vector<std::vector<std::string>>& tags_for_rank_batch);
-    int parse_rank_results(const std::shared_ptr<paddle_infer::Tensor>& rank_tensor, 
-                           std::vector<std::vector<OutputItem>>& results);
+    /* 将最近一次预测的rank权重按tags_for_rank_batch的词边界合并到results中 */
+    int merge_rank_weights_with_word_length(const std::vector<std::vector<std::string>>& tags_for_rank_batch,
+                                            std::vector<std::vector<OutputItem>>& results);
     std::string run_rank_json(const std::string& query);
     std::string run_rank_json(const std::vector<std::string>& querys);
     std::string run_json(const std::string& query);
     std::string run_json(const std::vector<std::string>& querys);
 
+    /* 预热：运行合成query，使预测器在接入流量前完成内存分配，返回耗时(毫秒) */
+    double warmup(const WarmupConfig& config);
+    double warmup();
+    void set_warmup_config(const WarmupConfig& config) { _warmup_config = config; }
+    double warmup_ms() const { return _warmup_ms; }
+
+    /* 装载降级分词词典，每行为"词 词频 [词性]" */
+    int load_segment_dict(const std::string& dict_path);
+
+    /* 降级分词：按词典最大概率分词并进行用户词典干预，不运行预测器
+     * 词典中未标注词性的词词性为空，rank均为0 */
+    int run_fallback(const std::vector<std::string>& querys, std::vector<std::vector<OutputItem>>& results);
+
+    /* 同上，按options.customization和options.dicts进行干预并按options.tag_filter过滤，其余选项不生效 */
+    int run_fallback(const std::vector<std::string>& querys, const RunOptions& options,
+                     std::vector<std::vector<OutputItem>>& results);
+
+    /* 是否已装载降级分词词典 */
+    bool fallback_enabled() const { return (bool)_segment; }
+
+    /* 降级分词词典，未装载时为空 */
+    std::shared_ptr<const Segment> segment() const;
+
+    /* 模型是否装载成功 */
+    bool model_loaded() const { return (bool)_backend; }
+
+    /* 推理后端类型 */
+    LAC_BACKEND backend_type() const { return _backend ? _backend->type() : default_backend(); }
+
+    /* 是否已装载rank模型 */
+    bool rank_enabled() const { return _rank_mode; }
+
+    /* rank模型是否为与LAC合并导出的模型 */
+    bool rank_fused() const { return _rank_fused; }
+
+    /* 输入文本的编码 */
+    CODE_TYPE codetype() const { return _codetype; }
+
     std::shared_ptr<Customization> custom;
 };
 #endif  // LAC_CLASS
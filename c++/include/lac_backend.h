@@ -0,0 +1,92 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_BACKEND_H
+#define BAIDU_LAC_BACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* 推理后端类型 */
+enum LAC_BACKEND
+{
+    BACKEND_PADDLE = 0,     // Paddle Inference，模型目录为model_path/model
+    BACKEND_LITE,           // Paddle-Lite(含x86版本)，模型文件为model_path/model.nb
+    BACKEND_NATIVE,         // 原生引擎，不依赖Paddle，参数文件为model_path/model.native，仅支持LAC模型
+    BACKEND_NUM,
+};
+
+/* 推理后端：输入为按LoD拼接的id序列，输出为逐字的id序列(LAC模型为标签id，rank模型为权重)
+ * 后端只负责运行预测器，切分、解码、用户词典干预和rank权重合并由LAC共享 */
+class LACBackend
+{
+public:
+    virtual ~LACBackend() {}
+
+    /* 运行预测器：inputs为num_inputs个长度为count的输入，lod[0]为各句的起止位置
+     * 输出由后端持有，在下一次run之前有效；返回0表示成功 */
+    virtual int run(const int64_t *const *inputs, size_t num_inputs, size_t count,
+                    const std::vector<std::vector<size_t>> &lod,
+                    const int64_t *&output, size_t &output_size) = 0;
+
+    /* 是否在后端内做Viterbi解码，是则run_constrained可以在解码时施加逐字的标签约束 */
+    virtual bool constrained_decoding() const
+    {
+        return false;
+    }
+
+    /* 同run，masks[t]为第t个字的标签约束(长度为标签数，允许的标签为0，其余为-inf)，为NULL的字不约束
+     * 不支持约束的后端忽略masks */
+    virtual int run_constrained(const int64_t *const *inputs, size_t num_inputs, size_t count,
+                                const std::vector<std::vector<size_t>> &lod, const float *const *masks,
+                                const int64_t *&output, size_t &output_size)
+    {
+        return this->run(inputs, num_inputs, count, lod, output, output_size);
+    }
+
+    /* 模型的输入个数，LAC模型为1，rank模型为2(words和crf_decode) */
+    virtual size_t input_count() const = 0;
+
+    /* 模型的输出个数，LAC与rank合并导出的模型为2(标签和rank权重) */
+    virtual size_t output_count() const
+    {
+        return 1;
+    }
+
+    /* 最近一次run的第index个输出，run返回的为第0个，在下一次run之前有效；返回0表示成功 */
+    virtual int output(size_t index, const int64_t *&output, size_t &output_size)
+    {
+        return -1;
+    }
+
+    /* 为新会话创建后端，与当前后端共享模型参数 */
+    virtual std::shared_ptr<LACBackend> clone() = 0;
+
+    virtual LAC_BACKEND type() const = 0;
+};
+
+/* 创建后端并装载model_path下的模型，未编译该后端或装载失败时返回空指针 */
+std::shared_ptr<LACBackend> create_backend(LAC_BACKEND type, const std::string &model_path, int threads = 1);
+
+/* 编译时启用的后端中的默认后端，依次为Paddle Inference、Paddle-Lite、原生引擎 */
+LAC_BACKEND default_backend();
+
+/* 后端名称与枚举的转换，名称为paddle、lite、native，未知名称返回false */
+bool parse_backend(const std::string &name, LAC_BACKEND &type);
+const char *backend_name(LAC_BACKEND type);
+
+#endif  // BAIDU_LAC_BACKEND_H
@@ -18,6 +18,14 @@ limitations under the License. */
 #include<vector>
 #include<string>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "lac_util.h"
 #include "ahocorasick.h"
@@ -26,31 +34,244 @@ limitations under the License. */
 struct customization_term{
     std::vector<std::string> tags;
     std::vector<int> split;
+    customization_term(){}
     customization_term(const std::vector<std::string>& tags, 
             const std::vector<int>& split):
         tags(tags),
         split(split){}
 };
 
+/* 解码时施加的标签约束表，允许的标签为0，其余为-inf，各会话共享 */
+class ConstraintMasks{
+    private:
+        int _num_labels;
+
+        // [(2 + 2 x 词性数) x 标签数]，前两行为任意词首、任意非词首
+        std::vector<float> _masks;
+
+        // 词性到其词首约束所在行的映射，下一行为非词首
+        std::unordered_map<std::string, int> _rows;
+
+    public:
+    /* labels为按编号排列的模型标签，tags为用户词典中的词性 */
+    ConstraintMasks(const std::vector<std::string> &labels, const std::vector<std::string> &tags);
+
+    int num_labels() const{
+        return _num_labels;
+    }
+
+    /* 词性为tag的词首(begin)或非词首的约束，tag为空或模型没有该词性时只约束分词边界
+     * 非词首的约束紧随词首之后，即mask(tag, false) == mask(tag, true) + num_labels() */
+    const float *mask(const std::string &tag, bool begin) const;
+};
+
+/* 标签与编号的对应，用户词典干预时直接改写标签编号：编号先为模型的标签，之后追加用户词典新词性的标签
+ * 及各标签末字改为B、I所得的标签；运行时首次出现的新词性在使用时追加，由各会话各自持有 */
+class LabelTable{
+    private:
+        std::vector<std::string> _names;
+        std::unordered_map<std::string, int> _ids;
+
+        // 各标签末字改为B、I所得的标签，与按字符串改写的结果一致
+        std::vector<int> _begins;
+        std::vector<int> _inners;
+
+        // 词性到其非词首标签("词性-I")的映射
+        std::unordered_map<std::string, int> _tag_inners;
+
+        void add_variants(int id);
+
+    public:
+    LabelTable(){}
+
+    /* labels为按编号排列的模型标签 */
+    explicit LabelTable(const std::vector<std::string> &labels);
+
+    /* 标签label的编号，不存在时追加 */
+    int id(const std::string &label);
+
+    /* 词性tag的非词首标签，不存在时追加 */
+    int tag_inner(const std::string &tag);
+
+    size_t size() const{
+        return _names.size();
+    }
+
+    const std::string &name(int id) const{
+        return _names[id];
+    }
+
+    int begin(int id) const{
+        return _begins[id];
+    }
+
+    int inner(int id) const{
+        return _inners[id];
+    }
+};
+
 /* 干预使用的类 */
 class Customization{
     private:
-        // 记录每个item的标签和分词信息
-        std::vector<customization_term> _customization_dic;  
+        // 基础词典：装载或合并时构建，之后只读，由增删得到的各版本共享
+        struct Base{
+            // 记录每个item的标签和分词信息
+            std::vector<customization_term> terms;
+
+            // AC自动机用于item的查询
+            AhoCorasick ac;
+        };
+        std::shared_ptr<Base> _base;
+
+        // 增删的词条：覆盖层的自动机与基础自动机同步查询，value为基础词条数加覆盖层下标
+        std::vector<customization_term> _overlay_terms;
+        std::vector<std::vector<uint32_t>> _overlay_phrases;
+        std::shared_ptr<AhoCorasick> _overlay_ac;
+
+        // 删除的及被覆盖层替换的基础词条，及各结点下删除的词条数：与结点的count相等时，
+        // 该结点不再是任何词条的前缀，查询时沿fail指针退到仍有词条的结点，与重建的自动机一致
+        std::unordered_set<int> _deleted;
+        std::unordered_map<const Node*, int> _deleted_counts;
+
+        const customization_term &term(int value) const{
+            int base_size = _base->terms.size();
+            return value < base_size ? _base->terms[value] : _overlay_terms[value - base_size];
+        }
+
+        /* 查询各位置结束的匹配，与由全部词条重建的自动机一致；codes中没有可作为首字的字符时不查询 */
+        void search(const std::vector<uint32_t> &codes, std::vector<std::pair<int, int>> &ac_res) const;
 
-        // AC自动机用于item的查询
-        AhoCorasick _ac_dict;
+        /* 查询并去掉与前一个选取的匹配重叠的匹配，ac_res中留下依次施加的匹配 */
+        void select(const std::vector<uint32_t> &codes, std::vector<std::pair<int, int>> &ac_res) const;
 
     public:
-    Customization(const std::string &customization_dic_path){
+    Customization():_base(std::make_shared<Base>()){}
+
+    Customization(const std::string &customization_dic_path):_base(std::make_shared<Base>()){
         load_dict(customization_dic_path);
     }
 
-    /* 从用户词典中进行装载 */
-    RVAL load_dict(const std::string &customization_dic_path);
+    /* 从用户词典中进行装载，由threads个线程(0为CPU核数)分批并行解析各行、按首字分区构建自动机并逐层计算fail指针 */
+    RVAL load_dict(const std::string &customization_dic_path, int threads = 0);
+
+    /* 词典中出现的所有词性，不含重复；overlay_only为true时只看覆盖层(增删加入)的词条 */
+    void collect_tags(std::vector<std::string> &tags, bool overlay_only = false) const;
+
+    /* 增删词条得到新版本，当前版本不变：基础自动机共享，只重建覆盖层
+     * add为词典格式的行，remove为要删除的词(词性及空格被忽略)，已有的词再次添加时替换；格式错误时返回空 */
+    std::shared_ptr<Customization> update(const std::vector<std::string> &add,
+            const std::vector<std::string> &remove) const;
 
-    /* 对lac的预测结果进行干预 */
+    /* 将覆盖层和删除合并为新的基础自动机，结果与由全部词条重新装载一致，构建方式同load_dict */
+    std::shared_ptr<Customization> compact(int threads = 0) const;
+
+    /* 覆盖层的词条数与删除的基础词条数之和 */
+    size_t overlay_size() const{
+        return _overlay_terms.size() + _deleted.size();
+    }
+
+    /* 对lac的预测结果进行干预，每次调用申请临时的编码和查询结果 */
     RVAL parse_customization(const std::vector<std::string> &seq_chars, std::vector<std::string> &tag_ids);
+
+    /* 同上，字的编码和AC自动机的查询结果存于调用方提供的codes和ac_res，重复调用时复用其内存 */
+    RVAL parse_customization(const std::vector<std::string> &seq_chars, std::vector<std::string> &tag_ids,
+            std::vector<uint32_t> &codes, std::vector<std::pair<int, int>> &ac_res);
+
+    /* 同上，codes为各字的编码(char_codes)，AC自动机的查询结果存于调用方提供的ac_res，重复调用时复用其内存 */
+    RVAL parse_customization(const std::vector<uint32_t> &codes, std::vector<std::string> &tag_ids,
+            std::vector<std::pair<int, int>> &ac_res);
+
+    /* 同上，在标签编号label_ids[codes.size()]上原地改写，编号由labels转换，结果与改写标签字符串一致
+     * 词典中的新词性追加到labels中，已有的词性不申请内存 */
+    RVAL parse_customization(const std::vector<uint32_t> &codes, LabelTable &labels, int64_t *label_ids,
+            std::vector<std::pair<int, int>> &ac_res);
+
+    /* 与parse_customization选取相同的匹配，转为逐字的约束写入char_masks[codes.size()]，供Viterbi解码时施加
+     * 词后的第一个字约束为词首，没有匹配的字保持不变 */
+    RVAL decode_constraints(const std::vector<uint32_t> &codes,
+            std::vector<std::pair<int, int>> &ac_res,
+            const ConstraintMasks &masks, const float **char_masks);
+};
+
+/* 按名称登记的用户词典，由多个LAC会话共享，请求按名称选取若干词典叠加(如基础词典加租户词典)
+ * 各词典可以独立地重新装载或增删词条：新版本构建完成后才替换，已取得旧版本的调用不受影响
+ * 增删只重建覆盖层，覆盖层达到合并阈值时由后台线程合并为新的基础自动机 */
+class CustomizationRegistry{
+    private:
+        // 一次增删，合并期间的增删在合并结果上重放
+        struct Update{
+            std::vector<std::string> add;
+            std::vector<std::string> remove;
+        };
+
+        struct Entry{
+            std::string path;
+            std::shared_ptr<Customization> dict;
+            uint64_t generation;            // 每次装载时更新，合并期间重新装载时放弃合并结果
+            bool compacting;
+            std::vector<Update> pending;    // 合并开始后的增删
+        };
+
+        mutable std::mutex _mutex;          // 保护_dicts，只在选取和发布时短暂持有
+        std::mutex _update_mutex;           // 串行化装载、增删和合并结果的发布
+        std::unordered_map<std::string, Entry> _dicts;
+        uint64_t _generation;
+        size_t _compact_threshold;
+        std::function<void(const std::vector<std::string> &)> _tag_listener;
+
+        // 后台合并线程及待合并的词典
+        std::thread _compactor;
+        std::condition_variable _compact_cond;
+        std::deque<std::string> _compact_queue;
+        bool _stop;
+
+        void compact_loop();
+
+    public:
+    CustomizationRegistry():_generation(0), _compact_threshold(4096), _stop(false){}
+
+    ~CustomizationRegistry();
+
+    /* 装载词典文件并登记为name，已登记时替换；装载失败时保留原词典 */
+    RVAL load(const std::string &name, const std::string &path);
+
+    /* 按登记时的文件重新装载 */
+    RVAL reload(const std::string &name);
+
+    RVAL remove(const std::string &name);
+
+    /* 对name的词典增删词条并发布新版本，耗时与覆盖层的词条数成正比，之后选取的调用即可看到
+     * 格式同Customization::update，词典未登记或格式错误时返回_FAILD */
+    RVAL update(const std::string &name, const std::vector<std::string> &add,
+            const std::vector<std::string> &remove);
+
+    /* 将name的覆盖层合并为新的基础自动机并发布，期间不阻塞选取和增删，合并期间的增删在发布前重放 */
+    RVAL compact(const std::string &name);
+
+    /* 覆盖层的词条数达到threshold时在后台合并，0表示不自动合并 */
+    void set_compact_threshold(size_t threshold){
+        _compact_threshold = threshold;
+    }
+
+    /* 装载或增删得到的新词典在发布前以其中的词性调用listener(持有装载锁)，
+     * 如LACPool::add_tags，使之后选取该词典的调用都能按词性过滤 */
+    void set_tag_listener(const std::function<void(const std::vector<std::string> &)> &listener){
+        std::lock_guard<std::mutex> update_lock(_update_mutex);
+        _tag_listener = listener;
+    }
+
+    /* 未登记时返回空 */
+    std::shared_ptr<Customization> get(const std::string &name) const;
+
+    /* 按names的顺序取得各层词典，用作RunOptions::dicts；有未登记的名称时返回_FAILD，missing为该名称 */
+    RVAL select(const std::vector<std::string> &names,
+            std::vector<std::shared_ptr<Customization>> &layers, std::string *missing = NULL) const;
+
+    /* 已登记的名称 */
+    void names(std::vector<std::string> &names) const;
+
+    /* 所有词典中出现的词性，不含重复，用于LAC::add_tags */
+    void collect_tags(std::vector<std::string> &tags) const;
 };
 
 #endif  //BAIDU_LAC_CUSTOM_H
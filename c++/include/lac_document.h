@@ -0,0 +1,64 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_DOCUMENT_H
+#define BAIDU_LAC_DOCUMENT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lac.h"
+
+/* 文档中的一个句子及其分析结果 */
+struct DocumentSentence
+{
+    size_t begin;                    // 句子在文档中的起始字节位置
+    size_t length;                   // 句子的字节长度
+    size_t hash;                     // 句子内容的hash
+    std::vector<OutputItem> items;   // 句子的分析结果
+};
+
+/* 文档级分析：按句缓存结果，文本修改后只重新分析内容变化的句子
+ * 每个句子作为独立的query送入LAC，用户词典的匹配不会跨越句子，
+ * 因此句子内容不变时其结果(含干预结果)可直接复用 */
+class LACDocument
+{
+private:
+    LAC &_lac;
+    bool _rank;
+    std::string _text;
+    std::vector<DocumentSentence> _sentences;
+    std::shared_ptr<Customization> _custom;   // 缓存结果对应的用户词典
+    std::vector<OutputItem> _results;         // 展开后的全文结果
+    bool _results_dirty;
+    size_t _last_analyzed;                    // 最近一次update重新分析的句子数
+
+public:
+    LACDocument(LAC &lac, bool rank = false);
+
+    /* 设置文档的新文本，返回重新分析的句子数 */
+    int update(const std::string &text);
+
+    /* 全文的分析结果 */
+    const std::vector<OutputItem> &results();
+
+    /* 按句访问分析结果，不需要展开全文 */
+    const std::vector<DocumentSentence> &sentences() const { return _sentences; }
+
+    const std::string &text() const { return _text; }
+    size_t last_analyzed() const { return _last_analyzed; }
+};
+
+#endif  // BAIDU_LAC_DOCUMENT_H
@@ -0,0 +1,95 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_JSON_H
+#define BAIDU_LAC_JSON_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lac.h"
+
+/* 追加式JSON输出：直接写入调用方的字符串，不经过ostringstream
+ * 逗号由writer根据嵌套层次自动添加，对象中先调用key再写值 */
+class JsonWriter
+{
+private:
+    std::string &_out;
+    std::vector<bool> _has_item;    // 每一层是否已写入元素
+    bool _after_key;
+
+    void separator();
+
+public:
+    explicit JsonWriter(std::string &out);
+
+    void start_object();
+    void end_object();
+    void start_array();
+    void end_array();
+    void key(const char *name);
+
+    void value(const std::string &str);
+    void value(const char *str, size_t len);
+    void value(int64_t number);
+    void value(int number) { value((int64_t)number); }
+    void value(double number);
+    void value(bool flag);
+    void null_value();
+
+    /* 写入已经是JSON格式的内容 */
+    void raw(const char *json, size_t len);
+};
+
+/* 将字符串转义后追加到out，不含两侧的引号 */
+void json_escape_append(std::string &out, const char *str, size_t len);
+
+/* 按LAC::results_to_json的格式写出一句话的结果 */
+void json_write_items(JsonWriter &writer, const std::vector<OutputItem> &items);
+
+/* 同上，只写出fields(OUTPUT_FIELD的组合)中的字段，FIELD_OFFSET写出offset和length */
+void json_write_items(JsonWriter &writer, const std::vector<OutputItem> &items, int fields);
+
+/* JSON值，用于解析请求 */
+struct JsonValue
+{
+    enum Type
+    {
+        JSON_NULL = 0,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT,
+    };
+
+    Type type;
+    bool boolean;
+    double number;
+    std::string str;
+    std::vector<JsonValue> items;                               // 数组元素
+    std::vector<std::pair<std::string, JsonValue>> members;     // 对象成员，保持原始顺序
+
+    JsonValue() : type(JSON_NULL), boolean(false), number(0) {}
+
+    /* 对象成员查找，不存在或不是对象时返回NULL */
+    const JsonValue *get(const char *name) const;
+};
+
+/* 解析JSON文本，失败时返回false，error中为出错原因和位置；字符串须为合法的UTF-8 */
+bool json_parse(const char *text, size_t len, JsonValue &value, std::string *error = NULL);
+
+#endif  // BAIDU_LAC_JSON_H
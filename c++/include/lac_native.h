@@ -0,0 +1,192 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_NATIVE_H
+#define BAIDU_LAC_NATIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lac_viterbi.h"
+
+/* 原生推理引擎：不依赖Paddle，直接运行embedding-BiGRU-CRF网络(python/LAC/nets.py)
+ * 参数由c++/tools/export_native_model.py从Paddle模型导出为model_path/model.native */
+
+/* 权重的存储精度，由c++/lac_native_quantize.cpp校准并写入参数文件 */
+enum NativePrecision
+{
+    NATIVE_FP32 = 0,
+    NATIVE_BF16,        // 权重存为bfloat16，计算仍为fp32
+    NATIVE_INT8,        // 权重按列对称量化，输入按校准得到的静态步长量化，整数点积
+    NATIVE_PRECISION_NUM,
+};
+
+const char *native_precision_name(NativePrecision precision);
+
+/* 权重矩阵W[k x n]，k为输入维，按precision只使用对应的数据 */
+struct NativeMatrix
+{
+    NativePrecision precision;
+    int rows;                           // k
+    int cols;                           // n
+    std::vector<float> fp32;            // [k x n]
+    std::vector<uint16_t> bf16;         // [k x n]，fp32的高16位(就近舍入)
+    std::vector<int8_t> int8;           // 每4行交错为[k4 / 4][n][4]，k4为k补齐到4的倍数，补齐部分为0
+    std::vector<float> weight_scale;    // [n]，每列权重的量化步长
+    std::vector<float> scale;           // [n]，input_scale * weight_scale，整数点积的反量化系数
+    std::vector<int32_t> compensation;  // [n]，每列权重之和的128倍，VNNI以u8(输入+128)计算时扣除
+    float input_scale;                  // 输入的量化步长，由校准语料中输入的最大绝对值得到
+
+    NativeMatrix() : precision(NATIVE_FP32), rows(0), cols(0), input_scale(0) {}
+
+    int padded_rows() const
+    {
+        return (this->rows + 3) & ~3;
+    }
+
+    size_t bytes() const;
+};
+
+/* embedding表[vocab x emb]，按行查表，INT8时每行一个量化步长 */
+struct NativeEmbedding
+{
+    NativePrecision precision;
+    int rows;
+    int cols;
+    std::vector<float> fp32;
+    std::vector<uint16_t> bf16;
+    std::vector<int8_t> int8;
+    std::vector<float> scale;           // [vocab]
+
+    NativeEmbedding() : precision(NATIVE_FP32), rows(0), cols(0) {}
+
+    /* 将第id行还原为fp32写入out */
+    void lookup(int64_t id, float *out) const;
+
+    size_t bytes() const;
+};
+
+/* 计算核，按CPU支持的指令集在运行时选择，矩阵均为行优先 */
+struct NativeKernels
+{
+    const char *name;
+
+    /* C[m x n] = A[m x k] * B[k x n] + bias[n]，bias可为NULL */
+    void (*gemm)(int m, int n, int k, const float *a, int lda, const float *b, int ldb,
+                 const float *bias, float *c, int ldc);
+
+    /* y[n] += x[k] * W[k x n] */
+    void (*gemv)(int n, int k, const float *x, const float *w, int ldw, float *y);
+
+    /* 与gemm、gemv相同，B、W为bf16 */
+    void (*gemm_bf16)(int m, int n, int k, const float *a, int lda, const uint16_t *b, int ldb,
+                      const float *bias, float *c, int ldc);
+    void (*gemv_bf16)(int n, int k, const float *x, const uint16_t *w, int ldw, float *y);
+
+    /* C[m x n] = (A_q[m x k4] * W_q) * w.scale + bias，A_q为量化后的输入(补齐部分为0)，bias可为NULL */
+    void (*gemm_int8)(int m, const NativeMatrix &w, const int8_t *a, int lda, const float *bias,
+                      float *c, int ldc);
+
+    /* y[n] += (x_q[k4] * W_q) * w.scale */
+    void (*gemv_int8)(const NativeMatrix &w, const int8_t *x, float *y);
+};
+
+/* 各指令集的计算核，未编译或CPU不支持时返回NULL
+ * avx512在CPU支持VNNI时使用VNNI的int8点积，否则int8计算核为NULL，由native_kernels以avx2的补齐 */
+const NativeKernels *native_kernels_scalar();
+const NativeKernels *native_kernels_avx2();
+const NativeKernels *native_kernels_avx512();
+
+/* 当前CPU可用的最快计算核，设置环境变量LAC_NATIVE_ISA(scalar、avx2、avx512)时使用指定的计算核 */
+const NativeKernels *native_kernels();
+
+/* 一个方向的GRU参数，输入投影与GRU的偏置已合并 */
+struct NativeGRU
+{
+    NativeMatrix gate_weight;           // [H x 2H]，更新门和重置门
+    NativeMatrix state_weight;          // [H x H]，候选状态
+};
+
+/* 一层BiGRU：两个方向的输入投影合并为[in x 6H]，对整个batch只做一次矩阵乘 */
+struct NativeLayer
+{
+    int input_dim;
+    NativeMatrix proj_weight;           // [in x 6H]，前3H为正向，后3H为反向
+    std::vector<float> proj_bias;       // [6H]
+    NativeGRU forward;
+    NativeGRU reverse;
+};
+
+/* 模型参数，装载后只读，各会话共享 */
+class NativeModel
+{
+public:
+    int vocab_size;
+    int emb_dim;
+    int hidden_dim;
+    int num_labels;
+    bool origin_mode;                   // Paddle dynamic_gru的origin_mode
+    NativeEmbedding embedding;          // [vocab x emb]
+    std::vector<NativeLayer> layers;
+    NativeMatrix emission_weight;       // [2H x L]
+    std::vector<float> emission_bias;   // [L]
+    std::vector<float> transition;      // [(L + 2) x L]，第0行为起始，第1行为结束，其余为标签间转移
+    ViterbiDecoder decoder;             // 由transition初始化
+
+    NativeModel() : vocab_size(0), emb_dim(0), hidden_dim(0), num_labels(0), origin_mode(false) {}
+
+    /* 装载参数文件，返回0表示成功
+     * 版本1为export_native_model.py导出的fp32参数，版本2为lac_native_quantize写出的按矩阵指定精度的参数 */
+    int load(const std::string &path);
+
+    /* 以版本2的格式写出，返回0表示成功 */
+    int save(const std::string &path) const;
+
+    /* 参数占用的内存字节数 */
+    size_t bytes() const;
+};
+
+/* 将fp32的矩阵转换为指定精度写入dst，INT8时input_scale为输入的量化步长 */
+void native_quantize_matrix(const NativeMatrix &src, NativePrecision precision, float input_scale,
+                            NativeMatrix &dst);
+void native_quantize_embedding(const NativeEmbedding &src, NativePrecision precision, NativeEmbedding &dst);
+
+/* 前向计算的缓冲区，每个会话一份，重复调用时复用内存 */
+struct NativeBuffers
+{
+    std::vector<float> input;           // [T x in]
+    std::vector<float> proj;            // [T x 6H]
+    std::vector<float> output;          // [T x 2H]
+    std::vector<float> gates;           // [3H]
+    std::vector<float> reset_state;     // [H]
+    std::vector<float> emission;        // [T x L]
+    ViterbiBuffers viterbi;
+    std::vector<int8_t> input_q;        // INT8矩阵的量化输入
+
+    /* 校准时记录每个矩阵输入的最大绝对值，为NULL时不记录 */
+    std::map<const NativeMatrix *, float> *calibration;
+
+    NativeBuffers() : calibration(NULL) {}
+};
+
+/* 对count个字(按lod划分句子)运行网络，逐字输出标签id
+ * masks非空时为逐字的标签约束，见ViterbiDecoder::decode */
+void native_forward(const NativeModel &model, const NativeKernels &kernels,
+                    const int64_t *ids, size_t count, const std::vector<size_t> &lod,
+                    NativeBuffers &buffers, int64_t *tags, const float *const *masks = NULL);
+
+#endif  // BAIDU_LAC_NATIVE_H
@@ -0,0 +1,133 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_POOL_H
+#define BAIDU_LAC_POOL_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "lac.h"
+
+/* 流量类别 */
+enum TRAFFIC_CLASS
+{
+    CLASS_INTERACTIVE = 0,  // 交互请求：可使用全部会话
+    CLASS_BULK,             // 批量请求：只使用保留会话之外的空闲会话
+    CLASS_NUM,
+};
+
+/* LAC会话池：由一个已装载模型的LAC拷贝出多个会话，供多线程借出和归还
+ * 拷贝时沿用原型的rank模型、用户词典、降级分词词典和预热配置
+ * 降级分词不借出会话，由调用方以segment()创建各自的SegmentSession
+ * 可为交互请求保留若干会话，批量请求只在空闲会话多于保留数时借出 */
+class LACPool
+{
+private:
+    std::vector<std::unique_ptr<LAC>> _sessions;
+    std::vector<LAC *> _idle;
+    mutable std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _rank_enabled;
+    bool _fallback_enabled;
+    CODE_TYPE _codetype;
+    // 词性表只追加，_synced_tags为各会话已加入的词性数，会话借出时补齐
+    std::vector<std::string> _tag_names;
+    std::unordered_map<std::string, int> _tag_ids;
+    std::vector<size_t> _synced_tags;
+    std::shared_ptr<const Segment> _segment;
+    CustomizationLayers _custom_layers;
+    size_t _reserved;
+
+    bool can_acquire(TRAFFIC_CLASS cls) const
+    {
+        return _idle.size() > (cls == CLASS_BULK ? _reserved : 0);
+    }
+
+    /* 借出前将新登记的词性按顺序加入会话，调用时持有锁 */
+    void sync_tags(LAC *lac);
+
+public:
+    LACPool(LAC &prototype, size_t size);
+
+    /* 借出一个会话，没有可用的空闲会话时阻塞等待 */
+    LAC *acquire(TRAFFIC_CLASS cls = CLASS_INTERACTIVE);
+
+    /* 借出一个会话，没有可用的空闲会话时返回NULL */
+    LAC *try_acquire(TRAFFIC_CLASS cls = CLASS_INTERACTIVE);
+
+    /* 归还会话 */
+    void release(LAC *lac);
+
+    /* 为交互请求保留的会话数，至多为会话数减一 */
+    void set_reserved(size_t reserved);
+    size_t reserved() const { return _reserved; }
+
+    /* 会话在池中的编号(0到size()-1)，不属于本池时返回size() */
+    size_t index(const LAC *lac) const;
+
+    size_t size() const { return _sessions.size(); }
+    size_t idle();
+    bool rank_enabled() const { return _rank_enabled; }
+    bool fallback_enabled() const { return _fallback_enabled; }
+    CODE_TYPE codetype() const { return _codetype; }
+
+    /* 登记新词性，追加到词性表末尾；各会话在下次借出时按相同顺序加入，词性编号在各会话间一致
+     * 用户词典须在发布前登记其词性，如CustomizationRegistry::set_tag_listener */
+    void add_tags(const std::vector<std::string> &tags);
+
+    /* 按当前词性表编译RunOptions::tag_filter，可在会话运行时调用 */
+    TagMask compile_tag_filter(const std::vector<std::string> &tags) const;
+
+    /* 将新登记的词性加入降级分词会话 */
+    void sync_tags(SegmentSession &segment) const;
+
+    /* 原型的降级分词词典，未装载时为空 */
+    const std::shared_ptr<const Segment> &segment() const { return _segment; }
+
+    /* 同LAC::custom_layers，按options选取降级分词干预的词典，未选取时使用原型装载的用户词典 */
+    const CustomizationLayers *custom_layers(const RunOptions &options) const
+    {
+        if (!options.customization)
+        {
+            return NULL;
+        }
+        if (!options.dicts.empty())
+        {
+            return &options.dicts;
+        }
+        return _custom_layers.empty() ? NULL : &_custom_layers;
+    }
+};
+
+/* 在作用域内持有一个会话，离开作用域时自动归还 */
+class LACPoolGuard
+{
+private:
+    LACPool &_pool;
+    LAC *_lac;
+
+public:
+    explicit LACPoolGuard(LACPool &pool, TRAFFIC_CLASS cls = CLASS_INTERACTIVE)
+        : _pool(pool), _lac(pool.acquire(cls)) {}
+    ~LACPoolGuard() { _pool.release(_lac); }
+
+    LAC &operator*() { return *_lac; }
+    LAC *operator->() { return _lac; }
+};
+
+#endif  // BAIDU_LAC_POOL_H
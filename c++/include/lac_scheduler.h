@@ -0,0 +1,266 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_SCHEDULER_H
+#define BAIDU_LAC_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lac.h"
+#include "lac_pool.h"
+
+class SegmentSession;
+
+/* 分析模式 */
+enum LAC_MODE
+{
+    MODE_LAC = 0,       // 分词和词性标注
+    MODE_RANK,          // 附带词语重要性
+    MODE_KEYWORD,       // 只保留重要性不低于keyword_min_rank的词
+};
+
+/* 产生结果的路径 */
+enum LAC_PATH
+{
+    PATH_MODEL = 0,     // 预测器
+    PATH_FALLBACK,      // 降级分词(词典最大概率分词)，过载时使用
+};
+
+/* 请求状态 */
+enum SCHED_STATUS
+{
+    SCHED_OK = 0,
+    SCHED_REJECTED,     // 队列已满，未被接收
+    SCHED_STOPPED,      // 调度器已停止
+    SCHED_UNSUPPORTED,  // 会话池未装载rank模型
+    SCHED_EXPIRED,      // 截止时间前无法完成，未运行即丢弃
+};
+
+/* 调度请求：一个请求可包含多条query，与其他请求合并成batch运行 */
+struct LACRequest
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<std::string> querys;
+    LAC_MODE mode;
+    RunOptions options;             // 干预及词典、只分词、输出字段及词性过滤，rank和keyword模式总是计算rank；降级分词时只干预和过滤词性
+    TRAFFIC_CLASS traffic_class;    // 流量类别，默认为交互请求
+    Clock::time_point deadline;     // 截止时间，默认不限
+
+    // 以下由调度器填写
+    std::vector<std::vector<OutputItem>> results;
+    int status;
+    LAC_PATH path;
+    size_t tokens;          // 所有query的字数之和
+    Clock::time_point enqueue_time;
+    int64_t queue_us;       // 排队耗时(微秒)
+    int64_t run_us;         // 所在batch的运行耗时(微秒)
+
+    // 运行完成后在调度线程中调用
+    std::function<void(LACRequest &)> done;
+
+    LACRequest()
+        : mode(MODE_LAC), traffic_class(CLASS_INTERACTIVE), deadline(Clock::time_point::max()), status(SCHED_OK),
+          path(PATH_MODEL), tokens(0), queue_us(0), run_us(0) {}
+
+    /* 以当前时间为起点设置截止时间 */
+    void set_timeout_us(int64_t timeout_us)
+    {
+        deadline = Clock::now() + std::chrono::microseconds(timeout_us);
+    }
+
+    bool has_deadline() const { return deadline != Clock::time_point::max(); }
+};
+
+typedef std::shared_ptr<LACRequest> LACRequestPtr;
+
+/* 单个流量类别的调度配置 */
+struct ClassConfig
+{
+    int weight;                 // 多个类别都有batch可运行时，按权重比例分配
+    size_t max_batch_size;      // 每个batch最多的query数
+    size_t max_batch_tokens;    // 每个batch最多的字数，0表示不限
+    int max_wait_us;            // 凑batch的最长等待时间(微秒)
+
+    ClassConfig(int weight, size_t max_batch_size, size_t max_batch_tokens, int max_wait_us)
+        : weight(weight), max_batch_size(max_batch_size), max_batch_tokens(max_batch_tokens),
+          max_wait_us(max_wait_us) {}
+};
+
+/* 调度配置 */
+struct SchedulerConfig
+{
+    ClassConfig classes[CLASS_NUM];     // 交互请求默认小batch，批量请求按字数凑大batch
+    size_t reserved_sessions;   // 为交互请求保留的会话数，批量请求只使用其余的空闲会话
+    size_t max_queue_depth;     // 排队query数上限，超过时拒绝新请求
+    size_t num_workers;         // 调度线程数，0表示与会话数相同；可以降级时至少比会话数多一个
+    int keyword_min_rank;       // keyword模式保留的最低重要性
+    int deadline_slack_us;      // 凑batch时在截止时间前预留的余量(微秒)
+    int fallback_queue_us;      // 排队超过该时间(微秒)的请求改用降级分词，0表示不降级
+
+    SchedulerConfig()
+        : classes{ClassConfig(4, 8, 0, 1000), ClassConfig(1, 256, 16384, 20000)},
+          reserved_sessions(1), max_queue_depth(4096), num_workers(0), keyword_min_rank(2),
+          deadline_slack_us(1000), fallback_queue_us(0) {}
+};
+
+/* 单个流量类别的统计 */
+struct ClassMetrics
+{
+    std::atomic<uint64_t> requests;         // 已接收的请求数
+    std::atomic<uint64_t> completed;        // 已完成的请求数
+    std::atomic<uint64_t> batches;          // 以预测器运行的batch数
+    std::atomic<uint64_t> queue_us;         // 请求排队耗时之和
+
+    ClassMetrics() : requests(0), completed(0), batches(0), queue_us(0) {}
+};
+
+/* 调度统计 */
+struct SchedulerMetrics
+{
+    std::atomic<uint64_t> requests;         // 已接收的请求数
+    std::atomic<uint64_t> rejected;         // 因队列已满被拒绝的请求数
+    std::atomic<uint64_t> shed;             // 预计无法在截止时间前完成、未运行即丢弃的请求数
+    std::atomic<uint64_t> deadline_missed;  // 已运行但完成时超过截止时间的请求数
+    std::atomic<uint64_t> fallback;         // 改用降级分词完成的请求数
+    std::atomic<uint64_t> completed;        // 已完成的请求数
+    std::atomic<uint64_t> querys;           // 已完成的query数
+    std::atomic<uint64_t> batches;          // 已运行的batch数
+    std::atomic<uint64_t> queue_us;         // 请求排队耗时之和
+    std::atomic<uint64_t> run_us;           // batch运行耗时之和
+    ClassMetrics classes[CLASS_NUM];
+
+    SchedulerMetrics()
+        : requests(0), rejected(0), shed(0), deadline_missed(0), fallback(0), completed(0), querys(0), batches(0),
+          queue_us(0), run_us(0) {}
+};
+
+/* 批量调度器：请求进入共享队列，调度线程从会话池借出会话，将同类请求合并成batch运行
+ * 队列中的query数超过max_queue_depth时拒绝新请求
+ * 每个流量类别一个队列，都有batch可运行时按权重轮流运行(步长调度)；批量请求只借用保留会话之外的空闲会话
+ * 队列按截止时间排序(EDF)，没有截止时间的请求排在最后并保持到达顺序；
+ * 按最近batch的运行耗时估计完成时间，来不及完成的请求在进入预测器前丢弃
+ * 设置fallback_queue_us且会话装载了降级分词词典时，排队过久或预测器来不及完成的请求改用降级分词 */
+class BatchScheduler
+{
+private:
+    LACPool &_pool;
+    SchedulerConfig _config;
+    SchedulerMetrics _metrics;
+
+    std::deque<LACRequestPtr> _queues[CLASS_NUM];
+    size_t _class_querys[CLASS_NUM];
+    size_t _class_tokens[CLASS_NUM];
+    size_t _queued_querys;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _stop;
+    std::vector<std::thread> _workers;
+    int64_t _estimate_us[CLASS_NUM];    // batch运行耗时的滑动平均，用于判断能否按时完成
+    uint64_t _pass[CLASS_NUM];          // 步长调度的进度，每运行一个batch增加STRIDE / weight
+    uint64_t _vtime;                    // 最近运行的batch开始时的进度
+
+    /* 第cls类的队列是否可以凑成batch，不能时将预计可以的时间合并到wake_time，调用时持有锁 */
+    bool batch_ready(int cls, LACRequest::Clock::time_point now, LACRequest::Clock::time_point &wake_time);
+
+    /* 在可以凑成batch且借到会话的类别中选进度最小的，返回类别，没有时返回-1，调用时持有锁 */
+    int pick_class(LACRequest::Clock::time_point now, LACRequest::Clock::time_point &wake_time, LAC *&lac);
+
+    /* 按截止时间插入所属类别的队列，调用时持有锁 */
+    void enqueue(const LACRequestPtr &request);
+
+    /* 请求出队时扣除排队计数，调用时持有锁 */
+    void remove_queued(const LACRequest &request);
+
+    /* 取出队首来不及完成的请求，调用时持有锁
+     * 可以降级时，截止时间未到的请求放入fallback，其余放入expired；新的队首将来不及完成的时间合并到wake_time */
+    void take_expired(LACRequest::Clock::time_point now, std::vector<LACRequestPtr> &expired,
+                      std::vector<LACRequestPtr> &fallback, LACRequest::Clock::time_point &wake_time);
+
+    /* 取出排队超过fallback_queue_us的请求，其余请求中最早需要降级的时间合并到wake_time，调用时持有锁 */
+    void take_fallback(LACRequest::Clock::time_point now, std::vector<LACRequestPtr> &fallback,
+                       LACRequest::Clock::time_point &wake_time);
+
+    bool fallback_enabled() const { return _config.fallback_queue_us > 0 && _pool.fallback_enabled(); }
+
+    /* 以SCHED_EXPIRED完成被丢弃的请求 */
+    void finish_expired(std::vector<LACRequestPtr> &expired);
+
+    /* 调度线程：凑batch、运行、分发结果 */
+    void worker_loop();
+
+    /* 从第cls类的队列中取出与第一个请求同模式、同选项的请求组成batch，调用时持有锁 */
+    void take_batch(int cls, std::vector<LACRequestPtr> &batch);
+
+    /* 用会话lac运行一个batch，lac为NULL时用segment降级分词 */
+    void run_batch(std::vector<LACRequestPtr> &batch, LAC *lac, SegmentSession *segment,
+                   std::vector<std::string> &querys,
+                   std::vector<std::vector<OutputItem>> &results);
+
+public:
+    BatchScheduler(LACPool &pool, const SchedulerConfig &config = SchedulerConfig());
+    ~BatchScheduler();
+
+    /* 提交请求，返回SCHED_OK表示已进入队列，完成后调用request->done
+     * 其余返回值表示请求未被接收，不会调用done */
+    int submit(const LACRequestPtr &request);
+
+    /* 同步运行：提交后等待完成，返回请求状态 */
+    int run(const std::vector<std::string> &querys, LAC_MODE mode,
+            std::vector<std::vector<OutputItem>> &results);
+
+    /* 同上，带截止时间，来不及完成时返回SCHED_EXPIRED */
+    int run(const std::vector<std::string> &querys, LAC_MODE mode,
+            std::vector<std::vector<OutputItem>> &results, LACRequest::Clock::time_point deadline);
+
+    /* 停止调度线程，队列中未运行的请求以SCHED_STOPPED完成 */
+    void stop();
+
+    /* 当前排队的query数 */
+    size_t queue_depth();
+    size_t queue_depth(TRAFFIC_CLASS cls);
+
+    /* 当前估计的batch运行耗时(微秒) */
+    int64_t estimate_us(TRAFFIC_CLASS cls = CLASS_INTERACTIVE);
+
+    const LACPool &pool() const { return _pool; }
+    const SchedulerMetrics &metrics() const { return _metrics; }
+    const SchedulerConfig &config() const { return _config; }
+
+    /* 以Prometheus文本格式追加统计信息 */
+    void write_metrics(std::string &out);
+};
+
+/* 模式名称与枚举的转换，名称为lac、rank、keyword，未知名称返回false */
+bool parse_lac_mode(const std::string &name, LAC_MODE &mode);
+const char *lac_mode_name(LAC_MODE mode);
+
+/* 路径名称：model、fallback */
+const char *lac_path_name(LAC_PATH path);
+
+/* 流量类别名称与枚举的转换，名称为interactive、bulk，未知名称返回false */
+bool parse_traffic_class(const std::string &name, TRAFFIC_CLASS &cls);
+const char *traffic_class_name(TRAFFIC_CLASS cls);
+
+#endif  // BAIDU_LAC_SCHEDULER_H
@@ -0,0 +1,117 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#ifndef BAIDU_LAC_SEGMENT_H
+#define BAIDU_LAC_SEGMENT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lac.h"
+#include "lac_util.h"
+
+/* 基于词频的最大概率分词(与python/LAC/segment.py相同)，不运行预测器，用于过载时的降级
+ * 词典每行为"词 词频 [词性]"，装载后只读，可由多个会话共享 */
+class Segment
+{
+private:
+    /* 前缀树结点，count为0表示只是词的前缀 */
+    struct TrieNode
+    {
+        int64_t count;
+        int tag;        // 词性在_tags中的下标
+
+        TrieNode() : count(0), tag(0) {}
+    };
+
+    // 所有结点存于同一数组，边以(父结点, 字编号)为键存于同一个哈希表
+    std::vector<TrieNode> _nodes;
+    std::unordered_map<uint64_t, int> _edges;
+    std::unordered_map<std::string, int> _char_ids;
+    std::vector<std::string> _tags;
+    int64_t _total;         // 词频之和
+    double _log_total;
+    CODE_TYPE _codetype;
+
+    int child(int node, int char_id) const
+    {
+        auto it = _edges.find(((uint64_t)node << 32) | (uint32_t)char_id);
+        return it == _edges.end() ? -1 : it->second;
+    }
+
+public:
+    Segment(const std::string &dict_path, CODE_TYPE codetype = CODE_UTF8);
+
+    /* 装载词典，可多次调用追加 */
+    RVAL load_dict(const std::string &dict_path);
+
+    /* 词典中出现的所有词性，第一个为空词性 */
+    const std::vector<std::string> &tags() const { return _tags; }
+
+    size_t word_count() const;
+
+    CODE_TYPE codetype() const { return _codetype; }
+
+    /* 对切分好的字序列分词，结果以"词性-B"、"词性-I"标签存于labels
+     * 连续的单个英文字母或数字合并为一个词；char_ids和route为调用方提供的缓冲区 */
+    RVAL cut(const std::vector<std::string> &chars, std::vector<std::string> &labels,
+             std::vector<int> &char_ids, std::vector<std::pair<double, int>> &route) const;
+};
+
+/* 降级分词会话：共享只读的Segment，持有各自的缓冲区，不占用LAC的预测器会话
+ * 词性编号与sync_tags登记的词性表(如LAC::tag_names())一致，供tag_filter使用 */
+class SegmentSession
+{
+private:
+    std::shared_ptr<const Segment> _segment;
+    std::vector<std::string> _chars;
+    std::vector<std::string> _labels;
+    std::vector<int> _char_ids;
+    std::vector<std::pair<double, int>> _route;
+    std::vector<uint32_t> _char_codes;
+    std::vector<std::pair<int, int>> _ac_res;
+    // 以"词性-B"、"词性-I"标签为键的词性编号，取词性时不必截取标签
+    std::unordered_map<std::string, int> _label_tag_ids;
+    size_t _tag_count;
+
+    int label_tag_id(const std::string &label) const
+    {
+        auto it = _label_tag_ids.find(label);
+        return it == _label_tag_ids.end() ? -1 : it->second;
+    }
+
+    void append_words(const RunOptions &options, std::vector<OutputItem> &result) const;
+
+public:
+    explicit SegmentSession(const std::shared_ptr<const Segment> &segment)
+        : _segment(segment), _tag_count(0) {}
+
+    const std::shared_ptr<const Segment> &segment() const { return _segment; }
+
+    /* 登记词性表中新增的词性，tag_names只追加不修改 */
+    void sync_tags(const std::vector<std::string> &tag_names);
+    size_t tag_count() const { return _tag_count; }
+
+    /* 分词后按layers依次干预(为NULL时不干预)，只输出词性通过options.tag_filter的词
+     * rank均为0，其余选项不生效 */
+    int run(const std::vector<std::string> &querys, const CustomizationLayers *layers,
+            const RunOptions &options, std::vector<std::vector<OutputItem>> &results);
+};
+
+#endif  // BAIDU_LAC_SEGMENT_H
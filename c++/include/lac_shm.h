@@ -0,0 +1,234 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_SHM_H
+#define BAIDU_LAC_SHM_H
+
+/* 共享内存传输：同一台机器上的进程通过/dev/shm中的环形队列调用LAC
+ * 客户端将query直接写入槽位，守护进程在原地分析并将WordSpan结果写回同一槽位，
+ * 整个过程不做序列化。仅支持Linux(futex) */
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lac.h"
+#include "lac_pool.h"
+#include "lac_scheduler.h"
+
+#define LAC_SHM_MAGIC 0x5343414c        // "LACS"
+#define LAC_SHM_VERSION 2
+#define LAC_SHM_TAG_BYTES 4096          // 词性表的最大字节数
+
+/* 调用结果 */
+enum LAC_SHM_STATUS
+{
+    SHM_OK = 0,
+    SHM_TOO_LARGE = -1,         // 请求或结果超过槽位大小
+    SHM_INVALID = -2,           // 请求格式错误
+    SHM_UNSUPPORTED = -3,       // 守护进程未装载rank模型
+    SHM_TIMEOUT = -4,           // 等待超时
+    SHM_NOT_CONNECTED = -5,     // 未连接或共享内存格式不符
+};
+
+/* 传输配置，守护进程和客户端共用 */
+struct LACShmConfig
+{
+    uint32_t slot_count;        // 槽位数，取2的幂
+    uint32_t slot_bytes;        // 每个槽位的数据区大小，向上取8的倍数
+    uint32_t max_batch;         // 守护进程每次最多取出的槽位数
+    int spin_us;                // 进入futex等待前自旋的时间(微秒)
+    bool block;                 // 自旋后是否进入futex等待，false时一直自旋(让出CPU)
+    int timeout_ms;             // 客户端等待结果的超时时间，0表示不超时
+    int keyword_min_rank;       // keyword模式保留的最低重要性
+    uint32_t file_mode;         // 守护进程创建共享内存的权限，默认只允许同一用户的进程连接
+
+    LACShmConfig()
+        : slot_count(64), slot_bytes(64 * 1024), max_batch(32), spin_us(50), block(true),
+          timeout_ms(5000), keyword_min_rank(2), file_mode(0600) {}
+};
+
+/* 共享内存头部，之后依次为slot_count个槽位 */
+struct LACShmHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_bytes;
+    uint32_t slot_stride;       // 相邻槽位的间隔，含槽位头部
+    uint32_t rank_enabled;
+    uint32_t tag_count;
+    int32_t spin_us;            // 守护进程的自旋配置，客户端默认沿用
+    uint32_t block;
+
+    alignas(64) std::atomic<uint64_t> head;     // 下一个写入的位置(客户端)
+    alignas(64) std::atomic<uint64_t> tail;     // 下一个读取的位置(守护进程)
+    alignas(64) std::atomic<uint32_t> server_seq;       // 有新请求时递增，守护进程在此futex等待
+    std::atomic<uint32_t> server_waiters;
+
+    char tags[LAC_SHM_TAG_BYTES];               // 以'\0'分隔的词性表
+};
+
+/* 槽位状态 */
+enum LAC_SHM_SLOT_STATE
+{
+    SLOT_EMPTY = 0,
+    SLOT_QUEUED,
+    SLOT_DONE,
+    SLOT_ABANDONED,             // 客户端等待超时，守护进程完成后直接回收
+};
+
+/* 槽位头部，之后是slot_bytes的数据区：
+ * 请求：uint32_t query_offsets[query_count + 1]，之后为所有query的文本
+ * 结果：8字节对齐的WordSpan spans[span_count]，之后为uint32_t span_lod[query_count + 1]
+ * seq为无锁多生产者队列(Vyukov)的序号，客户端取得位置pos时seq == pos，提交后为pos + 1，
+ * 取回结果后置为pos + slot_count供下一轮使用
+ * owner为占用槽位的客户端进程号(租约)，客户端在提交前异常退出或未归还结果时由守护进程回收槽位；
+ * 守护进程与客户端须在同一pid命名空间 */
+struct LACShmSlot
+{
+    std::atomic<uint64_t> seq;
+    std::atomic<uint32_t> state;        // 客户端在此futex等待
+    std::atomic<uint32_t> waiting;      // 客户端是否在futex等待
+    uint32_t mode;
+    int32_t status;
+    uint32_t query_count;
+    uint32_t text_bytes;
+    uint32_t span_count;
+    std::atomic<uint32_t> owner;        // 占用槽位的客户端进程号，0表示无
+};
+
+/* 一次调用的结果，指向共享内存，release前有效 */
+struct LACShmResult
+{
+    const WordSpan *spans;
+    const uint32_t *span_lod;   // 第i个query的词为spans[span_lod[i], span_lod[i+1])
+    uint32_t query_count;
+    LACShmSlot *slot;
+    uint64_t ticket;
+
+    LACShmResult() : spans(NULL), span_lod(NULL), query_count(0), slot(NULL), ticket(0) {}
+};
+
+/* 守护进程端：创建共享内存，调度线程从队列中批量取出请求，借用LACPool中的会话运行 */
+class LACShmServer
+{
+private:
+    /* 从槽位复制到守护进程内存的请求，复制后不再读取槽位中的长度和偏移 */
+    struct SlotRequest
+    {
+        LACShmSlot *slot;
+        uint32_t mode;
+        uint32_t query_count;
+        uint32_t text_bytes;
+        size_t offsets;         // query偏移在偏移缓冲区中的起点，共query_count + 1个
+    };
+
+    LACPool &_pool;
+    LACShmConfig _config;
+    std::string _name;
+    LACShmHeader *_header;
+    size_t _size;
+    std::atomic<bool> _stop;
+    std::vector<std::thread> _workers;
+
+    // 统计
+    std::atomic<uint64_t> _requests;
+    std::atomic<uint64_t> _batches;
+    std::atomic<uint64_t> _reclaimed;
+
+    // 租约检查，同一时间只有一个调度线程执行
+    std::mutex _reclaim_mutex;
+    int64_t _last_reclaim_us;
+    uint64_t _stalled_pos;          // 已取得位置但未提交、也未登记进程号的队首位置
+    int64_t _stalled_since_us;
+
+    LACShmSlot *slot(uint64_t pos);
+    char *slot_data(LACShmSlot *slot) { return (char *)(slot + 1); }
+
+    /* 取出连续的已提交槽位，返回个数 */
+    size_t take_batch(uint64_t &first);
+
+    /* 等待新请求 */
+    void wait_requests();
+
+    void worker_loop();
+
+    /* 运行一组同类请求并写回结果，offsets为read_request复制出的偏移 */
+    void run_slots(LAC &lac, const std::vector<SlotRequest> &requests, bool rank,
+                   const std::vector<uint32_t> &offsets, std::vector<const char *> &texts,
+                   std::vector<int> &lens, std::vector<WordSpan> &spans, std::vector<size_t> &span_lod);
+
+    /* 将请求的长度和偏移复制到request和offsets中再检查格式，客户端之后的改写不影响守护进程 */
+    int read_request(LACShmSlot *slot, SlotRequest &request, std::vector<uint32_t> &offsets);
+
+    /* 写回完成状态并唤醒客户端 */
+    void complete(LACShmSlot *slot, uint64_t pos);
+
+    /* 回收客户端已退出的槽位：队首未提交的槽位跳过，已完成未归还的槽位归还，每隔一段时间检查一次 */
+    void reclaim_slots();
+
+public:
+    LACShmServer(LACPool &pool, const LACShmConfig &config = LACShmConfig());
+    ~LACShmServer();
+
+    /* 创建名为name(如"/lac")的共享内存并启动调度线程，权限为config.file_mode
+     * 以O_EXCL新建，不打开已存在的对象；已存在(如上次异常退出时遗留)时先删除再新建 */
+    int start(const std::string &name, const std::vector<std::string> &tag_names, size_t num_workers = 0);
+
+    /* 停止调度线程并删除共享内存 */
+    void stop();
+
+    uint64_t requests() const { return _requests.load(); }
+    uint64_t batches() const { return _batches.load(); }
+    uint64_t reclaimed() const { return _reclaimed.load(); }
+};
+
+/* 客户端：连接守护进程创建的共享内存，每次调用占用一个槽位 */
+class LACShmClient
+{
+private:
+    LACShmConfig _config;
+    LACShmHeader *_header;
+    size_t _size;
+    std::vector<std::string> _tag_names;
+
+    LACShmSlot *slot(uint64_t pos);
+
+public:
+    /* config中的spin_us为负数时沿用守护进程的配置 */
+    explicit LACShmClient(const LACShmConfig &config = LACShmConfig());
+    ~LACShmClient();
+
+    int connect(const std::string &name);
+    void disconnect();
+
+    /* 提交querys并等待结果，成功时result指向共享内存中的结果，用完后调用release */
+    int run(const std::vector<std::string> &querys, LAC_MODE mode, LACShmResult &result);
+    int run(const char *const *texts, const int *lens, size_t count, LAC_MODE mode, LACShmResult &result);
+
+    /* 归还槽位 */
+    void release(LACShmResult &result);
+
+    /* 词性表，WordSpan::tag_id为其下标 */
+    const std::vector<std::string> &tag_names() const { return _tag_names; }
+};
+
+#endif  // __linux__
+
+#endif  // BAIDU_LAC_SHM_H
@@ -0,0 +1,60 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_STREAM_H
+#define BAIDU_LAC_STREAM_H
+
+#include <string>
+#include <vector>
+
+#include "lac.h"
+
+/* 流式分析会话：文本分片到达后按句切分，句子一结束即送入LAC分析
+ * 末尾未结束的句子保留到句末标点到达或flush为止；句末标点恰好是已到达的最后一个字符时，
+ * 句子保留到下次push或flush，以便把紧随其后的闭合引号、括号归入该句
+ * 会话内部直接使用传入的LAC对象，多线程时每个线程应使用各自的LAC拷贝 */
+class LACStream
+{
+private:
+    LAC &_lac;
+    bool _rank;
+    size_t _max_pending;                      // 未结束句子的最大字节数，超过则强制切分
+    std::string _pending;                     // 尚未结束的句子
+    std::vector<std::string> _sentences;      // 已结束、待分析的句子
+    std::vector<std::vector<OutputItem>> _ready;   // 已分析完成、待poll的结果，每句一项
+    std::vector<std::vector<OutputItem>> _results_batch;
+
+    /* 分析_sentences中的句子并追加到_ready */
+    int analyze();
+
+public:
+    LACStream(LAC &lac, bool rank = false, size_t max_pending = 4096);
+
+    /* 追加文本分片，返回本次分析完成的句子数 */
+    int push(const std::string &fragment);
+
+    /* 取出已分析完成的结果，按句子到达的顺序每句一项 */
+    std::vector<std::vector<OutputItem>> poll();
+
+    /* 将未结束的句子作为完整句子分析，返回分析的句子数 */
+    int flush();
+
+    /* 丢弃未结束的句子和未取出的结果 */
+    void reset();
+
+    /* 未结束句子的字节数 */
+    size_t pending_size() const { return _pending.size(); }
+};
+
+#endif  // BAIDU_LAC_STREAM_H
@@ -17,7 +17,9 @@ limitations under the License. */
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <unordered_map>
 
 #include "lac.h"
@@ -44,15 +46,45 @@ RVAL load_q2b_dict(const std::string &filepath,
 RVAL load_id2label_dict(const std::string &filepath,
                         std::unordered_map<int64_t, std::string> &kv_dict);
 
-/* 获取下一个字的长度 */
+/* 获取下一个字的长度，只读取str起始的len字节，不会越过len读取
+ * get_next_gb18030/get_next_utf8在字符不完整或不合法时返回0，get_next_word此时返回1 */
+int get_next_gb18030(const char *str, int len);
+int get_next_utf8(const char *str, int len);
+int get_next_word(const char *str, int len, CODE_TYPE codetype);
+
+/* 同上，str须以\0结尾 */
 int get_next_gb18030(const char *str);
 int get_next_utf8(const char *str);
 int get_next_word(const char *str, CODE_TYPE codetype);
 
+/* str起始的len字节是否为被截断的多字节字符，后续字节到达后可能构成完整的字符 */
+bool is_incomplete_char(const char *str, int len, CODE_TYPE codetype);
+
 /* 将字符串按照单字切分 */
 RVAL split_words(const char *input, int len, CODE_TYPE codetype, std::vector<std::string> &words);
 RVAL split_words(const std::string &input, CODE_TYPE codetype, std::vector<std::string> &words);
 
+/* 字符的编码：将字符的各字节依次拼为整数，split_words切分出的字符不超过4字节，不同字符的编码不同
+ * 与编码方式无关，用户词典以此在字id序列上匹配 */
+uint32_t char_code(const char *str, int len);
+uint32_t char_code(const std::string &ch);
+
+/* 各字符的编码，codes中已有的内存会被复用 */
+void char_codes(const std::vector<std::string> &chars, std::vector<uint32_t> &codes);
+
+/* 判断str起始的字符是否为句末标点或句末的闭合引号、括号 */
+bool is_sentence_terminator(const char *str, int len, CODE_TYPE codetype);
+bool is_sentence_closer(const char *str, int len, CODE_TYPE codetype);
+
+/* 返回input中第一个完整句子的字节长度(含句末标点)，不存在句末标点或句末处的字符被截断时返回0 */
+int get_sentence_end(const char *input, int len, CODE_TYPE codetype);
+
+/* 并行线程数：threads大于0时直接使用，否则为CPU核数，且每个线程至少分到min_items项 */
+int parallel_threads(int threads, size_t items, size_t min_items);
+
+/* 将[0, count)均分为threads段，fn(begin, end, 段号)在各自的线程中执行，threads不大于1时在当前线程执行 */
+void parallel_for(size_t count, int threads, const std::function<void(size_t, size_t, int)> &fn);
+
 #endif  // BAIDU_LAC_LAC_UTIL_H
 
 
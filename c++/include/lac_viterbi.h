@@ -0,0 +1,115 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#ifndef BAIDU_LAC_VITERBI_H
+#define BAIDU_LAC_VITERBI_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* CRF的Viterbi解码，结果与Paddle的crf_decoding一致(分数相同时取编号较小的标签)
+ * 一个batch的各句按时间步交替解码，每一步的max-plus在标签维上向量化 */
+
+/* 64字节(一个缓存行)对齐的float数组 */
+class AlignedFloats
+{
+private:
+    std::vector<float> _storage;
+    size_t _offset;
+    size_t _size;
+
+public:
+    AlignedFloats() : _offset(0), _size(0) {}
+    AlignedFloats(const AlignedFloats &other);
+    AlignedFloats &operator=(const AlignedFloats &other);
+
+    /* 重设为n个value，容量足够时不重新申请内存 */
+    void assign(size_t n, float value);
+
+    float *data()
+    {
+        return this->_storage.data() + this->_offset;
+    }
+
+    const float *data() const
+    {
+        return this->_storage.data() + this->_offset;
+    }
+
+    size_t size() const
+    {
+        return this->_size;
+    }
+};
+
+/* 一个时间步：score[j] = max_i(prev[i] + trans[i * padded + j]) + emission[j]，arg[j]为取得最大值的最小的i
+ * prev、trans、score按64字节对齐，长度为padded(L补齐到16的倍数)；emission、arg长度为L */
+typedef void (*ViterbiStep)(int L, int padded, const float *prev, const float *trans, const float *emission,
+                            float *score, int *arg);
+
+struct ViterbiKernel
+{
+    const char *name;
+    ViterbiStep step;
+};
+
+/* 各指令集的解码核，未编译或CPU不支持时返回NULL */
+const ViterbiKernel *viterbi_kernel_scalar();
+const ViterbiKernel *viterbi_kernel_avx2();
+const ViterbiKernel *viterbi_kernel_avx512();
+
+/* 当前CPU可用的最快解码核，设置环境变量LAC_VITERBI_ISA(scalar、avx2、avx512)时使用指定的解码核 */
+const ViterbiKernel *viterbi_kernel();
+
+/* 解码的缓冲区，每个会话一份，重复调用时复用内存 */
+struct ViterbiBuffers
+{
+    AlignedFloats alpha;            // [句数 x 2 x padded]，每句两行交替使用
+    AlignedFloats row;              // [padded]，施加约束后的发射分数
+    std::vector<int> path;          // [T x L]
+};
+
+class ViterbiDecoder
+{
+private:
+    int _num_labels;
+    int _padded;
+    std::vector<float> _start;      // [L]
+    std::vector<float> _end;        // [L]
+    AlignedFloats _trans;           // [L x padded]，按行补齐，补齐部分为-inf
+    const ViterbiKernel *_kernel;
+
+public:
+    ViterbiDecoder() : _num_labels(0), _padded(0), _kernel(NULL) {}
+
+    /* transition为[(L + 2) x L]，第0行为起始，第1行为结束，其余为标签间转移(Paddle crf_decoding的参数) */
+    void init(const float *transition, int num_labels);
+
+    /* 读取c++/tools/export_emission_model.py导出的转移矩阵文件，返回0表示成功 */
+    int load(const std::string &path);
+
+    int num_labels() const
+    {
+        return this->_num_labels;
+    }
+
+    /* emission为[count x L]，lod为各句的起止位置，结果写入tags[count]
+     * masks非空时masks[t]为第t个字的标签约束(长度L，允许的标签为0，其余为-inf)，为NULL的字不约束 */
+    void decode(const float *emission, const std::vector<size_t> &lod, const float *const *masks,
+                ViterbiBuffers &buffers, int64_t *tags) const;
+};
+
+#endif  // BAIDU_LAC_VITERBI_H
@@ -0,0 +1,239 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 内存申请检查：替换全局operator new，统计预热后每个处理阶段的内存申请次数和字节数。
+ * 预热后基于偏移输出的run_offsets/run_rank_offsets(含用户词典干预)应不再申请内存，
+ * 预测器内部的申请单独列出，仅在--strict时计入检查。 */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include "lac.h"
+
+using namespace std;
+
+/* 各阶段的统计，下标STAGE_NUM记录阶段之外的申请 */
+static bool g_counting = false;
+static int g_stage = STAGE_NUM;
+static size_t g_alloc_count[STAGE_NUM + 1];
+static size_t g_alloc_bytes[STAGE_NUM + 1];
+
+static const char *STAGE_NAMES[STAGE_NUM + 1] = {
+    "tokenize", "predict", "rank_predict", "decode", "customization", "output", "other"};
+
+static void *counted_alloc(size_t size)
+{
+    if (g_counting)
+    {
+        g_alloc_count[g_stage]++;
+        g_alloc_bytes[g_stage] += size;
+    }
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size) { return counted_alloc(size); }
+void *operator new[](size_t size) { return counted_alloc(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static void stage_hook(LAC_STAGE stage, void *context)
+{
+    g_stage = stage;
+}
+
+static void reset_counters()
+{
+    memset(g_alloc_count, 0, sizeof(g_alloc_count));
+    memset(g_alloc_bytes, 0, sizeof(g_alloc_bytes));
+}
+
+/* 判断阶段是否属于预测器内部 */
+static bool is_predictor_stage(int stage)
+{
+    return stage == STAGE_PREDICT || stage == STAGE_RANK_PREDICT;
+}
+
+/* 运行一种模式：先预热，再统计iters轮的内存申请，返回是否通过检查 */
+static bool check_mode(LAC &lac, bool rank, const vector<string> &querys, int iters, bool strict)
+{
+    vector<WordSpan> spans;
+    vector<size_t> span_lod;
+    vector<string> single(1);
+
+    // 预热：整批和逐条各运行两轮，使所有缓冲区达到所需大小
+    for (int round = 0; round < 2; ++round)
+    {
+        rank ? lac.run_rank_offsets(querys, spans, span_lod) : lac.run_offsets(querys, spans, span_lod);
+        for (size_t i = 0; i < querys.size(); ++i)
+        {
+            single[0] = querys[i];
+            rank ? lac.run_rank_offsets(single, spans, span_lod) : lac.run_offsets(single, spans, span_lod);
+        }
+    }
+
+    size_t words = 0;
+    reset_counters();
+    auto start_time = chrono::high_resolution_clock::now();
+    for (int it = 0; it < iters; ++it)
+    {
+        g_stage = STAGE_NUM;
+        g_counting = true;
+        rank ? lac.run_rank_offsets(querys, spans, span_lod) : lac.run_offsets(querys, spans, span_lod);
+        g_counting = false;
+        words += spans.size();
+
+        for (size_t i = 0; i < querys.size(); ++i)
+        {
+            single[0].assign(querys[i]);
+            g_stage = STAGE_NUM;
+            g_counting = true;
+            rank ? lac.run_rank_offsets(single, spans, span_lod) : lac.run_offsets(single, spans, span_lod);
+            g_counting = false;
+            words += spans.size();
+        }
+    }
+    auto end_time = chrono::high_resolution_clock::now();
+    double total_ms = chrono::duration_cast<chrono::microseconds>(end_time - start_time).count() / 1000.0;
+    size_t calls = (size_t)iters * (querys.size() + 1);
+
+    bool passed = true;
+    for (int s = 0; s <= STAGE_NUM; ++s)
+    {
+        if (g_alloc_count[s] > 0 && (strict || !is_predictor_stage(s)))
+        {
+            passed = false;
+        }
+    }
+
+    cout << (rank ? "run_rank_offsets" : "run_offsets") << ": " << calls << " 次调用, "
+         << words << " 个词, 平均耗时 " << total_ms / calls << " 毫秒, "
+         << (passed ? "PASS" : "FAIL") << endl;
+    for (int s = 0; s <= STAGE_NUM; ++s)
+    {
+        if (s == STAGE_RANK_PREDICT && !rank)
+        {
+            continue;
+        }
+        printf("  %-14s allocs=%-8zu bytes=%-10zu%s\n", STAGE_NAMES[s], g_alloc_count[s], g_alloc_bytes[s],
+               is_predictor_stage(s) && !strict ? " (predictor, not checked)" : "");
+    }
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    string model_path = "../models/lac_model";
+    string rank_path = "";
+    string dict_path = "";
+    string input_path = "";
+    int iters = 100;
+    bool strict = false;
+    LAC_BACKEND backend = default_backend();
+
+    if (argc > 1 && argv[1][0] != '-')
+    {
+        model_path = argv[1];
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--rank" && i + 1 < argc)
+        {
+            rank_path = argv[++i];
+        }
+        else if (arg == "--dict" && i + 1 < argc)
+        {
+            dict_path = argv[++i];
+        }
+        else if (arg == "--input" && i + 1 < argc)
+        {
+            input_path = argv[++i];
+        }
+        else if (arg == "--iters" && i + 1 < argc)
+        {
+            iters = atoi(argv[++i]);
+        }
+        else if (arg == "--strict")
+        {
+            strict = true;
+        }
+        else if (arg == "--backend" && i + 1 < argc)
+        {
+            if (!parse_backend(argv[++i], backend))
+            {
+                cerr << "unknown backend " << argv[i] << endl;
+                return 1;
+            }
+        }
+    }
+
+    // 待检查的query，默认使用内置样例
+    vector<string> querys;
+    if (input_path.length() > 0)
+    {
+        ifstream fin(input_path.c_str());
+        string line;
+        while (getline(fin, line))
+        {
+            if (!line.empty())
+            {
+                querys.push_back(line);
+            }
+        }
+    }
+    if (querys.empty())
+    {
+        querys.push_back("百度是一家高科技公司");
+        querys.push_back("LAC是个优秀的分词工具");
+        querys.push_back("春天的花开秋天的风以及冬天的落阳");
+        querys.push_back("忧郁的青春年少的我曾经无知的这么想，风车在四季轮回的歌里它天天的流转。");
+        querys.push_back("a");
+    }
+
+    // 装载模型和用户词典
+    LAC lac(model_path, CODE_UTF8, backend);
+    if (dict_path.length() > 0)
+    {
+        lac.load_customization(dict_path);
+    }
+    if (rank_path.length() > 0)
+    {
+        lac.enable_rank_mode(rank_path);
+    }
+    lac.set_stage_hook(stage_hook, NULL);
+
+    cout << "内存申请检查: " << querys.size() << " 条query, " << iters << " 轮"
+         << (dict_path.length() > 0 ? ", 用户词典: " + dict_path : "")
+         << (strict ? ", 包含预测器" : "") << endl;
+
+    bool passed = check_mode(lac, false, querys, iters, strict);
+    if (rank_path.length() > 0)
+    {
+        passed = check_mode(lac, true, querys, iters, strict) && passed;
+    }
+    return passed ? 0 : 1;
+}
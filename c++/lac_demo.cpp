@@ -27,11 +27,12 @@ int main(int argc, char* argv[]){
     string model_path = "../models/lac_model";
     string dict_path = "";
     bool json_output = true;  // 默认使用JSON输出
+    bool warmup = false;
     
     if (argc > 1){
         model_path = argv[1];
     }
-    if (argc > 2){
+    if (argc > 2 && argv[2][0] != '-'){
         dict_path = argv[2];
     }
     
@@ -39,11 +40,12 @@ int main(int argc, char* argv[]){
     for (int i = 1; i < argc; i++) {
         if (string(argv[i]) == "--json" || string(argv[i]) == "-j") {
             json_output = true;
-            break;
         }
         if (string(argv[i]) == "--normal" || string(argv[i]) == "-n") {
             json_output = false;
-            break;
+        }
+        if (string(argv[i]) == "--warmup" || string(argv[i]) == "-w") {
+            warmup = true;
         }
     }
 
@@ -53,6 +55,12 @@ int main(int argc, char* argv[]){
         lac.load_customization(dict_path);
     }
 
+    // 预热，避免首批请求的冷启动延迟
+    if (warmup) {
+        double warmup_ms = lac.warmup();
+        cout << "LAC预热完成，耗时: " << warmup_ms << " 毫秒" << endl;
+    }
+
     // 统计初始化结束时间
     auto init_end_time = chrono::high_resolution_clock::now();
     // 计算初始化耗时（毫秒）
@@ -61,7 +69,7 @@ int main(int argc, char* argv[]){
     
     // 显示输出格式
     cout << "输出格式: " << (json_output ? "JSON" : "普通格式") << endl;
-    cout << "使用 --json 或 -j 参数启用JSON输出，使用 --normal 或 -n 参数启用普通格式输出" << endl;
+    cout << "使用 --json 或 -j 参数启用JSON输出，使用 --normal 或 -n 参数启用普通格式输出，使用 --warmup 或 -w 参数启用预热" << endl;
     
     string query;
     cout << "请输入文本(Enter退出): ";
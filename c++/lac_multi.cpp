@@ -28,8 +28,13 @@ mutex g_cout_mutex;
 
 /* 线程函数 */
 void thread_worker(LAC& g_model) {
-    // Clone model
+    // Clone model, 开启预热时拷贝出的模型会自动预热
     LAC lac(g_model);
+    if (lac.warmup_ms() > 0) {
+        g_cout_mutex.lock();
+        cerr << "线程预热完成，耗时: " << lac.warmup_ms() << " 毫秒" << endl;
+        g_cout_mutex.unlock();
+    }
 
     string query;    
     while (true) {
@@ -61,7 +66,7 @@ void thread_worker(LAC& g_model) {
 int main(int argc, char* argv[]) {
     if (argc < 3) {
         cout << "Usage: " << argv[0]
-                  << " + model_dir + thread_num"
+                  << " + model_dir + thread_num [+ --warmup]"
                   << endl;
         exit(-1);
     }
@@ -72,6 +77,11 @@ int main(int argc, char* argv[]) {
 
     // 装载模型, 多线程共用
     LAC g_model(model_path);
+    if (argc > 3 && string(argv[3]) == "--warmup") {
+        WarmupConfig warmup_config;
+        warmup_config.on_clone = true;
+        g_model.set_warmup_config(warmup_config);
+    }
     // 启动多线程
     std::vector<std::thread> threads;
     for (int i = 0; i < thread_num; i++) {
@@ -0,0 +1,176 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 原生推理引擎的一致性检查：同一批query分别以参考后端(默认Paddle Inference)和原生引擎运行，
+ * 按字比较切分和词性，并输出两者的装载耗时与运行耗时。
+ * 逐字一致率低于--min-agree时返回1。 */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "lac.h"
+#include "lac_native.h"
+
+using namespace std;
+
+typedef chrono::high_resolution_clock Clock;
+
+static double elapsed_ms(Clock::time_point start)
+{
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count() / 1000.0;
+}
+
+/* 将第i个句子的结果展开为逐字的(词性, 是否词首)，词首记为负数 */
+static void expand_labels(const vector<WordSpan> &spans, const vector<size_t> &span_lod, size_t i,
+                          vector<int> &labels)
+{
+    labels.clear();
+    for (size_t j = span_lod[i]; j < span_lod[i + 1]; ++j)
+    {
+        for (int c = 0; c < spans[j].char_length; ++c)
+        {
+            labels.push_back(c == 0 ? -1 - spans[j].tag_id : spans[j].tag_id);
+        }
+    }
+}
+
+/* 分batch运行全部query，返回总耗时(毫秒)，结果依次追加 */
+static double run_all(LAC &lac, const vector<string> &querys, size_t batch_size,
+                      vector<vector<int>> &labels)
+{
+    vector<string> batch;
+    vector<WordSpan> spans;
+    vector<size_t> span_lod;
+    labels.clear();
+    double total_ms = 0;
+    for (size_t begin = 0; begin < querys.size(); begin += batch_size)
+    {
+        size_t end = min(querys.size(), begin + batch_size);
+        batch.assign(querys.begin() + begin, querys.begin() + end);
+        Clock::time_point start = Clock::now();
+        lac.run_offsets(batch, spans, span_lod);
+        total_ms += elapsed_ms(start);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            labels.push_back(vector<int>());
+            expand_labels(spans, span_lod, i, labels.back());
+        }
+    }
+    return total_ms;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || argv[1][0] == '-')
+    {
+        cout << "Usage: " << argv[0] << " model_dir input_file [options]\n"
+             << "  --ref <backend>       参考后端，paddle或lite，默认paddle\n"
+             << "  --batch <n>           batch大小，默认16\n"
+             << "  --min-agree <ratio>   逐字一致率的下限，默认0.999" << endl;
+        return -1;
+    }
+    string model_path = argv[1];
+    string input_path = argv[2];
+    LAC_BACKEND ref_backend = BACKEND_PADDLE;
+    size_t batch_size = 16;
+    double min_agree = 0.999;
+    for (int i = 3; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--ref" && i + 1 < argc)
+        {
+            if (!parse_backend(argv[++i], ref_backend))
+            {
+                cerr << "unknown backend " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batch_size = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--min-agree" && i + 1 < argc)
+        {
+            min_agree = atof(argv[++i]);
+        }
+    }
+
+    vector<string> querys;
+    ifstream fin(input_path.c_str());
+    string line;
+    while (getline(fin, line))
+    {
+        if (!line.empty())
+        {
+            querys.push_back(line);
+        }
+    }
+    if (querys.empty())
+    {
+        cerr << "no query in " << input_path << endl;
+        return -1;
+    }
+
+    Clock::time_point start = Clock::now();
+    LAC ref_lac(model_path, CODE_UTF8, ref_backend);
+    double ref_load_ms = elapsed_ms(start);
+    start = Clock::now();
+    LAC native_lac(model_path, CODE_UTF8, BACKEND_NATIVE);
+    double native_load_ms = elapsed_ms(start);
+    if (!ref_lac.model_loaded() || !native_lac.model_loaded())
+    {
+        return -1;
+    }
+
+    // 两个实例各预热一轮，排除首次运行的内存分配
+    vector<vector<int>> ref_labels, native_labels;
+    run_all(ref_lac, querys, batch_size, ref_labels);
+    run_all(native_lac, querys, batch_size, native_labels);
+    double ref_ms = run_all(ref_lac, querys, batch_size, ref_labels);
+    double native_ms = run_all(native_lac, querys, batch_size, native_labels);
+
+    size_t chars = 0, agree_chars = 0, agree_querys = 0, printed = 0;
+    for (size_t i = 0; i < querys.size(); ++i)
+    {
+        const vector<int> &a = ref_labels[i];
+        const vector<int> &b = native_labels[i];
+        size_t same = 0;
+        for (size_t j = 0; j < a.size() && j < b.size(); ++j)
+        {
+            same += a[j] == b[j];
+        }
+        chars += a.size();
+        agree_chars += same;
+        if (same == a.size() && a.size() == b.size())
+        {
+            agree_querys++;
+        }
+        else if (printed++ < 10)
+        {
+            cout << "diff: " << querys[i] << endl;
+        }
+    }
+    double agree = chars > 0 ? (double)agree_chars / chars : 1.0;
+
+    cout << "queries: " << querys.size() << ", chars: " << chars << ", batch: " << batch_size << endl;
+    cout << "native kernels: " << native_kernels()->name << endl;
+    cout << backend_name(ref_backend) << ": load " << ref_load_ms << " ms, run " << ref_ms << " ms" << endl;
+    cout << "native: load " << native_load_ms << " ms, run " << native_ms << " ms" << endl;
+    cout << "char agreement: " << agree << ", query agreement: " << (double)agree_querys / querys.size()
+         << (agree >= min_agree ? " PASS" : " FAIL") << endl;
+    return agree >= min_agree ? 0 : 1;
+}
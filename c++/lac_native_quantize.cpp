@@ -0,0 +1,354 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 原生推理引擎的量化校准：以校准语料统计各矩阵输入的范围，将FP32参数量化为INT8或BF16，
+ * 并在留出集上按字比较量化前后的标签，报告标签的不一致率。
+ * 校准语料上不一致率超出--max-delta时，按各组参数单独量化时的敏感度依次提高精度；
+ * 留出集仍超出时不写出(--force除外)，返回1。
+ * 结果写入<model_dir>/model.native，原FP32参数保留为model.native.fp32，重复校准时从其读取。 */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lac_native.h"
+#include "lac_util.h"
+
+using namespace std;
+
+typedef chrono::high_resolution_clock Clock;
+
+static const size_t BATCH_SIZE = 16;
+
+/* 按精度分组的参数，组内使用相同的精度 */
+enum QuantGroup
+{
+    GROUP_EMBEDDING = 0,
+    GROUP_PROJECTION,   // 各层的输入投影
+    GROUP_RECURRENT,    // GRU的门与候选状态权重
+    GROUP_EMISSION,     // 发射层
+    GROUP_NUM,
+};
+
+static const char *GROUP_NAMES[GROUP_NUM] = {"embedding", "projection", "recurrent", "emission"};
+
+/* 转为id的语料，lod为各句的起止位置 */
+struct Corpus
+{
+    vector<int64_t> ids;
+    vector<size_t> lod;
+};
+
+/* 与LAC::feed_data相同：按字切分、全角转半角后查词表，不在词表中的字为OOV */
+static int load_corpus(const string &path, const unordered_map<string, int64_t> &word2id,
+                       const unordered_map<string, string> &q2b, int64_t oov_id, Corpus &corpus)
+{
+    ifstream fin(path.c_str());
+    if (!fin)
+    {
+        cerr << "can not open " << path << endl;
+        return -1;
+    }
+    string line;
+    vector<string> chars;
+    corpus.lod.assign(1, 0);
+    while (getline(fin, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+        split_words(line, CODE_UTF8, chars);
+        for (size_t i = 0; i < chars.size(); ++i)
+        {
+            auto q2b_iter = q2b.find(chars[i]);
+            const string &word = q2b_iter != q2b.end() ? q2b_iter->second : chars[i];
+            auto word_iter = word2id.find(word);
+            corpus.ids.push_back(word_iter != word2id.end() ? word_iter->second : oov_id);
+        }
+        corpus.lod.push_back(corpus.ids.size());
+    }
+    if (corpus.lod.size() < 2)
+    {
+        cerr << "no query in " << path << endl;
+        return -1;
+    }
+    return 0;
+}
+
+/* 每BATCH_SIZE句运行一次，返回耗时(毫秒) */
+static double run_corpus(const NativeModel &model, const Corpus &corpus, NativeBuffers &buffers,
+                         vector<int64_t> &tags)
+{
+    const NativeKernels &kernels = *native_kernels();
+    tags.resize(corpus.ids.size());
+    vector<size_t> lod;
+    Clock::time_point start = Clock::now();
+    for (size_t begin = 0; begin + 1 < corpus.lod.size(); begin += BATCH_SIZE)
+    {
+        size_t end = min(corpus.lod.size() - 1, begin + BATCH_SIZE);
+        lod.clear();
+        for (size_t i = begin; i <= end; ++i)
+        {
+            lod.push_back(corpus.lod[i] - corpus.lod[begin]);
+        }
+        size_t offset = corpus.lod[begin];
+        native_forward(model, kernels, corpus.ids.data() + offset, lod.back(), lod, buffers,
+                       tags.data() + offset);
+    }
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count() / 1000.0;
+}
+
+/* 逐字标签的不一致率 */
+static double tag_delta(const vector<int64_t> &ref, const vector<int64_t> &tags)
+{
+    size_t diff = 0;
+    for (size_t i = 0; i < ref.size(); ++i)
+    {
+        diff += ref[i] != tags[i];
+    }
+    return ref.empty() ? 0.0 : (double)diff / ref.size();
+}
+
+/* 按各组的精度由FP32参数生成量化后的参数，INT8的输入步长由校准得到的最大绝对值确定 */
+static void quantize_model(const NativeModel &src, map<const NativeMatrix *, float> &calibration,
+                           const NativePrecision precisions[GROUP_NUM], NativeModel &dst)
+{
+    auto quantize = [&](const NativeMatrix &w, QuantGroup group, NativeMatrix &out) {
+        native_quantize_matrix(w, precisions[group], calibration[&w] / 127, out);
+    };
+    dst = src;
+    native_quantize_embedding(src.embedding, precisions[GROUP_EMBEDDING], dst.embedding);
+    for (size_t l = 0; l < src.layers.size(); ++l)
+    {
+        const NativeLayer &layer = src.layers[l];
+        NativeLayer &out = dst.layers[l];
+        quantize(layer.proj_weight, GROUP_PROJECTION, out.proj_weight);
+        quantize(layer.forward.gate_weight, GROUP_RECURRENT, out.forward.gate_weight);
+        quantize(layer.forward.state_weight, GROUP_RECURRENT, out.forward.state_weight);
+        quantize(layer.reverse.gate_weight, GROUP_RECURRENT, out.reverse.gate_weight);
+        quantize(layer.reverse.state_weight, GROUP_RECURRENT, out.reverse.state_weight);
+    }
+    quantize(src.emission_weight, GROUP_EMISSION, dst.emission_weight);
+}
+
+static bool is_fp32(const NativeModel &model)
+{
+    bool fp32 = model.embedding.precision == NATIVE_FP32 && model.emission_weight.precision == NATIVE_FP32;
+    for (size_t l = 0; l < model.layers.size(); ++l)
+    {
+        const NativeLayer &layer = model.layers[l];
+        fp32 = fp32 && layer.proj_weight.precision == NATIVE_FP32 &&
+               layer.forward.gate_weight.precision == NATIVE_FP32 &&
+               layer.forward.state_weight.precision == NATIVE_FP32 &&
+               layer.reverse.gate_weight.precision == NATIVE_FP32 &&
+               layer.reverse.state_weight.precision == NATIVE_FP32;
+    }
+    return fp32;
+}
+
+/* 输出留出集上各标签的不一致情况，按变化的字数排序，最多limit个 */
+static void print_label_deltas(const vector<int64_t> &ref, const vector<int64_t> &tags,
+                               const unordered_map<int64_t, string> &id2label, size_t limit)
+{
+    map<int64_t, pair<size_t, size_t>> counts;  // 标签 -> (FP32的字数, 量化后变化的字数)
+    for (size_t i = 0; i < ref.size(); ++i)
+    {
+        counts[ref[i]].first++;
+        counts[ref[i]].second += ref[i] != tags[i];
+    }
+    vector<pair<size_t, int64_t>> changed;
+    for (auto it = counts.begin(); it != counts.end(); ++it)
+    {
+        if (it->second.second > 0)
+        {
+            changed.push_back(make_pair(it->second.second, it->first));
+        }
+    }
+    sort(changed.rbegin(), changed.rend());
+    for (size_t i = 0; i < changed.size() && i < limit; ++i)
+    {
+        auto label = id2label.find(changed[i].second);
+        const pair<size_t, size_t> &count = counts[changed[i].second];
+        printf("  %-8s chars %-8zu changed %-6zu delta %.4f\n",
+               label != id2label.end() ? label->second.c_str() : "?", count.first, count.second,
+               (double)count.second / count.first);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argv[1][0] == '-')
+    {
+        cout << "Usage: " << argv[0] << " model_dir calib_file heldout_file [options]\n"
+             << "  --precision <p>       int8或bf16，默认int8\n"
+             << "  --max-delta <ratio>   留出集上逐字标签不一致率的上限，默认0.005\n"
+             << "  --force               超出上限时仍写出量化后的参数" << endl;
+        return -1;
+    }
+    string model_path = argv[1];
+    NativePrecision target = NATIVE_INT8;
+    double max_delta = 0.005;
+    bool force = false;
+    for (int i = 4; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--precision" && i + 1 < argc)
+        {
+            string name = argv[++i];
+            if (name != "int8" && name != "bf16")
+            {
+                cerr << "unknown precision " << name << endl;
+                return -1;
+            }
+            target = name == "int8" ? NATIVE_INT8 : NATIVE_BF16;
+        }
+        else if (arg == "--max-delta" && i + 1 < argc)
+        {
+            max_delta = atof(argv[++i]);
+        }
+        else if (arg == "--force")
+        {
+            force = true;
+        }
+    }
+
+    // 词典，与LAC的装载方式一致
+    string conf_path = model_path + "/conf";
+    if (!ifstream((conf_path + "/word.dic").c_str()).good())
+    {
+        conf_path = model_path;
+    }
+    unordered_map<string, int64_t> word2id;
+    unordered_map<string, string> q2b;
+    unordered_map<int64_t, string> id2label;
+    load_word2id_dict(conf_path + "/word.dic", word2id);
+    load_q2b_dict(conf_path + "/q2b.dic", q2b);
+    load_id2label_dict(conf_path + "/tag.dic", id2label);
+    int64_t oov_id = word2id.count("OOV") ? word2id["OOV"] : (int64_t)word2id.size() - 1;
+
+    Corpus calib, heldout;
+    if (load_corpus(argv[2], word2id, q2b, oov_id, calib) != 0 ||
+        load_corpus(argv[3], word2id, q2b, oov_id, heldout) != 0)
+    {
+        return -1;
+    }
+
+    // 已量化过的模型从保留的FP32参数重新校准
+    string output_path = model_path + "/model.native";
+    string fp32_path = output_path + ".fp32";
+    bool has_fp32_copy = ifstream(fp32_path.c_str()).good();
+    NativeModel fp32;
+    if (fp32.load(has_fp32_copy ? fp32_path : output_path) != 0)
+    {
+        return -1;
+    }
+    if (!is_fp32(fp32))
+    {
+        cerr << output_path << " is already quantized and " << fp32_path << " is missing" << endl;
+        return -1;
+    }
+
+    // 校准：FP32运行校准语料，记录各矩阵输入的最大绝对值
+    map<const NativeMatrix *, float> calibration;
+    NativeBuffers buffers;
+    vector<int64_t> calib_ref, heldout_ref, tags;
+    buffers.calibration = &calibration;
+    run_corpus(fp32, calib, buffers, calib_ref);
+    buffers.calibration = NULL;
+    run_corpus(fp32, heldout, buffers, heldout_ref);
+
+    // 各组单独量化时校准语料上的不一致率作为敏感度
+    NativePrecision precisions[GROUP_NUM];
+    double sensitivity[GROUP_NUM];
+    NativeModel quantized;
+    for (int g = 0; g < GROUP_NUM; ++g)
+    {
+        fill(precisions, precisions + GROUP_NUM, NATIVE_FP32);
+        precisions[g] = target;
+        quantize_model(fp32, calibration, precisions, quantized);
+        run_corpus(quantized, calib, buffers, tags);
+        sensitivity[g] = tag_delta(calib_ref, tags);
+    }
+
+    // 全部量化，超出上限时将最敏感的组提高一级精度，直至满足上限
+    fill(precisions, precisions + GROUP_NUM, target);
+    quantize_model(fp32, calibration, precisions, quantized);
+    run_corpus(quantized, calib, buffers, tags);
+    double calib_delta = tag_delta(calib_ref, tags);
+    while (calib_delta > max_delta)
+    {
+        int worst = -1;
+        for (int g = 0; g < GROUP_NUM; ++g)
+        {
+            if (precisions[g] != NATIVE_FP32 && (worst < 0 || sensitivity[g] > sensitivity[worst]))
+            {
+                worst = g;
+            }
+        }
+        if (worst < 0)
+        {
+            break;
+        }
+        precisions[worst] = (NativePrecision)(precisions[worst] - 1);
+        sensitivity[worst] = 0;
+        quantize_model(fp32, calibration, precisions, quantized);
+        run_corpus(quantized, calib, buffers, tags);
+        calib_delta = tag_delta(calib_ref, tags);
+    }
+
+    // 留出集上评估，运行前各预热一轮
+    run_corpus(fp32, heldout, buffers, tags);
+    double fp32_ms = run_corpus(fp32, heldout, buffers, tags);
+    run_corpus(quantized, heldout, buffers, tags);
+    double quantized_ms = run_corpus(quantized, heldout, buffers, tags);
+    double heldout_delta = tag_delta(heldout_ref, tags);
+    bool pass = heldout_delta <= max_delta;
+
+    printf("calibration: %zu queries, %zu chars; held-out: %zu queries, %zu chars\n",
+           calib.lod.size() - 1, calib.ids.size(), heldout.lod.size() - 1, heldout.ids.size());
+    printf("kernels: %s, target precision: %s\n", native_kernels()->name, native_precision_name(target));
+    for (int g = 0; g < GROUP_NUM; ++g)
+    {
+        printf("  %-11s %s\n", GROUP_NAMES[g], native_precision_name(precisions[g]));
+    }
+    printf("memory: fp32 %.2f MB, quantized %.2f MB\n", fp32.bytes() / 1048576.0, quantized.bytes() / 1048576.0);
+    printf("held-out run: fp32 %.1f ms, quantized %.1f ms\n", fp32_ms, quantized_ms);
+    printf("tag delta: calibration %.5f, held-out %.5f (max %.5f) %s\n", calib_delta, heldout_delta,
+           max_delta, pass ? "PASS" : "FAIL");
+    print_label_deltas(heldout_ref, tags, id2label, 10);
+
+    if (!pass && !force)
+    {
+        cerr << "held-out tag delta exceeds --max-delta, " << output_path << " is not written" << endl;
+        return 1;
+    }
+    if (!has_fp32_copy && rename(output_path.c_str(), fp32_path.c_str()) != 0)
+    {
+        cerr << "can not keep fp32 parameters as " << fp32_path << endl;
+        return -1;
+    }
+    if (quantized.save(output_path) != 0)
+    {
+        return -1;
+    }
+    cout << "saved " << output_path << ", fp32 parameters kept in " << fp32_path << endl;
+    return pass ? 0 : 1;
+}
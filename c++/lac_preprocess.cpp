@@ -0,0 +1,847 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 训练数据预处理：将标注语料按python/LAC/reader.py中Dataset.file_reader的规则转为字id与标签id，
+ * 多线程转换后写为二进制分片，Python端的Dataset.file_reader传入分片目录时以numpy.memmap直接读取。
+ * 词典的读取、行的切分、空白字符的判断及分词(segment.py中的Segment.fast_cut)均按Python的语义实现，
+ * 输出与Python逐句相同；Python读取时会报错的输入(非法UTF-8、tag.dic中没有O等)在此同样报错。
+ *
+ * 分片格式(小端)：
+ *   char magic[4] = "LACD"; int32 version = 1; int32 flags(1表示含标签); int32 reserved;
+ *   int64 num_samples; int64 num_ids;
+ *   int64 lod[num_samples + 1]; int64 ids[num_ids]; int64 labels[num_ids](flags & 1时) */
+
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "lac_util.h"
+
+using namespace std;
+
+typedef chrono::high_resolution_clock Clock;
+
+static const char SHARD_MAGIC[4] = {'L', 'A', 'C', 'D'};
+static const int32_t SHARD_VERSION = 1;
+static const int32_t SHARD_HAS_LABELS = 1;
+
+/* 与reader.py对应的处理方式 */
+enum DATA_MODE
+{
+    MODE_LAC = 0,   // Dataset.parse_tag：词/词性，按small_seg.dic分词后以词和字的混合粒度转id
+    MODE_SEG,       // SegDataset.parse_tag：空格分隔的词，按字转id
+    MODE_INFER,     // file_reader(mode="infer")：每行按字转id，无标签
+};
+
+/* Python的str.isspace()为真的字符，str.strip()与str.split()以其为空白 */
+static bool is_py_space(uint32_t c)
+{
+    return (c >= 0x09 && c <= 0x0D) || (c >= 0x1C && c <= 0x20) || c == 0x85 || c == 0xA0 ||
+           c == 0x1680 || (c >= 0x2000 && c <= 0x200A) || c == 0x2028 || c == 0x2029 ||
+           c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+/* 按字解码的一行，第i个字为text[offsets[i], offsets[i+1]) */
+struct PyLine
+{
+    string text;
+    vector<int> offsets;
+    vector<uint32_t> chars;
+
+    size_t size() const { return chars.size(); }
+
+    /* 第begin到end个字的UTF-8串 */
+    void substr(size_t begin, size_t end, string &out) const
+    {
+        out.assign(text, offsets[begin], offsets[end] - offsets[begin]);
+    }
+};
+
+/* 按字切分并解码，与Python的严格UTF-8解码相同，不接受代理区及超出U+10FFFF的字符 */
+static bool decode_line(const string &text, PyLine &line)
+{
+    line.text = text;
+    line.offsets.clear();
+    line.chars.clear();
+    const unsigned char *p = (const unsigned char *)text.c_str();
+    int len = text.size();
+    for (int i = 0; i < len;)
+    {
+        // c_str()以\0结尾，get_next_utf8遇到\0即判为不完整，不会越界读取
+        int n = get_next_utf8((const char *)p + i);
+        if (n == 0 || (n == 3 && p[i] == 0xED && p[i + 1] >= 0xA0) || (n == 4 && p[i] == 0xF4 && p[i + 1] >= 0x90))
+        {
+            return false;
+        }
+        uint32_t c = n == 1 ? p[i] : n == 2 ? p[i] & 0x1F : n == 3 ? p[i] & 0x0F : p[i] & 0x07;
+        for (int k = 1; k < n; ++k)
+        {
+            c = (c << 6) | (p[i + k] & 0x3F);
+        }
+        line.offsets.push_back(i);
+        line.chars.push_back(c);
+        i += n;
+    }
+    line.offsets.push_back(len);
+    return true;
+}
+
+/* 与Python的str.strip()相同，返回去掉首尾空白后的[begin, end) */
+static void py_strip(const PyLine &line, size_t &begin, size_t &end)
+{
+    begin = 0;
+    end = line.size();
+    while (begin < end && is_py_space(line.chars[begin]))
+    {
+        ++begin;
+    }
+    while (end > begin && is_py_space(line.chars[end - 1]))
+    {
+        --end;
+    }
+}
+
+/* 与Python的str.split()相同，返回各项的[begin, end) */
+static void py_split(const PyLine &line, vector<pair<size_t, size_t>> &items)
+{
+    items.clear();
+    size_t i = 0;
+    while (i < line.size())
+    {
+        while (i < line.size() && is_py_space(line.chars[i]))
+        {
+            ++i;
+        }
+        size_t begin = i;
+        while (i < line.size() && !is_py_space(line.chars[i]))
+        {
+            ++i;
+        }
+        if (i > begin)
+        {
+            items.push_back(make_pair(begin, i));
+        }
+    }
+}
+
+/* 按Python文本模式(通用换行)读取行：\n、\r和\r\n均为行尾，最后一行可以没有行尾 */
+class PyLineReader
+{
+private:
+    istream &_in;
+    string _buffer;
+    deque<string> _pending;
+
+public:
+    explicit PyLineReader(istream &in) : _in(in) {}
+
+    bool next(string &line)
+    {
+        while (_pending.empty())
+        {
+            if (!getline(this->_in, this->_buffer))
+            {
+                return false;
+            }
+            // getline至\n为止，其中的每个\r也是行尾，以\r结尾时为\r\n
+            size_t begin = 0;
+            size_t pos = 0;
+            while ((pos = this->_buffer.find('\r', begin)) != string::npos)
+            {
+                this->_pending.push_back(this->_buffer.substr(begin, pos - begin));
+                begin = pos + 1;
+            }
+            if (begin < this->_buffer.size() || begin == 0)
+            {
+                this->_pending.push_back(this->_buffer.substr(begin));
+            }
+        }
+        line.swap(this->_pending.front());
+        this->_pending.pop_front();
+        return true;
+    }
+};
+
+/* 与reader.py的load_kv_dict相同：每行去掉行尾后按\t切分，恰为两项时装载，后出现的键覆盖先出现的 */
+static bool load_kv_dict(const string &path, bool reverse, unordered_map<string, string> &dict)
+{
+    ifstream fin(path.c_str(), ios::binary);
+    if (!fin)
+    {
+        cerr << "failed to open " << path << endl;
+        return false;
+    }
+    PyLineReader reader(fin);
+    string line;
+    while (reader.next(line))
+    {
+        size_t tab = line.find('\t');
+        if (tab == string::npos || line.find('\t', tab + 1) != string::npos)
+        {
+            continue;
+        }
+        string key = line.substr(0, tab);
+        string value = line.substr(tab + 1);
+        if (reverse)
+        {
+            key.swap(value);
+        }
+        dict[key] = value;
+    }
+    return true;
+}
+
+/* 值为int的词典，值不是整数时与Python的int()一样报错 */
+static bool load_kv_int_dict(const string &path, unordered_map<string, int64_t> &dict)
+{
+    unordered_map<string, string> raw;
+    if (!load_kv_dict(path, true, raw))
+    {
+        return false;
+    }
+    for (auto it = raw.begin(); it != raw.end(); ++it)
+    {
+        char *end = NULL;
+        const char *value = it->second.c_str();
+        long long id = strtoll(value, &end, 10);
+        while (end && *end != '\0' && isspace((unsigned char)*end))
+        {
+            ++end;
+        }
+        if (end == value || *end != '\0')
+        {
+            cerr << path << ": invalid id " << it->second << endl;
+            return false;
+        }
+        dict[it->first] = id;
+    }
+    return true;
+}
+
+/* segment.py中Segment使用的前缀词典：词的值为其字数，词的前缀(不是词时)值为-1 */
+struct SegDict
+{
+    unordered_map<string, int> words;
+    double logtotal;
+};
+
+/* 与segment.py的load_seg_dict相同，每行须为"词 词频" */
+static bool load_seg_dict(const string &path, SegDict &dict)
+{
+    ifstream fin(path.c_str(), ios::binary);
+    if (!fin)
+    {
+        cerr << "failed to open " << path << endl;
+        return false;
+    }
+    PyLineReader reader(fin);
+    string text;
+    PyLine line;
+    string prefix;
+    long long total = 0;
+    size_t line_no = 0;
+    while (reader.next(text))
+    {
+        ++line_no;
+        size_t begin = 0;
+        size_t end = 0;
+        if (!decode_line(text, line))
+        {
+            cerr << path << ":" << line_no << ": invalid utf-8" << endl;
+            return false;
+        }
+        py_strip(line, begin, end);
+        string stripped(line.text, line.offsets[begin], line.offsets[end] - line.offsets[begin]);
+        size_t space = stripped.find(' ');
+        if (space == string::npos || stripped.find(' ', space + 1) != string::npos)
+        {
+            cerr << path << ":" << line_no << ": expect \"word count\"" << endl;
+            return false;
+        }
+        string word = stripped.substr(0, space);
+        const char *count = stripped.c_str() + space + 1;
+        char *count_end = NULL;
+        long long value = strtoll(count, &count_end, 10);
+        if (count_end == count || *count_end != '\0')
+        {
+            cerr << path << ":" << line_no << ": invalid count" << endl;
+            return false;
+        }
+        total += value;
+
+        PyLine chars;
+        decode_line(word, chars);
+        dict.words[word] = chars.size();
+        for (size_t i = 1; i < chars.size(); ++i)
+        {
+            chars.substr(0, i, prefix);
+            dict.words.insert(make_pair(prefix, -1));
+        }
+    }
+    if (total <= 0)
+    {
+        cerr << path << ": total count must be positive" << endl;
+        return false;
+    }
+    dict.logtotal = log((double)total);
+    return true;
+}
+
+/* 各线程转换时复用的缓冲区 */
+struct ConvertBuffers
+{
+    PyLine line;
+    PyLine joined;
+    vector<pair<size_t, size_t>> items;
+    vector<string> labels;
+    vector<vector<size_t>> dag;
+    vector<pair<double, size_t>> route;
+    vector<pair<size_t, size_t>> segments;
+    string word;
+};
+
+/* 按reader.py将一行转为字id与标签id */
+class Converter
+{
+private:
+    DATA_MODE _mode;
+    unordered_map<string, int64_t> _word2id;
+    unordered_map<string, int64_t> _label2id;
+    unordered_map<string, string> _q2b;
+    SegDict _seg_dict;
+    int64_t _oov_id;
+
+    /* Dataset.word_to_ids中的一个词 */
+    int64_t word_id(const string &word) const
+    {
+        auto rep = this->_q2b.find(word);
+        auto it = this->_word2id.find(rep == this->_q2b.end() ? word : rep->second);
+        return it == this->_word2id.end() ? this->_oov_id : it->second;
+    }
+
+    /* Segment.fast_cut：按前缀词典构造DAG求最大概率路径，连续的单个字母数字合并为一段 */
+    void fast_cut(const PyLine &text, ConvertBuffers &buf) const
+    {
+        size_t n = text.size();
+        buf.dag.resize(n);
+        for (size_t head = 0; head < n; ++head)
+        {
+            buf.dag[head].assign(1, head);
+            for (size_t end = head + 1; end <= n; ++end)
+            {
+                text.substr(head, end, buf.word);
+                auto it = this->_seg_dict.words.find(buf.word);
+                if (it == this->_seg_dict.words.end())
+                {
+                    break;
+                }
+                if (it->second > 0)
+                {
+                    buf.dag[head].push_back(end - 1);
+                }
+            }
+        }
+
+        // route[i]为(分数, 段的末字)，分数相同时取末字靠后的，与Python中元组的max一致
+        buf.route.resize(n + 1);
+        buf.route[n] = make_pair(0.0, (size_t)0);
+        for (size_t k = n; k-- > 0;)
+        {
+            bool first = true;
+            for (size_t t = 0; t < buf.dag[k].size(); ++t)
+            {
+                size_t j = buf.dag[k][t];
+                text.substr(k, j + 1, buf.word);
+                auto it = this->_seg_dict.words.find(buf.word);
+                int freq = it == this->_seg_dict.words.end() || it->second <= 0 ? 1 : it->second;
+                double score = log((double)freq) - this->_seg_dict.logtotal + buf.route[j + 1].first;
+                if (first || score > buf.route[k].first || (score == buf.route[k].first && j > buf.route[k].second))
+                {
+                    buf.route[k] = make_pair(score, j);
+                    first = false;
+                }
+            }
+        }
+
+        buf.segments.clear();
+        size_t alnum_begin = 0;
+        bool in_alnum = false;
+        for (size_t i = 0; i < n;)
+        {
+            size_t end = buf.route[i].second + 1;
+            uint32_t c = text.chars[i];
+            bool alnum = end - i == 1 && c < 0x80 && isalnum((int)c);
+            if (alnum)
+            {
+                if (!in_alnum)
+                {
+                    alnum_begin = i;
+                    in_alnum = true;
+                }
+            }
+            else
+            {
+                if (in_alnum)
+                {
+                    buf.segments.push_back(make_pair(alnum_begin, i));
+                    in_alnum = false;
+                }
+                buf.segments.push_back(make_pair(i, end));
+            }
+            i = end;
+        }
+        if (in_alnum)
+        {
+            buf.segments.push_back(make_pair(alnum_begin, n));
+        }
+    }
+
+    /* Dataset.label_to_ids：不在tag.dic中的标签记为O，tag.dic中没有O时返回false */
+    bool label_id(const string &label, vector<int64_t> &labels) const
+    {
+        auto it = this->_label2id.find(label);
+        if (it == this->_label2id.end())
+        {
+            it = this->_label2id.find("O");
+        }
+        if (it == this->_label2id.end())
+        {
+            return false;
+        }
+        labels.push_back(it->second);
+        return true;
+    }
+
+public:
+    size_t warnings;
+
+    Converter() : _mode(MODE_LAC), _oov_id(0), warnings(0) {}
+
+    /* 装载model_dir/conf下的词典，MODE_LAC另需small_seg.dic */
+    bool load(const string &model_dir, DATA_MODE mode)
+    {
+        this->_mode = mode;
+        string conf = model_dir + "/conf/";
+        if (!load_kv_int_dict(conf + "word.dic", this->_word2id) ||
+            !load_kv_int_dict(conf + "tag.dic", this->_label2id) ||
+            !load_kv_dict(conf + "q2b.dic", false, this->_q2b))
+        {
+            return false;
+        }
+        if (this->_word2id.count("OOV") == 0)
+        {
+            cerr << "word.dic has no OOV" << endl;
+            return false;
+        }
+        this->_oov_id = this->_word2id["OOV"];
+        if (mode == MODE_LAC && !load_seg_dict(conf + "small_seg.dic", this->_seg_dict))
+        {
+            return false;
+        }
+        return true;
+    }
+
+    /* 转换一行，追加到ids和labels；返回0为一个样本，1为跳过的空行，-1为错误 */
+    int convert(const string &text, ConvertBuffers &buf, vector<int64_t> &ids, vector<int64_t> &labels,
+                size_t &bad_lines) const
+    {
+        if (!decode_line(text, buf.line))
+        {
+            return -1;
+        }
+        size_t begin = 0;
+        size_t end = 0;
+        py_strip(buf.line, begin, end);
+        if (this->_mode == MODE_INFER)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                buf.line.substr(i, i + 1, buf.word);
+                ids.push_back(word_id(buf.word));
+            }
+            return 0;
+        }
+        if (begin == end)
+        {
+            return 1;
+        }
+
+        // parse_tag：逐字的标签及拼接后的文本
+        py_split(buf.line, buf.items);
+        buf.labels.clear();
+        string joined;
+        for (size_t k = 0; k < buf.items.size(); ++k)
+        {
+            size_t item_begin = buf.items[k].first;
+            size_t item_end = buf.items[k].second;
+            if (this->_mode == MODE_SEG)
+            {
+                size_t n = item_end - item_begin;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    buf.labels.push_back(n == 1 ? "-S" : i == 0 ? "-B" : i + 1 == n ? "-E" : "-I");
+                }
+                joined.append(buf.line.text, buf.line.offsets[item_begin],
+                              buf.line.offsets[item_end] - buf.line.offsets[item_begin]);
+                continue;
+            }
+            size_t slash = item_end;
+            for (size_t i = item_end; i-- > item_begin;)
+            {
+                if (buf.line.chars[i] == '/')
+                {
+                    slash = i;
+                    break;
+                }
+            }
+            if (slash == item_end || slash == item_begin || slash + 1 == item_end)
+            {
+                // Python记录警告并产出空样本
+                ++bad_lines;
+                return 0;
+            }
+            string tag;
+            buf.line.substr(slash + 1, item_end, tag);
+            for (size_t i = item_begin; i < slash; ++i)
+            {
+                buf.labels.push_back(tag + (i == item_begin ? "-B" : "-I"));
+            }
+            joined.append(buf.line.text, buf.line.offsets[item_begin],
+                          buf.line.offsets[slash] - buf.line.offsets[item_begin]);
+        }
+        decode_line(joined, buf.joined);
+
+        if (this->_mode == MODE_SEG)
+        {
+            for (size_t i = 0; i < buf.joined.size(); ++i)
+            {
+                buf.joined.substr(i, i + 1, buf.word);
+                ids.push_back(word_id(buf.word));
+                if (!label_id(buf.labels[i], labels))
+                {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+
+        // text_to_ids：在词表中的词以词为单位，否则逐字；词的标签取其首字的标签
+        fast_cut(buf.joined, buf);
+        for (size_t k = 0; k < buf.segments.size(); ++k)
+        {
+            size_t seg_begin = buf.segments[k].first;
+            size_t seg_end = buf.segments[k].second;
+            buf.joined.substr(seg_begin, seg_end, buf.word);
+            if (this->_word2id.count(buf.word))
+            {
+                ids.push_back(word_id(buf.word));
+                if (!label_id(buf.labels[seg_begin], labels))
+                {
+                    return -1;
+                }
+                continue;
+            }
+            for (size_t i = seg_begin; i < seg_end; ++i)
+            {
+                buf.joined.substr(i, i + 1, buf.word);
+                ids.push_back(word_id(buf.word));
+                if (!label_id(buf.labels[i], labels))
+                {
+                    return -1;
+                }
+            }
+        }
+        return 0;
+    }
+};
+
+/* 一个分片的输入行 */
+struct Chunk
+{
+    size_t index;
+    size_t first_line;
+    vector<string> lines;
+};
+
+/* 读取线程与转换线程之间的有界队列 */
+class ChunkQueue
+{
+private:
+    deque<Chunk> _chunks;
+    mutex _mutex;
+    condition_variable _cond;
+    size_t _capacity;
+    bool _closed;
+
+public:
+    explicit ChunkQueue(size_t capacity) : _capacity(capacity), _closed(false) {}
+
+    void push(Chunk &chunk)
+    {
+        unique_lock<mutex> lock(this->_mutex);
+        this->_cond.wait(lock, [this] { return this->_chunks.size() < this->_capacity; });
+        this->_chunks.push_back(Chunk());
+        this->_chunks.back().index = chunk.index;
+        this->_chunks.back().first_line = chunk.first_line;
+        this->_chunks.back().lines.swap(chunk.lines);
+        this->_cond.notify_all();
+    }
+
+    bool pop(Chunk &chunk)
+    {
+        unique_lock<mutex> lock(this->_mutex);
+        this->_cond.wait(lock, [this] { return !this->_chunks.empty() || this->_closed; });
+        if (this->_chunks.empty())
+        {
+            return false;
+        }
+        chunk.index = this->_chunks.front().index;
+        chunk.first_line = this->_chunks.front().first_line;
+        chunk.lines.swap(this->_chunks.front().lines);
+        this->_chunks.pop_front();
+        this->_cond.notify_all();
+        return true;
+    }
+
+    void close()
+    {
+        lock_guard<mutex> lock(this->_mutex);
+        this->_closed = true;
+        this->_cond.notify_all();
+    }
+};
+
+/* 转换的统计，由各线程累加 */
+struct Stats
+{
+    mutex lock;
+    size_t samples;
+    size_t ids;
+    size_t bad_lines;
+    bool failed;
+
+    Stats() : samples(0), ids(0), bad_lines(0), failed(false) {}
+};
+
+static bool write_shard(const string &path, bool has_labels, const vector<int64_t> &lod,
+                        const vector<int64_t> &ids, const vector<int64_t> &labels)
+{
+    ofstream fout(path.c_str(), ios::binary);
+    int32_t header[3] = {SHARD_VERSION, has_labels ? SHARD_HAS_LABELS : 0, 0};
+    int64_t counts[2] = {(int64_t)lod.size() - 1, (int64_t)ids.size()};
+    fout.write(SHARD_MAGIC, 4);
+    fout.write((const char *)header, sizeof(header));
+    fout.write((const char *)counts, sizeof(counts));
+    fout.write((const char *)lod.data(), lod.size() * sizeof(int64_t));
+    fout.write((const char *)ids.data(), ids.size() * sizeof(int64_t));
+    if (has_labels)
+    {
+        fout.write((const char *)labels.data(), labels.size() * sizeof(int64_t));
+    }
+    fout.close();
+    return !fout.fail();
+}
+
+static void convert_worker(const Converter &converter, bool has_labels, const string &output_dir,
+                           ChunkQueue &queue, Stats &stats)
+{
+    ConvertBuffers buf;
+    vector<int64_t> lod;
+    vector<int64_t> ids;
+    vector<int64_t> labels;
+    Chunk chunk;
+    char name[32];
+    while (queue.pop(chunk))
+    {
+        lod.assign(1, 0);
+        ids.clear();
+        labels.clear();
+        size_t bad_lines = 0;
+        for (size_t i = 0; i < chunk.lines.size(); ++i)
+        {
+            int ret = converter.convert(chunk.lines[i], buf, ids, labels, bad_lines);
+            if (ret < 0)
+            {
+                lock_guard<mutex> lock(stats.lock);
+                cerr << "line " << chunk.first_line + i << ": invalid utf-8 or unknown label" << endl;
+                stats.failed = true;
+                return;
+            }
+            if (ret == 0)
+            {
+                lod.push_back(ids.size());
+            }
+        }
+        snprintf(name, sizeof(name), "/part-%05zu.shard", chunk.index);
+        bool ok = write_shard(output_dir + name, has_labels, lod, ids, labels);
+        lock_guard<mutex> lock(stats.lock);
+        if (!ok)
+        {
+            cerr << "failed to write " << output_dir << name << endl;
+            stats.failed = true;
+            return;
+        }
+        stats.samples += lod.size() - 1;
+        stats.ids += ids.size();
+        stats.bad_lines += bad_lines;
+    }
+}
+
+static void usage(const char *prog)
+{
+    cerr << "Usage: " << prog << " <model_dir> <input_file> <output_dir> [options]" << endl
+         << "  --model lac|seg          与conf/args.ini的model一致，默认lac" << endl
+         << "  --infer                  按file_reader(mode=\"infer\")转换，不含标签" << endl
+         << "  --threads N              转换线程数，默认为CPU核数" << endl
+         << "  --shard-lines N          每个分片的输入行数，默认100000" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    string model_dir = argv[1];
+    string input_path = argv[2];
+    string output_dir = argv[3];
+    DATA_MODE mode = MODE_LAC;
+    bool infer = false;
+    size_t threads = thread::hardware_concurrency();
+    size_t shard_lines = 100000;
+    for (int i = 4; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc)
+        {
+            string model = argv[++i];
+            if (model != "lac" && model != "seg")
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            mode = model == "seg" ? MODE_SEG : MODE_LAC;
+        }
+        else if (arg == "--infer")
+        {
+            infer = true;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (arg == "--shard-lines" && i + 1 < argc)
+        {
+            shard_lines = atol(argv[++i]);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    threads = threads > 0 ? threads : 1;
+    shard_lines = shard_lines > 0 ? shard_lines : 1;
+    if (infer)
+    {
+        mode = MODE_INFER;
+    }
+
+    Converter converter;
+    if (!converter.load(model_dir, mode))
+    {
+        return 1;
+    }
+    ifstream fin(input_path.c_str(), ios::binary);
+    if (!fin)
+    {
+        cerr << "failed to open " << input_path << endl;
+        return 1;
+    }
+#ifdef _WIN32
+    _mkdir(output_dir.c_str());
+#else
+    mkdir(output_dir.c_str(), 0755);
+#endif
+
+    auto start = Clock::now();
+    ChunkQueue queue(threads * 2);
+    Stats stats;
+    vector<thread> workers;
+    for (size_t i = 0; i < threads; ++i)
+    {
+        workers.push_back(thread(convert_worker, std::cref(converter), !infer, std::cref(output_dir),
+                                 std::ref(queue), std::ref(stats)));
+    }
+
+    // 按行切为分片，分片编号即输入顺序
+    PyLineReader reader(fin);
+    Chunk chunk;
+    chunk.index = 0;
+    chunk.first_line = 1;
+    string line;
+    size_t line_no = 0;
+    while (reader.next(line))
+    {
+        ++line_no;
+        chunk.lines.push_back(line);
+        if (chunk.lines.size() == shard_lines)
+        {
+            queue.push(chunk);
+            chunk.index += 1;
+            chunk.first_line = line_no + 1;
+        }
+        if (stats.failed)
+        {
+            break;
+        }
+    }
+    if (!chunk.lines.empty() || chunk.index == 0)
+    {
+        queue.push(chunk);
+        chunk.index += 1;
+    }
+    queue.close();
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+    if (stats.failed)
+    {
+        return 1;
+    }
+
+    double seconds = chrono::duration_cast<chrono::duration<double>>(Clock::now() - start).count();
+    cerr << "lines: " << line_no << ", samples: " << stats.samples << ", ids: " << stats.ids
+         << ", malformed lines: " << stats.bad_lines << ", shards: " << chunk.index << endl
+         << "time: " << seconds << "s, " << (seconds > 0 ? line_no / seconds : 0) << " lines/s" << endl;
+    return 0;
+}
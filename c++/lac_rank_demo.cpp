@@ -297,6 +297,7 @@ int main(int argc, char* argv[]){
     string dict_path = "";
     bool json_output = true;
     bool batch_mode = false;
+    bool warmup = false;
     
     if (argc > 1){
         lac_model_path = argv[1];
@@ -304,7 +305,7 @@ int main(int argc, char* argv[]){
     if (argc > 2){
         rank_model_path = argv[2];
     }
-    if (argc > 3){
+    if (argc > 3 && argv[3][0] != '-'){
         dict_path = argv[3];
     }
     
@@ -316,6 +317,8 @@ int main(int argc, char* argv[]){
             batch_mode = true;
         } else if (string(argv[i]) == "--plain" || string(argv[i]) == "-p") {
             json_output = false;
+        } else if (string(argv[i]) == "--warmup" || string(argv[i]) == "-w") {
+            warmup = true;
         }
     }
 
@@ -330,6 +333,12 @@ int main(int argc, char* argv[]){
         lac.load_customization(dict_path);
     }
 
+    // 预热LAC和rank预测器
+    if (warmup) {
+        double warmup_ms = lac.warmup();
+        cerr << "LAC和Rank模型预热完成，耗时: " << fixed << setprecision(3) << warmup_ms << " 毫秒" << endl;
+    }
+
     // 统计初始化结束时间
     auto init_end_time = high_resolution_clock::now();
     auto init_duration_ms = duration_cast<microseconds>(init_end_time - init_start_time).count() / 1000.0;
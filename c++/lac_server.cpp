@@ -0,0 +1,1402 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* HTTP/JSON服务：单线程epoll处理连接，支持keep-alive和pipeline
+ * 请求经BatchScheduler合并成batch，由LACPool中的会话运行，结果在调度线程中序列化
+ * 仅支持Linux */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "lac.h"
+#include "lac_custom.h"
+#include "lac_json.h"
+#include "lac_pool.h"
+#include "lac_scheduler.h"
+
+using namespace std;
+
+static const size_t MAX_HEADER_SIZE = 16 * 1024;        // 请求头上限
+static const size_t MAX_BODY_SIZE = 8 * 1024 * 1024;    // 请求体上限
+static const size_t MAX_PIPELINE = 64;                  // 每个连接未完成的请求数上限
+static const int64_t MAX_TIMEOUT_MS = 24 * 3600 * 1000LL;   // 超时上限(一天)，更大的值按上限处理
+static const uint64_t LISTEN_ID = 0;
+static const uint64_t EVENT_ID = 1;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_signal(int sig)
+{
+    g_stop = 1;
+}
+
+/* 一个请求的响应，pipeline中按请求顺序发送 */
+struct Response
+{
+    std::atomic<bool> ready;
+    string data;
+
+    Response() : ready(false) {}
+};
+typedef shared_ptr<Response> ResponsePtr;
+
+/* 连接状态 */
+struct Connection
+{
+    int fd;
+    uint64_t id;
+    string in;                      // 已读入未处理的数据
+    string out;                     // 待发送的数据
+    size_t out_offset;
+    deque<ResponsePtr> pending;     // 按请求顺序排列的响应
+    bool close_after;               // 发送完已有响应后关闭
+    bool writing;                   // 是否已监听EPOLLOUT
+    bool paused;                    // 未完成的请求过多，暂停处理后续请求
+
+    Connection() : fd(-1), id(0), out_offset(0), close_after(false), writing(false), paused(false) {}
+};
+
+/* 等待在后台重新装载的词典及其响应 */
+struct ReloadTask
+{
+    string name;
+    uint64_t conn_id;
+    ResponsePtr response;
+    bool keep_alive;
+};
+
+/* 解析后的HTTP请求 */
+struct HttpRequest
+{
+    string method;
+    string path;
+    bool keep_alive;
+    const char *body;
+    size_t body_len;
+    int64_t timeout_ms;     // X-Timeout-Ms请求头，-1表示未指定
+};
+
+class LACServer
+{
+private:
+    BatchScheduler &_scheduler;
+    CustomizationRegistry &_registry;   // 按名称选取的用户词典
+    int64_t _default_timeout_ms;    // 请求未指定超时时使用，0表示不限
+    int _listen_fd;
+    int _epoll_fd;
+    int _event_fd;
+    uint64_t _next_id;
+    unordered_map<uint64_t, Connection *> _conns;
+
+    // 调度线程完成的连接id，由事件循环处理
+    mutex _done_mutex;
+    vector<uint64_t> _done_ids;
+    vector<uint64_t> _done_swap;
+
+    // 后台重新装载词典的线程，首次重新装载时启动，按请求顺序依次装载
+    thread _reloader;
+    mutex _reload_mutex;
+    condition_variable _reload_cond;
+    deque<ReloadTask> _reload_queue;
+    bool _reload_stop;
+
+    // 服务统计
+    atomic<uint64_t> _connections_total;
+    atomic<uint64_t> _http_requests_total;
+    atomic<uint64_t> _http_errors_total;
+
+    void accept_connections();
+    void close_connection(Connection *conn);
+    void read_connection(Connection *conn);
+    void process_input(Connection *conn);
+    void flush_ready(Connection *conn);
+    void write_connection(Connection *conn);
+    void update_events(Connection *conn, bool writing);
+    void drain_done();
+
+    /* 处理一个完整的请求，结果追加到conn->pending */
+    void handle_request(Connection *conn, const HttpRequest &request);
+    void handle_analyze(Connection *conn, const HttpRequest &request, LAC_MODE mode, bool mode_in_body);
+
+    /* 重新装载一个已登记的用户词典，在后台线程中装载，完成后再响应，事件循环不等待 */
+    void handle_reload_dict(Connection *conn, const HttpRequest &request);
+    void reload_loop();
+    void stop_reloader();
+
+    /* 增删一个已登记的用户词典的词条，只重建覆盖层，之后的请求即可看到 */
+    void handle_update_dict(const HttpRequest &request, string &out);
+
+    /* 运行完成后在调度线程中调用 */
+    void notify_done(uint64_t conn_id);
+
+    void write_metrics(string &out);
+
+public:
+    LACServer(BatchScheduler &scheduler, CustomizationRegistry &registry, int64_t default_timeout_ms = 0)
+        : _scheduler(scheduler),
+          _registry(registry),
+          _default_timeout_ms(default_timeout_ms),
+          _listen_fd(-1),
+          _epoll_fd(-1),
+          _event_fd(-1),
+          _next_id(EVENT_ID + 1),
+          _reload_stop(false),
+          _connections_total(0),
+          _http_requests_total(0),
+          _http_errors_total(0)
+    {
+    }
+
+    int listen_on(const string &host, int port);
+    int serve();
+};
+
+/* 生成一个完整的HTTP响应 */
+static void build_response(string &out, int status, const char *content_type,
+                           const string &body, bool keep_alive)
+{
+    const char *reason = "OK";
+    switch (status)
+    {
+    case 400: reason = "Bad Request"; break;
+    case 404: reason = "Not Found"; break;
+    case 405: reason = "Method Not Allowed"; break;
+    case 411: reason = "Length Required"; break;
+    case 413: reason = "Payload Too Large"; break;
+    case 431: reason = "Request Header Fields Too Large"; break;
+    case 500: reason = "Internal Server Error"; break;
+    case 501: reason = "Not Implemented"; break;
+    case 503: reason = "Service Unavailable"; break;
+    case 504: reason = "Gateway Timeout"; break;
+    default: break;
+    }
+    char header[256];
+    int len = snprintf(header, sizeof(header),
+                       "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                       status, reason, content_type, body.size(), keep_alive ? "keep-alive" : "close");
+    out.reserve(len + body.size());
+    out.append(header, len);
+    out.append(body);
+}
+
+static void build_error(string &out, int status, const char *message, bool keep_alive)
+{
+    string body;
+    JsonWriter writer(body);
+    writer.start_object();
+    writer.key("error");
+    writer.value(message, strlen(message));
+    writer.end_object();
+    build_response(out, status, "application/json", body, keep_alive);
+}
+
+/* 忽略大小写比较请求头名称 */
+static bool header_equals(const char *name, size_t len, const char *expect)
+{
+    return strlen(expect) == len && strncasecmp(name, expect, len) == 0;
+}
+
+static bool contains_token(const string &value, const char *token)
+{
+    string lower(value);
+    for (size_t i = 0; i < lower.size(); ++i)
+    {
+        lower[i] = tolower(lower[i]);
+    }
+    return lower.find(token) != string::npos;
+}
+
+/* 解析请求头，header_end为空行之后的位置
+ * 返回0表示成功，否则为应返回的HTTP状态码 */
+static int parse_header(const char *data, size_t header_end, HttpRequest &request, size_t &content_length)
+{
+    const char *p = data;
+    const char *end = data + header_end;
+    const char *line_end = (const char *)memmem(p, end - p, "\r\n", 2);
+    if (line_end == NULL)
+    {
+        return 400;
+    }
+
+    // 请求行：METHOD PATH VERSION
+    const char *sp1 = (const char *)memchr(p, ' ', line_end - p);
+    const char *sp2 = sp1 ? (const char *)memchr(sp1 + 1, ' ', line_end - sp1 - 1) : NULL;
+    if (sp1 == NULL || sp2 == NULL)
+    {
+        return 400;
+    }
+    request.method.assign(p, sp1 - p);
+    request.path.assign(sp1 + 1, sp2 - sp1 - 1);
+    string version(sp2 + 1, line_end - sp2 - 1);
+    if (version != "HTTP/1.1" && version != "HTTP/1.0")
+    {
+        return 400;
+    }
+    request.keep_alive = (version == "HTTP/1.1");
+
+    // 忽略查询参数
+    size_t question = request.path.find('?');
+    if (question != string::npos)
+    {
+        request.path.resize(question);
+    }
+
+    content_length = 0;
+    bool has_length = false;
+    request.timeout_ms = -1;
+    p = line_end + 2;
+    while (p < end - 2)
+    {
+        line_end = (const char *)memmem(p, end - p, "\r\n", 2);
+        const char *colon = (const char *)memchr(p, ':', line_end - p);
+        if (colon == NULL)
+        {
+            return 400;
+        }
+        const char *value = colon + 1;
+        while (value < line_end && (*value == ' ' || *value == '\t'))
+        {
+            ++value;
+        }
+        string value_str(value, line_end - value);
+        if (header_equals(p, colon - p, "Content-Length"))
+        {
+            // strtoull接受正负号并把负数回绕为大数；重复的Content-Length可被用于请求走私
+            if (has_length || value_str.empty() || value_str[0] < '0' || value_str[0] > '9')
+            {
+                return 400;
+            }
+            has_length = true;
+            char *num_end = NULL;
+            unsigned long long length = strtoull(value_str.c_str(), &num_end, 10);
+            if (*num_end != '\0')
+            {
+                return 400;
+            }
+            if (length > MAX_BODY_SIZE)
+            {
+                return 413;
+            }
+            content_length = length;
+        }
+        else if (header_equals(p, colon - p, "Connection"))
+        {
+            if (contains_token(value_str, "close"))
+            {
+                request.keep_alive = false;
+            }
+            else if (contains_token(value_str, "keep-alive"))
+            {
+                request.keep_alive = true;
+            }
+        }
+        else if (header_equals(p, colon - p, "Transfer-Encoding"))
+        {
+            return 501;
+        }
+        else if (header_equals(p, colon - p, "X-Timeout-Ms"))
+        {
+            char *num_end = NULL;
+            long long timeout = strtoll(value_str.c_str(), &num_end, 10);
+            if (value_str.empty() || *num_end != '\0' || timeout < 0)
+            {
+                return 400;
+            }
+            request.timeout_ms = timeout < MAX_TIMEOUT_MS ? timeout : MAX_TIMEOUT_MS;
+        }
+        p = line_end + 2;
+    }
+    return 0;
+}
+
+int LACServer::listen_on(const string &host, int port)
+{
+    this->_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (this->_listen_fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    int on = 1;
+    setsockopt(this->_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+    {
+        cerr << "Invalid listen address: " << host << endl;
+        return -1;
+    }
+    if (bind(this->_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        return -1;
+    }
+    if (listen(this->_listen_fd, 1024) < 0)
+    {
+        perror("listen");
+        return -1;
+    }
+
+    this->_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    this->_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->_epoll_fd < 0 || this->_event_fd < 0)
+    {
+        perror("epoll");
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = LISTEN_ID;
+    epoll_ctl(this->_epoll_fd, EPOLL_CTL_ADD, this->_listen_fd, &ev);
+    ev.data.u64 = EVENT_ID;
+    epoll_ctl(this->_epoll_fd, EPOLL_CTL_ADD, this->_event_fd, &ev);
+    return 0;
+}
+
+/* 事件循环，收到SIGINT或SIGTERM后返回 */
+int LACServer::serve()
+{
+    const int MAX_EVENTS = 256;
+    struct epoll_event events[MAX_EVENTS];
+    while (!g_stop)
+    {
+        int n = epoll_wait(this->_epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait");
+            return -1;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID)
+            {
+                accept_connections();
+                continue;
+            }
+            if (id == EVENT_ID)
+            {
+                drain_done();
+                continue;
+            }
+
+            unordered_map<uint64_t, Connection *>::iterator it = this->_conns.find(id);
+            if (it == this->_conns.end())
+            {
+                continue;
+            }
+            Connection *conn = it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                close_connection(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+            {
+                write_connection(conn);
+                if (this->_conns.find(id) == this->_conns.end())
+                {
+                    continue;
+                }
+            }
+            if (events[i].events & EPOLLIN)
+            {
+                read_connection(conn);
+            }
+        }
+    }
+
+    // 停止调度，队列中的请求以503完成；正在装载的词典装载完成后再关闭连接
+    this->_scheduler.stop();
+    stop_reloader();
+    vector<Connection *> conns;
+    for (unordered_map<uint64_t, Connection *>::iterator it = this->_conns.begin(); it != this->_conns.end(); ++it)
+    {
+        conns.push_back(it->second);
+    }
+    for (size_t i = 0; i < conns.size(); ++i)
+    {
+        close_connection(conns[i]);
+    }
+    close(this->_listen_fd);
+    close(this->_event_fd);
+    close(this->_epoll_fd);
+    return 0;
+}
+
+void LACServer::accept_connections()
+{
+    while (true)
+    {
+        int fd = accept4(this->_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                perror("accept");
+            }
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        Connection *conn = new Connection();
+        conn->fd = fd;
+        conn->id = this->_next_id++;
+        this->_conns[conn->id] = conn;
+        this->_connections_total++;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = conn->id;
+        epoll_ctl(this->_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void LACServer::close_connection(Connection *conn)
+{
+    epoll_ctl(this->_epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    this->_conns.erase(conn->id);
+    delete conn;
+}
+
+void LACServer::update_events(Connection *conn, bool writing)
+{
+    if (conn->writing == writing)
+    {
+        return;
+    }
+    conn->writing = writing;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = writing ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u64 = conn->id;
+    epoll_ctl(this->_epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+void LACServer::read_connection(Connection *conn)
+{
+    char buf[65536];
+    while (true)
+    {
+        ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+        if (n > 0)
+        {
+            conn->in.append(buf, n);
+            if ((size_t)n < sizeof(buf))
+            {
+                break;
+            }
+            continue;
+        }
+        if (n == 0)
+        {
+            close_connection(conn);
+            return;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            close_connection(conn);
+            return;
+        }
+        break;
+    }
+    process_input(conn);
+}
+
+/* 依次处理缓冲区中完整的请求，未完成的请求过多时暂停读取后续请求 */
+void LACServer::process_input(Connection *conn)
+{
+    size_t offset = 0;
+    conn->paused = false;
+    while (!conn->close_after && offset < conn->in.size())
+    {
+        if (conn->pending.size() >= MAX_PIPELINE)
+        {
+            conn->paused = true;
+            break;
+        }
+        const char *data = conn->in.c_str() + offset;
+        size_t available = conn->in.size() - offset;
+        const char *header_end = (const char *)memmem(data, available, "\r\n\r\n", 4);
+        if (header_end == NULL)
+        {
+            if (available > MAX_HEADER_SIZE)
+            {
+                ResponsePtr response(new Response());
+                build_error(response->data, 431, "request header too large", false);
+                response->ready = true;
+                conn->pending.push_back(response);
+                conn->close_after = true;
+                this->_http_errors_total++;
+            }
+            break;
+        }
+
+        size_t header_len = header_end - data + 4;
+        HttpRequest request;
+        size_t content_length = 0;
+        int status = parse_header(data, header_len, request, content_length);
+        if (status != 0)
+        {
+            ResponsePtr response(new Response());
+            build_error(response->data, status, "invalid request", false);
+            response->ready = true;
+            conn->pending.push_back(response);
+            conn->close_after = true;
+            this->_http_errors_total++;
+            break;
+        }
+        if (available < header_len + content_length)
+        {
+            break;
+        }
+
+        request.body = data + header_len;
+        request.body_len = content_length;
+        offset += header_len + content_length;
+        if (!request.keep_alive)
+        {
+            conn->close_after = true;
+        }
+        this->_http_requests_total++;
+        handle_request(conn, request);
+    }
+    conn->in.erase(0, offset);
+    flush_ready(conn);
+}
+
+/* 将已完成的响应按顺序移入发送缓冲区并发送 */
+void LACServer::flush_ready(Connection *conn)
+{
+    while (!conn->pending.empty() && conn->pending.front()->ready.load(std::memory_order_acquire))
+    {
+        conn->out.append(conn->pending.front()->data);
+        conn->pending.pop_front();
+    }
+    write_connection(conn);
+}
+
+void LACServer::write_connection(Connection *conn)
+{
+    while (conn->out_offset < conn->out.size())
+    {
+        ssize_t n = send(conn->fd, conn->out.c_str() + conn->out_offset,
+                         conn->out.size() - conn->out_offset, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            conn->out_offset += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            update_events(conn, true);
+            return;
+        }
+        close_connection(conn);
+        return;
+    }
+    conn->out.clear();
+    conn->out_offset = 0;
+    update_events(conn, false);
+
+    if (conn->close_after && conn->pending.empty())
+    {
+        close_connection(conn);
+        return;
+    }
+    // pipeline因未完成的请求过多而暂停时，继续处理已读入的请求
+    if (conn->paused && conn->pending.size() < MAX_PIPELINE)
+    {
+        process_input(conn);
+    }
+}
+
+void LACServer::notify_done(uint64_t conn_id)
+{
+    {
+        lock_guard<mutex> lock(this->_done_mutex);
+        this->_done_ids.push_back(conn_id);
+    }
+    uint64_t one = 1;
+    ssize_t ret = write(this->_event_fd, &one, sizeof(one));
+    (void)ret;
+}
+
+void LACServer::drain_done()
+{
+    uint64_t value = 0;
+    ssize_t ret = read(this->_event_fd, &value, sizeof(value));
+    (void)ret;
+    {
+        lock_guard<mutex> lock(this->_done_mutex);
+        this->_done_swap.swap(this->_done_ids);
+    }
+    for (size_t i = 0; i < this->_done_swap.size(); ++i)
+    {
+        unordered_map<uint64_t, Connection *>::iterator it = this->_conns.find(this->_done_swap[i]);
+        if (it != this->_conns.end())
+        {
+            flush_ready(it->second);
+        }
+    }
+    this->_done_swap.clear();
+}
+
+void LACServer::handle_request(Connection *conn, const HttpRequest &request)
+{
+    const string &path = request.path;
+    if (path == "/lac" || path == "/rank" || path == "/keyword" || path == "/run")
+    {
+        if (request.method != "POST")
+        {
+            ResponsePtr response(new Response());
+            build_error(response->data, 405, "use POST", request.keep_alive);
+            response->ready = true;
+            conn->pending.push_back(response);
+            this->_http_errors_total++;
+            return;
+        }
+        LAC_MODE mode = MODE_LAC;
+        parse_lac_mode(path.substr(1), mode);
+        handle_analyze(conn, request, mode, path == "/run");
+        return;
+    }
+
+    ResponsePtr response(new Response());
+    if (path == "/metrics" && request.method == "GET")
+    {
+        string body;
+        write_metrics(body);
+        build_response(response->data, 200, "text/plain; version=0.0.4", body, request.keep_alive);
+    }
+    else if (path == "/health" && request.method == "GET")
+    {
+        build_response(response->data, 200, "application/json", "{\"status\":\"ok\"}", request.keep_alive);
+    }
+    else if (path == "/dicts" && request.method == "GET")
+    {
+        vector<string> names;
+        this->_registry.names(names);
+        string body;
+        JsonWriter writer(body);
+        writer.start_object();
+        writer.key("dicts");
+        writer.start_array();
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            writer.value(names[i]);
+        }
+        writer.end_array();
+        writer.end_object();
+        build_response(response->data, 200, "application/json", body, request.keep_alive);
+    }
+    else if (path == "/dicts/reload" && request.method == "POST")
+    {
+        handle_reload_dict(conn, request);
+        return;
+    }
+    else if (path == "/dicts/update" && request.method == "POST")
+    {
+        handle_update_dict(request, response->data);
+    }
+    else
+    {
+        build_error(response->data, 404, "not found", request.keep_alive);
+        this->_http_errors_total++;
+    }
+    response->ready = true;
+    conn->pending.push_back(response);
+}
+
+/* 字符串数组，类型不符时返回false */
+static bool parse_string_array(const JsonValue &value, vector<string> &strs)
+{
+    strs.clear();
+    for (size_t i = 0; value.type == JsonValue::JSON_ARRAY && i < value.items.size(); ++i)
+    {
+        if (value.items[i].type != JsonValue::JSON_STRING)
+        {
+            return false;
+        }
+        strs.push_back(value.items[i].str);
+    }
+    return value.type == JsonValue::JSON_ARRAY;
+}
+
+void LACServer::handle_reload_dict(Connection *conn, const HttpRequest &request)
+{
+    ResponsePtr response(new Response());
+    conn->pending.push_back(response);
+    string &out = response->data;
+
+    JsonValue body;
+    const JsonValue *name = NULL;
+    if (json_parse(request.body, request.body_len, body) && body.type == JsonValue::JSON_OBJECT)
+    {
+        name = body.get("name");
+    }
+    if (name == NULL || name->type != JsonValue::JSON_STRING)
+    {
+        build_error(out, 400, "missing \"name\"", request.keep_alive);
+        this->_http_errors_total++;
+    }
+    else if (!this->_registry.get(name->str))
+    {
+        build_error(out, 404, "unknown dict", request.keep_alive);
+        this->_http_errors_total++;
+    }
+    else
+    {
+        ReloadTask task;
+        task.name = name->str;
+        task.conn_id = conn->id;
+        task.response = response;
+        task.keep_alive = request.keep_alive;
+        {
+            lock_guard<mutex> lock(this->_reload_mutex);
+            this->_reload_queue.push_back(task);
+            if (!this->_reloader.joinable())
+            {
+                this->_reloader = thread(&LACServer::reload_loop, this);
+            }
+        }
+        this->_reload_cond.notify_one();
+        return;
+    }
+    response->ready = true;
+}
+
+void LACServer::reload_loop()
+{
+    unique_lock<mutex> lock(this->_reload_mutex);
+    while (true)
+    {
+        while (!this->_reload_stop && this->_reload_queue.empty())
+        {
+            this->_reload_cond.wait(lock);
+        }
+        if (this->_reload_queue.empty())
+        {
+            return;
+        }
+        ReloadTask task = this->_reload_queue.front();
+        this->_reload_queue.pop_front();
+        lock.unlock();
+
+        // 装载失败时保留原词典；新词典中的词性在发布前由词典的监听者登记
+        if (this->_registry.reload(task.name) != _SUCCESS)
+        {
+            build_error(task.response->data, 500, "failed to load dict, the previous one is kept",
+                        task.keep_alive);
+            this->_http_errors_total++;
+        }
+        else
+        {
+            build_response(task.response->data, 200, "application/json", "{\"status\":\"ok\"}", task.keep_alive);
+        }
+        task.response->ready.store(true, std::memory_order_release);
+        notify_done(task.conn_id);
+        lock.lock();
+    }
+}
+
+/* 装载完队列中已有的词典后退出 */
+void LACServer::stop_reloader()
+{
+    {
+        lock_guard<mutex> lock(this->_reload_mutex);
+        this->_reload_stop = true;
+    }
+    this->_reload_cond.notify_all();
+    if (this->_reloader.joinable())
+    {
+        this->_reloader.join();
+    }
+}
+
+void LACServer::handle_update_dict(const HttpRequest &request, string &out)
+{
+    JsonValue body;
+    const JsonValue *name = NULL;
+    vector<string> add;
+    vector<string> remove;
+    bool valid = json_parse(request.body, request.body_len, body) && body.type == JsonValue::JSON_OBJECT;
+    if (valid)
+    {
+        name = body.get("name");
+        const JsonValue *add_value = body.get("add");
+        const JsonValue *remove_value = body.get("remove");
+        valid = name != NULL && name->type == JsonValue::JSON_STRING &&
+                (add_value == NULL || parse_string_array(*add_value, add)) &&
+                (remove_value == NULL || parse_string_array(*remove_value, remove));
+    }
+    if (!valid)
+    {
+        build_error(out, 400, "expect {\"name\": ..., \"add\": [lines], \"remove\": [words]}", request.keep_alive);
+        this->_http_errors_total++;
+    }
+    else if (!this->_registry.get(name->str))
+    {
+        build_error(out, 404, "unknown dict", request.keep_alive);
+        this->_http_errors_total++;
+    }
+    else if (this->_registry.update(name->str, add, remove) != _SUCCESS)
+    {
+        build_error(out, 400, "invalid dict entry", request.keep_alive);
+        this->_http_errors_total++;
+    }
+    else
+    {
+        build_response(out, 200, "application/json", "{\"status\":\"ok\"}", request.keep_alive);
+    }
+}
+
+/* 解析请求体中的运行选项，output_fields为响应中每个词的字段，"tags"按会话池的词性表编译为词性过滤
+ * "dicts"为依次叠加的已登记词典名称，代替启动时--dict指定的词典；出错时返回false */
+static bool parse_run_options(const JsonValue &body, const LACPool &pool,
+                              const CustomizationRegistry &registry, RunOptions &options,
+                              int &output_fields, string &error)
+{
+    vector<string> names;
+    const JsonValue *tags = body.get("tags");
+    if (tags != NULL)
+    {
+        if (!parse_string_array(*tags, names))
+        {
+            error = "tags must be an array of strings";
+            return false;
+        }
+        options.tag_filter = pool.compile_tag_filter(names);
+    }
+    const JsonValue *dicts = body.get("dicts");
+    if (dicts != NULL)
+    {
+        if (!parse_string_array(*dicts, names))
+        {
+            error = "dicts must be an array of strings";
+            return false;
+        }
+        string missing;
+        if (registry.select(names, options.dicts, &missing) != _SUCCESS)
+        {
+            error = "unknown dict " + missing;
+            return false;
+        }
+    }
+    const JsonValue *customization = body.get("customization");
+    if (customization != NULL)
+    {
+        if (customization->type != JsonValue::JSON_BOOL)
+        {
+            error = "customization must be a boolean";
+            return false;
+        }
+        options.customization = customization->boolean;
+    }
+    const JsonValue *segment_only = body.get("segment_only");
+    if (segment_only != NULL)
+    {
+        if (segment_only->type != JsonValue::JSON_BOOL)
+        {
+            error = "segment_only must be a boolean";
+            return false;
+        }
+        options.segment_only = segment_only->boolean;
+    }
+    const JsonValue *fields = body.get("fields");
+    if (fields != NULL)
+    {
+        static const struct
+        {
+            const char *name;
+            OUTPUT_FIELD field;
+        } names[] = {{"word", FIELD_WORD}, {"tag", FIELD_TAG}, {"rank", FIELD_RANK}, {"offset", FIELD_OFFSET}};
+        error = "fields must be an array of word, tag, rank, offset";
+        if (fields->type != JsonValue::JSON_ARRAY)
+        {
+            return false;
+        }
+        options.fields = 0;
+        for (size_t i = 0; i < fields->items.size(); ++i)
+        {
+            size_t k = 0;
+            while (k < sizeof(names) / sizeof(names[0]) &&
+                   (fields->items[i].type != JsonValue::JSON_STRING || fields->items[i].str != names[k].name))
+            {
+                ++k;
+            }
+            if (k == sizeof(names) / sizeof(names[0]))
+            {
+                return false;
+            }
+            options.fields |= names[k].field;
+        }
+        error.clear();
+        output_fields = options.fields;
+    }
+    if (options.segment_only)
+    {
+        output_fields &= ~FIELD_TAG;
+    }
+    return true;
+}
+
+/* 分析请求：{"query": "..."}为单条，{"querys": [...]}为批量，/run时由"mode"指定模式 */
+void LACServer::handle_analyze(Connection *conn, const HttpRequest &request, LAC_MODE mode, bool mode_in_body)
+{
+    ResponsePtr response(new Response());
+    conn->pending.push_back(response);
+    bool keep_alive = request.keep_alive;
+
+    JsonValue body;
+    string error;
+    if (!json_parse(request.body, request.body_len, body, &error) || body.type != JsonValue::JSON_OBJECT)
+    {
+        error = error.empty() ? "request body must be a JSON object" : "invalid JSON: " + error;
+        build_error(response->data, 400, error.c_str(), keep_alive);
+        response->ready = true;
+        this->_http_errors_total++;
+        return;
+    }
+
+    const JsonValue *mode_value = body.get("mode");
+    if (mode_in_body && mode_value != NULL &&
+        (mode_value->type != JsonValue::JSON_STRING || !parse_lac_mode(mode_value->str, mode)))
+    {
+        build_error(response->data, 400, "mode must be one of lac, rank, keyword", keep_alive);
+        response->ready = true;
+        this->_http_errors_total++;
+        return;
+    }
+
+    TRAFFIC_CLASS traffic_class = CLASS_INTERACTIVE;
+    const JsonValue *class_value = body.get("class");
+    if (class_value != NULL &&
+        (class_value->type != JsonValue::JSON_STRING || !parse_traffic_class(class_value->str, traffic_class)))
+    {
+        build_error(response->data, 400, "class must be one of interactive, bulk", keep_alive);
+        response->ready = true;
+        this->_http_errors_total++;
+        return;
+    }
+
+    // 超时优先取请求体中的"timeout_ms"，其次为X-Timeout-Ms请求头和服务默认值
+    int64_t timeout_ms = request.timeout_ms >= 0 ? request.timeout_ms : this->_default_timeout_ms;
+    const JsonValue *timeout_value = body.get("timeout_ms");
+    if (timeout_value != NULL)
+    {
+        if (timeout_value->type != JsonValue::JSON_NUMBER || !(timeout_value->number >= 0))
+        {
+            build_error(response->data, 400, "timeout_ms must be a non-negative number", keep_alive);
+            response->ready = true;
+            this->_http_errors_total++;
+            return;
+        }
+        // 先按上限截断再转为整数，超时换算为微秒时不会溢出
+        timeout_ms = timeout_value->number < MAX_TIMEOUT_MS ? (int64_t)timeout_value->number : MAX_TIMEOUT_MS;
+    }
+
+    // "fields"为输出字段，未指定时输出word、tag和rank；"customization"、"segment_only"、"tags"、"dicts"为运行选项
+    RunOptions options;
+    int output_fields = FIELD_WORD | FIELD_TAG | FIELD_RANK;
+    if (!parse_run_options(body, this->_scheduler.pool(), this->_registry, options, output_fields,
+                           error))
+    {
+        build_error(response->data, 400, error.c_str(), keep_alive);
+        response->ready = true;
+        this->_http_errors_total++;
+        return;
+    }
+
+    LACRequestPtr lac_request(new LACRequest());
+    lac_request->mode = mode;
+    lac_request->options = options;
+    lac_request->traffic_class = traffic_class;
+    if (timeout_ms > 0)
+    {
+        lac_request->set_timeout_us(timeout_ms * 1000);
+    }
+    bool batch = false;
+    const JsonValue *query = body.get("query");
+    const JsonValue *querys = body.get("querys");
+    if (query != NULL && query->type == JsonValue::JSON_STRING)
+    {
+        lac_request->querys.push_back(query->str);
+    }
+    else if (querys != NULL && querys->type == JsonValue::JSON_ARRAY)
+    {
+        batch = true;
+        for (size_t i = 0; i < querys->items.size(); ++i)
+        {
+            if (querys->items[i].type != JsonValue::JSON_STRING)
+            {
+                lac_request->querys.clear();
+                break;
+            }
+            lac_request->querys.push_back(querys->items[i].str);
+        }
+        if (lac_request->querys.size() != querys->items.size())
+        {
+            build_error(response->data, 400, "querys must be an array of strings", keep_alive);
+            response->ready = true;
+            this->_http_errors_total++;
+            return;
+        }
+    }
+    else
+    {
+        build_error(response->data, 400, "missing \"query\" or \"querys\"", keep_alive);
+        response->ready = true;
+        this->_http_errors_total++;
+        return;
+    }
+
+    // 在调度线程中序列化结果并通知事件循环
+    uint64_t conn_id = conn->id;
+    LACServer *server = this;
+    lac_request->done = [server, response, conn_id, batch, keep_alive, output_fields](LACRequest &req) {
+        if (req.status == SCHED_EXPIRED)
+        {
+            build_error(response->data, 504, "deadline exceeded", keep_alive);
+        }
+        else if (req.status != SCHED_OK)
+        {
+            build_error(response->data, 503, "server is shutting down", keep_alive);
+        }
+        else
+        {
+            string body;
+            JsonWriter writer(body);
+            writer.start_object();
+            writer.key("mode");
+            writer.value(string(lac_mode_name(req.mode)));
+            writer.key("path");
+            writer.value(string(lac_path_name(req.path)));
+            writer.key(batch ? "results" : "result");
+            if (batch)
+            {
+                writer.start_array();
+            }
+            for (size_t i = 0; i < req.results.size(); ++i)
+            {
+                json_write_items(writer, req.results[i], output_fields);
+            }
+            if (batch)
+            {
+                writer.end_array();
+            }
+            writer.end_object();
+            build_response(response->data, 200, "application/json", body, keep_alive);
+        }
+        response->ready.store(true, std::memory_order_release);
+        server->notify_done(conn_id);
+    };
+
+    int status = this->_scheduler.submit(lac_request);
+    if (status == SCHED_OK)
+    {
+        return;
+    }
+    if (status == SCHED_UNSUPPORTED)
+    {
+        build_error(response->data, 400, "rank model is not loaded", keep_alive);
+    }
+    else if (status == SCHED_REJECTED)
+    {
+        build_error(response->data, 503, "queue is full", keep_alive);
+    }
+    else if (status == SCHED_EXPIRED)
+    {
+        build_error(response->data, 504, "deadline exceeded", keep_alive);
+    }
+    else
+    {
+        build_error(response->data, 503, "server is shutting down", keep_alive);
+    }
+    response->ready = true;
+    this->_http_errors_total++;
+}
+
+void LACServer::write_metrics(string &out)
+{
+    this->_scheduler.write_metrics(out);
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf),
+                       "# TYPE lac_http_connections_total counter\nlac_http_connections_total %llu\n"
+                       "# TYPE lac_http_connections gauge\nlac_http_connections %llu\n",
+                       (unsigned long long)this->_connections_total.load(),
+                       (unsigned long long)this->_conns.size());
+    out.append(buf, len);
+    len = snprintf(buf, sizeof(buf),
+                   "# TYPE lac_http_requests_total counter\nlac_http_requests_total %llu\n"
+                   "# TYPE lac_http_errors_total counter\nlac_http_errors_total %llu\n",
+                   (unsigned long long)this->_http_requests_total.load(),
+                   (unsigned long long)this->_http_errors_total.load());
+    out.append(buf, len);
+}
+
+static void usage(const char *name)
+{
+    cout << "Usage: " << name << " model_dir [options]\n"
+         << "  --rank <dir>             装载rank模型，启用rank和keyword模式\n"
+         << "  --dict <file>            用户词典\n"
+         << "  --named-dict <name=file> 登记名为name的用户词典，请求以\"dicts\"选取，可重复指定\n"
+         << "  --compact-threshold <n>  登记的词典增删的词条数达到n时在后台合并，默认4096，0不合并\n"
+         << "  --host <ip>              监听地址，默认127.0.0.1\n"
+         << "  --port <port>            监听端口，默认8080\n"
+         << "  --sessions <n>           LAC会话数，默认4\n"
+         << "  --max-batch <n>          交互请求每个batch最多的query数，默认8\n"
+         << "  --max-wait-us <us>       交互请求凑batch的最长等待时间，默认1000\n"
+         << "  --bulk-max-batch <n>     批量请求每个batch最多的query数，默认256\n"
+         << "  --bulk-max-tokens <n>    批量请求每个batch最多的字数，默认16384\n"
+         << "  --bulk-max-wait-us <us>  批量请求凑batch的最长等待时间，默认20000\n"
+         << "  --bulk-weight <n>        批量请求的权重，交互请求为4，默认1\n"
+         << "  --reserved <n>           为交互请求保留的会话数，默认1\n"
+         << "  --max-queue <n>          排队query数上限，超过时返回503，默认4096\n"
+         << "  --keyword-min-rank <n>   keyword模式保留的最低重要性，默认2\n"
+         << "  --seg-dict <file>        降级分词词典，每行为\"词 词频 [词性]\"\n"
+         << "  --fallback-queue-us <us> 排队超过该时间的请求改用降级分词，需要--seg-dict，默认0不降级\n"
+         << "  --timeout-ms <ms>        请求未指定超时时的默认值，超时前无法完成返回504，默认0不限，至多一天\n"
+         << "  --warmup                 启动时预热每个会话" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    string model_path = argv[1];
+    string rank_path = "";
+    string dict_path = "";
+    vector<string> named_dicts;
+    long compact_threshold = -1;
+    string seg_dict_path = "";
+    string host = "127.0.0.1";
+    int port = 8080;
+    size_t sessions = 4;
+    bool warmup = false;
+    int64_t timeout_ms = 0;
+    SchedulerConfig config;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rank" && has_value)
+        {
+            rank_path = argv[++i];
+        }
+        else if (arg == "--dict" && has_value)
+        {
+            dict_path = argv[++i];
+        }
+        else if (arg == "--named-dict" && has_value)
+        {
+            named_dicts.push_back(argv[++i]);
+        }
+        else if (arg == "--compact-threshold" && has_value)
+        {
+            compact_threshold = atol(argv[++i]);
+        }
+        else if (arg == "--host" && has_value)
+        {
+            host = argv[++i];
+        }
+        else if (arg == "--port" && has_value)
+        {
+            port = atoi(argv[++i]);
+        }
+        else if (arg == "--sessions" && has_value)
+        {
+            sessions = atoi(argv[++i]);
+        }
+        else if (arg == "--max-batch" && has_value)
+        {
+            config.classes[CLASS_INTERACTIVE].max_batch_size = atoi(argv[++i]);
+        }
+        else if (arg == "--max-wait-us" && has_value)
+        {
+            config.classes[CLASS_INTERACTIVE].max_wait_us = atoi(argv[++i]);
+        }
+        else if (arg == "--bulk-max-batch" && has_value)
+        {
+            config.classes[CLASS_BULK].max_batch_size = atoi(argv[++i]);
+        }
+        else if (arg == "--bulk-max-tokens" && has_value)
+        {
+            config.classes[CLASS_BULK].max_batch_tokens = atoi(argv[++i]);
+        }
+        else if (arg == "--bulk-max-wait-us" && has_value)
+        {
+            config.classes[CLASS_BULK].max_wait_us = atoi(argv[++i]);
+        }
+        else if (arg == "--bulk-weight" && has_value)
+        {
+            config.classes[CLASS_BULK].weight = atoi(argv[++i]);
+        }
+        else if (arg == "--reserved" && has_value)
+        {
+            config.reserved_sessions = atoi(argv[++i]);
+        }
+        else if (arg == "--max-queue" && has_value)
+        {
+            config.max_queue_depth = atoi(argv[++i]);
+        }
+        else if (arg == "--keyword-min-rank" && has_value)
+        {
+            config.keyword_min_rank = atoi(argv[++i]);
+        }
+        else if (arg == "--seg-dict" && has_value)
+        {
+            seg_dict_path = argv[++i];
+        }
+        else if (arg == "--fallback-queue-us" && has_value)
+        {
+            config.fallback_queue_us = atoi(argv[++i]);
+        }
+        else if (arg == "--timeout-ms" && has_value)
+        {
+            timeout_ms = atoll(argv[++i]);
+            if (timeout_ms < 0)
+            {
+                usage(argv[0]);
+                return -1;
+            }
+            timeout_ms = timeout_ms < MAX_TIMEOUT_MS ? timeout_ms : MAX_TIMEOUT_MS;
+        }
+        else if (arg == "--warmup")
+        {
+            warmup = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    // 装载模型和用户词典，会话池中的会话由其拷贝得到
+    LAC lac(model_path);
+    if (dict_path.length() > 0)
+    {
+        lac.load_customization(dict_path);
+    }
+
+    // 登记的词典共享同一个模型和会话池，其词性在拷贝会话前加入词性表
+    CustomizationRegistry registry;
+    if (compact_threshold >= 0)
+    {
+        registry.set_compact_threshold(compact_threshold);
+    }
+    for (size_t i = 0; i < named_dicts.size(); ++i)
+    {
+        size_t pos = named_dicts[i].find('=');
+        if (pos == string::npos || pos == 0 ||
+            registry.load(named_dicts[i].substr(0, pos), named_dicts[i].substr(pos + 1)) != _SUCCESS)
+        {
+            cerr << "invalid --named-dict " << named_dicts[i] << endl;
+            return -1;
+        }
+    }
+    vector<string> registry_tags;
+    registry.collect_tags(registry_tags);
+    lac.add_tags(registry_tags);
+    if (seg_dict_path.length() > 0 && lac.load_segment_dict(seg_dict_path) != 0)
+    {
+        return -1;
+    }
+    if (rank_path.length() > 0)
+    {
+        lac.enable_rank_mode(rank_path);
+    }
+    if (warmup)
+    {
+        WarmupConfig warmup_config;
+        warmup_config.on_clone = true;
+        lac.set_warmup_config(warmup_config);
+    }
+    // 调度线程屏蔽SIGINT和SIGTERM，保证信号由事件循环所在的主线程处理
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    LACPool pool(lac, sessions);
+    BatchScheduler scheduler(pool, config);
+    // 之后重新装载或增删的词典在发布前登记其词性，词性过滤对新词性同样生效
+    registry.set_tag_listener([&pool](const vector<string> &tags) { pool.add_tags(tags); });
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+
+    LACServer server(scheduler, registry, timeout_ms);
+    if (server.listen_on(host, port) != 0)
+    {
+        return -1;
+    }
+    cout << "lac_server listening on " << host << ":" << port << ", sessions: " << pool.size() << endl;
+    return server.serve();
+}
@@ -0,0 +1,85 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 共享内存客户端示例：从标准输入逐行读取句子，经lac_shm_daemon分析后输出 */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lac_shm.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    string name = "/lac";
+    LAC_MODE mode = MODE_LAC;
+    LACShmConfig config;
+    config.spin_us = -1;    // 沿用守护进程的配置
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--name" && i + 1 < argc)
+        {
+            name = argv[++i];
+        }
+        else if (arg == "--mode" && i + 1 < argc)
+        {
+            if (!parse_lac_mode(argv[++i], mode))
+            {
+                cerr << "mode must be one of lac, rank, keyword" << endl;
+                return -1;
+            }
+        }
+    }
+
+    LACShmClient client(config);
+    if (client.connect(name) != SHM_OK)
+    {
+        return -1;
+    }
+    const vector<string> &tags = client.tag_names();
+
+    string query;
+    while (getline(cin, query))
+    {
+        vector<string> querys(1, query);
+        LACShmResult result;
+        int status = client.run(querys, mode, result);
+        if (status != SHM_OK)
+        {
+            cerr << "run failed: " << status << endl;
+            continue;
+        }
+        for (uint32_t i = result.span_lod[0]; i < result.span_lod[1]; ++i)
+        {
+            const WordSpan &span = result.spans[i];
+            cout << query.substr(span.offset, span.length);
+            if (span.tag_id >= 0 && span.tag_id < (int)tags.size() && tags[span.tag_id].length() > 0)
+            {
+                cout << "/" << tags[span.tag_id];
+            }
+            if (mode != MODE_LAC)
+            {
+                cout << "/" << span.rank;
+            }
+            cout << " ";
+        }
+        cout << endl;
+        client.release(result);
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 共享内存守护进程：持有LAC会话，同一台机器上的进程通过LACShmClient调用 */
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "lac.h"
+#include "lac_pool.h"
+#include "lac_shm.h"
+
+using namespace std;
+
+static void usage(const char *name)
+{
+    cout << "Usage: " << name << " model_dir [options]\n"
+         << "  --rank <dir>             装载rank模型，启用rank和keyword模式\n"
+         << "  --dict <file>            用户词典\n"
+         << "  --name <name>            共享内存名称，默认/lac\n"
+         << "  --sessions <n>           LAC会话数，默认4\n"
+         << "  --slots <n>              槽位数，默认64\n"
+         << "  --slot-bytes <n>         每个槽位的数据区大小，默认65536\n"
+         << "  --max-batch <n>          每次最多取出的请求数，默认32\n"
+         << "  --spin-us <us>           futex等待前自旋的时间，默认50\n"
+         << "  --no-block               一直自旋，不进入futex等待\n"
+         << "  --keyword-min-rank <n>   keyword模式保留的最低重要性，默认2\n"
+         << "  --mode <octal>           共享内存的权限，默认0600只允许同一用户的进程连接\n"
+         << "  --warmup                 启动时预热每个会话" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    string model_path = argv[1];
+    string rank_path = "";
+    string dict_path = "";
+    string name = "/lac";
+    size_t sessions = 4;
+    bool warmup = false;
+    LACShmConfig config;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rank" && has_value)
+        {
+            rank_path = argv[++i];
+        }
+        else if (arg == "--dict" && has_value)
+        {
+            dict_path = argv[++i];
+        }
+        else if (arg == "--name" && has_value)
+        {
+            name = argv[++i];
+        }
+        else if (arg == "--sessions" && has_value)
+        {
+            sessions = atoi(argv[++i]);
+        }
+        else if (arg == "--slots" && has_value)
+        {
+            config.slot_count = atoi(argv[++i]);
+        }
+        else if (arg == "--slot-bytes" && has_value)
+        {
+            config.slot_bytes = atoi(argv[++i]);
+        }
+        else if (arg == "--max-batch" && has_value)
+        {
+            config.max_batch = atoi(argv[++i]);
+        }
+        else if (arg == "--spin-us" && has_value)
+        {
+            config.spin_us = atoi(argv[++i]);
+        }
+        else if (arg == "--no-block")
+        {
+            config.block = false;
+        }
+        else if (arg == "--keyword-min-rank" && has_value)
+        {
+            config.keyword_min_rank = atoi(argv[++i]);
+        }
+        else if (arg == "--mode" && has_value)
+        {
+            config.file_mode = strtoul(argv[++i], NULL, 8);
+        }
+        else if (arg == "--warmup")
+        {
+            warmup = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    // 装载模型和用户词典，会话池中的会话由其拷贝得到
+    LAC lac(model_path);
+    if (dict_path.length() > 0)
+    {
+        lac.load_customization(dict_path);
+    }
+    if (rank_path.length() > 0)
+    {
+        lac.enable_rank_mode(rank_path);
+    }
+    if (warmup)
+    {
+        WarmupConfig warmup_config;
+        warmup_config.on_clone = true;
+        lac.set_warmup_config(warmup_config);
+    }
+    // 所有线程屏蔽SIGINT和SIGTERM，由主线程sigwait等待
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    LACPool pool(lac, sessions);
+
+    LACShmServer server(pool, config);
+    if (server.start(name, lac.tag_names()) != 0)
+    {
+        return -1;
+    }
+    cout << "lac_shm_daemon serving on /dev/shm" << name << ", sessions: " << pool.size() << endl;
+
+    int sig = 0;
+    sigwait(&signals, &sig);
+    server.stop();
+    cout << "requests: " << server.requests() << ", batches: " << server.batches() << endl;
+    return 0;
+}
@@ -13,28 +13,31 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License. */
 
+#include<algorithm>
 #include<queue>
 
 #include "ahocorasick.h"
+#include "lac_util.h"
 
-Node* Node::get_child(const std::string &str){
-    for (auto i : next){
-        if (i->key == str){
-            return i;
-        }
-    }
-    return NULL;
+/* 子结点按字符有序排列，查找时二分 */
+static bool key_less(const Node *node, uint32_t key){
+    return node->key < key;
 }
 
-Node* Node::add_child(const std::string &str){
-    for (auto i : next){
-        if (i->key == str){
-            return i;
-        }
+Node* Node::get_child(uint32_t key){
+    auto iter = std::lower_bound(next.begin(), next.end(), key, key_less);
+    return (iter != next.end() && (*iter)->key == key) ? *iter : NULL;
+}
+
+Node* Node::add_child(uint32_t key){
+    auto iter = std::lower_bound(next.begin(), next.end(), key, key_less);
+    if (iter != next.end() && (*iter)->key == key){
+        return *iter;
     }
     Node* child = new Node();
-    child->key = str;
-    next.push_back(child);
+    child->key = key;
+    child->depth = depth + 1;
+    next.insert(iter, child);
     return child;
 }
 
@@ -53,68 +56,164 @@ AhoCorasick::~AhoCorasick(){
     }
 }
 
+Node* AhoCorasick::child(Node *node, uint32_t key) const{
+    if (node != _root){
+        return node->get_child(key);
+    }
+    auto iter = _root_index.find(key);
+    return iter != _root_index.end() ? iter->second : NULL;
+}
+
+Node* AhoCorasick::root_child(uint32_t key){
+    Node* &child = _root_index[key];
+    if (child == NULL){
+        child = _root->add_child(key);
+    }
+    return child;
+}
+
 /* 添加AC自动机item */
-void AhoCorasick::insert(const std::vector<std::string> &chars, int value){
+void AhoCorasick::insert(const std::vector<uint32_t> &chars, int value){
     if (chars.size() == 0 || value < 0){
         return;
     }
 
-    Node* root = _root;
-    for (auto i : chars){
-        root = root->add_child(i);
+    Node* root = root_child(chars[0]);
+    for (size_t i=1; i<chars.size(); i++){
+        root = root->add_child(chars[i]);
     }
     root->value = value;
 }
 
+void AhoCorasick::insert(const std::vector<std::vector<uint32_t>> &items, int first_value, int threads){
+    threads = parallel_threads(threads, items.size(), 4096);
+
+    // 首字的结点在当前线程中添加，各item按首字分配到线程
+    std::vector<Node*> firsts(items.size(), NULL);
+    std::vector<int> parts(items.size(), -1);
+    std::unordered_map<Node*, int> node_parts;
+    for (size_t i=0; i<items.size(); i++){
+        if (items[i].empty() || first_value + (int)i < 0){
+            continue;
+        }
+        firsts[i] = root_child(items[i][0]);
+        auto iter = node_parts.find(firsts[i]);
+        if (iter == node_parts.end()){
+            iter = node_parts.insert(std::make_pair(firsts[i], (int)(node_parts.size() % threads))).first;
+        }
+        parts[i] = iter->second;
+    }
+
+    // 各线程只修改自己分区的子树，按item的顺序插入
+    parallel_for(threads, threads, [&](size_t begin, size_t end, int){
+        for (size_t part=begin; part<end; part++){
+            for (size_t i=0; i<items.size(); i++){
+                if (parts[i] != (int)part){
+                    continue;
+                }
+                Node* node = firsts[i];
+                for (size_t j=1; j<items[i].size(); j++){
+                    node = node->add_child(items[i][j]);
+                }
+                node->value = first_value + i;
+            }
+        }
+    });
+}
+
 /* 生成AC自动机的fail指针 */
-void AhoCorasick::make_fail(){
-    
+void AhoCorasick::make_fail(int threads){
     _root->fail = NULL;
-    std::queue <Node*> que;
-    for (auto child : _root->next ){
+    std::vector<std::vector<Node*>> levels(1, _root->next);
+    _first_chars.assign(FIRST_CHAR_BITS / 64, 0);
+    for (auto child : _root->next){
         child->fail = _root;
-        que.push(child);
+        uint32_t bit = first_char_bit(child->key);
+        _first_chars[bit >> 6] |= (uint64_t)1 << (bit & 63);
     }
 
-    /* 以广度优先遍历设置fail指针 */
-    while (!que.empty()){
-        Node* current = que.front();
-        que.pop();
-        for (auto child : current->next){
-            Node* current_fail = current->fail;
+    /* 逐层设置下一层结点的fail指针：只读取上层结点的fail及各结点的子结点，同一层可以并行 */
+    while (!levels.back().empty()){
+        size_t level = levels.size() - 1;
+        int level_threads = parallel_threads(threads, levels[level].size(), 4096);
+        std::vector<std::vector<Node*>> next_parts(level_threads);
+        parallel_for(levels[level].size(), level_threads, [&](size_t begin, size_t end, int part){
+            for (size_t i=begin; i<end; i++){
+                Node* current = levels[level][i];
+                for (auto child : current->next){
+                    Node* current_fail = current->fail;
 
-            // 若当前节点有fail指针，尝试设置其子结点的fail指针
-            while (current_fail){
-                if (current_fail->get_child(child->key)){
-                    child->fail = current_fail->get_child(child->key);
-                    break;
+                    // 若当前节点有fail指针，尝试设置其子结点的fail指针
+                    child->fail = NULL;
+                    while (current_fail){
+                        Node* fail_child = this->child(current_fail, child->key);
+                        if (fail_child){
+                            child->fail = fail_child;
+                            break;
+                        }
+                        current_fail = current_fail->fail;
+                    }
+
+                    // 若当前节点的fail指针不存在子结点，令子结点fail指向根节点
+                    if (current_fail == NULL){
+                        child->fail = _root;
+                    }
+
+                    next_parts[part].push_back(child);
                 }
-                current_fail = current_fail->fail;
             }
+        });
+        std::vector<Node*> next_level;
+        for (size_t part=0; part<next_parts.size(); part++){
+            next_level.insert(next_level.end(), next_parts[part].begin(), next_parts[part].end());
+        }
+        levels.push_back(std::vector<Node*>());
+        levels.back().swap(next_level);
+    }
 
-            // 若当前节点的fail指针不存在子结点，令子结点fail指向根节点
-            if (current_fail == NULL){
-                child->fail = _root;
+    /* 由深到浅逐层累加子树中的item数，并统计结点数和内存 */
+    _node_count = 1;
+    _memory_bytes = sizeof(Node) + _root->next.capacity() * sizeof(Node*) +
+            _root_index.size() * (sizeof(std::pair<uint32_t, Node*>) + 2 * sizeof(void*)) +
+            _first_chars.size() * sizeof(uint64_t);
+    for (size_t level=levels.size(); level>0; level--){
+        const std::vector<Node*> &nodes = levels[level - 1];
+        int level_threads = parallel_threads(threads, nodes.size(), 4096);
+        std::vector<size_t> bytes(level_threads, 0);
+        parallel_for(nodes.size(), level_threads, [&](size_t begin, size_t end, int part){
+            for (size_t i=begin; i<end; i++){
+                Node* current = nodes[i];
+                current->count = current->value >= 0 ? 1 : 0;
+                for (auto child : current->next){
+                    current->count += child->count;
+                }
+                bytes[part] += sizeof(Node) + current->next.capacity() * sizeof(Node*);
             }
-
-            que.push(child);
+        });
+        _node_count += nodes.size();
+        for (size_t part=0; part<bytes.size(); part++){
+            _memory_bytes += bytes[part];
         }
     }
+    _root->count = _root->value >= 0 ? 1 : 0;
+    for (auto child : _root->next){
+        _root->count += child->count;
+    }
 }
 
 
 /* 查询返回多模匹配结果 */
-int AhoCorasick::search(const std::vector<std::string> &sentence, std::vector<std::pair<int, int>> &res, bool backtrack){
+int AhoCorasick::search(const std::vector<uint32_t> &sentence, std::vector<std::pair<int, int>> &res, bool backtrack){
     // std::vector<std::pair<int, int> > res;
     Node *child = NULL, *p = _root;
     for (size_t i=0; i< sentence.size(); i++){
-        child = p->get_child(sentence[i]);
+        child = this->child(p, sentence[i]);
         while (child == NULL){
             if (p == _root){
                 break;
             }
             p = p->fail;
-            child = p->get_child(sentence[i]);
+            child = this->child(p, sentence[i]);
         }
         
         if (child){
@@ -137,3 +236,44 @@ int AhoCorasick::search(const std::vector<std::string> &sentence, std::vector<st
     }
     return 0;
 }
+
+Node* AhoCorasick::next_state(Node *state, uint32_t key) const{
+    Node *child = this->child(state, key);
+    while (child == NULL){
+        if (state == _root){
+            return _root;
+        }
+        state = state->fail;
+        child = this->child(state, key);
+    }
+    return child;
+}
+
+int AhoCorasick::find(const std::vector<uint32_t> &chars, std::vector<Node*> *path) const{
+    Node* node = _root;
+    for (size_t i=0; i<chars.size() && node; i++){
+        node = child(node, chars[i]);
+        if (path && node){
+            path->push_back(node);
+        }
+    }
+    return (node && node != _root) ? node->value : -1;
+}
+
+/* 深度优先遍历，path为当前结点对应的字序列 */
+static void visit_node(Node *node, std::vector<uint32_t> &path,
+        const std::function<void(const std::vector<uint32_t>&, int)> &visit){
+    if (node->value >= 0){
+        visit(path, node->value);
+    }
+    for (auto child : node->next){
+        path.push_back(child->key);
+        visit_node(child, path, visit);
+        path.pop_back();
+    }
+}
+
+void AhoCorasick::for_each(const std::function<void(const std::vector<uint32_t>&, int)> &visit) const{
+    std::vector<uint32_t> path;
+    visit_node(_root, path, visit);
+}
@@ -15,58 +15,99 @@ limitations under the License. */
 #include "lac.h"
 #include "lac_util.h"
 #include "lac_custom.h"
-#include <paddle_inference_api.h>
+#include "lac_segment.h"
+#include "lac_json.h"
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <chrono>
+
+/* _label_begins中的标记：LABEL_SPAN_BEGIN与parse_spans的切分一致，LABEL_RANK_BEGIN与merge_sentence_rank_weights一致 */
+enum LABEL_BEGIN_FLAG
+{
+    LABEL_SPAN_BEGIN = 1,
+    LABEL_RANK_BEGIN = 2,
+};
+
+/* 干预时追加的标签尚未加入词性表 */
+static const int LABEL_TAG_PENDING = -2;
+
+/* 标签的词首标记，与按标签字符串切分及合并rank权重时的判断一致 */
+static char label_flags(const std::string &label)
+{
+    char flags = 0;
+    if (label.rfind("B") == label.length() - 1 || label.rfind("S") == label.length() - 1)
+    {
+        flags |= LABEL_SPAN_BEGIN;
+    }
+    if (label.find("-B") != std::string::npos || label.find("-S") != std::string::npos)
+    {
+        flags |= LABEL_RANK_BEGIN;
+    }
+    return flags;
+}
+
+/* 位图的长度覆盖整个词性表，tags中没有已知词性时位图全为0而不为空，不会被当作不过滤 */
+TagMask compile_tag_filter(const std::vector<std::string>& tag_names, const std::vector<std::string>& tags)
+{
+    TagMask mask(tag_names.size() / 64 + 1, 0);
+    for (size_t i = 0; i < tag_names.size(); ++i)
+    {
+        if (std::find(tags.begin(), tags.end(), tag_names[i]) != tags.end())
+        {
+            mask[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+    }
+    return mask;
+}
+
+/* 词典所在目录：优先model_path/conf，不存在时为model_path(Android等平台的平铺目录) */
+static std::string dict_dir(const std::string& model_path)
+{
+    std::string conf_path = model_path + "/conf";
+    std::ifstream word_dict(conf_path + "/word.dic");
+    if (word_dict.good())
+    {
+        return conf_path;
+    }
+    return model_path;
+}
 
 /* LAC构造函数：初始化、装载模型和词典 */
-LAC::LAC(const std::string& model_path, CODE_TYPE type)
+LAC::LAC(const std::string& model_path, CODE_TYPE type, LAC_BACKEND backend)
     : _codetype(type),
       _lod(std::vector<std::vector<size_t> >(1)),
       _id2label_dict(new std::unordered_map<int64_t, std::string>),
       _q2b_dict(new std::unordered_map<std::string, std::string>),
       _word2id_dict(new std::unordered_map<std::string, int64_t>),
+      _output_data(NULL),
+      _output_size(0),
+      _stage_hook(NULL),
+      _stage_context(NULL),
       _rank_mode(false),
-      _input_tensor(nullptr),
-      _output_tensor(nullptr),
-      _rank_output_tensor(nullptr),
+      _rank_fused(false),
+      _rank_output_data(NULL),
+      _rank_output_size(0),
+      _warmup_ms(0),
       custom(NULL)
 {
 
     // 装载词典
-    std::string word_dict_path = model_path + "/conf/word.dic";
+    std::string conf_path = dict_dir(model_path);
+    std::string word_dict_path = conf_path + "/word.dic";
     load_word2id_dict(word_dict_path, *_word2id_dict);
-    std::string q2b_dict_path = model_path + "/conf/q2b.dic";
+    std::string q2b_dict_path = conf_path + "/q2b.dic";
     load_q2b_dict(q2b_dict_path, *_q2b_dict);
-    std::string label_dict_path = model_path + "/conf/tag.dic";
+    std::string label_dict_path = conf_path + "/tag.dic";
     load_id2label_dict(label_dict_path, *_id2label_dict);
+    init_tag_names();
+
+    // 由推理后端装载模型，装载失败时_backend为空，运行时返回-1
+    this->_backend = create_backend(backend, model_path);
+    init_constraint_masks();
 
-    // 使用AnalysisConfig装载模型，会进一步优化模型
-    this->_place = paddle::PaddlePlace::kCPU;
-    paddle_infer::Config config;
-    // config.SwitchIrOptim(false);       // 关闭优化
-    // config.EnableMKLDNN();
-    config.DisableGpu();
-    config.DisableGlogInfo();
-    config.SetModel(model_path + "/model");
-    // config.SetProgFile(model_path + "/model/__model__");
-    // config.SetParamsFile(model_path + "/model/__params__");
-    // std::cout << "Load model from: " << model_path  << std::endl;
-    // config.SetModel(model_path + "/model/__model__", model_path + "/model/__params__");
-    config.SetCpuMathLibraryNumThreads(1);
-    config.SwitchUseFeedFetchOps(false);
-    this->_predictor = paddle_infer::CreatePredictor(config);
-    // this->_predictor = paddle::CreatePredictor<paddle::AnalysisConfig>(config);
-
-    // 初始化输入输出变量
-    auto input_names = this->_predictor->GetInputNames();
-    this->_input_tensor = this->_predictor->GetInputHandle(input_names[0]);
-
-    // std::cout << "Input tensor name: " << input_names[0] << std::endl;
-    auto output_names = this->_predictor->GetOutputNames();
-    this->_output_tensor = this->_predictor->GetOutputHandle(output_names[0]);
-    
     this->_oov_id = this->_word2id_dict->size() - 1;
     auto word_iter = this->_word2id_dict->find("OOV");
     if (word_iter != this->_word2id_dict->end())
@@ -76,6 +117,90 @@ LAC::LAC(const std::string& model_path, CODE_TYPE type)
     // std::cout << "OOV id: " << this->_oov_id << std::endl;
 }
 
+/* 根据id2label构造词性表，按标签编号顺序编号 */
+void LAC::init_tag_names()
+{
+    std::vector<int64_t> label_ids;
+    for (auto it = this->_id2label_dict->begin(); it != this->_id2label_dict->end(); ++it)
+    {
+        label_ids.push_back(it->first);
+    }
+    std::sort(label_ids.begin(), label_ids.end());
+    for (size_t i = 0; i < label_ids.size(); ++i)
+    {
+        const std::string &label = (*this->_id2label_dict)[label_ids[i]];
+        int tag_id = label_tag_id(label);
+        if (label_ids[i] < 0)
+        {
+            continue;
+        }
+        if (this->_label_begins.size() <= (size_t)label_ids[i])
+        {
+            this->_label_begins.resize(label_ids[i] + 1, 0);
+            this->_label_tags.resize(label_ids[i] + 1, -1);
+        }
+        this->_label_tags[label_ids[i]] = tag_id;
+        this->_label_begins[label_ids[i]] = label_flags(label);
+    }
+
+    // 标签编号表中模型标签的编号与模型一致
+    std::vector<std::string> labels(this->_label_begins.size());
+    for (size_t i = 0; i < label_ids.size(); ++i)
+    {
+        if (label_ids[i] >= 0)
+        {
+            labels[label_ids[i]] = (*this->_id2label_dict)[label_ids[i]];
+        }
+    }
+    this->_label_table = std::make_shared<LabelTable>(labels);
+    sync_label_table();
+}
+
+/* 词首标记直接补充，词性在label_tag首次用到时再加入词性表，词性表与按标签字符串查表时一致 */
+void LAC::sync_label_table()
+{
+    for (size_t id = this->_label_begins.size(); id < this->_label_table->size(); ++id)
+    {
+        this->_label_begins.push_back(label_flags(this->_label_table->name(id)));
+        this->_label_tags.push_back(LABEL_TAG_PENDING);
+    }
+}
+
+/* 标签编号对应的词性编号，未知的编号返回-1 */
+int LAC::label_tag(int64_t label_id)
+{
+    if (label_id < 0 || (size_t)label_id >= this->_label_tags.size())
+    {
+        return -1;
+    }
+    int &tag_id = this->_label_tags[label_id];
+    if (tag_id == LABEL_TAG_PENDING)
+    {
+        tag_id = label_tag_id(this->_label_table->name(label_id));
+    }
+    return tag_id;
+}
+
+/* 约束表按模型的全部词性构造，与装载的用户词典无关，各词典及各会话共享
+ * 后端在解码时施加约束，标签编号须为0到标签数-1 */
+void LAC::init_constraint_masks()
+{
+    if (!this->_backend || !this->_backend->constrained_decoding())
+    {
+        return;
+    }
+    std::vector<std::string> labels(this->_id2label_dict->size());
+    for (auto it = this->_id2label_dict->begin(); it != this->_id2label_dict->end(); ++it)
+    {
+        if (it->first < 0 || it->first >= (int64_t)labels.size())
+        {
+            return;
+        }
+        labels[it->first] = it->second;
+    }
+    this->_constraint_masks = std::make_shared<ConstraintMasks>(labels, this->_tag_names);
+}
+
 /* 拷贝构造函数，用于多线程重载 */
 LAC::LAC(LAC &lac)
     : _codetype(lac._codetype),
@@ -84,17 +209,38 @@ LAC::LAC(LAC &lac)
       _q2b_dict(lac._q2b_dict),
       _word2id_dict(lac._word2id_dict),
       _oov_id(lac._oov_id),
-      _place(lac._place),
-      _predictor(lac._predictor->Clone()),
-      _input_tensor(nullptr),
-      _output_tensor(nullptr),
-      _rank_output_tensor(nullptr),
+      _backend(lac._backend ? lac._backend->clone() : nullptr),
+      _output_data(NULL),
+      _output_size(0),
+      _tag_names(lac._tag_names),
+      _tag2id(lac._tag2id),
+      _label2tag(lac._label2tag),
+      _label_begins(lac._label_begins),
+      _label_tags(lac._label_tags),
+      _label_table(std::make_shared<LabelTable>(*lac._label_table)),
+      _constraint_masks(lac._constraint_masks),
+      _stage_hook(NULL),
+      _stage_context(NULL),
+      _segment(lac._segment ? std::make_shared<SegmentSession>(lac._segment->segment())
+                                : std::shared_ptr<SegmentSession>()),
+      _rank_mode(lac._rank_mode),
+      _rank_fused(lac._rank_fused),
+      _rank_output_data(NULL),
+      _rank_output_size(0),
+      _warmup_config(lac._warmup_config),
+      _warmup_ms(0),
       custom(lac.custom)
 {
-    auto input_names = this->_predictor->GetInputNames();
-    this->_input_tensor = this->_predictor->GetInputHandle(input_names[0]);
-    auto output_names = this->_predictor->GetOutputNames();
-    this->_output_tensor = this->_predictor->GetOutputHandle(output_names[0]);
+    // rank模型同样需要每个线程独立的预测器
+    if (this->_rank_mode)
+    {
+        this->_rank_backend = lac._rank_backend->clone();
+    }
+
+    if (this->_warmup_config.on_clone)
+    {
+        warmup();
+    }
 }
 
 /* 装载用户词典 */
@@ -105,295 +251,972 @@ int LAC::load_customization(const std::string& filename){
     }
     */
     custom = std::make_shared<Customization>(filename);
+
+    // 用户词典中的词性预先加入词性表，使拷贝出的各会话的词性编号一致
+    std::vector<std::string> custom_tags;
+    custom->collect_tags(custom_tags);
+    add_tags(custom_tags);
+    return 0;
+}
+
+void LAC::add_tags(const std::vector<std::string>& tags)
+{
+    for (size_t i = 0; i < tags.size(); ++i)
+    {
+        label_tag_id(tags[i] + "-B");
+        this->_label_table->tag_inner(tags[i]);
+    }
+    sync_label_table();
+}
+
+/* custom构成的单层词典，custom被直接替换时随之更新 */
+const CustomizationLayers *LAC::custom_layers()
+{
+    if (!custom)
+    {
+        return NULL;
+    }
+    if (this->_custom_layers.size() != 1 || this->_custom_layers[0] != custom)
+    {
+        this->_custom_layers.assign(1, custom);
+    }
+    return &this->_custom_layers;
+}
+
+const CustomizationLayers *LAC::custom_layers(const RunOptions& options)
+{
+    if (!options.customization)
+    {
+        return NULL;
+    }
+    return options.dicts.empty() ? custom_layers() : &options.dicts;
+}
+
+/* 装载降级分词词典，词典中的词性预先加入词性表 */
+int LAC::load_segment_dict(const std::string& dict_path)
+{
+    std::shared_ptr<Segment> segment = std::make_shared<Segment>(dict_path, this->_codetype);
+    if (segment->word_count() == 0)
+    {
+        return -1;
+    }
+    this->_segment = std::make_shared<SegmentSession>(segment);
+    const std::vector<std::string> &tags = segment->tags();
+    for (size_t i = 0; i < tags.size(); ++i)
+    {
+        label_tag_id(tags[i] + "-B");
+    }
     return 0;
 }
 
-/* 将字符串输入转为Tensor */
+std::shared_ptr<const Segment> LAC::segment() const
+{
+    return this->_segment ? this->_segment->segment() : std::shared_ptr<const Segment>();
+}
+
+/* 将字符串输入转为id序列及LoD，由predict送入推理后端
+ * _seq_words_batch只增不减，每个句子的切分结果复用上一次调用的内存 */
 int LAC::feed_data(const std::vector<std::string> &querys)
 {
     // std::cout << "Feed data: " << querys.size() << " queries." << std::endl;
-    this->_seq_words_batch.clear();
-    this->_lod[0].clear();
+    set_query_views(querys);
+    return feed_data(this->_query_texts.data(), this->_query_lens.data(), querys.size());
+}
 
-    this->_lod[0].push_back(0);
-    int shape = 0;
+/* 记录每个query的起始地址和长度，供基于指针的接口使用 */
+void LAC::set_query_views(const std::vector<std::string> &querys)
+{
+    this->_query_texts.resize(querys.size());
+    this->_query_lens.resize(querys.size());
     for (size_t i = 0; i < querys.size(); ++i)
     {
-        split_words(querys[i], this->_codetype, this->_seq_words);
-        this->_seq_words_batch.push_back(this->_seq_words);
-        shape += this->_seq_words.size();
-        this->_lod[0].push_back(shape);
+        this->_query_texts[i] = querys[i].c_str();
+        this->_query_lens[i] = querys[i].length();
     }
-    this->_input_tensor->SetLoD(this->_lod);
-    this->_input_tensor->Reshape({shape, 1});
+}
 
-    int64_t *input_d = this->_input_tensor->mutable_data<int64_t>(this->_place);
-    
-    int index = 0;
-    for (size_t i = 0; i < this->_seq_words_batch.size(); ++i)
+/* 输入为count个(地址, 长度)，文本可位于调用方的任意内存(如共享内存)中，不做拷贝 */
+int LAC::feed_data(const char *const *texts, const int *lens, size_t count)
+{
+    enter_stage(STAGE_TOKENIZE);
+    if (this->_seq_words_batch.size() < count)
     {
+        this->_seq_words_batch.resize(count);
+    }
+    this->_lod[0].clear();
+    this->_input_ids.clear();
+
+    this->_lod[0].push_back(0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        split_words(texts[i], lens[i], this->_codetype, this->_seq_words_batch[i]);
         for (size_t j = 0; j < this->_seq_words_batch[i].size(); ++j)
         {
             // normalization
-            std::string word = this->_seq_words_batch[i][j];
-            auto q2b_iter = this->_q2b_dict->find(word);
+            const std::string *word = &this->_seq_words_batch[i][j];
+            auto q2b_iter = this->_q2b_dict->find(*word);
             if (q2b_iter != this->_q2b_dict->end())
             {
-                word = q2b_iter->second;
+                word = &q2b_iter->second;
             }
 
             // get word_id
             int64_t word_id = this->_oov_id;
-            auto word_iter = this->_word2id_dict->find(word);
+            auto word_iter = this->_word2id_dict->find(*word);
             if (word_iter != this->_word2id_dict->end())
             {
                 word_id = word_iter->second;
             }
-            input_d[index++] = word_id;
+            this->_input_ids.push_back(word_id);
+        }
+        this->_lod[0].push_back(this->_input_ids.size());
+    }
+    return 0;
+}
+
+/* 对已送入的数据运行LAC预测器，rank为true时将LAC的输入输出送入rank预测器继续运行
+ * 输出与输入的字数不一致时返回-1 */
+int LAC::predict(bool rank, const CustomizationLayers *layers)
+{
+    enter_stage(STAGE_PREDICT);
+    if (!this->_backend)
+    {
+        std::cerr << "Model not loaded!" << std::endl;
+        return -1;
+    }
+    size_t input_size = this->_input_ids.size();
+    const int64_t *inputs[2] = {this->_input_ids.data(), NULL};
+    if (rank && this->_rank_fused)
+    {
+        return predict_fused();
+    }
+
+    // 后端支持时用户词典的约束在解码时施加，之后decode_labels中的干预只需改写模型中没有的词性
+    // rank模型以LAC的输出为输入，rank模式下不加约束；多层词典时后面的词典覆盖前面的约束
+    const float *const *masks = NULL;
+    if (layers && this->_constraint_masks && !rank)
+    {
+        enter_stage(STAGE_CUSTOMIZATION);
+        this->_char_masks.assign(input_size, NULL);
+        for (size_t i = 0; i + 1 < this->_lod[0].size(); ++i)
+        {
+            char_codes(this->_seq_words_batch[i], this->_char_codes);
+            for (size_t k = 0; k < layers->size(); ++k)
+            {
+                (*layers)[k]->decode_constraints(this->_char_codes, this->_ac_res, *this->_constraint_masks,
+                                                 this->_char_masks.data() + this->_lod[0][i]);
+            }
         }
+        masks = this->_char_masks.data();
+        enter_stage(STAGE_PREDICT);
+    }
+    if (this->_backend->run_constrained(inputs, 1, input_size, this->_lod, masks,
+                                        this->_output_data, this->_output_size) != 0 ||
+        this->_output_size != input_size)
+    {
+        std::cerr << "Invalid output size " << this->_output_size << std::endl;
+        return -1;
+    }
+    if (!rank)
+    {
+        return 0;
+    }
+
+    // rank模型的两个输入：words复用LAC的输入，crf_decode复用LAC的输出，LoD一致
+    enter_stage(STAGE_RANK_PREDICT);
+    inputs[1] = this->_output_data;
+    if (this->_rank_backend->run(inputs, 2, input_size, this->_lod,
+                                 this->_rank_output_data, this->_rank_output_size) != 0)
+    {
+        this->_rank_output_data = NULL;
+        this->_rank_output_size = 0;
     }
     return 0;
 }
 
-/* 对输出的标签进行解码转换为模型输出格式 */
+/* 合并模型的一次运行：第0个输出为LAC的标签，第1个输出为rank权重，rank模型不再重复编码输入 */
+int LAC::predict_fused()
+{
+    size_t input_size = this->_input_ids.size();
+    const int64_t *inputs[1] = {this->_input_ids.data()};
+    if (this->_rank_backend->run(inputs, 1, input_size, this->_lod, this->_output_data, this->_output_size) != 0 ||
+        this->_output_size != input_size)
+    {
+        std::cerr << "Invalid output size " << this->_output_size << std::endl;
+        return -1;
+    }
+    if (this->_rank_backend->output(1, this->_rank_output_data, this->_rank_output_size) != 0)
+    {
+        this->_rank_output_data = NULL;
+        this->_rank_output_size = 0;
+    }
+    return 0;
+}
+
+/* 预测失败时每个query输出空结果，保留容器中已有的内存 */
+void LAC::clear_results(size_t count, std::vector<std::vector<OutputItem>> &results)
+{
+    results.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        results[i].clear();
+    }
+}
+
+/* 解码第sent_index个句子的标签编号存于_label_ids，并进行用户词典干预
+ * rank为true时同时保存干预前的标签，用于合并rank权重 */
+void LAC::decode_labels(size_t sent_index, bool rank, const CustomizationLayers *layers)
+{
+    enter_stage(STAGE_DECODE);
+    size_t begin = this->_lod[0][sent_index];
+    size_t length = this->_lod[0][sent_index + 1] - begin;
+    this->_label_ids.assign(this->_output_data + begin, this->_output_data + begin + length);
+
+    if (rank)
+    {
+        if (this->_tags_for_rank_batch.size() <= sent_index)
+        {
+            this->_tags_for_rank_batch.resize(sent_index + 1);
+        }
+        std::vector<std::string> &tags_for_rank = this->_tags_for_rank_batch[sent_index];
+        tags_for_rank.resize(length);
+        for (size_t j = 0; j < length; ++j)
+        {
+            tags_for_rank[j].assign(this->_label_table->name(this->_label_ids[j]));
+        }
+    }
+
+    // 装载了用户干预词典，先进行干预处理，后面的词典覆盖前面词典的结果
+    // 在各字的编码上匹配，原地改写标签编号
+    if (layers)
+    {
+        enter_stage(STAGE_CUSTOMIZATION);
+        char_codes(this->_seq_words_batch[sent_index], this->_char_codes);
+        for (size_t k = 0; k < layers->size(); ++k)
+        {
+            (*layers)[k]->parse_customization(this->_char_codes, *this->_label_table, this->_label_ids.data(),
+                                              this->_ac_res);
+        }
+        sync_label_table();
+    }
+}
+
+void LAC::fill_labels()
+{
+    this->_labels.resize(this->_label_ids.size());
+    for (size_t j = 0; j < this->_label_ids.size(); ++j)
+    {
+        this->_labels[j].assign(this->_label_table->name(this->_label_ids[j]));
+    }
+}
+
+/* 对输出的标签进行解码转换为模型输出格式
+ * result中已有的OutputItem会被复用，重复调用时不再申请内存 */
 int LAC::parse_targets(
     const std::vector<std::string> &tags,
     const std::vector<std::string> &words,
     std::vector<OutputItem> &result)
 {
-    result.clear();
+    size_t count = 0;
+    int offset = 0;
     for (size_t i = 0; i < tags.size(); ++i)
     {
-        // 若新词，则push_back一个新词，否则append到上一个词中
-        if (result.empty() || tags[i].rfind("B") == tags[i].length() - 1 || tags[i].rfind("S") == tags[i].length() - 1)
+        // 若新词，则追加一个新词，否则append到上一个词中
+        if (count == 0 || tags[i].rfind("B") == tags[i].length() - 1 || tags[i].rfind("S") == tags[i].length() - 1)
+        {
+            if (count == result.size())
+            {
+                result.push_back(OutputItem());
+            }
+            OutputItem &output_item = result[count++];
+            output_item.word.assign(words[i]);
+            output_item.tag.assign(tags[i], 0, tags[i].length() - 2);
+            output_item.rank = 0;
+            output_item.offset = offset;
+            output_item.length = words[i].length();
+        }
+        else
+        {
+            result[count - 1].word += words[i];
+            result[count - 1].length += words[i].length();
+        }
+        offset += words[i].length();
+    }
+    result.resize(count);
+    return 0;
+}
+
+/* 将标签编号解码为基于偏移的结果，追加到spans中，label_ids与words一一对应 */
+int LAC::parse_spans(
+    const int64_t *label_ids,
+    const std::vector<std::string> &words,
+    std::vector<WordSpan> &spans)
+{
+    int offset = 0;
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        int length = words[i].length();
+        int64_t label_id = label_ids[i];
+        bool known = label_id >= 0 && (size_t)label_id < this->_label_begins.size();
+        if (i == 0 || (known && (this->_label_begins[label_id] & LABEL_SPAN_BEGIN)))
         {
-            OutputItem output_item;
-            output_item.word = words[i];
-            output_item.tag = tags[i].substr(0, tags[i].length() - 2);
-            result.push_back(output_item);
+            WordSpan span;
+            span.offset = offset;
+            span.length = length;
+            span.char_offset = i;
+            span.char_length = 1;
+            span.tag_id = label_tag(label_id);
+            span.rank = 0;
+            spans.push_back(span);
         }
         else
         {
-            result[result.size() - 1].word += words[i];
+            spans.back().length += length;
+            spans.back().char_length += 1;
         }
+        offset += length;
     }
     return 0;
 }
 
+/* 切分第sent_index个句子并在切分时过滤：词首的词性不通过tag_filter时整个词跳过
+ * 词首及词性由标签编号查表得到，不生成标签字符串 */
+void LAC::append_spans(size_t sent_index, bool from_labels, const RunOptions &options,
+                       const std::vector<int> *weights, std::vector<WordSpan> &spans)
+{
+    size_t begin = this->_lod[0][sent_index];
+    size_t length = this->_lod[0][sent_index + 1] - begin;
+    const std::vector<std::string> &words = this->_seq_words_batch[sent_index];
+    const int64_t *label_ids = from_labels ? this->_label_ids.data() : this->_output_data + begin;
+    bool tags = options.want(FIELD_TAG);
+    bool need_tag = tags || !options.tag_filter.empty();
+    int offset = 0;
+    size_t word_index = 0;
+    bool keep = false;
+    for (size_t i = 0; i < length; ++i)
+    {
+        int64_t label_id = label_ids[i];
+        bool known = label_id >= 0 && (size_t)label_id < this->_label_begins.size();
+        bool word_begin = i == 0 || (known && (this->_label_begins[label_id] & LABEL_SPAN_BEGIN));
+        int tag_id = word_begin && need_tag ? label_tag(label_id) : -1;
+
+        int word_length = words[i].length();
+        if (word_begin)
+        {
+            word_index += i > 0;
+            keep = options.keep(tag_id);
+            if (keep)
+            {
+                WordSpan span;
+                span.offset = offset;
+                span.length = word_length;
+                span.char_offset = i;
+                span.char_length = 1;
+                span.tag_id = tags ? tag_id : -1;
+                span.rank = weights && word_index < weights->size() ? (*weights)[word_index] : 0;
+                spans.push_back(span);
+            }
+        }
+        else if (keep)
+        {
+            spans.back().length += word_length;
+            spans.back().char_length += 1;
+        }
+        offset += word_length;
+    }
+}
+
+/* 返回标签(如"n-B")对应的词性编号，用户词典中的新词性追加到词性表末尾 */
+int LAC::label_tag_id(const std::string &label)
+{
+    auto label_iter = this->_label2tag.find(label);
+    if (label_iter != this->_label2tag.end())
+    {
+        return label_iter->second;
+    }
+
+    std::string tag_name = label.substr(0, label.length() - 2);
+    int tag_id = this->_tag_names.size();
+    auto tag_iter = this->_tag2id.find(tag_name);
+    if (tag_iter != this->_tag2id.end())
+    {
+        tag_id = tag_iter->second;
+    }
+    else
+    {
+        this->_tag_names.push_back(tag_name);
+        this->_tag2id[tag_name] = tag_id;
+    }
+    this->_label2tag[label] = tag_id;
+    return tag_id;
+}
+
 std::vector<OutputItem> LAC::run(const std::string &query)
 {
     // std::cout << "Run LAC with query: " << query << std::endl;
-    std::vector<std::string> query_vector = std::vector<std::string>({query});
-    auto result = run(query_vector);
-    return result[0];
+    std::vector<OutputItem> result;
+    run(query, result);
+    return result;
 }
 
 std::vector<std::vector<OutputItem>> LAC::run(const std::vector<std::string> &querys)
+{
+    std::vector<std::vector<OutputItem>> results;
+    run(querys, results);
+    return results;
+}
+
+/* 单条query，结果与_results_batch[0]交换，调用方和LAC交替持有两份内存 */
+int LAC::run(const std::string &query, std::vector<OutputItem> &result)
+{
+    this->_single_query.resize(1);
+    this->_single_query[0].assign(query);
+    this->_results_batch.resize(1);
+    this->_results_batch[0].swap(result);
+    run(this->_single_query, this->_results_batch);
+    result.swap(this->_results_batch[0]);
+    return 0;
+}
+
+int LAC::run(const std::vector<std::string> &querys, std::vector<std::vector<OutputItem>> &results)
 {
     // std::cout << "Run LAC with " << querys.size() << " queries." << std::endl;
     this->feed_data(querys);
-    // std::cout << "Input tensor shape: " << std::endl;
-    this->_predictor->Run();
+    if (this->predict(false, custom_layers()) != 0)
+    {
+        clear_results(querys.size(), results);
+        return -1;
+    }
 
     // 对模型输出进行解码
-    int output_size = 0;
-    int64_t *output_d = this->_output_tensor->data<int64_t>(&(this->_place), &output_size);
-    
-    this->_labels.clear();
-    this->_results_batch.clear();
-    for (size_t i = 0; i < this->_lod[0].size() - 1; ++i)
+    enter_stage(STAGE_OUTPUT);
+    results.resize(querys.size());
+    for (size_t i = 0; i < querys.size(); ++i)
+    {
+        decode_labels(i, false, custom_layers());
+        enter_stage(STAGE_OUTPUT);
+        fill_labels();
+        parse_targets(this->_labels, this->_seq_words_batch[i], results[i]);
+    }
+    return 0;
+}
+
+/* 降级分词，只切分输入，不送入预测器 */
+int LAC::run_fallback(const std::vector<std::string> &querys, std::vector<std::vector<OutputItem>> &results)
+{
+    return run_fallback(querys, RunOptions(), results);
+}
+
+int LAC::run_fallback(const std::vector<std::string> &querys, const RunOptions &options,
+                      std::vector<std::vector<OutputItem>> &results)
+{
+    const CustomizationLayers *layers = custom_layers(options);
+    if (!this->_segment)
+    {
+        std::cerr << "Segment dict not loaded! Please call load_segment_dict() first." << std::endl;
+        return -1;
+    }
+
+    enter_stage(STAGE_DECODE);
+    this->_segment->sync_tags(this->_tag_names);
+    int ret = this->_segment->run(querys, layers, options, results);
+    enter_stage(STAGE_OUTPUT);
+    return ret;
+}
+
+/* 基于偏移输出，不生成词和标签字符串 */
+int LAC::run_offsets(const std::vector<std::string> &querys,
+                     std::vector<WordSpan> &spans, std::vector<size_t> &span_lod)
+{
+    set_query_views(querys);
+    return run_offsets(this->_query_texts.data(), this->_query_lens.data(), querys.size(), spans, span_lod);
+}
+
+int LAC::run_offsets(const char *const *texts, const int *lens, size_t count,
+                     std::vector<WordSpan> &spans, std::vector<size_t> &span_lod)
+{
+    this->feed_data(texts, lens, count);
+    if (this->predict(false, custom_layers()) != 0)
+    {
+        spans.clear();
+        span_lod.assign(count + 1, 0);
+        return -1;
+    }
+
+    enter_stage(STAGE_OUTPUT);
+    spans.clear();
+    span_lod.clear();
+    span_lod.push_back(0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        decode_labels(i, false, custom_layers());
+        enter_stage(STAGE_OUTPUT);
+        parse_spans(this->_label_ids.data(), this->_seq_words_batch[i], spans);
+        span_lod.push_back(spans.size());
+    }
+    return 0;
+}
+
+/* 按options运行：请求rank字段时才运行rank预测器，关闭干预时不施加约束也不改写标签
+ * 只在解码后干预时改写标签编号，其余情况直接由模型输出的标签编号切分并得到词性；tag_filter在切分时过滤 */
+int LAC::run_spans(const char *const *texts, const int *lens, size_t count, const RunOptions &options,
+                   std::vector<WordSpan> &spans, std::vector<size_t> &span_lod)
+{
+    bool rank = options.want(FIELD_RANK);
+    if (rank && !this->_rank_mode)
+    {
+        std::cerr << "Rank mode not enabled! Please call enable_rank_mode() first." << std::endl;
+        rank = false;
+    }
+    const CustomizationLayers *layers = custom_layers(options);
+
+    // predict中rank模式不施加约束，此时只能在解码后干预；施加了约束时干预只改写词性
+    bool constrained = layers && this->_constraint_masks && !rank;
+    bool need_tag = options.want(FIELD_TAG) || !options.tag_filter.empty();
+    bool need_labels = layers && (!constrained || need_tag);
+
+    this->feed_data(texts, lens, count);
+    if (this->predict(rank, layers) != 0)
     {
-        for (size_t j = 0; j < _lod[0][i + 1] - _lod[0][i]; ++j)
+        spans.clear();
+        span_lod.assign(count + 1, 0);
+        return -1;
+    }
+
+    enter_stage(STAGE_OUTPUT);
+    const int64_t *rank_output = rank ? rank_output_data() : NULL;
+
+    spans.clear();
+    span_lod.clear();
+    span_lod.push_back(0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (rank_output)
         {
+            merge_sentence_rank_ids(i, rank_output);
+        }
+        if (need_labels)
+        {
+            decode_labels(i, false, layers);
+        }
+        else
+        {
+            enter_stage(STAGE_DECODE);
+        }
+        append_spans(i, need_labels, options, rank_output ? &this->_merged_weights : NULL, spans);
+        enter_stage(STAGE_OUTPUT);
+        span_lod.push_back(spans.size());
+    }
+    return 0;
+}
+
+int LAC::run(const std::vector<std::string> &querys, const RunOptions &options,
+             std::vector<std::vector<OutputItem>> &results)
+{
+    set_query_views(querys);
+    int ret = run_spans(this->_query_texts.data(), this->_query_lens.data(), querys.size(), options,
+                        this->_option_spans, this->_option_span_lod);
 
-            int64_t cur_label_id = output_d[_lod[0][i] + j];
-            auto it = this->_id2label_dict->find(cur_label_id);
-            this->_labels.push_back(it->second);
+    // 只生成请求的字段，容器中已有的OutputItem会被复用
+    bool words = options.want(FIELD_WORD);
+    bool tags = options.want(FIELD_TAG);
+    results.resize(querys.size());
+    for (size_t i = 0; i < querys.size(); ++i)
+    {
+        size_t begin = this->_option_span_lod[i];
+        std::vector<OutputItem> &items = results[i];
+        items.resize(this->_option_span_lod[i + 1] - begin);
+        for (size_t j = 0; j < items.size(); ++j)
+        {
+            const WordSpan &span = this->_option_spans[begin + j];
+            OutputItem &item = items[j];
+            if (words)
+            {
+                item.word.assign(querys[i], span.offset, span.length);
+            }
+            else
+            {
+                item.word.clear();
+            }
+            if (tags && span.tag_id >= 0)
+            {
+                item.tag.assign(this->_tag_names[span.tag_id]);
+            }
+            else
+            {
+                item.tag.clear();
+            }
+            item.rank = span.rank;
+            item.offset = span.offset;
+            item.length = span.length;
         }
+    }
+    return ret;
+}
 
-        // 装载了用户干预词典，先进行干预处理
-        if (custom){
-            custom->parse_customization(this->_seq_words_batch[i], this->_labels);
+int LAC::run_offsets(const std::vector<std::string> &querys, const RunOptions &options,
+                     std::vector<WordSpan> &spans, std::vector<size_t> &span_lod)
+{
+    set_query_views(querys);
+    return run_spans(this->_query_texts.data(), this->_query_lens.data(), querys.size(), options, spans, span_lod);
+}
+
+int LAC::run_offsets(const char *const *texts, const int *lens, size_t count, const RunOptions &options,
+                     std::vector<WordSpan> &spans, std::vector<size_t> &span_lod)
+{
+    return run_spans(texts, lens, count, options, spans, span_lod);
+}
+
+/* 写出一句话的词，词直接取自query，不生成中间字符串 */
+static void json_write_spans(JsonWriter &writer, const char *text, const WordSpan *spans, size_t count,
+                             const std::vector<std::string> &tag_names, const RunOptions &options)
+{
+    writer.start_array();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const WordSpan &span = spans[i];
+        writer.start_object();
+        if (options.want(FIELD_WORD))
+        {
+            writer.key("word");
+            writer.value(text + span.offset, span.length);
+        }
+        if (options.want(FIELD_TAG))
+        {
+            writer.key("tag");
+            writer.value(span.tag_id >= 0 ? tag_names[span.tag_id] : std::string());
+        }
+        if (options.want(FIELD_RANK))
+        {
+            writer.key("rank");
+            writer.value(span.rank);
+        }
+        if (options.want(FIELD_OFFSET))
+        {
+            writer.key("offset");
+            writer.value(span.offset);
+            writer.key("length");
+            writer.value(span.length);
         }
+        writer.end_object();
+    }
+    writer.end_array();
+}
 
-        parse_targets(this->_labels, this->_seq_words_batch[i], this->_results);
-        this->_labels.clear();
-        this->_results_batch.push_back(this->_results);
+/* 按options运行并返回JSON，单个query为一层数组 */
+std::string LAC::run_json(const std::string &query, const RunOptions &options)
+{
+    this->_single_query.resize(1);
+    this->_single_query[0].assign(query);
+    set_query_views(this->_single_query);
+    run_spans(this->_query_texts.data(), this->_query_lens.data(), 1, options,
+              this->_option_spans, this->_option_span_lod);
+
+    std::string json;
+    JsonWriter writer(json);
+    json_write_spans(writer, query.c_str(), this->_option_spans.data(), this->_option_spans.size(),
+                     this->_tag_names, options);
+    return json;
+}
+
+/* 按options运行并返回JSON，批量query为两层数组 */
+std::string LAC::run_json(const std::vector<std::string> &querys, const RunOptions &options)
+{
+    set_query_views(querys);
+    run_spans(this->_query_texts.data(), this->_query_lens.data(), querys.size(), options,
+              this->_option_spans, this->_option_span_lod);
+
+    std::string json;
+    JsonWriter writer(json);
+    writer.start_array();
+    for (size_t i = 0; i < querys.size(); ++i)
+    {
+        size_t begin = this->_option_span_lod[i];
+        json_write_spans(writer, querys[i].c_str(), this->_option_spans.data() + begin,
+                         this->_option_span_lod[i + 1] - begin, this->_tag_names, options);
+    }
+    writer.end_array();
+    return json;
+}
+
+/* 预热：按句长、batch大小从大到小运行合成query
+ * 先运行最大的shape，预测器内部按最大需求分配内存，之后较小shape的Reshape可直接复用 */
+double LAC::warmup(const WarmupConfig& config)
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // 从词表中取真实存在的字构造合成query，与输入编码无关
+    std::vector<std::string> chars;
+    for (auto it = this->_word2id_dict->begin();
+         it != this->_word2id_dict->end() && chars.size() < 64; ++it)
+    {
+        if (it->first != "OOV")
+        {
+            chars.push_back(it->first);
+        }
+    }
+    if (chars.empty())
+    {
+        return 0;
+    }
+
+    std::vector<int> lengths = config.lengths;
+    std::vector<int> batch_sizes = config.batch_sizes;
+    std::sort(lengths.rbegin(), lengths.rend());
+    std::sort(batch_sizes.rbegin(), batch_sizes.rend());
+
+    std::vector<std::string> querys;
+    for (size_t b = 0; b < batch_sizes.size(); ++b)
+    {
+        for (size_t l = 0; l < lengths.size(); ++l)
+        {
+            querys.assign(std::max(batch_sizes[b], 1), std::string());
+            for (size_t q = 0; q < querys.size(); ++q)
+            {
+                for (int c = 0; c < std::max(lengths[l], 1); ++c)
+                {
+                    querys[q] += chars[(q + c) % chars.size()];
+                }
+            }
+            if (this->_rank_mode)
+            {
+                run_rank(querys);
+            }
+            else
+            {
+                run(querys);
+            }
+        }
     }
 
-    return this->_results_batch;
+    auto end_time = std::chrono::high_resolution_clock::now();
+    this->_warmup_ms = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() / 1000.0;
+    return this->_warmup_ms;
 }
 
-/* 开启Rank模式，加载rank模型 */
+double LAC::warmup()
+{
+    return warmup(this->_warmup_config);
+}
+
+/* c++/tools/export_fused_rank_model.py导出的合并模型位于rank_model_path/fused，文件与对应后端的模型一致 */
+static bool fused_model_exists(const std::string& fused_path, LAC_BACKEND backend) {
+    const char *files[] = {"/model/__model__", "/model/model.pdmodel", "/model.nb"};
+    size_t begin = backend == BACKEND_LITE ? 2 : 0;
+    size_t end = backend == BACKEND_LITE ? 3 : 2;
+    for (size_t i = begin; i < end; ++i) {
+        std::ifstream fin(fused_path + files[i]);
+        if (fin.good()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 开启Rank模式，以与LAC模型相同的推理后端加载rank模型
+ * 原生引擎只实现了LAC网络，此时rank模型使用编译时的默认后端
+ * 存在合并模型时优先装载，rank模式下一次运行同时得到标签和rank权重 */
 void LAC::enable_rank_mode(const std::string& rank_model_path) {
-    // 使用AnalysisConfig装载Rank模型
+    LAC_BACKEND rank_backend = backend_type();
+    if (rank_backend == BACKEND_NATIVE) {
+        rank_backend = default_backend();
+    }
+    this->_rank_mode = false;
+    this->_rank_fused = false;
+    std::string fused_path = rank_model_path + "/fused";
+    if (fused_model_exists(fused_path, rank_backend)) {
+        this->_rank_backend = create_backend(rank_backend, fused_path);
+        if (this->_rank_backend && this->_rank_backend->input_count() == 1 &&
+            this->_rank_backend->output_count() >= 2) {
+            this->_rank_fused = true;
+            this->_rank_mode = true;
+            return;
+        }
+        std::cerr << "Invalid fused rank model: " << fused_path << std::endl;
+    }
+    this->_rank_backend = create_backend(rank_backend, rank_model_path);
+    if (!this->_rank_backend) {
+        return;
+    }
+    // Rank模型的两个输入：words和crf_decode（与Python版本一致）
+    if (this->_rank_backend->input_count() < 2) {
+        std::cerr << "Rank model expects 2 inputs but got " << this->_rank_backend->input_count() << std::endl;
+        this->_rank_backend.reset();
+        return;
+    }
     this->_rank_mode = true;
-    paddle_infer::Config rank_config;
-    rank_config.DisableGpu();
-    rank_config.DisableGlogInfo();
-    rank_config.SetModel(rank_model_path + "/model");
-    rank_config.SetCpuMathLibraryNumThreads(1);
-    rank_config.SwitchUseFeedFetchOps(false);
-    this->_rank_predictor = paddle_infer::CreatePredictor(rank_config);
-    
-    // std::cout << "Rank model loaded from: " << rank_model_path << std::endl;
-    auto output_names = this->_rank_predictor->GetOutputNames();
-    // std::cout << "Rank model output name: " << output_names[0] << std::endl;
-    this->_rank_output_tensor = this->_rank_predictor->GetOutputHandle(output_names[0]);
 }
 
 /* Rank模式运行，单个query */
 std::vector<OutputItem> LAC::run_rank(const std::string& query) {
-    std::vector<std::string> query_vector = std::vector<std::string>({query});
-    auto results = run_rank(query_vector);
-    return results[0];
+    std::vector<OutputItem> result;
+    run_rank(query, result);
+    return result;
 }
 
 /* Rank模式运行，批量query */
 std::vector<std::vector<OutputItem>> LAC::run_rank(const std::vector<std::string>& querys) {
+    std::vector<std::vector<OutputItem>> results;
+    run_rank(querys, results);
+    return results;
+}
+
+/* Rank模式运行，单个query，结果写入调用方提供的容器 */
+int LAC::run_rank(const std::string& query, std::vector<OutputItem>& result) {
+    this->_single_query.resize(1);
+    this->_single_query[0].assign(query);
+    this->_results_batch.resize(1);
+    this->_results_batch[0].swap(result);
+    int ret = run_rank(this->_single_query, this->_results_batch);
+    result.swap(this->_results_batch[0]);
+    return ret;
+}
+
+/* Rank模式运行，批量query，结果写入调用方提供的容器 */
+int LAC::run_rank(const std::vector<std::string>& querys, std::vector<std::vector<OutputItem>>& results) {
     if (!this->_rank_mode) {
         std::cerr << "Rank mode not enabled! Please call enable_rank_mode() first." << std::endl;
-        return run(querys);
+        return run(querys, results);
     }
     
-    // 首先进行LAC处理 - 重用现有的LAC逻辑
+    // 首先进行LAC处理，再将LAC的输入输出送入rank模型
     this->feed_data(querys);
-    this->_predictor->Run();
-    
-    // 获取LAC的输入输出数据
-    auto input_lod = this->_input_tensor->lod();
-    auto input_shape = this->_input_tensor->shape();
-    auto output_lod = this->_output_tensor->lod();
-    auto output_shape = this->_output_tensor->shape();
-    
-    int lac_input_size = 0;
-    int lac_output_size = 0;
-    int64_t *lac_input_d = this->_input_tensor->data<int64_t>(&(this->_place), &lac_input_size);
-    int64_t *lac_output_d = this->_output_tensor->data<int64_t>(&(this->_place), &lac_output_size);
-    
-    // 准备Rank模型输入
-    auto rank_input_names = this->_rank_predictor->GetInputNames();
-    if (rank_input_names.size() < 2) {
-        std::cerr << "Rank model expects 2 inputs but got " << rank_input_names.size() << std::endl;
-        return run(querys);
+    if (this->predict(true, custom_layers()) != 0) {
+        clear_results(querys.size(), results);
+        return -1;
     }
     
-    // 设置Rank模型的两个输入：words和crf_decode（与Python版本一致）
-    auto rank_words_input = this->_rank_predictor->GetInputHandle(rank_input_names[0]);
-    auto rank_crf_input = this->_rank_predictor->GetInputHandle(rank_input_names[1]);
-    
-    // 设置第一个输入（words） - 直接复用LAC的输入
-    rank_words_input->SetLoD(input_lod);
-    rank_words_input->Reshape(input_shape);
-    int64_t *rank_words_d = rank_words_input->mutable_data<int64_t>(this->_place);
-    std::memcpy(rank_words_d, lac_input_d, lac_input_size * sizeof(int64_t));
-    
-    // 设置第二个输入（crf_decode） - 直接复用LAC的输出
-    rank_crf_input->SetLoD(output_lod);
-    rank_crf_input->Reshape(output_shape);
-    int64_t *rank_crf_d = rank_crf_input->mutable_data<int64_t>(this->_place);
-    std::memcpy(rank_crf_d, lac_output_d, lac_output_size * sizeof(int64_t));
-    
-    // 运行rank模型
-    this->_rank_predictor->Run();
+    // 处理LAC结果 - 保存干预前的标签用于后续权重合并
+    enter_stage(STAGE_OUTPUT);
+    results.resize(querys.size());
+    for (size_t i = 0; i < querys.size(); ++i) {
+        decode_labels(i, true, custom_layers());
+        enter_stage(STAGE_OUTPUT);
+        fill_labels();
+        parse_targets(this->_labels, this->_seq_words_batch[i], results[i]);
+    }
     
-    // 处理LAC结果 - 需要保存tags_for_rank用于后续权重合并
-    this->_labels.clear();
-    this->_results_batch.clear();
-    std::vector<std::vector<std::string>> tags_for_rank_batch;
+    // 解析并合并rank权重 - 关键步骤
+    merge_rank_weights_with_word_length(this->_tags_for_rank_batch, results);
     
-    // 按batch处理LAC输出
-    for (size_t i = 0; i < output_lod[0].size() - 1; ++i) {
-        std::vector<std::string> tags_for_rank;
-        
-        // 解析当前句子的标签
-        for (size_t j = output_lod[0][i]; j < output_lod[0][i + 1]; ++j) {
-            int64_t cur_label_id = lac_output_d[j];
-            auto it = this->_id2label_dict->find(cur_label_id);
-            this->_labels.push_back(it->second);
-            tags_for_rank.push_back(it->second);
+    return 0;
+}
+
+/* Rank模式运行，基于偏移输出 */
+int LAC::run_rank_offsets(const std::vector<std::string>& querys,
+                          std::vector<WordSpan>& spans, std::vector<size_t>& span_lod) {
+    set_query_views(querys);
+    return run_rank_offsets(this->_query_texts.data(), this->_query_lens.data(), querys.size(), spans, span_lod);
+}
+
+int LAC::run_rank_offsets(const char *const *texts, const int *lens, size_t count,
+                          std::vector<WordSpan>& spans, std::vector<size_t>& span_lod) {
+    if (!this->_rank_mode) {
+        std::cerr << "Rank mode not enabled! Please call enable_rank_mode() first." << std::endl;
+        return run_offsets(texts, lens, count, spans, span_lod);
+    }
+
+    this->feed_data(texts, lens, count);
+    if (this->predict(true, custom_layers()) != 0) {
+        spans.clear();
+        span_lod.assign(count + 1, 0);
+        return -1;
+    }
+
+    enter_stage(STAGE_OUTPUT);
+    const int64_t *rank_output = rank_output_data();
+
+    spans.clear();
+    span_lod.clear();
+    span_lod.push_back(0);
+    for (size_t i = 0; i < count; ++i) {
+        decode_labels(i, true, custom_layers());
+        enter_stage(STAGE_OUTPUT);
+        parse_spans(this->_label_ids.data(), this->_seq_words_batch[i], spans);
+        span_lod.push_back(spans.size());
+
+        if (rank_output) {
+            size_t begin = this->_lod[0][i];
+            merge_sentence_rank_weights(this->_tags_for_rank_batch[i], rank_output + begin,
+                                        this->_lod[0][i + 1] - begin);
+            for (size_t j = span_lod[i]; j < span_lod[i + 1] && j - span_lod[i] < this->_merged_weights.size(); ++j) {
+                spans[j].rank = this->_merged_weights[j - span_lod[i]];
+            }
         }
-        
-        // 用户自定义词典处理
-        if (custom) {
-            custom->parse_customization(this->_seq_words_batch[i], this->_labels);
+    }
+    return 0;
+}
+
+/* rank模型逐字输出权重，LoD与LAC的输入一致，大小不符时返回NULL */
+const int64_t *LAC::rank_output_data() {
+    if (this->_lod[0].empty() || this->_rank_output_size != this->_lod[0].back()) {
+        std::cerr << "Invalid rank output size " << this->_rank_output_size << std::endl;
+        return NULL;
+    }
+    return this->_rank_output_data;
+}
+
+/* 按照标签边界合并一个句子的权重（与Python parse_result逻辑一致），结果存于_merged_weights */
+void LAC::merge_sentence_rank_weights(const std::vector<std::string>& tags,
+                                      const int64_t *rank_weights, size_t weight_size) {
+    // 如果使用了混合粒度（字词混合），需要根据segment_tool的结果处理word_length，
+    // 当前按字输入，权重与标签一一对应
+    this->_merged_weights.clear();
+    for (size_t ind = 0; ind < tags.size() && ind < weight_size; ++ind) {
+        int weight = static_cast<int>(rank_weights[ind]);
+        if (this->_merged_weights.empty() || 
+            tags[ind].find("-B") != std::string::npos || 
+            tags[ind].find("-S") != std::string::npos) {
+            this->_merged_weights.push_back(weight);
+        } else {
+            // 取最大值作为权重（与Python逻辑一致）
+            this->_merged_weights.back() = std::max(this->_merged_weights.back(), weight);
+        }
+    }
+}
+
+/* 同merge_sentence_rank_weights，按模型输出的标签编号判断词首，不需要标签字符串 */
+void LAC::merge_sentence_rank_ids(size_t sent_index, const int64_t *rank_output) {
+    this->_merged_weights.clear();
+    for (size_t ind = this->_lod[0][sent_index]; ind < this->_lod[0][sent_index + 1]; ++ind) {
+        int weight = static_cast<int>(rank_output[ind]);
+        int64_t label_id = this->_output_data[ind];
+        if (this->_merged_weights.empty() ||
+            (label_id >= 0 && (size_t)label_id < this->_label_begins.size() &&
+             (this->_label_begins[label_id] & LABEL_RANK_BEGIN))) {
+            this->_merged_weights.push_back(weight);
+        } else {
+            this->_merged_weights.back() = std::max(this->_merged_weights.back(), weight);
         }
-        
-        // 解析为最终结果
-        parse_targets(this->_labels, this->_seq_words_batch[i], this->_results);
-        this->_results_batch.push_back(this->_results);
-        tags_for_rank_batch.push_back(tags_for_rank);
-        this->_labels.clear();
     }
-    
-    // 解析并合并rank权重 - 关键步骤
-    merge_rank_weights_with_word_length(tags_for_rank_batch);
-    
-    return this->_results_batch;
 }
 
-/* 解析Rank模型的输出并合并到结果中 - 按照Python逻辑实现 */
-int LAC::merge_rank_weights_with_word_length(const std::vector<std::vector<std::string>>& tags_for_rank_batch) {
-    auto rank_lod = this->_rank_output_tensor->lod();
-    if (rank_lod.empty() || rank_lod[0].empty()) {
-        std::cerr << "Invalid rank output LOD" << std::endl;
+/* 解析Rank模型的输出并合并到results中 - 按照Python逻辑实现 */
+int LAC::merge_rank_weights_with_word_length(const std::vector<std::vector<std::string>>& tags_for_rank_batch,
+                                             std::vector<std::vector<OutputItem>>& results) {
+    const int64_t *rank_output = rank_output_data();
+    if (rank_output == NULL) {
         return -1;
     }
     
-    int rank_output_size = 0;
-    int64_t *rank_output = this->_rank_output_tensor->data<int64_t>(&(this->_place), &rank_output_size);
-    
-    size_t batch_size = rank_lod[0].size() - 1;
-    
-    for (size_t sent_index = 0; sent_index < batch_size && sent_index < this->_results_batch.size(); ++sent_index) {
-        size_t begin = rank_lod[0][sent_index];
-        size_t end = rank_lod[0][sent_index + 1];
-        
-        // 获取当前句子的rank权重
-        std::vector<int> rank_weights;
-        for (size_t j = begin; j < end; ++j) {
-            rank_weights.push_back(static_cast<int>(rank_output[j]));
+    size_t batch_size = this->_lod[0].size() - 1;
+    for (size_t sent_index = 0; sent_index < batch_size && sent_index < results.size(); ++sent_index) {
+        if (sent_index >= tags_for_rank_batch.size()) {
+            break;
         }
-        
-        // 处理word_length - 模拟Python版本的word_length处理
-        if (sent_index < tags_for_rank_batch.size() && !rank_weights.empty()) {
-            const auto& tags = tags_for_rank_batch[sent_index];
-            
-            // 模拟Python版本的word_length扩展逻辑
-            // 这里需要根据segment_tool的处理结果来重新填充权重
-            std::vector<int> expanded_weights = rank_weights;
-            
-            // 如果使用了混合粒度（字词混合），需要处理word_length
-            // 这里简化处理，实际应该根据segment_tool的结果来处理
-            
-            // 按照标签边界合并权重（与Python parse_result逻辑一致）
-            std::vector<int> merged_weights;
-            for (size_t ind = 0; ind < tags.size() && ind < expanded_weights.size(); ++ind) {
-                if (merged_weights.empty() || 
-                    tags[ind].find("-B") != std::string::npos || 
-                    tags[ind].find("-S") != std::string::npos) {
-                    merged_weights.push_back(expanded_weights[ind]);
-                } else {
-                    // 取最大值作为权重（与Python逻辑一致）
-                    merged_weights.back() = std::max(merged_weights.back(), expanded_weights[ind]);
-                }
-            }
+        size_t begin = this->_lod[0][sent_index];
+        merge_sentence_rank_weights(tags_for_rank_batch[sent_index], rank_output + begin,
+                                    this->_lod[0][sent_index + 1] - begin);
             
-            // 将权重分配给结果
-            for (size_t i = 0; i < this->_results_batch[sent_index].size() && i < merged_weights.size(); ++i) {
-                this->_results_batch[sent_index][i].rank = merged_weights[i];
-            }
+        // 将权重分配给结果
+        for (size_t i = 0; i < results[sent_index].size() && i < this->_merged_weights.size(); ++i) {
+            results[sent_index][i].rank = this->_merged_weights[i];
         }
     }
     
     return 0;
 }
 
-// 保留原有的简化版本作为备用
-int LAC::merge_rank_weights(const std::vector<std::vector<std::string>>& tags_for_rank_batch) {
-    return merge_rank_weights_with_word_length(tags_for_rank_batch);
-}
-
 /* 将LAC结果转换为JSON格式字符串 */
 std::string LAC::results_to_json(const std::vector<OutputItem>& results) {
     std::ostringstream json;
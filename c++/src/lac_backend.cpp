@@ -0,0 +1,106 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <iostream>
+
+#include "lac_backend.h"
+
+/* 各后端的创建函数，实现位于lac_backend_*.cpp，由编译选项决定是否编译 */
+#ifdef LAC_WITH_PADDLE
+std::shared_ptr<LACBackend> create_paddle_backend(const std::string &model_path, int threads);
+#endif
+#ifdef LAC_WITH_LITE
+std::shared_ptr<LACBackend> create_lite_backend(const std::string &model_path, int threads);
+#endif
+#ifdef LAC_WITH_NATIVE
+std::shared_ptr<LACBackend> create_native_backend(const std::string &model_path, int threads);
+#endif
+
+std::shared_ptr<LACBackend> create_backend(LAC_BACKEND type, const std::string &model_path, int threads)
+{
+    std::shared_ptr<LACBackend> backend;
+    switch (type)
+    {
+#ifdef LAC_WITH_PADDLE
+    case BACKEND_PADDLE:
+        backend = create_paddle_backend(model_path, threads);
+        break;
+#endif
+#ifdef LAC_WITH_LITE
+    case BACKEND_LITE:
+        backend = create_lite_backend(model_path, threads);
+        break;
+#endif
+#ifdef LAC_WITH_NATIVE
+    case BACKEND_NATIVE:
+        backend = create_native_backend(model_path, threads);
+        break;
+#endif
+    default:
+        std::cerr << "backend " << backend_name(type) << " is not compiled" << std::endl;
+        return backend;
+    }
+    if (!backend)
+    {
+        std::cerr << "failed to load " << backend_name(type) << " model from " << model_path << std::endl;
+    }
+    return backend;
+}
+
+LAC_BACKEND default_backend()
+{
+#if defined(LAC_WITH_PADDLE)
+    return BACKEND_PADDLE;
+#elif defined(LAC_WITH_LITE)
+    return BACKEND_LITE;
+#elif defined(LAC_WITH_NATIVE)
+    return BACKEND_NATIVE;
+#else
+    return BACKEND_PADDLE;
+#endif
+}
+
+bool parse_backend(const std::string &name, LAC_BACKEND &type)
+{
+    if (name == "paddle")
+    {
+        type = BACKEND_PADDLE;
+    }
+    else if (name == "lite")
+    {
+        type = BACKEND_LITE;
+    }
+    else if (name == "native")
+    {
+        type = BACKEND_NATIVE;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char *backend_name(LAC_BACKEND type)
+{
+    switch (type)
+    {
+    case BACKEND_LITE:
+        return "lite";
+    case BACKEND_NATIVE:
+        return "native";
+    default:
+        return "paddle";
+    }
+}
@@ -0,0 +1,152 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* Paddle-Lite后端，装载opt工具转换得到的model_path/model.nb
+ * 使用light api(MobileConfig)，Android与x86版本的预测库均可使用 */
+
+#ifdef LAC_WITH_LITE
+
+#include <cstring>
+#include <iostream>
+
+#include "paddle_api.h"
+
+#include "lac_backend.h"
+
+class LiteBackend : public LACBackend
+{
+private:
+    std::shared_ptr<paddle::lite_api::PaddlePredictor> _predictor;
+    std::vector<std::unique_ptr<paddle::lite_api::Tensor>> _input_tensors;
+    std::vector<std::unique_ptr<const paddle::lite_api::Tensor>> _output_tensors;
+    paddle::lite_api::shape_t _input_shape;
+    paddle::lite_api::lod_t _lod;
+
+    /* 获取输入输出句柄，每次运行时不再重复查询 */
+    void init_tensors()
+    {
+        size_t input_count = this->_predictor->GetInputNames().size();
+        for (size_t i = 0; i < input_count; ++i)
+        {
+            this->_input_tensors.push_back(this->_predictor->GetInput(i));
+        }
+        size_t output_count = this->_predictor->GetOutputNames().size();
+        for (size_t i = 0; i < output_count; ++i)
+        {
+            this->_output_tensors.push_back(this->_predictor->GetOutput(i));
+        }
+    }
+
+    /* 第index个输出的数据及元素个数 */
+    int output_data(size_t index, const int64_t *&output, size_t &output_size)
+    {
+        const paddle::lite_api::Tensor &tensor = *this->_output_tensors[index];
+        paddle::lite_api::shape_t shape = tensor.shape();
+        output_size = 1;
+        for (size_t i = 0; i < shape.size(); ++i)
+        {
+            output_size *= shape[i];
+        }
+        output = tensor.data<int64_t>();
+        return 0;
+    }
+
+public:
+    explicit LiteBackend(const std::shared_ptr<paddle::lite_api::PaddlePredictor> &predictor)
+        : _predictor(predictor),
+          _input_shape({0, 1})
+    {
+        init_tensors();
+    }
+
+    int run(const int64_t *const *inputs, size_t num_inputs, size_t count,
+            const std::vector<std::vector<size_t>> &lod,
+            const int64_t *&output, size_t &output_size)
+    {
+        if (num_inputs != this->_input_tensors.size())
+        {
+            std::cerr << "model expects " << this->_input_tensors.size() << " inputs but got " << num_inputs
+                      << std::endl;
+            return -1;
+        }
+
+        // Paddle-Lite的LoD为uint64，复用转换缓冲区
+        this->_lod.resize(lod.size());
+        for (size_t i = 0; i < lod.size(); ++i)
+        {
+            this->_lod[i].assign(lod[i].begin(), lod[i].end());
+        }
+        this->_input_shape[0] = count;
+        for (size_t i = 0; i < num_inputs; ++i)
+        {
+            paddle::lite_api::Tensor &tensor = *this->_input_tensors[i];
+            tensor.Resize(this->_input_shape);
+            tensor.SetLoD(this->_lod);
+            int64_t *input_d = tensor.mutable_data<int64_t>();
+            if (count > 0)
+            {
+                std::memcpy(input_d, inputs[i], count * sizeof(int64_t));
+            }
+        }
+
+        this->_predictor->Run();
+        return this->output_data(0, output, output_size);
+    }
+
+    size_t input_count() const
+    {
+        return this->_input_tensors.size();
+    }
+
+    size_t output_count() const
+    {
+        return this->_output_tensors.size();
+    }
+
+    int output(size_t index, const int64_t *&output, size_t &output_size)
+    {
+        if (index == 0 || index >= this->_output_tensors.size())
+        {
+            return -1;
+        }
+        return this->output_data(index, output, output_size);
+    }
+
+    /* 拷贝出的预测器共享模型参数 */
+    std::shared_ptr<LACBackend> clone()
+    {
+        return std::make_shared<LiteBackend>(this->_predictor->Clone());
+    }
+
+    LAC_BACKEND type() const
+    {
+        return BACKEND_LITE;
+    }
+};
+
+std::shared_ptr<LACBackend> create_lite_backend(const std::string &model_path, int threads)
+{
+    paddle::lite_api::MobileConfig config;
+    config.set_threads(threads);
+    config.set_model_from_file(model_path + "/model.nb");
+    std::shared_ptr<paddle::lite_api::PaddlePredictor> predictor =
+        paddle::lite_api::CreatePaddlePredictor<paddle::lite_api::MobileConfig>(config);
+    if (!predictor)
+    {
+        return std::shared_ptr<LACBackend>();
+    }
+    return std::make_shared<LiteBackend>(predictor);
+}
+
+#endif  // LAC_WITH_LITE
@@ -0,0 +1,195 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* Paddle Inference后端，装载model_path/model下的模型
+ * 存在export_emission_model.py导出的model_path/model_emission时，模型输出发射分数，由ViterbiDecoder解码 */
+
+#ifdef LAC_WITH_PADDLE
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <paddle_inference_api.h>
+
+#include "lac_backend.h"
+#include "lac_viterbi.h"
+
+class PaddleBackend : public LACBackend
+{
+private:
+    paddle::PaddlePlace _place;
+    std::shared_ptr<paddle_infer::Predictor> _predictor;
+    std::vector<std::shared_ptr<paddle_infer::Tensor>> _input_tensors;
+    std::vector<std::shared_ptr<paddle_infer::Tensor>> _output_tensors;
+    std::vector<int> _input_shape;
+    std::shared_ptr<const ViterbiDecoder> _decoder;     // 非空时模型输出发射分数，各会话共享
+    ViterbiBuffers _viterbi;
+    std::vector<int64_t> _tags;
+
+    /* 获取输入输出句柄，每次运行时不再重复查询 */
+    void init_tensors()
+    {
+        auto input_names = this->_predictor->GetInputNames();
+        for (size_t i = 0; i < input_names.size(); ++i)
+        {
+            this->_input_tensors.push_back(this->_predictor->GetInputHandle(input_names[i]));
+        }
+        auto output_names = this->_predictor->GetOutputNames();
+        for (size_t i = 0; i < output_names.size(); ++i)
+        {
+            this->_output_tensors.push_back(this->_predictor->GetOutputHandle(output_names[i]));
+        }
+    }
+
+public:
+    PaddleBackend(const std::shared_ptr<paddle_infer::Predictor> &predictor,
+                  const std::shared_ptr<const ViterbiDecoder> &decoder)
+        : _place(paddle::PaddlePlace::kCPU),
+          _predictor(predictor),
+          _input_shape({0, 1}),
+          _decoder(decoder)
+    {
+        init_tensors();
+    }
+
+    int run(const int64_t *const *inputs, size_t num_inputs, size_t count,
+            const std::vector<std::vector<size_t>> &lod,
+            const int64_t *&output, size_t &output_size)
+    {
+        return this->run_constrained(inputs, num_inputs, count, lod, NULL, output, output_size);
+    }
+
+    bool constrained_decoding() const
+    {
+        return this->_decoder.get() != NULL;
+    }
+
+    int run_constrained(const int64_t *const *inputs, size_t num_inputs, size_t count,
+                        const std::vector<std::vector<size_t>> &lod, const float *const *masks,
+                        const int64_t *&output, size_t &output_size)
+    {
+        if (num_inputs != this->_input_tensors.size())
+        {
+            std::cerr << "model expects " << this->_input_tensors.size() << " inputs but got " << num_inputs
+                      << std::endl;
+            return -1;
+        }
+        this->_input_shape[0] = count;
+        for (size_t i = 0; i < num_inputs; ++i)
+        {
+            paddle_infer::Tensor &tensor = *this->_input_tensors[i];
+            tensor.SetLoD(lod);
+            tensor.Reshape(this->_input_shape);
+            int64_t *input_d = tensor.mutable_data<int64_t>(this->_place);
+            if (count > 0)
+            {
+                std::memcpy(input_d, inputs[i], count * sizeof(int64_t));
+            }
+        }
+
+        this->_predictor->Run();
+
+        int size = 0;
+        if (!this->_decoder)
+        {
+            output = this->_output_tensors[0]->data<int64_t>(&(this->_place), &size);
+            output_size = size;
+            return 0;
+        }
+        const float *emission = this->_output_tensors[0]->data<float>(&(this->_place), &size);
+        if ((size_t)size != count * this->_decoder->num_labels())
+        {
+            std::cerr << "emission size " << size << " does not match " << count << " x "
+                      << this->_decoder->num_labels() << std::endl;
+            return -1;
+        }
+        this->_tags.resize(count);
+        if (count > 0 && !lod.empty())
+        {
+            this->_decoder->decode(emission, lod[0], masks, this->_viterbi, this->_tags.data());
+        }
+        output = this->_tags.data();
+        output_size = count;
+        return 0;
+    }
+
+    size_t input_count() const
+    {
+        return this->_input_tensors.size();
+    }
+
+    size_t output_count() const
+    {
+        return this->_output_tensors.size();
+    }
+
+    int output(size_t index, const int64_t *&output, size_t &output_size)
+    {
+        if (index == 0 || index >= this->_output_tensors.size())
+        {
+            return -1;
+        }
+        int size = 0;
+        output = this->_output_tensors[index]->data<int64_t>(&(this->_place), &size);
+        output_size = size;
+        return 0;
+    }
+
+    /* 拷贝出的预测器共享模型参数 */
+    std::shared_ptr<LACBackend> clone()
+    {
+        std::shared_ptr<paddle_infer::Predictor> predictor(this->_predictor->Clone());
+        return std::make_shared<PaddleBackend>(predictor, this->_decoder);
+    }
+
+    LAC_BACKEND type() const
+    {
+        return BACKEND_PADDLE;
+    }
+};
+
+std::shared_ptr<LACBackend> create_paddle_backend(const std::string &model_path, int threads)
+{
+    std::string model_dir = model_path + "/model";
+    std::shared_ptr<ViterbiDecoder> decoder;
+    std::string transition_path = model_path + "/model_emission/crf_transition";
+    if (std::ifstream(transition_path.c_str()).good())
+    {
+        decoder = std::make_shared<ViterbiDecoder>();
+        if (decoder->load(transition_path) != 0)
+        {
+            return std::shared_ptr<LACBackend>();
+        }
+        model_dir = model_path + "/model_emission";
+    }
+
+    // 使用AnalysisConfig装载模型，会进一步优化模型
+    paddle_infer::Config config;
+    // config.SwitchIrOptim(false);       // 关闭优化
+    // config.EnableMKLDNN();
+    config.DisableGpu();
+    config.DisableGlogInfo();
+    config.SetModel(model_dir);
+    config.SetCpuMathLibraryNumThreads(threads);
+    config.SwitchUseFeedFetchOps(false);
+    std::shared_ptr<paddle_infer::Predictor> predictor = paddle_infer::CreatePredictor(config);
+    if (!predictor)
+    {
+        return std::shared_ptr<LACBackend>();
+    }
+    return std::make_shared<PaddleBackend>(predictor, decoder);
+}
+
+#endif  // LAC_WITH_PADDLE
@@ -12,11 +12,56 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License. */
 
+#include<algorithm>
+#include<chrono>
 #include<iostream>
+#include<limits>
 #include "lac_custom.h"
 
-/* 从用户词典中进行装载 */
-RVAL Customization::load_dict(const std::string &customization_dic_path){
+/* 解析词典的一行：phrase为词的各字的编码，tags和split为各部分的词性和累计长度 */
+static RVAL parse_line(const std::string &line, std::vector<uint32_t> &phrase,
+        std::vector<std::string> &tags, std::vector<int> &split){
+    // 中文字符处理临时变量
+    std::vector<std::string> line_vector;
+    if (split_tokens(line, " ", line_vector) < _SUCCESS) {
+        return _FAILD;
+    }
+
+    std::vector<std::string> chars;
+    int length = 0;
+    for (auto kv : line_vector){
+        if (kv.length() < 1){
+            continue;
+        }
+        // 将中文字符串拆分为字
+        std::string word = kv.substr(0, kv.rfind("/"));
+        if (kv.length()>1){
+            split_words(word, CODE_UTF8, chars);
+        }else{
+            split_words(kv, CODE_UTF8, chars);
+        }
+
+        for (size_t i=0; i<chars.size(); i++){
+            phrase.push_back(char_code(chars[i]));
+        }
+        length += chars.size();
+        std::string tag = (word.length() < kv.size()) ? kv.substr(kv.rfind("/") + 1) : "";
+        tags.push_back(tag);
+        split.push_back(length);
+    }
+    return _SUCCESS;
+}
+
+/* 字序列作为索引的key，每个字的编码占4字节 */
+static void phrase_key(const std::vector<uint32_t> &phrase, std::string &key){
+    key.assign((const char*)phrase.data(), phrase.size() * sizeof(uint32_t));
+}
+
+/* 每批解析的行数，限制解析结果占用的临时内存 */
+static const size_t LOAD_BATCH_LINES = 1 << 20;
+
+/* 从用户词典中进行装载，装载后只含该文件的词条 */
+RVAL Customization::load_dict(const std::string &customization_dic_path, int threads){
     std::ifstream fin;
     fin.open(customization_dic_path.c_str());
     if (!fin) {
@@ -25,87 +70,272 @@ RVAL Customization::load_dict(const std::string &customization_dic_path){
         return _FAILD;
     }
 
-    std::string line;
-    
-    // 中文字符处理临时变量
-    std::vector<std::string> line_vector;
-    
-    while (getline(fin, line))
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<Base> base = std::make_shared<Base>();
+    std::vector<std::string> lines;
+    std::vector<std::vector<uint32_t>> phrases;
+    size_t term_bytes = 0;
+    bool eof = false;
+    while (!eof)
     {
-        if (line.length() < 1){
-                continue;
+        // 读入一批非空行
+        std::string line;
+        lines.clear();
+        while (lines.size() < LOAD_BATCH_LINES && !(eof = !getline(fin, line))){
+            if (line.length() > 0){
+                lines.push_back(line);
+            }
         }
-        if (split_tokens(line, " ", line_vector) < _SUCCESS) {
+
+        // 各线程解析一段连续的行，词条的编号与逐行装载时一致
+        size_t first = base->terms.size();
+        base->terms.resize(first + lines.size());
+        phrases.clear();
+        phrases.resize(lines.size());
+        int batch_threads = parallel_threads(threads, lines.size(), 4096);
+        std::vector<size_t> errors(batch_threads, lines.size());
+        std::vector<size_t> bytes(batch_threads, 0);
+        parallel_for(lines.size(), batch_threads, [&](size_t begin, size_t end, int part){
+            for (size_t i=begin; i<end; i++){
+                customization_term &term = base->terms[first + i];
+                if (parse_line(lines[i], phrases[i], term.tags, term.split) < _SUCCESS){
+                    errors[part] = i;
+                    return;
+                }
+                bytes[part] += term.tags.capacity() * sizeof(std::string) + term.split.capacity() * sizeof(int);
+            }
+        });
+        size_t error = *std::min_element(errors.begin(), errors.end());
+        if (error < lines.size()) {
             std::cerr << "Load customization dic failed ! -- format error "
-                    << line << std::endl;
+                    << lines[error] << std::endl;
             return _FAILD;
         }
-        
-        // 读取用户字典文件并存入相应数据结构
-        std::vector<std::string> chars;
-        std::vector<std::string> phrase;
+        for (size_t part=0; part<bytes.size(); part++){
+            term_bytes += bytes[part];
+        }
+        base->ac.insert(phrases, first, threads);
+    }
+    base->ac.make_fail(threads);
+
+    fin.close();
+
+    _base = base;
+    _overlay_terms.clear();
+    _overlay_phrases.clear();
+    _overlay_ac.reset();
+    _deleted.clear();
+    _deleted_counts.clear();
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    size_t memory = base->ac.memory_bytes() + base->terms.capacity() * sizeof(customization_term) + term_bytes;
+    std::cerr << "Loaded customization dic -- num = " << _base->terms.size()
+            << ", nodes = " << base->ac.node_count()
+            << ", memory = " << memory / (1 << 20) << " MB"
+            << ", build = " << (int64_t)build_ms << " ms" << std::endl;
+    return _SUCCESS;
+}
+
+std::shared_ptr<Customization> Customization::update(const std::vector<std::string> &add,
+        const std::vector<std::string> &remove) const{
+    std::shared_ptr<Customization> next = std::make_shared<Customization>();
+    next->_base = _base;
+    next->_deleted = _deleted;
+    next->_deleted_counts = _deleted_counts;
+
+    // 覆盖层的词条按字序列索引，删除或替换的词条在重建时跳过
+    std::vector<customization_term> terms(_overlay_terms);
+    std::vector<std::vector<uint32_t>> phrases(_overlay_phrases);
+    std::vector<char> alive(terms.size(), 1);
+    std::unordered_map<std::string, size_t> index;
+    std::string key;
+    for (size_t i=0; i<phrases.size(); i++){
+        phrase_key(phrases[i], key);
+        index[key] = i;
+    }
+
+    for (size_t k=0; k<remove.size() + add.size(); k++){
+        bool adding = k >= remove.size();
+        const std::string &line = adding ? add[k - remove.size()] : remove[k];
+        std::vector<uint32_t> phrase;
         std::vector<std::string> tags;
         std::vector<int> split;
-        int length = 0;
-        for (auto kv : line_vector){
-            if (kv.length() < 1){
-                continue;
+        if (parse_line(line, phrase, tags, split) < _SUCCESS || phrase.empty()) {
+            std::cerr << "Update customization dic failed ! -- format error "
+                    << line << std::endl;
+            return std::shared_ptr<Customization>();
+        }
+
+        // 基础词典中的同一个词被删除或替换
+        std::vector<Node*> path;
+        int value = _base->ac.find(phrase, &path);
+        if (value >= 0 && next->_deleted.insert(value).second){
+            for (size_t i=0; i<path.size(); i++){
+                next->_deleted_counts[path[i]]++;
             }
-            // 将中文字符串拆分为字
-            std::string word = kv.substr(0, kv.rfind("/"));
-            if (kv.length()>1){
-                split_words(word, CODE_UTF8, chars);
-            }else{
-                split_words(kv, CODE_UTF8, chars);
+        }
+        phrase_key(phrase, key);
+        auto iter = index.find(key);
+        if (iter != index.end()){
+            alive[iter->second] = 0;
+            index.erase(iter);
+        }
+        if (adding){
+            index[key] = terms.size();
+            terms.push_back(customization_term(tags, split));
+            phrases.push_back(phrase);
+            alive.push_back(1);
+        }
+    }
+
+    // 重建覆盖层的自动机，耗时与覆盖层的词条数成正比
+    for (size_t i=0; i<terms.size(); i++){
+        if (!alive[i]){
+            continue;
+        }
+        if (!next->_overlay_ac){
+            next->_overlay_ac = std::make_shared<AhoCorasick>();
+        }
+        next->_overlay_ac->insert(phrases[i], next->_overlay_terms.size());
+        next->_overlay_terms.push_back(terms[i]);
+        next->_overlay_phrases.push_back(phrases[i]);
+    }
+    if (next->_overlay_ac){
+        next->_overlay_ac->make_fail();
+    }
+    return next;
+}
+
+std::shared_ptr<Customization> Customization::compact(int threads) const{
+    std::shared_ptr<Customization> next = std::make_shared<Customization>();
+    Base &base = *next->_base;
+    std::vector<std::vector<uint32_t>> phrases;
+    _base->ac.for_each([&](const std::vector<uint32_t> &phrase, int value){
+        if (_deleted.count(value) == 0){
+            phrases.push_back(phrase);
+            base.terms.push_back(_base->terms[value]);
+        }
+    });
+    phrases.insert(phrases.end(), _overlay_phrases.begin(), _overlay_phrases.end());
+    base.terms.insert(base.terms.end(), _overlay_terms.begin(), _overlay_terms.end());
+    base.ac.insert(phrases, 0, threads);
+    base.ac.make_fail(threads);
+    return next;
+}
+
+/* 基础自动机与覆盖层同步转移，两者的状态中较长的为合并后自动机的状态，长度相同时以覆盖层的词条为准
+ * 基础自动机本身的状态不受删除影响，继续按原自动机转移 */
+void Customization::search(const std::vector<uint32_t> &codes, std::vector<std::pair<int, int>> &ac_res) const{
+    ac_res.clear();
+
+    // 匹配必然从某个词条的首字开始，多数query没有任何首字，直接跳过查询
+    bool may_match = false;
+    for (size_t i=0; i<codes.size() && !may_match; i++){
+        may_match = _base->ac.may_start(codes[i]) || (_overlay_ac && _overlay_ac->may_start(codes[i]));
+    }
+    if (!may_match){
+        return;
+    }
+
+    if (!_overlay_ac && _deleted.empty()){
+        _base->ac.search(codes, ac_res);
+        return;
+    }
+
+    int base_size = _base->terms.size();
+    Node *base_state = _base->ac.root();
+    Node *overlay_state = _overlay_ac ? _overlay_ac->root() : NULL;
+    for (size_t i=0; i<codes.size(); i++){
+        base_state = _base->ac.next_state(base_state, codes[i]);
+
+        // 只剩删除的词条的结点在重建的自动机中不存在，退到其最长的仍有词条的后缀
+        Node *state = base_state;
+        while (state != _base->ac.root()){
+            auto iter = _deleted_counts.find(state);
+            if (iter == _deleted_counts.end() || iter->second < state->count){
+                break;
+            }
+            state = state->fail;
+        }
+        int value = state->value;
+        if (value >= 0 && _deleted.count(value) > 0){
+            value = -1;
+        }
+        if (overlay_state){
+            overlay_state = _overlay_ac->next_state(overlay_state, codes[i]);
+            if (overlay_state->depth > state->depth ||
+                    (overlay_state->depth == state->depth && overlay_state->value >= 0)){
+                value = overlay_state->value >= 0 ? base_size + overlay_state->value : -1;
             }
-            
-            phrase.insert(phrase.end(), chars.begin(), chars.end());
-            length += chars.size();
-            std::string tag = (word.length() < kv.size()) ? kv.substr(kv.rfind("/") + 1) : "";
-            tags.push_back(tag);
-            split.push_back(length);
         }
-        int value = _customization_dic.size();
-        _customization_dic.push_back(customization_term(tags, split));
-        _ac_dict.insert(phrase, value);
+        if (value >= 0){
+            ac_res.push_back(std::make_pair(i, value));
+        }
     }
-    _ac_dict.make_fail();
+}
 
-    fin.close();
-    
-    std::cerr << "Loaded customization dic -- num = " << _customization_dic.size()
-            << std::endl;
-    return _SUCCESS;
+/* 收集词条中的非空词性，按首次出现的顺序追加到tags */
+void Customization::collect_tags(std::vector<std::string> &tags, bool overlay_only) const{
+    for (size_t i=overlay_only ? _base->terms.size() : 0; i<_base->terms.size() + _overlay_terms.size(); i++){
+        const customization_term &item = term(i);
+        for (size_t j=0; j<item.tags.size(); j++){
+            const std::string &tag = item.tags[j];
+            if (tag.length() > 0 && std::find(tags.begin(), tags.end(), tag) == tags.end()){
+                tags.push_back(tag);
+            }
+        }
+    }
 }
 
 /* 对lac的预测结果进行干预 */
 RVAL Customization::parse_customization(const std::vector<std::string> &seq_chars, std::vector<std::string> &tag_ids){
     // AC自动机查询返回结果
+    std::vector<uint32_t> codes;
     std::vector<std::pair<int, int>> ac_res;
-    _ac_dict.search(seq_chars, ac_res);
-    
-    int pre_begin = -1, pre_end = -1;
-    for (auto ac_pair : ac_res){
-        int value = ac_pair.second;
-        int length = _customization_dic[value].split.back();
-        int begin = ac_pair.first - length + 1;
+    return parse_customization(seq_chars, tag_ids, codes, ac_res);
+}
+
+RVAL Customization::parse_customization(const std::vector<std::string> &seq_chars, std::vector<std::string> &tag_ids,
+        std::vector<uint32_t> &codes, std::vector<std::pair<int, int>> &ac_res){
+    char_codes(seq_chars, codes);
+    return parse_customization(codes, tag_ids, ac_res);
+}
 
-        // 对查询结果进行预处理
+void Customization::select(const std::vector<uint32_t> &codes, std::vector<std::pair<int, int>> &ac_res) const{
+    search(codes, ac_res);
+
+    // 对查询结果进行预处理
+    size_t count = 0;
+    int pre_begin = -1, pre_end = -1;
+    for (size_t i=0; i<ac_res.size(); i++){
+        int begin = ac_res[i].first - term(ac_res[i].second).split.back() + 1;
         if (pre_begin < begin && pre_end >= begin){
             continue;
         }
         pre_begin = begin;
-        pre_end = ac_pair.first;
+        pre_end = ac_res[i].first;
+        ac_res[count++] = ac_res[i];
+    }
+    ac_res.resize(count);
+}
+
+RVAL Customization::parse_customization(const std::vector<uint32_t> &codes, std::vector<std::string> &tag_ids,
+        std::vector<std::pair<int, int>> &ac_res){
+    select(codes, ac_res);
+    for (const auto &ac_pair : ac_res){
+        const customization_term &item = term(ac_pair.second);
+        int length = item.split.back();
+        int begin = ac_pair.first - length + 1;
 
-        // 修正标注中的标签
-        for (size_t i=0; i<_customization_dic[value].split.size(); i++){
-            std::string tag = _customization_dic[value].tags[i];
-            for (int j=0; j<_customization_dic[value].split[i]; j++){
+        // 修正标注中的标签，split为各部分的累计长度
+        for (size_t i=0; i<item.split.size(); i++){
+            const std::string &tag = item.tags[i];
+            int part_begin = (i > 0) ? item.split[i-1] : 0;
+            for (int j=part_begin; j<item.split[i]; j++){
                 if (tag.length() < 1){
                     tag_ids[begin][tag_ids[begin].length()-1] = 'I';
                 }
                 else{
-                    tag_ids[begin] = tag + "-I";
+                    tag_ids[begin].assign(tag).append("-I");
                 }
                 begin ++;
             }
@@ -114,8 +344,8 @@ RVAL Customization::parse_customization(const std::vector<std::string> &seq_char
         // 修正标注中的分词
         begin = ac_pair.first - length + 1;
         tag_ids[begin][tag_ids[begin].length()-1] = 'B';
-        for (size_t i=0; i<_customization_dic[value].split.size(); i++){
-            size_t ind = begin+_customization_dic[value].split[i];
+        for (size_t i=0; i<item.split.size(); i++){
+            size_t ind = begin+item.split[i];
             if (ind < tag_ids.size()){
                 tag_ids[ind][tag_ids[ind].length()-1] = 'B';
             }
@@ -123,3 +353,346 @@ RVAL Customization::parse_customization(const std::vector<std::string> &seq_char
     }
     return _SUCCESS;
 }
+
+RVAL Customization::parse_customization(const std::vector<uint32_t> &codes, LabelTable &labels, int64_t *label_ids,
+        std::vector<std::pair<int, int>> &ac_res){
+    select(codes, ac_res);
+    for (const auto &ac_pair : ac_res){
+        const customization_term &item = term(ac_pair.second);
+        int begin = ac_pair.first - item.split.back() + 1;
+
+        // 修正标注中的标签：有词性时改为"词性-I"，否则只将标签改为非词首
+        for (size_t i=0; i<item.split.size(); i++){
+            const std::string &tag = item.tags[i];
+            int tag_label = tag.length() < 1 ? -1 : labels.tag_inner(tag);
+            int part_begin = (i > 0) ? item.split[i-1] : 0;
+            for (int j=part_begin; j<item.split[i]; j++){
+                int64_t &label = label_ids[begin + j];
+                label = tag_label >= 0 ? tag_label : labels.inner(label);
+            }
+        }
+
+        // 修正标注中的分词
+        label_ids[begin] = labels.begin(label_ids[begin]);
+        for (size_t i=0; i<item.split.size(); i++){
+            size_t ind = begin+item.split[i];
+            if (ind < codes.size()){
+                label_ids[ind] = labels.begin(label_ids[ind]);
+            }
+        }
+    }
+    return _SUCCESS;
+}
+
+RVAL Customization::decode_constraints(const std::vector<uint32_t> &codes,
+        std::vector<std::pair<int, int>> &ac_res,
+        const ConstraintMasks &masks, const float **char_masks){
+    // 匹配的选取与parse_customization一致，后选取的匹配覆盖先前的约束
+    select(codes, ac_res);
+    const float *boundary = masks.mask("", true);
+    for (const auto &ac_pair : ac_res){
+        const customization_term &term = this->term(ac_pair.second);
+        int begin = ac_pair.first - term.split.back() + 1;
+        for (size_t i=0; i<term.split.size(); i++){
+            // 每个部分只查一次词性，部分内的字直接使用词首、非词首的约束
+            int part_begin = (i > 0) ? term.split[i-1] : 0;
+            const float *begin_mask = masks.mask(term.tags[i], true);
+            const float *inner_mask = begin_mask + masks.num_labels();
+            for (int j=part_begin; j<term.split[i]; j++){
+                char_masks[begin + j] = j == part_begin ? begin_mask : inner_mask;
+            }
+        }
+        if (ac_pair.first + 1 < (int)codes.size()){
+            char_masks[ac_pair.first + 1] = boundary;
+        }
+    }
+    return _SUCCESS;
+}
+
+LabelTable::LabelTable(const std::vector<std::string> &labels):
+    _names(labels),
+    _begins(labels.size(), -1),
+    _inners(labels.size(), -1){
+    for (size_t i=0; i<labels.size(); i++){
+        _ids.insert(std::make_pair(labels[i], (int)i));
+    }
+    for (size_t i=0; i<labels.size(); i++){
+        add_variants(i);
+    }
+}
+
+/* 与按字符串改写时修改末字一致，末字改为B、I所得的标签不存在时追加 */
+void LabelTable::add_variants(int id){
+    if (_names[id].empty()){
+        _begins[id] = id;
+        _inners[id] = id;
+        return;
+    }
+    std::string variant = _names[id];
+    variant[variant.length()-1] = 'B';
+    int begin = this->id(variant);
+    variant[variant.length()-1] = 'I';
+    int inner = this->id(variant);
+    _begins[id] = begin;
+    _inners[id] = inner;
+}
+
+int LabelTable::id(const std::string &label){
+    auto iter = _ids.find(label);
+    if (iter != _ids.end()){
+        return iter->second;
+    }
+    int id = _names.size();
+    _names.push_back(label);
+    _ids[label] = id;
+    _begins.push_back(-1);
+    _inners.push_back(-1);
+    add_variants(id);
+    return id;
+}
+
+int LabelTable::tag_inner(const std::string &tag){
+    auto iter = _tag_inners.find(tag);
+    if (iter != _tag_inners.end()){
+        return iter->second;
+    }
+    int inner = id(tag + "-I");
+    _tag_inners[tag] = inner;
+    return inner;
+}
+
+ConstraintMasks::ConstraintMasks(const std::vector<std::string> &labels, const std::vector<std::string> &tags):
+    _num_labels(labels.size()){
+    const float disallowed = -std::numeric_limits<float>::infinity();
+    _masks.assign((2 + 2 * tags.size()) * _num_labels, disallowed);
+
+    // 与LAC::parse_targets一致，以B或S结尾的标签为词首
+    for (int j=0; j<_num_labels; j++){
+        const std::string &label = labels[j];
+        bool begin = label.length() > 0 &&
+                (label[label.length()-1] == 'B' || label[label.length()-1] == 'S');
+        _masks[(begin ? 0 : 1) * _num_labels + j] = 0.0f;
+    }
+
+    int row = 2;
+    for (size_t i=0; i<tags.size(); i++){
+        auto begin_iter = std::find(labels.begin(), labels.end(), tags[i] + "-B");
+        auto inner_iter = std::find(labels.begin(), labels.end(), tags[i] + "-I");
+        if (begin_iter == labels.end() || inner_iter == labels.end()){
+            continue;
+        }
+        _masks[row * _num_labels + (begin_iter - labels.begin())] = 0.0f;
+        _masks[(row + 1) * _num_labels + (inner_iter - labels.begin())] = 0.0f;
+        _rows[tags[i]] = row;
+        row += 2;
+    }
+    _masks.resize(row * _num_labels);
+}
+
+const float *ConstraintMasks::mask(const std::string &tag, bool begin) const{
+    int row = 0;
+    if (tag.length() > 0){
+        auto iter = _rows.find(tag);
+        if (iter != _rows.end()){
+            row = iter->second;
+        }
+    }
+    return &_masks[(row + (begin ? 0 : 1)) * _num_labels];
+}
+
+CustomizationRegistry::~CustomizationRegistry(){
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _compact_cond.notify_all();
+    if (_compactor.joinable()){
+        _compactor.join();
+    }
+}
+
+RVAL CustomizationRegistry::load(const std::string &name, const std::string &path){
+    std::lock_guard<std::mutex> update_lock(_update_mutex);
+
+    // 装载时不持有_mutex，不阻塞其他词典的选取
+    std::shared_ptr<Customization> dict = std::make_shared<Customization>();
+    if (dict->load_dict(path) != _SUCCESS){
+        return _FAILD;
+    }
+    if (_tag_listener){
+        std::vector<std::string> tags;
+        dict->collect_tags(tags);
+        _tag_listener(tags);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry &entry = _dicts[name];
+    entry.path = path;
+    entry.dict = dict;
+    entry.generation = ++_generation;
+    entry.compacting = false;
+    entry.pending.clear();
+    return _SUCCESS;
+}
+
+RVAL CustomizationRegistry::reload(const std::string &name){
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _dicts.find(name);
+        if (iter == _dicts.end()){
+            std::cerr << "Customization dic not registered -- " << name << std::endl;
+            return _FAILD;
+        }
+        path = iter->second.path;
+    }
+    return load(name, path);
+}
+
+RVAL CustomizationRegistry::remove(const std::string &name){
+    std::lock_guard<std::mutex> update_lock(_update_mutex);
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dicts.erase(name) > 0 ? _SUCCESS : _FAILD;
+}
+
+RVAL CustomizationRegistry::update(const std::string &name, const std::vector<std::string> &add,
+        const std::vector<std::string> &remove){
+    std::lock_guard<std::mutex> update_lock(_update_mutex);
+    std::shared_ptr<Customization> current = get(name);
+    if (!current){
+        std::cerr << "Customization dic not registered -- " << name << std::endl;
+        return _FAILD;
+    }
+    std::shared_ptr<Customization> next = current->update(add, remove);
+    if (!next){
+        return _FAILD;
+    }
+    if (_tag_listener){
+        std::vector<std::string> tags;
+        next->collect_tags(tags, true);
+        _tag_listener(tags);
+    }
+
+    bool compact = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Entry &entry = _dicts[name];
+        entry.dict = next;
+        if (entry.compacting){
+            Update op;
+            op.add = add;
+            op.remove = remove;
+            entry.pending.push_back(op);
+        }
+        else if (_compact_threshold > 0 && next->overlay_size() >= _compact_threshold &&
+                std::find(_compact_queue.begin(), _compact_queue.end(), name) == _compact_queue.end()){
+            _compact_queue.push_back(name);
+            compact = true;
+            if (!_compactor.joinable()){
+                _compactor = std::thread(&CustomizationRegistry::compact_loop, this);
+            }
+        }
+    }
+    if (compact){
+        _compact_cond.notify_one();
+    }
+    return _SUCCESS;
+}
+
+RVAL CustomizationRegistry::compact(const std::string &name){
+    std::shared_ptr<Customization> snapshot;
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> update_lock(_update_mutex);
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _dicts.find(name);
+        if (iter == _dicts.end() || iter->second.compacting){
+            return _FAILD;
+        }
+        snapshot = iter->second.dict;
+        generation = iter->second.generation;
+        iter->second.compacting = true;
+        iter->second.pending.clear();
+    }
+
+    // 不持有锁，期间的增删记录在pending中
+    std::shared_ptr<Customization> next = snapshot->compact();
+
+    std::lock_guard<std::mutex> update_lock(_update_mutex);
+    std::vector<Update> pending;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _dicts.find(name);
+        if (iter == _dicts.end() || iter->second.generation != generation){
+            return _FAILD;
+        }
+        pending.swap(iter->second.pending);
+    }
+    for (size_t i=0; i<pending.size() && next; i++){
+        next = next->update(pending[i].add, pending[i].remove);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry &entry = _dicts[name];
+    entry.compacting = false;
+    if (!next){
+        return _FAILD;
+    }
+    entry.dict = next;
+    return _SUCCESS;
+}
+
+void CustomizationRegistry::compact_loop(){
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true){
+        while (!_stop && _compact_queue.empty()){
+            _compact_cond.wait(lock);
+        }
+        if (_stop){
+            return;
+        }
+        std::string name = _compact_queue.front();
+        _compact_queue.pop_front();
+        lock.unlock();
+        compact(name);
+        lock.lock();
+    }
+}
+
+std::shared_ptr<Customization> CustomizationRegistry::get(const std::string &name) const{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iter = _dicts.find(name);
+    return iter != _dicts.end() ? iter->second.dict : std::shared_ptr<Customization>();
+}
+
+RVAL CustomizationRegistry::select(const std::vector<std::string> &names,
+        std::vector<std::shared_ptr<Customization>> &layers, std::string *missing) const{
+    layers.clear();
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i=0; i<names.size(); i++){
+        auto iter = _dicts.find(names[i]);
+        if (iter == _dicts.end()){
+            if (missing){
+                *missing = names[i];
+            }
+            layers.clear();
+            return _FAILD;
+        }
+        layers.push_back(iter->second.dict);
+    }
+    return _SUCCESS;
+}
+
+void CustomizationRegistry::names(std::vector<std::string> &names) const{
+    names.clear();
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto iter = _dicts.begin(); iter != _dicts.end(); ++iter){
+        names.push_back(iter->first);
+    }
+    std::sort(names.begin(), names.end());
+}
+
+void CustomizationRegistry::collect_tags(std::vector<std::string> &tags) const{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto iter = _dicts.begin(); iter != _dicts.end(); ++iter){
+        iter->second.dict->collect_tags(tags);
+    }
+}
@@ -0,0 +1,204 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include "lac_document.h"
+#include "lac_util.h"
+
+LACDocument::LACDocument(LAC &lac, bool rank)
+    : _lac(lac),
+      _rank(rank),
+      _custom(lac.custom),
+      _results_dirty(false),
+      _last_analyzed(0)
+{
+}
+
+/* 设置文档的新文本，只重新分析编辑区域内内容变化的句子
+ *
+ * 先求新旧文本的公共前缀和公共后缀，编辑区域之前的句子保持不变；
+ * 从受影响的第一个句子开始重新切句，直到新句子的结束位置落在公共后缀中，
+ * 且恰好对应旧文本的一个句子边界，此后的句子只需平移位置 */
+int LACDocument::update(const std::string &text)
+{
+    // 用户词典被替换后，缓存结果全部失效
+    if (this->_custom != this->_lac.custom)
+    {
+        this->_custom = this->_lac.custom;
+        this->_sentences.clear();
+        this->_text.clear();
+    }
+
+    const std::string &old_text = this->_text;
+    size_t old_len = old_text.size();
+    size_t new_len = text.size();
+    size_t min_len = std::min(old_len, new_len);
+
+    size_t prefix = 0;
+    while (prefix < min_len && old_text[prefix] == text[prefix])
+    {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < min_len - prefix &&
+           old_text[old_len - 1 - suffix] == text[new_len - 1 - suffix])
+    {
+        ++suffix;
+    }
+    if (prefix == old_len && prefix == new_len)
+    {
+        this->_last_analyzed = 0;
+        return 0;
+    }
+
+    // 受影响的第一个句子：句子边界由其后的一个字符决定(是否为闭合引号等)，
+    // 该字符(最长4字节)完整落在公共前缀内的句子才能保留
+    size_t first = 0;
+    while (first < this->_sentences.size() &&
+           this->_sentences[first].begin + this->_sentences[first].length + 4 <= prefix)
+    {
+        ++first;
+    }
+    size_t start = first < this->_sentences.size() ? this->_sentences[first].begin : 0;
+
+    long delta = (long)new_len - (long)old_len;
+    size_t last = this->_sentences.size();    // 第一个可以平移复用的旧句子
+    std::vector<DocumentSentence> region;
+
+    // 从受影响的句子开始重新切句
+    size_t old_pos = first;
+    size_t begin = start;
+    while (begin < new_len)
+    {
+        int end = get_sentence_end(text.c_str() + begin, new_len - begin, this->_lac.codetype());
+        size_t sentence_end = end > 0 ? begin + end : new_len;
+
+        DocumentSentence sentence;
+        sentence.begin = begin;
+        sentence.length = sentence_end - begin;
+        region.push_back(sentence);
+        begin = sentence_end;
+
+        // 新句子的结束位置落在公共后缀中，且对应旧文本的句子边界时停止
+        if (sentence_end >= new_len - suffix)
+        {
+            size_t old_end = sentence_end - delta;
+            while (old_pos < this->_sentences.size() &&
+                   this->_sentences[old_pos].begin + this->_sentences[old_pos].length < old_end)
+            {
+                ++old_pos;
+            }
+            if (old_pos < this->_sentences.size() &&
+                this->_sentences[old_pos].begin + this->_sentences[old_pos].length == old_end)
+            {
+                last = old_pos + 1;
+                break;
+            }
+        }
+    }
+
+    // 被替换的旧句子中内容相同的，直接复用其结果(结果为空的句子同样复用)
+    // 每个旧句子的结果只能被取走一次，复用后即从索引中删除
+    std::hash<std::string> hasher;
+    std::unordered_multimap<size_t, size_t> old_index;
+    for (size_t i = first; i < last; ++i)
+    {
+        old_index.insert(std::make_pair(this->_sentences[i].hash, i));
+    }
+
+    std::vector<std::string> querys;
+    std::vector<size_t> query_index;
+    for (size_t i = 0; i < region.size(); ++i)
+    {
+        std::string content = text.substr(region[i].begin, region[i].length);
+        region[i].hash = hasher(content);
+
+        bool cached = false;
+        auto range = old_index.equal_range(region[i].hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            DocumentSentence &old = this->_sentences[it->second];
+            if (old.length == region[i].length &&
+                old_text.compare(old.begin, old.length, content) == 0)
+            {
+                region[i].items.swap(old.items);
+                old_index.erase(it);
+                cached = true;
+                break;
+            }
+        }
+        if (!cached)
+        {
+            querys.push_back(content);
+            query_index.push_back(i);
+        }
+    }
+
+    // 变化的句子合并为一个batch分析
+    if (!querys.empty())
+    {
+        std::vector<std::vector<OutputItem>> results_batch = this->_rank
+                                                                 ? this->_lac.run_rank(querys)
+                                                                 : this->_lac.run(querys);
+        for (size_t i = 0; i < results_batch.size() && i < query_index.size(); ++i)
+        {
+            region[query_index[i]].items.swap(results_batch[i]);
+        }
+    }
+
+    // 拼接：编辑区域前的句子 + 重新切分的句子 + 平移后的剩余句子
+    std::vector<DocumentSentence> sentences;
+    sentences.reserve(first + region.size() + this->_sentences.size() - last);
+    for (size_t i = 0; i < first; ++i)
+    {
+        sentences.push_back(DocumentSentence());
+        std::swap(sentences.back(), this->_sentences[i]);
+    }
+    for (size_t i = 0; i < region.size(); ++i)
+    {
+        sentences.push_back(DocumentSentence());
+        std::swap(sentences.back(), region[i]);
+    }
+    for (size_t i = last; i < this->_sentences.size(); ++i)
+    {
+        sentences.push_back(DocumentSentence());
+        std::swap(sentences.back(), this->_sentences[i]);
+        sentences.back().begin += delta;
+    }
+    this->_sentences.swap(sentences);
+    this->_text = text;
+    this->_results_dirty = true;
+    this->_last_analyzed = querys.size();
+    return querys.size();
+}
+
+/* 全文的分析结果，按需展开 */
+const std::vector<OutputItem> &LACDocument::results()
+{
+    if (this->_results_dirty)
+    {
+        this->_results.clear();
+        for (size_t i = 0; i < this->_sentences.size(); ++i)
+        {
+            this->_results.insert(this->_results.end(),
+                                  this->_sentences[i].items.begin(),
+                                  this->_sentences[i].items.end());
+        }
+        this->_results_dirty = false;
+    }
+    return this->_results;
+}
@@ -0,0 +1,607 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "lac_json.h"
+#include "lac_util.h"
+
+JsonWriter::JsonWriter(std::string &out)
+    : _out(out),
+      _after_key(false)
+{
+}
+
+/* 同一层中第二个及之后的元素前加逗号 */
+void JsonWriter::separator()
+{
+    if (this->_after_key)
+    {
+        this->_after_key = false;
+        return;
+    }
+    if (!this->_has_item.empty())
+    {
+        if (this->_has_item.back())
+        {
+            this->_out.push_back(',');
+        }
+        this->_has_item.back() = true;
+    }
+}
+
+void JsonWriter::start_object()
+{
+    separator();
+    this->_out.push_back('{');
+    this->_has_item.push_back(false);
+}
+
+void JsonWriter::end_object()
+{
+    this->_has_item.pop_back();
+    this->_out.push_back('}');
+}
+
+void JsonWriter::start_array()
+{
+    separator();
+    this->_out.push_back('[');
+    this->_has_item.push_back(false);
+}
+
+void JsonWriter::end_array()
+{
+    this->_has_item.pop_back();
+    this->_out.push_back(']');
+}
+
+void JsonWriter::key(const char *name)
+{
+    separator();
+    this->_out.push_back('"');
+    json_escape_append(this->_out, name, strlen(name));
+    this->_out.append("\":", 2);
+    this->_after_key = true;
+}
+
+void JsonWriter::value(const std::string &str)
+{
+    value(str.c_str(), str.length());
+}
+
+void JsonWriter::value(const char *str, size_t len)
+{
+    separator();
+    this->_out.push_back('"');
+    json_escape_append(this->_out, str, len);
+    this->_out.push_back('"');
+}
+
+void JsonWriter::value(int64_t number)
+{
+    separator();
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%lld", (long long)number);
+    this->_out.append(buf, len);
+}
+
+void JsonWriter::value(double number)
+{
+    separator();
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%.6g", number);
+    this->_out.append(buf, len);
+}
+
+void JsonWriter::value(bool flag)
+{
+    separator();
+    if (flag)
+    {
+        this->_out.append("true", 4);
+    }
+    else
+    {
+        this->_out.append("false", 5);
+    }
+}
+
+void JsonWriter::null_value()
+{
+    separator();
+    this->_out.append("null", 4);
+}
+
+void JsonWriter::raw(const char *json, size_t len)
+{
+    separator();
+    this->_out.append(json, len);
+}
+
+/* 将字符串转义后追加到out，无需转义的连续字节整段追加 */
+void json_escape_append(std::string &out, const char *str, size_t len)
+{
+    static const char HEX[] = "0123456789abcdef";
+    size_t begin = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = str[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+        out.append(str + begin, i - begin);
+        begin = i + 1;
+        switch (c)
+        {
+        case '"':
+            out.append("\\\"", 2);
+            break;
+        case '\\':
+            out.append("\\\\", 2);
+            break;
+        case '\b':
+            out.append("\\b", 2);
+            break;
+        case '\f':
+            out.append("\\f", 2);
+            break;
+        case '\n':
+            out.append("\\n", 2);
+            break;
+        case '\r':
+            out.append("\\r", 2);
+            break;
+        case '\t':
+            out.append("\\t", 2);
+            break;
+        default:
+            char buf[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+            out.append(buf, 6);
+            break;
+        }
+    }
+    out.append(str + begin, len - begin);
+}
+
+/* 按LAC::results_to_json的格式写出一句话的结果 */
+void json_write_items(JsonWriter &writer, const std::vector<OutputItem> &items)
+{
+    json_write_items(writer, items, FIELD_WORD | FIELD_TAG | FIELD_RANK);
+}
+
+void json_write_items(JsonWriter &writer, const std::vector<OutputItem> &items, int fields)
+{
+    writer.start_array();
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        writer.start_object();
+        if (fields & FIELD_WORD)
+        {
+            writer.key("word");
+            writer.value(items[i].word);
+        }
+        if (fields & FIELD_TAG)
+        {
+            writer.key("tag");
+            writer.value(items[i].tag);
+        }
+        if (fields & FIELD_RANK)
+        {
+            writer.key("rank");
+            writer.value(items[i].rank);
+        }
+        if (fields & FIELD_OFFSET)
+        {
+            writer.key("offset");
+            writer.value(items[i].offset);
+            writer.key("length");
+            writer.value(items[i].length);
+        }
+        writer.end_object();
+    }
+    writer.end_array();
+}
+
+const JsonValue *JsonValue::get(const char *name) const
+{
+    if (this->type != JSON_OBJECT)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < this->members.size(); ++i)
+    {
+        if (this->members[i].first == name)
+        {
+            return &this->members[i].second;
+        }
+    }
+    return NULL;
+}
+
+/* 递归下降解析，嵌套深度受限以避免恶意输入导致栈溢出 */
+class JsonParser
+{
+private:
+    const char *_begin;
+    const char *_p;
+    const char *_end;
+    std::string _error;
+
+    static const int MAX_DEPTH = 64;
+
+    bool fail(const char *msg)
+    {
+        if (this->_error.empty())
+        {
+            char buf[128];
+            snprintf(buf, sizeof(buf), "%s at offset %d", msg, (int)(this->_p - this->_begin));
+            this->_error = buf;
+        }
+        return false;
+    }
+
+    void skip_space()
+    {
+        while (this->_p < this->_end &&
+               (*this->_p == ' ' || *this->_p == '\t' || *this->_p == '\n' || *this->_p == '\r'))
+        {
+            ++this->_p;
+        }
+    }
+
+    bool match(const char *word)
+    {
+        size_t len = strlen(word);
+        if ((size_t)(this->_end - this->_p) < len || memcmp(this->_p, word, len) != 0)
+        {
+            return fail("invalid literal");
+        }
+        this->_p += len;
+        return true;
+    }
+
+    bool parse_hex4(unsigned int &code)
+    {
+        if (this->_end - this->_p < 4)
+        {
+            return fail("invalid unicode escape");
+        }
+        code = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            char c = *this->_p++;
+            code <<= 4;
+            if (c >= '0' && c <= '9')
+            {
+                code |= c - '0';
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                code |= c - 'a' + 10;
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                code |= c - 'A' + 10;
+            }
+            else
+            {
+                return fail("invalid unicode escape");
+            }
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string &out, unsigned int code)
+    {
+        if (code < 0x80)
+        {
+            out.push_back((char)code);
+        }
+        else if (code < 0x800)
+        {
+            out.push_back((char)(0xC0 | (code >> 6)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+            out.push_back((char)(0xE0 | (code >> 12)));
+            out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+        }
+        else
+        {
+            out.push_back((char)(0xF0 | (code >> 18)));
+            out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+            out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+        }
+    }
+
+    bool parse_string(std::string &out)
+    {
+        // 调用时_p指向起始引号
+        ++this->_p;
+        out.clear();
+        const char *begin = this->_p;
+        while (this->_p < this->_end)
+        {
+            char c = *this->_p;
+            if (c == '"')
+            {
+                out.append(begin, this->_p - begin);
+                ++this->_p;
+                return true;
+            }
+            if ((unsigned char)c < 0x20)
+            {
+                return fail("control character in string");
+            }
+            // JSON文本为UTF-8，不合法的字节序列原样写回响应会使输出不是合法的JSON
+            if ((unsigned char)c >= 0x80)
+            {
+                // get_next_utf8不排除代理区(ED A0-BF)和超出U+10FFFF(F4 90-BF)的编码
+                int char_len = get_next_utf8(this->_p, this->_end - this->_p);
+                unsigned char second = char_len > 1 ? this->_p[1] : 0;
+                if (char_len == 0 || ((unsigned char)c == 0xED && second >= 0xA0) ||
+                    ((unsigned char)c == 0xF4 && second >= 0x90))
+                {
+                    return fail("invalid UTF-8 in string");
+                }
+                this->_p += char_len;
+                continue;
+            }
+            if (c != '\\')
+            {
+                ++this->_p;
+                continue;
+            }
+
+            out.append(begin, this->_p - begin);
+            if (++this->_p >= this->_end)
+            {
+                break;
+            }
+            c = *this->_p++;
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out.push_back(c);
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u':
+            {
+                unsigned int code = 0;
+                if (!parse_hex4(code))
+                {
+                    return false;
+                }
+                // UTF-16代理对
+                if (code >= 0xD800 && code <= 0xDBFF)
+                {
+                    unsigned int low = 0;
+                    if (this->_end - this->_p < 2 || this->_p[0] != '\\' || this->_p[1] != 'u')
+                    {
+                        return fail("invalid surrogate pair");
+                    }
+                    this->_p += 2;
+                    if (!parse_hex4(low) || low < 0xDC00 || low > 0xDFFF)
+                    {
+                        return fail("invalid surrogate pair");
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (code >= 0xDC00 && code <= 0xDFFF)
+                {
+                    return fail("invalid surrogate pair");
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+            }
+            begin = this->_p;
+        }
+        return fail("unterminated string");
+    }
+
+    bool parse_number(double &number)
+    {
+        const char *start = this->_p;
+        if (this->_p < this->_end && *this->_p == '-')
+        {
+            ++this->_p;
+        }
+        while (this->_p < this->_end &&
+               ((*this->_p >= '0' && *this->_p <= '9') || *this->_p == '.' ||
+                *this->_p == 'e' || *this->_p == 'E' || *this->_p == '+' || *this->_p == '-'))
+        {
+            ++this->_p;
+        }
+        std::string text(start, this->_p - start);
+        char *num_end = NULL;
+        number = strtod(text.c_str(), &num_end);
+        if (text.empty() || num_end != text.c_str() + text.length())
+        {
+            return fail("invalid number");
+        }
+        return true;
+    }
+
+    bool parse_value(JsonValue &value, int depth)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            return fail("nesting too deep");
+        }
+        skip_space();
+        if (this->_p >= this->_end)
+        {
+            return fail("unexpected end");
+        }
+        switch (*this->_p)
+        {
+        case 'n':
+            value.type = JsonValue::JSON_NULL;
+            return match("null");
+        case 't':
+            value.type = JsonValue::JSON_BOOL;
+            value.boolean = true;
+            return match("true");
+        case 'f':
+            value.type = JsonValue::JSON_BOOL;
+            value.boolean = false;
+            return match("false");
+        case '"':
+            value.type = JsonValue::JSON_STRING;
+            return parse_string(value.str);
+        case '[':
+            value.type = JsonValue::JSON_ARRAY;
+            ++this->_p;
+            skip_space();
+            if (this->_p < this->_end && *this->_p == ']')
+            {
+                ++this->_p;
+                return true;
+            }
+            while (true)
+            {
+                value.items.push_back(JsonValue());
+                if (!parse_value(value.items.back(), depth + 1))
+                {
+                    return false;
+                }
+                skip_space();
+                if (this->_p < this->_end && *this->_p == ',')
+                {
+                    ++this->_p;
+                    continue;
+                }
+                if (this->_p < this->_end && *this->_p == ']')
+                {
+                    ++this->_p;
+                    return true;
+                }
+                return fail("expected ',' or ']'");
+            }
+        case '{':
+            value.type = JsonValue::JSON_OBJECT;
+            ++this->_p;
+            skip_space();
+            if (this->_p < this->_end && *this->_p == '}')
+            {
+                ++this->_p;
+                return true;
+            }
+            while (true)
+            {
+                skip_space();
+                if (this->_p >= this->_end || *this->_p != '"')
+                {
+                    return fail("expected object key");
+                }
+                value.members.push_back(std::make_pair(std::string(), JsonValue()));
+                if (!parse_string(value.members.back().first))
+                {
+                    return false;
+                }
+                skip_space();
+                if (this->_p >= this->_end || *this->_p != ':')
+                {
+                    return fail("expected ':'");
+                }
+                ++this->_p;
+                if (!parse_value(value.members.back().second, depth + 1))
+                {
+                    return false;
+                }
+                skip_space();
+                if (this->_p < this->_end && *this->_p == ',')
+                {
+                    ++this->_p;
+                    continue;
+                }
+                if (this->_p < this->_end && *this->_p == '}')
+                {
+                    ++this->_p;
+                    return true;
+                }
+                return fail("expected ',' or '}'");
+            }
+        default:
+            value.type = JsonValue::JSON_NUMBER;
+            return parse_number(value.number);
+        }
+    }
+
+public:
+    JsonParser(const char *text, size_t len)
+        : _begin(text),
+          _p(text),
+          _end(text + len)
+    {
+    }
+
+    bool parse(JsonValue &value)
+    {
+        if (!parse_value(value, 0))
+        {
+            return false;
+        }
+        skip_space();
+        if (this->_p != this->_end)
+        {
+            return fail("trailing characters");
+        }
+        return true;
+    }
+
+    const std::string &error() const { return _error; }
+};
+
+/* 解析JSON文本 */
+bool json_parse(const char *text, size_t len, JsonValue &value, std::string *error)
+{
+    value = JsonValue();
+    JsonParser parser(text, len);
+    if (parser.parse(value))
+    {
+        return true;
+    }
+    if (error)
+    {
+        *error = parser.error();
+    }
+    return false;
+}
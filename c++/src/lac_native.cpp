@@ -0,0 +1,757 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 原生推理引擎：参数装载、BiGRU前向计算及CRF解码，以及对应的推理后端 */
+
+#ifdef LAC_WITH_NATIVE
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "lac_backend.h"
+#include "lac_native.h"
+
+static const char NATIVE_MAGIC[4] = {'L', 'A', 'C', 'N'};
+static const int32_t NATIVE_VERSION_FP32 = 1;
+static const int32_t NATIVE_VERSION = 2;
+
+const char *native_precision_name(NativePrecision precision)
+{
+    static const char *names[NATIVE_PRECISION_NUM] = {"fp32", "bf16", "int8"};
+    return precision >= 0 && precision < NATIVE_PRECISION_NUM ? names[precision] : "unknown";
+}
+
+/* 读取n个元素，文件不足时返回false */
+template <typename T>
+static bool read_array(std::ifstream &fin, std::vector<T> &data, size_t n)
+{
+    data.resize(n);
+    fin.read(reinterpret_cast<char *>(data.data()), n * sizeof(T));
+    return (size_t)fin.gcount() == n * sizeof(T);
+}
+
+template <typename T>
+static void write_array(std::ofstream &fout, const std::vector<T> &data)
+{
+    fout.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(T));
+}
+
+static inline uint16_t float_to_bf16(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+static inline float bf16_to_float(uint16_t value)
+{
+    uint32_t bits = (uint32_t)value << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static inline int8_t quantize_value(float value, float inv_scale)
+{
+    float q = value * inv_scale;
+    q = q > 127.0f ? 127.0f : (q < -127.0f ? -127.0f : q);
+    return (int8_t)std::lrint(q);
+}
+
+size_t NativeMatrix::bytes() const
+{
+    return this->fp32.size() * sizeof(float) + this->bf16.size() * sizeof(uint16_t) + this->int8.size() +
+           (this->weight_scale.size() + this->scale.size()) * sizeof(float) +
+           this->compensation.size() * sizeof(int32_t);
+}
+
+void NativeEmbedding::lookup(int64_t id, float *out) const
+{
+    size_t offset = (size_t)id * this->cols;
+    if (this->precision == NATIVE_FP32)
+    {
+        std::memcpy(out, &this->fp32[offset], this->cols * sizeof(float));
+    }
+    else if (this->precision == NATIVE_BF16)
+    {
+        for (int j = 0; j < this->cols; ++j)
+        {
+            out[j] = bf16_to_float(this->bf16[offset + j]);
+        }
+    }
+    else
+    {
+        float row_scale = this->scale[id];
+        for (int j = 0; j < this->cols; ++j)
+        {
+            out[j] = this->int8[offset + j] * row_scale;
+        }
+    }
+}
+
+size_t NativeEmbedding::bytes() const
+{
+    return this->fp32.size() * sizeof(float) + this->bf16.size() * sizeof(uint16_t) + this->int8.size() +
+           this->scale.size() * sizeof(float);
+}
+
+/* 由逐行存储的int8权重[k x n]和每列的步长生成计算用的交错布局及反量化系数 */
+static void pack_int8(const std::vector<int8_t> &row_major, NativeMatrix &w)
+{
+    int k4 = w.padded_rows();
+    int n = w.cols;
+    w.int8.assign((size_t)k4 * n, 0);
+    w.compensation.assign(n, 0);
+    w.scale.resize(n);
+    for (int p = 0; p < w.rows; ++p)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            int8_t q = row_major[(size_t)p * n + j];
+            w.int8[((size_t)(p / 4) * n + j) * 4 + p % 4] = q;
+            w.compensation[j] += 128 * q;
+        }
+    }
+    for (int j = 0; j < n; ++j)
+    {
+        w.scale[j] = w.input_scale * w.weight_scale[j];
+    }
+}
+
+static void unpack_int8(const NativeMatrix &w, std::vector<int8_t> &row_major)
+{
+    int n = w.cols;
+    row_major.resize((size_t)w.rows * n);
+    for (int p = 0; p < w.rows; ++p)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            row_major[(size_t)p * n + j] = w.int8[((size_t)(p / 4) * n + j) * 4 + p % 4];
+        }
+    }
+}
+
+void native_quantize_matrix(const NativeMatrix &src, NativePrecision precision, float input_scale,
+                            NativeMatrix &dst)
+{
+    dst = NativeMatrix();
+    dst.precision = precision;
+    dst.rows = src.rows;
+    dst.cols = src.cols;
+    if (precision == NATIVE_FP32)
+    {
+        dst.fp32 = src.fp32;
+    }
+    else if (precision == NATIVE_BF16)
+    {
+        dst.bf16.resize(src.fp32.size());
+        for (size_t i = 0; i < src.fp32.size(); ++i)
+        {
+            dst.bf16[i] = float_to_bf16(src.fp32[i]);
+        }
+    }
+    else
+    {
+        int n = src.cols;
+        dst.input_scale = input_scale > 0 ? input_scale : 1.0f / 127;
+        dst.weight_scale.assign(n, 0.0f);
+        for (int p = 0; p < src.rows; ++p)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                dst.weight_scale[j] = std::max(dst.weight_scale[j], std::fabs(src.fp32[(size_t)p * n + j]));
+            }
+        }
+        for (int j = 0; j < n; ++j)
+        {
+            dst.weight_scale[j] = dst.weight_scale[j] > 0 ? dst.weight_scale[j] / 127 : 1.0f;
+        }
+        std::vector<int8_t> row_major(src.fp32.size());
+        for (int p = 0; p < src.rows; ++p)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                row_major[(size_t)p * n + j] = quantize_value(src.fp32[(size_t)p * n + j], 1.0f / dst.weight_scale[j]);
+            }
+        }
+        pack_int8(row_major, dst);
+    }
+}
+
+void native_quantize_embedding(const NativeEmbedding &src, NativePrecision precision, NativeEmbedding &dst)
+{
+    dst = NativeEmbedding();
+    dst.precision = precision;
+    dst.rows = src.rows;
+    dst.cols = src.cols;
+    if (precision == NATIVE_FP32)
+    {
+        dst.fp32 = src.fp32;
+    }
+    else if (precision == NATIVE_BF16)
+    {
+        dst.bf16.resize(src.fp32.size());
+        for (size_t i = 0; i < src.fp32.size(); ++i)
+        {
+            dst.bf16[i] = float_to_bf16(src.fp32[i]);
+        }
+    }
+    else
+    {
+        dst.int8.resize(src.fp32.size());
+        dst.scale.resize(src.rows);
+        for (int r = 0; r < src.rows; ++r)
+        {
+            const float *row = &src.fp32[(size_t)r * src.cols];
+            float absmax = 0;
+            for (int j = 0; j < src.cols; ++j)
+            {
+                absmax = std::max(absmax, std::fabs(row[j]));
+            }
+            dst.scale[r] = absmax > 0 ? absmax / 127 : 1.0f;
+            for (int j = 0; j < src.cols; ++j)
+            {
+                dst.int8[(size_t)r * src.cols + j] = quantize_value(row[j], 1.0f / dst.scale[r]);
+            }
+        }
+    }
+}
+
+/* 版本2的矩阵：int32的精度、行数、列数，float的输入步长，之后为对应精度的数据，
+ * INT8为逐行的int8权重及每列的步长 */
+static bool read_matrix(std::ifstream &fin, int rows, int cols, NativeMatrix &w)
+{
+    int32_t header[3];
+    float input_scale = 0;
+    fin.read(reinterpret_cast<char *>(header), sizeof(header));
+    fin.read(reinterpret_cast<char *>(&input_scale), sizeof(input_scale));
+    if (!fin || header[0] < 0 || header[0] >= NATIVE_PRECISION_NUM || header[1] != rows || header[2] != cols)
+    {
+        return false;
+    }
+    w = NativeMatrix();
+    w.precision = (NativePrecision)header[0];
+    w.rows = rows;
+    w.cols = cols;
+    w.input_scale = input_scale;
+    size_t n = (size_t)rows * cols;
+    if (w.precision == NATIVE_FP32)
+    {
+        return read_array(fin, w.fp32, n);
+    }
+    if (w.precision == NATIVE_BF16)
+    {
+        return read_array(fin, w.bf16, n);
+    }
+    std::vector<int8_t> row_major;
+    if (!read_array(fin, row_major, n) || !read_array(fin, w.weight_scale, cols))
+    {
+        return false;
+    }
+    pack_int8(row_major, w);
+    return true;
+}
+
+static void write_matrix(std::ofstream &fout, const NativeMatrix &w)
+{
+    int32_t header[3] = {w.precision, w.rows, w.cols};
+    fout.write(reinterpret_cast<const char *>(header), sizeof(header));
+    fout.write(reinterpret_cast<const char *>(&w.input_scale), sizeof(w.input_scale));
+    if (w.precision == NATIVE_FP32)
+    {
+        write_array(fout, w.fp32);
+    }
+    else if (w.precision == NATIVE_BF16)
+    {
+        write_array(fout, w.bf16);
+    }
+    else
+    {
+        std::vector<int8_t> row_major;
+        unpack_int8(w, row_major);
+        write_array(fout, row_major);
+        write_array(fout, w.weight_scale);
+    }
+}
+
+/* 版本2的embedding：int32的精度，之后为对应精度的数据，INT8为逐行的int8及每行的步长 */
+static bool read_embedding(std::ifstream &fin, NativeEmbedding &table)
+{
+    int32_t precision = -1;
+    fin.read(reinterpret_cast<char *>(&precision), sizeof(precision));
+    if (!fin || precision < 0 || precision >= NATIVE_PRECISION_NUM)
+    {
+        return false;
+    }
+    table.precision = (NativePrecision)precision;
+    size_t n = (size_t)table.rows * table.cols;
+    if (table.precision == NATIVE_FP32)
+    {
+        return read_array(fin, table.fp32, n);
+    }
+    if (table.precision == NATIVE_BF16)
+    {
+        return read_array(fin, table.bf16, n);
+    }
+    return read_array(fin, table.int8, n) && read_array(fin, table.scale, table.rows);
+}
+
+static void write_embedding(std::ofstream &fout, const NativeEmbedding &table)
+{
+    int32_t precision = table.precision;
+    fout.write(reinterpret_cast<const char *>(&precision), sizeof(precision));
+    write_array(fout, table.fp32);
+    write_array(fout, table.bf16);
+    write_array(fout, table.int8);
+    write_array(fout, table.scale);
+}
+
+/* fp32的矩阵[rows x cols] */
+static void set_fp32(NativeMatrix &w, int rows, int cols, std::vector<float>::const_iterator begin)
+{
+    w = NativeMatrix();
+    w.rows = rows;
+    w.cols = cols;
+    w.fp32.assign(begin, begin + (size_t)rows * cols);
+}
+
+/* 版本1：int32的头部之后依次为float32的embedding，每层正反两个方向的fc权重、fc偏置、gru权重、gru偏置，
+ * 发射层的权重、偏置及CRF转移矩阵
+ * 版本2：头部相同，之后依次为embedding，每层合并后的输入投影、投影偏置(float32)、
+ * 正向的门权重、候选状态权重、反向的门权重、候选状态权重，发射层的权重、偏置(float32)及CRF转移矩阵(float32) */
+int NativeModel::load(const std::string &path)
+{
+    std::ifstream fin(path.c_str(), std::ios::binary);
+    if (!fin)
+    {
+        std::cerr << "native model not found: " << path << std::endl;
+        return -1;
+    }
+
+    char magic[4];
+    int32_t header[7];
+    fin.read(magic, sizeof(magic));
+    fin.read(reinterpret_cast<char *>(header), sizeof(header));
+    int32_t version = header[0];
+    if (!fin || std::memcmp(magic, NATIVE_MAGIC, sizeof(magic)) != 0 ||
+        (version != NATIVE_VERSION_FP32 && version != NATIVE_VERSION))
+    {
+        std::cerr << "invalid native model: " << path << std::endl;
+        return -1;
+    }
+    this->vocab_size = header[1];
+    this->emb_dim = header[2];
+    this->hidden_dim = header[3];
+    int num_layers = header[4];
+    this->num_labels = header[5];
+    this->origin_mode = header[6] != 0;
+
+    int H = this->hidden_dim;
+    int L = this->num_labels;
+    this->embedding = NativeEmbedding();
+    this->embedding.rows = this->vocab_size;
+    this->embedding.cols = this->emb_dim;
+    bool ok = version == NATIVE_VERSION_FP32
+                  ? read_array(fin, this->embedding.fp32, (size_t)this->vocab_size * this->emb_dim)
+                  : read_embedding(fin, this->embedding);
+    this->layers.resize(num_layers);
+    std::vector<float> fc_weight[2], fc_bias[2], gru_weight[2], gru_bias[2], proj_weight;
+    for (int l = 0; l < num_layers && ok; ++l)
+    {
+        NativeLayer &layer = this->layers[l];
+        layer.input_dim = l == 0 ? this->emb_dim : 2 * H;
+        if (version == NATIVE_VERSION)
+        {
+            ok = read_matrix(fin, layer.input_dim, 6 * H, layer.proj_weight) &&
+                 read_array(fin, layer.proj_bias, 6 * H) &&
+                 read_matrix(fin, H, 2 * H, layer.forward.gate_weight) &&
+                 read_matrix(fin, H, H, layer.forward.state_weight) &&
+                 read_matrix(fin, H, 2 * H, layer.reverse.gate_weight) &&
+                 read_matrix(fin, H, H, layer.reverse.state_weight);
+            continue;
+        }
+
+        for (int d = 0; d < 2 && ok; ++d)
+        {
+            ok = read_array(fin, fc_weight[d], (size_t)layer.input_dim * 3 * H) &&
+                 read_array(fin, fc_bias[d], 3 * H) &&
+                 read_array(fin, gru_weight[d], 3 * H * H) &&
+                 read_array(fin, gru_bias[d], 3 * H);
+        }
+        if (!ok)
+        {
+            break;
+        }
+
+        // 两个方向的输入投影按列拼接，gru的偏置并入投影的偏置
+        proj_weight.resize((size_t)layer.input_dim * 6 * H);
+        layer.proj_bias.resize(6 * H);
+        for (int r = 0; r < layer.input_dim; ++r)
+        {
+            for (int d = 0; d < 2; ++d)
+            {
+                std::memcpy(&proj_weight[r * 6 * H + d * 3 * H], &fc_weight[d][r * 3 * H],
+                            3 * H * sizeof(float));
+            }
+        }
+        set_fp32(layer.proj_weight, layer.input_dim, 6 * H, proj_weight.begin());
+        for (int d = 0; d < 2; ++d)
+        {
+            for (int j = 0; j < 3 * H; ++j)
+            {
+                layer.proj_bias[d * 3 * H + j] = fc_bias[d][j] + gru_bias[d][j];
+            }
+            // Paddle的gru权重前H*2H为门的权重[H x 2H]，其后为候选状态的权重[H x H]
+            NativeGRU &gru = d == 0 ? layer.forward : layer.reverse;
+            set_fp32(gru.gate_weight, H, 2 * H, gru_weight[d].begin());
+            set_fp32(gru.state_weight, H, H, gru_weight[d].begin() + 2 * H * H);
+        }
+    }
+    if (ok && version == NATIVE_VERSION)
+    {
+        ok = read_matrix(fin, 2 * H, L, this->emission_weight);
+    }
+    else if (ok)
+    {
+        std::vector<float> emission_weight;
+        ok = read_array(fin, emission_weight, 2 * H * L);
+        set_fp32(this->emission_weight, 2 * H, L, emission_weight.begin());
+    }
+    ok = ok && read_array(fin, this->emission_bias, L) &&
+         read_array(fin, this->transition, (size_t)(L + 2) * L);
+    if (!ok)
+    {
+        std::cerr << "truncated native model: " << path << std::endl;
+        return -1;
+    }
+    this->decoder.init(this->transition.data(), L);
+    return 0;
+}
+
+int NativeModel::save(const std::string &path) const
+{
+    std::ofstream fout(path.c_str(), std::ios::binary);
+    if (!fout)
+    {
+        std::cerr << "can not write native model: " << path << std::endl;
+        return -1;
+    }
+    int32_t header[7] = {NATIVE_VERSION, this->vocab_size, this->emb_dim, this->hidden_dim,
+                         (int32_t)this->layers.size(), this->num_labels, this->origin_mode};
+    fout.write(NATIVE_MAGIC, sizeof(NATIVE_MAGIC));
+    fout.write(reinterpret_cast<const char *>(header), sizeof(header));
+    write_embedding(fout, this->embedding);
+    for (size_t l = 0; l < this->layers.size(); ++l)
+    {
+        const NativeLayer &layer = this->layers[l];
+        write_matrix(fout, layer.proj_weight);
+        write_array(fout, layer.proj_bias);
+        write_matrix(fout, layer.forward.gate_weight);
+        write_matrix(fout, layer.forward.state_weight);
+        write_matrix(fout, layer.reverse.gate_weight);
+        write_matrix(fout, layer.reverse.state_weight);
+    }
+    write_matrix(fout, this->emission_weight);
+    write_array(fout, this->emission_bias);
+    write_array(fout, this->transition);
+    fout.close();
+    if (!fout)
+    {
+        std::cerr << "can not write native model: " << path << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+size_t NativeModel::bytes() const
+{
+    size_t total = this->embedding.bytes() + this->emission_weight.bytes() +
+                   (this->emission_bias.size() + this->transition.size()) * sizeof(float);
+    for (size_t l = 0; l < this->layers.size(); ++l)
+    {
+        const NativeLayer &layer = this->layers[l];
+        total += layer.proj_weight.bytes() + layer.proj_bias.size() * sizeof(float) +
+                 layer.forward.gate_weight.bytes() + layer.forward.state_weight.bytes() +
+                 layer.reverse.gate_weight.bytes() + layer.reverse.state_weight.bytes();
+    }
+    return total;
+}
+
+/* 校准时记录矩阵输入的最大绝对值 */
+static void record_input(NativeBuffers &buffers, const NativeMatrix &w, const float *a, int m, int lda)
+{
+    float &absmax = (*buffers.calibration)[&w];
+    for (int i = 0; i < m; ++i)
+    {
+        for (int p = 0; p < w.rows; ++p)
+        {
+            absmax = std::max(absmax, std::fabs(a[(size_t)i * lda + p]));
+        }
+    }
+}
+
+/* 按w.input_scale量化m行输入到buffers.input_q，每行补齐到k4 */
+static const int8_t *quantize_input(const NativeMatrix &w, const float *a, int m, int lda, NativeBuffers &buffers)
+{
+    int k4 = w.padded_rows();
+    buffers.input_q.resize((size_t)m * k4);
+    float inv_scale = 1.0f / w.input_scale;
+    for (int i = 0; i < m; ++i)
+    {
+        const float *a_row = a + (size_t)i * lda;
+        int8_t *q_row = &buffers.input_q[(size_t)i * k4];
+        for (int p = 0; p < w.rows; ++p)
+        {
+            q_row[p] = quantize_value(a_row[p], inv_scale);
+        }
+        for (int p = w.rows; p < k4; ++p)
+        {
+            q_row[p] = 0;
+        }
+    }
+    return buffers.input_q.data();
+}
+
+/* C[m x cols] = A[m x rows] * W + bias，按W的精度选择计算核 */
+static void native_gemm(const NativeKernels &kernels, const NativeMatrix &w, int m, const float *a, int lda,
+                        const float *bias, float *c, int ldc, NativeBuffers &buffers)
+{
+    if (buffers.calibration)
+    {
+        record_input(buffers, w, a, m, lda);
+    }
+    if (w.precision == NATIVE_FP32)
+    {
+        kernels.gemm(m, w.cols, w.rows, a, lda, w.fp32.data(), w.cols, bias, c, ldc);
+    }
+    else if (w.precision == NATIVE_BF16)
+    {
+        kernels.gemm_bf16(m, w.cols, w.rows, a, lda, w.bf16.data(), w.cols, bias, c, ldc);
+    }
+    else
+    {
+        kernels.gemm_int8(m, w, quantize_input(w, a, m, lda, buffers), w.padded_rows(), bias, c, ldc);
+    }
+}
+
+/* y[cols] += x[rows] * W */
+static void native_gemv(const NativeKernels &kernels, const NativeMatrix &w, const float *x, float *y,
+                        NativeBuffers &buffers)
+{
+    if (buffers.calibration)
+    {
+        record_input(buffers, w, x, 1, w.rows);
+    }
+    if (w.precision == NATIVE_FP32)
+    {
+        kernels.gemv(w.cols, w.rows, x, w.fp32.data(), w.cols, y);
+    }
+    else if (w.precision == NATIVE_BF16)
+    {
+        kernels.gemv_bf16(w.cols, w.rows, x, w.bf16.data(), w.cols, y);
+    }
+    else
+    {
+        kernels.gemv_int8(w, quantize_input(w, x, 1, w.rows, buffers), y);
+    }
+}
+
+/* 与Paddle的CPU激活函数一致，对输入做相同的截断 */
+static inline float native_sigmoid(float x)
+{
+    x = x < -40.0f ? -40.0f : (x > 13.0f ? 13.0f : x);
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+static inline float native_tanh(float x)
+{
+    float t = -2.0f * x;
+    t = t > 40.0f ? 40.0f : t;
+    return 2.0f / (1.0f + std::exp(t)) - 1.0f;
+}
+
+/* 对一个句子运行一个方向的GRU，proj为输入投影(行间隔proj_stride)，结果写入out(行间隔out_stride) */
+static void run_gru(const NativeModel &model, const NativeKernels &kernels, const NativeGRU &gru,
+                    const float *proj, size_t proj_stride, size_t length, bool reverse,
+                    NativeBuffers &buffers, float *out, size_t out_stride)
+{
+    int H = model.hidden_dim;
+    float *gates = buffers.gates.data();
+    float *reset_state = buffers.reset_state.data();
+    const float *h_prev = NULL;
+    for (size_t step = 0; step < length; ++step)
+    {
+        size_t t = reverse ? length - 1 - step : step;
+        std::memcpy(gates, proj + t * proj_stride, 3 * H * sizeof(float));
+
+        // 初始状态为0，第一步不需要与状态相乘
+        if (h_prev)
+        {
+            native_gemv(kernels, gru.gate_weight, h_prev, gates, buffers);
+        }
+        for (int j = 0; j < 2 * H; ++j)
+        {
+            gates[j] = native_sigmoid(gates[j]);
+        }
+        if (h_prev)
+        {
+            for (int j = 0; j < H; ++j)
+            {
+                reset_state[j] = gates[H + j] * h_prev[j];
+            }
+            native_gemv(kernels, gru.state_weight, reset_state, gates + 2 * H, buffers);
+        }
+
+        float *h = out + t * out_stride;
+        for (int j = 0; j < H; ++j)
+        {
+            float u = gates[j];
+            float c = native_tanh(gates[2 * H + j]);
+            float prev = h_prev ? h_prev[j] : 0.0f;
+            h[j] = model.origin_mode ? u * prev + (1.0f - u) * c : prev - u * prev + u * c;
+        }
+        h_prev = h;
+    }
+}
+
+void native_forward(const NativeModel &model, const NativeKernels &kernels,
+                    const int64_t *ids, size_t count, const std::vector<size_t> &lod,
+                    NativeBuffers &buffers, int64_t *tags, const float *const *masks)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    int H = model.hidden_dim;
+    int L = model.num_labels;
+    buffers.gates.resize(3 * H);
+    buffers.reset_state.resize(H);
+
+    // embedding，越界的id按最后一个词(OOV)处理
+    buffers.input.resize(count * model.emb_dim);
+    for (size_t t = 0; t < count; ++t)
+    {
+        int64_t id = ids[t];
+        if (id < 0 || id >= model.vocab_size)
+        {
+            id = model.vocab_size - 1;
+        }
+        model.embedding.lookup(id, &buffers.input[t * model.emb_dim]);
+    }
+
+    for (size_t l = 0; l < model.layers.size(); ++l)
+    {
+        const NativeLayer &layer = model.layers[l];
+
+        // 整个batch所有字的两个方向的输入投影合并为一次矩阵乘
+        buffers.proj.resize(count * 6 * H);
+        native_gemm(kernels, layer.proj_weight, count, buffers.input.data(), layer.input_dim,
+                    layer.proj_bias.data(), buffers.proj.data(), 6 * H, buffers);
+
+        buffers.output.resize(count * 2 * H);
+        for (size_t i = 0; i + 1 < lod.size(); ++i)
+        {
+            size_t begin = lod[i];
+            size_t length = lod[i + 1] - begin;
+            const float *proj = &buffers.proj[begin * 6 * H];
+            float *out = &buffers.output[begin * 2 * H];
+            run_gru(model, kernels, layer.forward, proj, 6 * H, length, false, buffers, out, 2 * H);
+            run_gru(model, kernels, layer.reverse, proj + 3 * H, 6 * H, length, true, buffers, out + H, 2 * H);
+        }
+        buffers.input.swap(buffers.output);
+    }
+
+    buffers.emission.resize(count * L);
+    native_gemm(kernels, model.emission_weight, count, buffers.input.data(), 2 * H,
+                model.emission_bias.data(), buffers.emission.data(), L, buffers);
+    model.decoder.decode(buffers.emission.data(), lod, masks, buffers.viterbi, tags);
+}
+
+/* 原生推理后端：模型参数各会话共享，缓冲区每个会话一份 */
+class NativeBackend : public LACBackend
+{
+private:
+    std::shared_ptr<const NativeModel> _model;
+    const NativeKernels *_kernels;
+    NativeBuffers _buffers;
+    std::vector<int64_t> _output;
+
+public:
+    explicit NativeBackend(const std::shared_ptr<const NativeModel> &model)
+        : _model(model),
+          _kernels(native_kernels())
+    {
+    }
+
+    int run(const int64_t *const *inputs, size_t num_inputs, size_t count,
+            const std::vector<std::vector<size_t>> &lod,
+            const int64_t *&output, size_t &output_size)
+    {
+        return this->run_constrained(inputs, num_inputs, count, lod, NULL, output, output_size);
+    }
+
+    bool constrained_decoding() const
+    {
+        return true;
+    }
+
+    int run_constrained(const int64_t *const *inputs, size_t num_inputs, size_t count,
+                        const std::vector<std::vector<size_t>> &lod, const float *const *masks,
+                        const int64_t *&output, size_t &output_size)
+    {
+        if (num_inputs != 1 || lod.empty())
+        {
+            std::cerr << "native model expects 1 input but got " << num_inputs << std::endl;
+            return -1;
+        }
+        this->_output.resize(count);
+        native_forward(*this->_model, *this->_kernels, inputs[0], count, lod[0], this->_buffers,
+                       this->_output.data(), masks);
+        output = this->_output.data();
+        output_size = count;
+        return 0;
+    }
+
+    size_t input_count() const
+    {
+        return 1;
+    }
+
+    std::shared_ptr<LACBackend> clone()
+    {
+        return std::make_shared<NativeBackend>(this->_model);
+    }
+
+    LAC_BACKEND type() const
+    {
+        return BACKEND_NATIVE;
+    }
+};
+
+/* 装载model_path/model.native；每个会话单线程计算，并行由会话池提供，threads不使用 */
+std::shared_ptr<LACBackend> create_native_backend(const std::string &model_path, int threads)
+{
+    std::shared_ptr<NativeModel> model = std::make_shared<NativeModel>();
+    if (model->load(model_path + "/model.native") != 0)
+    {
+        return std::shared_ptr<LACBackend>();
+    }
+    return std::make_shared<NativeBackend>(model);
+}
+
+#endif  // LAC_WITH_NATIVE
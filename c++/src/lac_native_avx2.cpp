@@ -0,0 +1,380 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 原生推理引擎的AVX2计算核，本文件以-mavx2 -mfma编译，未启用时返回NULL */
+
+#ifdef LAC_WITH_NATIVE
+
+#include "lac_native.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <cstring>
+#include <immintrin.h>
+
+/* 读取8个权重，bf16左移16位即为fp32 */
+static inline __m256 load8(const float *p)
+{
+    return _mm256_loadu_ps(p);
+}
+
+static inline __m256 load8(const uint16_t *p)
+{
+    __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+}
+
+static inline float load1(const float *p)
+{
+    return *p;
+}
+
+static inline float load1(const uint16_t *p)
+{
+    uint32_t bits = (uint32_t)*p << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/* 计算R行A与B的乘积，每次16列(每行两个累加器)，不足8列的部分逐列计算 */
+template <int R, typename T>
+static inline void avx2_gemm_rows(int n, int k, const float *a, int lda, const T *b, int ldb,
+                                  const float *bias, float *c, int ldc)
+{
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m256 acc0[R], acc1[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc0[r] = bias ? _mm256_loadu_ps(bias + j) : _mm256_setzero_ps();
+            acc1[r] = bias ? _mm256_loadu_ps(bias + j + 8) : _mm256_setzero_ps();
+        }
+        for (int p = 0; p < k; ++p)
+        {
+            const T *b_row = b + (size_t)p * ldb + j;
+            __m256 b0 = load8(b_row);
+            __m256 b1 = load8(b_row + 8);
+            for (int r = 0; r < R; ++r)
+            {
+                __m256 a_rp = _mm256_broadcast_ss(a + (size_t)r * lda + p);
+                acc0[r] = _mm256_fmadd_ps(a_rp, b0, acc0[r]);
+                acc1[r] = _mm256_fmadd_ps(a_rp, b1, acc1[r]);
+            }
+        }
+        for (int r = 0; r < R; ++r)
+        {
+            _mm256_storeu_ps(c + (size_t)r * ldc + j, acc0[r]);
+            _mm256_storeu_ps(c + (size_t)r * ldc + j + 8, acc1[r]);
+        }
+    }
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256 acc[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc[r] = bias ? _mm256_loadu_ps(bias + j) : _mm256_setzero_ps();
+        }
+        for (int p = 0; p < k; ++p)
+        {
+            __m256 b0 = load8(b + (size_t)p * ldb + j);
+            for (int r = 0; r < R; ++r)
+            {
+                acc[r] = _mm256_fmadd_ps(_mm256_broadcast_ss(a + (size_t)r * lda + p), b0, acc[r]);
+            }
+        }
+        for (int r = 0; r < R; ++r)
+        {
+            _mm256_storeu_ps(c + (size_t)r * ldc + j, acc[r]);
+        }
+    }
+    for (; j < n; ++j)
+    {
+        for (int r = 0; r < R; ++r)
+        {
+            float sum = bias ? bias[j] : 0.0f;
+            for (int p = 0; p < k; ++p)
+            {
+                sum += a[(size_t)r * lda + p] * load1(b + (size_t)p * ldb + j);
+            }
+            c[(size_t)r * ldc + j] = sum;
+        }
+    }
+}
+
+/* 按行块ROW_TILE、列块COL_TILE分块，行块内的A与列块内的B在计算时保持在缓存中 */
+static const int ROW_TILE = 64;
+static const int COL_TILE = 128;
+
+template <typename T>
+static void avx2_gemm(int m, int n, int k, const float *a, int lda, const T *b, int ldb,
+                      const float *bias, float *c, int ldc)
+{
+    for (int i0 = 0; i0 < m; i0 += ROW_TILE)
+    {
+        int i_end = i0 + ROW_TILE < m ? i0 + ROW_TILE : m;
+        for (int j0 = 0; j0 < n; j0 += COL_TILE)
+        {
+            int cols = n - j0 < COL_TILE ? n - j0 : COL_TILE;
+            const T *b_tile = b + j0;
+            const float *bias_tile = bias ? bias + j0 : NULL;
+            int i = i0;
+            for (; i + 4 <= i_end; i += 4)
+            {
+                avx2_gemm_rows<4>(cols, k, a + (size_t)i * lda, lda, b_tile, ldb, bias_tile,
+                                  c + (size_t)i * ldc + j0, ldc);
+            }
+            for (; i < i_end; ++i)
+            {
+                avx2_gemm_rows<1>(cols, k, a + (size_t)i * lda, lda, b_tile, ldb, bias_tile,
+                                  c + (size_t)i * ldc + j0, ldc);
+            }
+        }
+    }
+}
+
+/* 每次64列，8个累加器常驻寄存器以掩盖FMA的延迟，W按行顺序读取 */
+template <typename T>
+static void avx2_gemv(int n, int k, const float *x, const T *w, int ldw, float *y)
+{
+    int j = 0;
+    for (; j + 64 <= n; j += 64)
+    {
+        __m256 acc[8];
+        for (int v = 0; v < 8; ++v)
+        {
+            acc[v] = _mm256_loadu_ps(y + j + v * 8);
+        }
+        for (int p = 0; p < k; ++p)
+        {
+            const T *w_row = w + (size_t)p * ldw + j;
+            __m256 x_p = _mm256_broadcast_ss(x + p);
+            for (int v = 0; v < 8; ++v)
+            {
+                acc[v] = _mm256_fmadd_ps(x_p, load8(w_row + v * 8), acc[v]);
+            }
+        }
+        for (int v = 0; v < 8; ++v)
+        {
+            _mm256_storeu_ps(y + j + v * 8, acc[v]);
+        }
+    }
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256 acc = _mm256_loadu_ps(y + j);
+        for (int p = 0; p < k; ++p)
+        {
+            acc = _mm256_fmadd_ps(_mm256_broadcast_ss(x + p), load8(w + (size_t)p * ldw + j), acc);
+        }
+        _mm256_storeu_ps(y + j, acc);
+    }
+    for (; j < n; ++j)
+    {
+        float sum = y[j];
+        for (int p = 0; p < k; ++p)
+        {
+            sum += x[p] * load1(w + (size_t)p * ldw + j);
+        }
+        y[j] = sum;
+    }
+}
+
+/* 读取一行量化输入中第g组的4个int8并广播 */
+static inline __m256i broadcast4(const int8_t *x, int g)
+{
+    int32_t word;
+    std::memcpy(&word, x + g * 4, sizeof(word));
+    return _mm256_set1_epi32(word);
+}
+
+/* 8列各4个int8与广播的4个int8的点积，结果为8个int32
+ * maddubs要求一侧无符号，以|x|与带x符号的w相乘；|x|、|w|不超过127，16位的中间结果不会饱和 */
+static inline __m256i dot4(__m256i x_abs, __m256i x, __m256i w)
+{
+    __m256i pairs = _mm256_maddubs_epi16(x_abs, _mm256_sign_epi8(w, x));
+    return _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+}
+
+/* 第j列起不足8列的部分逐列计算 */
+static inline int32_t dot_int8_column(const NativeMatrix &w, const int8_t *x, int j)
+{
+    int32_t sum = 0;
+    const int8_t *w_col = &w.int8[(size_t)j * 4];
+    for (int g = 0; g < w.padded_rows() / 4; ++g)
+    {
+        const int8_t *w_g = w_col + (size_t)g * w.cols * 4;
+        sum += x[g * 4] * w_g[0] + x[g * 4 + 1] * w_g[1] + x[g * 4 + 2] * w_g[2] + x[g * 4 + 3] * w_g[3];
+    }
+    return sum;
+}
+
+/* 计算R行量化输入与W的乘积，每次16列(每行两个累加器)，其余每次8列，不足8列的部分逐列计算 */
+template <int R>
+static inline void avx2_gemm_int8_rows(const NativeMatrix &w, const int8_t *a, int lda, const float *bias,
+                                       float *c, int ldc)
+{
+    int n = w.cols;
+    int groups = w.padded_rows() / 4;
+    const int8_t *b = w.int8.data();
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m256i acc0[R], acc1[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc0[r] = _mm256_setzero_si256();
+            acc1[r] = _mm256_setzero_si256();
+        }
+        for (int g = 0; g < groups; ++g)
+        {
+            const int8_t *b_g = b + ((size_t)g * n + j) * 4;
+            __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b_g));
+            __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b_g + 32));
+            for (int r = 0; r < R; ++r)
+            {
+                __m256i x = broadcast4(a + (size_t)r * lda, g);
+                __m256i x_abs = _mm256_abs_epi8(x);
+                acc0[r] = _mm256_add_epi32(acc0[r], dot4(x_abs, x, b0));
+                acc1[r] = _mm256_add_epi32(acc1[r], dot4(x_abs, x, b1));
+            }
+        }
+        __m256 scale0 = _mm256_loadu_ps(&w.scale[j]);
+        __m256 scale1 = _mm256_loadu_ps(&w.scale[j + 8]);
+        __m256 bias0 = bias ? _mm256_loadu_ps(bias + j) : _mm256_setzero_ps();
+        __m256 bias1 = bias ? _mm256_loadu_ps(bias + j + 8) : _mm256_setzero_ps();
+        for (int r = 0; r < R; ++r)
+        {
+            _mm256_storeu_ps(c + (size_t)r * ldc + j, _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc0[r]), scale0, bias0));
+            _mm256_storeu_ps(c + (size_t)r * ldc + j + 8, _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc1[r]), scale1, bias1));
+        }
+    }
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256i acc[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc[r] = _mm256_setzero_si256();
+        }
+        for (int g = 0; g < groups; ++g)
+        {
+            __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + ((size_t)g * n + j) * 4));
+            for (int r = 0; r < R; ++r)
+            {
+                __m256i x = broadcast4(a + (size_t)r * lda, g);
+                acc[r] = _mm256_add_epi32(acc[r], dot4(_mm256_abs_epi8(x), x, b0));
+            }
+        }
+        __m256 scale0 = _mm256_loadu_ps(&w.scale[j]);
+        __m256 bias0 = bias ? _mm256_loadu_ps(bias + j) : _mm256_setzero_ps();
+        for (int r = 0; r < R; ++r)
+        {
+            _mm256_storeu_ps(c + (size_t)r * ldc + j, _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[r]), scale0, bias0));
+        }
+    }
+    for (; j < n; ++j)
+    {
+        for (int r = 0; r < R; ++r)
+        {
+            c[(size_t)r * ldc + j] = dot_int8_column(w, a + (size_t)r * lda, j) * w.scale[j] + (bias ? bias[j] : 0.0f);
+        }
+    }
+}
+
+static void avx2_gemm_int8(int m, const NativeMatrix &w, const int8_t *a, int lda, const float *bias,
+                           float *c, int ldc)
+{
+    int i = 0;
+    for (; i + 4 <= m; i += 4)
+    {
+        avx2_gemm_int8_rows<4>(w, a + (size_t)i * lda, lda, bias, c + (size_t)i * ldc, ldc);
+    }
+    for (; i < m; ++i)
+    {
+        avx2_gemm_int8_rows<1>(w, a + (size_t)i * lda, lda, bias, c + (size_t)i * ldc, ldc);
+    }
+}
+
+/* 每次64列，8个累加器常驻寄存器 */
+static void avx2_gemv_int8(const NativeMatrix &w, const int8_t *x, float *y)
+{
+    int n = w.cols;
+    int groups = w.padded_rows() / 4;
+    const int8_t *b = w.int8.data();
+    int j = 0;
+    for (; j + 64 <= n; j += 64)
+    {
+        __m256i acc[8];
+        for (int v = 0; v < 8; ++v)
+        {
+            acc[v] = _mm256_setzero_si256();
+        }
+        for (int g = 0; g < groups; ++g)
+        {
+            const int8_t *b_g = b + ((size_t)g * n + j) * 4;
+            __m256i x_g = broadcast4(x, g);
+            __m256i x_abs = _mm256_abs_epi8(x_g);
+            for (int v = 0; v < 8; ++v)
+            {
+                __m256i b_v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b_g + v * 32));
+                acc[v] = _mm256_add_epi32(acc[v], dot4(x_abs, x_g, b_v));
+            }
+        }
+        for (int v = 0; v < 8; ++v)
+        {
+            __m256 y_v = _mm256_loadu_ps(y + j + v * 8);
+            __m256 scale_v = _mm256_loadu_ps(&w.scale[j + v * 8]);
+            _mm256_storeu_ps(y + j + v * 8, _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[v]), scale_v, y_v));
+        }
+    }
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        for (int g = 0; g < groups; ++g)
+        {
+            __m256i x_g = broadcast4(x, g);
+            __m256i b_g = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + ((size_t)g * n + j) * 4));
+            acc = _mm256_add_epi32(acc, dot4(_mm256_abs_epi8(x_g), x_g, b_g));
+        }
+        __m256 y_j = _mm256_loadu_ps(y + j);
+        _mm256_storeu_ps(y + j, _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc), _mm256_loadu_ps(&w.scale[j]), y_j));
+    }
+    for (; j < n; ++j)
+    {
+        y[j] += dot_int8_column(w, x, j) * w.scale[j];
+    }
+}
+
+const NativeKernels *native_kernels_avx2()
+{
+    static const NativeKernels kernels = {"avx2", avx2_gemm<float>, avx2_gemv<float>,
+                                          avx2_gemm<uint16_t>, avx2_gemv<uint16_t>,
+                                          avx2_gemm_int8, avx2_gemv_int8};
+    if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma"))
+    {
+        return NULL;
+    }
+    return &kernels;
+}
+
+#else
+
+const NativeKernels *native_kernels_avx2()
+{
+    return NULL;
+}
+
+#endif  // __AVX2__ && __FMA__
+
+#endif  // LAC_WITH_NATIVE
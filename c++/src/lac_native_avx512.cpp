@@ -0,0 +1,353 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 原生推理引擎的AVX-512计算核，本文件以-mavx512f -mfma编译，未启用时返回NULL
+ * 列数不足16的部分使用掩码读写，不需要标量收尾 */
+
+#ifdef LAC_WITH_NATIVE
+
+#include "lac_native.h"
+
+#if defined(__AVX512F__)
+
+#include <cstring>
+#include <immintrin.h>
+
+static inline __mmask16 tail_mask(int cols)
+{
+    return cols >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << cols) - 1);
+}
+
+/* 不带掩码的形式以_mm512_undefined_*为初值，GCC会误报未初始化，改用全掩码的maskz形式 */
+static const __mmask16 ALL_LANES = 0xFFFF;
+
+static inline __m512 int32_to_float(__m512i x)
+{
+    return _mm512_maskz_cvtepi32_ps(ALL_LANES, x);
+}
+
+/* 读取16个权重，bf16左移16位即为fp32；bf16的掩码读取需要AVX512BW，不足16列时经由栈上的副本读取 */
+static inline __m512 load16(const float *p)
+{
+    return _mm512_loadu_ps(p);
+}
+
+static inline __m512 load16(const uint16_t *p)
+{
+    __m512i wide = _mm512_maskz_cvtepu16_epi32(ALL_LANES, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(ALL_LANES, wide, 16));
+}
+
+static inline __m512 load16(const float *p, __mmask16 mask, int cols)
+{
+    return _mm512_maskz_loadu_ps(mask, p);
+}
+
+static inline __m512 load16(const uint16_t *p, __mmask16 mask, int cols)
+{
+    uint16_t tail[16] = {0};
+    std::memcpy(tail, p, (cols < 16 ? cols : 16) * sizeof(uint16_t));
+    return load16(tail);
+}
+
+/* 计算R行A与B的乘积，每次32列(每行两个累加器)，其余每次16列 */
+template <int R, typename T>
+static inline void avx512_gemm_rows(int n, int k, const float *a, int lda, const T *b, int ldb,
+                                    const float *bias, float *c, int ldc)
+{
+    int j = 0;
+    for (; j + 32 <= n; j += 32)
+    {
+        __m512 acc0[R], acc1[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc0[r] = bias ? _mm512_loadu_ps(bias + j) : _mm512_setzero_ps();
+            acc1[r] = bias ? _mm512_loadu_ps(bias + j + 16) : _mm512_setzero_ps();
+        }
+        for (int p = 0; p < k; ++p)
+        {
+            const T *b_row = b + (size_t)p * ldb + j;
+            __m512 b0 = load16(b_row);
+            __m512 b1 = load16(b_row + 16);
+            for (int r = 0; r < R; ++r)
+            {
+                __m512 a_rp = _mm512_set1_ps(a[(size_t)r * lda + p]);
+                acc0[r] = _mm512_fmadd_ps(a_rp, b0, acc0[r]);
+                acc1[r] = _mm512_fmadd_ps(a_rp, b1, acc1[r]);
+            }
+        }
+        for (int r = 0; r < R; ++r)
+        {
+            _mm512_storeu_ps(c + (size_t)r * ldc + j, acc0[r]);
+            _mm512_storeu_ps(c + (size_t)r * ldc + j + 16, acc1[r]);
+        }
+    }
+    for (; j < n; j += 16)
+    {
+        __mmask16 mask = tail_mask(n - j);
+        __m512 acc[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc[r] = bias ? _mm512_maskz_loadu_ps(mask, bias + j) : _mm512_setzero_ps();
+        }
+        for (int p = 0; p < k; ++p)
+        {
+            __m512 b0 = load16(b + (size_t)p * ldb + j, mask, n - j);
+            for (int r = 0; r < R; ++r)
+            {
+                acc[r] = _mm512_fmadd_ps(_mm512_set1_ps(a[(size_t)r * lda + p]), b0, acc[r]);
+            }
+        }
+        for (int r = 0; r < R; ++r)
+        {
+            _mm512_mask_storeu_ps(c + (size_t)r * ldc + j, mask, acc[r]);
+        }
+    }
+}
+
+/* 按行块ROW_TILE、列块COL_TILE分块，行块内的A与列块内的B在计算时保持在缓存中 */
+static const int ROW_TILE = 64;
+static const int COL_TILE = 128;
+
+template <typename T>
+static void avx512_gemm(int m, int n, int k, const float *a, int lda, const T *b, int ldb,
+                        const float *bias, float *c, int ldc)
+{
+    for (int i0 = 0; i0 < m; i0 += ROW_TILE)
+    {
+        int i_end = i0 + ROW_TILE < m ? i0 + ROW_TILE : m;
+        for (int j0 = 0; j0 < n; j0 += COL_TILE)
+        {
+            int cols = n - j0 < COL_TILE ? n - j0 : COL_TILE;
+            const T *b_tile = b + j0;
+            const float *bias_tile = bias ? bias + j0 : NULL;
+            int i = i0;
+            for (; i + 8 <= i_end; i += 8)
+            {
+                avx512_gemm_rows<8>(cols, k, a + (size_t)i * lda, lda, b_tile, ldb, bias_tile,
+                                    c + (size_t)i * ldc + j0, ldc);
+            }
+            for (; i < i_end; ++i)
+            {
+                avx512_gemm_rows<1>(cols, k, a + (size_t)i * lda, lda, b_tile, ldb, bias_tile,
+                                    c + (size_t)i * ldc + j0, ldc);
+            }
+        }
+    }
+}
+
+/* 每次128列，8个累加器常驻寄存器以掩盖FMA的延迟，W按行顺序读取 */
+template <typename T>
+static void avx512_gemv(int n, int k, const float *x, const T *w, int ldw, float *y)
+{
+    int j = 0;
+    for (; j + 128 <= n; j += 128)
+    {
+        __m512 acc[8];
+        for (int v = 0; v < 8; ++v)
+        {
+            acc[v] = _mm512_loadu_ps(y + j + v * 16);
+        }
+        for (int p = 0; p < k; ++p)
+        {
+            const T *w_row = w + (size_t)p * ldw + j;
+            __m512 x_p = _mm512_set1_ps(x[p]);
+            for (int v = 0; v < 8; ++v)
+            {
+                acc[v] = _mm512_fmadd_ps(x_p, load16(w_row + v * 16), acc[v]);
+            }
+        }
+        for (int v = 0; v < 8; ++v)
+        {
+            _mm512_storeu_ps(y + j + v * 16, acc[v]);
+        }
+    }
+    for (; j < n; j += 16)
+    {
+        __mmask16 mask = tail_mask(n - j);
+        __m512 acc = _mm512_maskz_loadu_ps(mask, y + j);
+        for (int p = 0; p < k; ++p)
+        {
+            acc = _mm512_fmadd_ps(_mm512_set1_ps(x[p]), load16(w + (size_t)p * ldw + j, mask, n - j), acc);
+        }
+        _mm512_mask_storeu_ps(y + j, mask, acc);
+    }
+}
+
+/* VNNI的int8计算核：vpdpbusd为u8与s8的4字节点积，输入异或0x80即为u8(x + 128)，
+ * 结果多出的128 * 每列权重之和由w.compensation扣除 */
+#define LAC_VNNI __attribute__((target("avx512vnni")))
+
+/* 读取一行量化输入中第g组的4个int8，转为u8后广播 */
+static inline __m512i broadcast4_u8(const int8_t *x, int g)
+{
+    uint32_t word;
+    std::memcpy(&word, x + g * 4, sizeof(word));
+    return _mm512_set1_epi32((int)(word ^ 0x80808080u));
+}
+
+/* 计算R行量化输入与W的乘积，每次32列(每行两个累加器)，其余每次16列 */
+template <int R>
+LAC_VNNI static inline void vnni_gemm_int8_rows(const NativeMatrix &w, const int8_t *a, int lda,
+                                                const float *bias, float *c, int ldc)
+{
+    int n = w.cols;
+    int groups = w.padded_rows() / 4;
+    const int8_t *b = w.int8.data();
+    int j = 0;
+    for (; j + 32 <= n; j += 32)
+    {
+        __m512i acc0[R], acc1[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc0[r] = _mm512_setzero_si512();
+            acc1[r] = _mm512_setzero_si512();
+        }
+        for (int g = 0; g < groups; ++g)
+        {
+            const int8_t *b_g = b + ((size_t)g * n + j) * 4;
+            __m512i b0 = _mm512_loadu_si512(b_g);
+            __m512i b1 = _mm512_loadu_si512(b_g + 64);
+            for (int r = 0; r < R; ++r)
+            {
+                __m512i x = broadcast4_u8(a + (size_t)r * lda, g);
+                acc0[r] = _mm512_dpbusd_epi32(acc0[r], x, b0);
+                acc1[r] = _mm512_dpbusd_epi32(acc1[r], x, b1);
+            }
+        }
+        __m512i comp0 = _mm512_loadu_si512(&w.compensation[j]);
+        __m512i comp1 = _mm512_loadu_si512(&w.compensation[j + 16]);
+        __m512 scale0 = _mm512_loadu_ps(&w.scale[j]);
+        __m512 scale1 = _mm512_loadu_ps(&w.scale[j + 16]);
+        __m512 bias0 = bias ? _mm512_loadu_ps(bias + j) : _mm512_setzero_ps();
+        __m512 bias1 = bias ? _mm512_loadu_ps(bias + j + 16) : _mm512_setzero_ps();
+        for (int r = 0; r < R; ++r)
+        {
+            __m512 sum0 = int32_to_float(_mm512_sub_epi32(acc0[r], comp0));
+            __m512 sum1 = int32_to_float(_mm512_sub_epi32(acc1[r], comp1));
+            _mm512_storeu_ps(c + (size_t)r * ldc + j, _mm512_fmadd_ps(sum0, scale0, bias0));
+            _mm512_storeu_ps(c + (size_t)r * ldc + j + 16, _mm512_fmadd_ps(sum1, scale1, bias1));
+        }
+    }
+    for (; j < n; j += 16)
+    {
+        __mmask16 mask = tail_mask(n - j);
+        __m512i acc[R];
+        for (int r = 0; r < R; ++r)
+        {
+            acc[r] = _mm512_setzero_si512();
+        }
+        for (int g = 0; g < groups; ++g)
+        {
+            __m512i b0 = _mm512_maskz_loadu_epi32(mask, b + ((size_t)g * n + j) * 4);
+            for (int r = 0; r < R; ++r)
+            {
+                acc[r] = _mm512_dpbusd_epi32(acc[r], broadcast4_u8(a + (size_t)r * lda, g), b0);
+            }
+        }
+        __m512i comp0 = _mm512_maskz_loadu_epi32(mask, &w.compensation[j]);
+        __m512 scale0 = _mm512_maskz_loadu_ps(mask, &w.scale[j]);
+        __m512 bias0 = bias ? _mm512_maskz_loadu_ps(mask, bias + j) : _mm512_setzero_ps();
+        for (int r = 0; r < R; ++r)
+        {
+            __m512 sum = int32_to_float(_mm512_sub_epi32(acc[r], comp0));
+            _mm512_mask_storeu_ps(c + (size_t)r * ldc + j, mask, _mm512_fmadd_ps(sum, scale0, bias0));
+        }
+    }
+}
+
+LAC_VNNI static void vnni_gemm_int8(int m, const NativeMatrix &w, const int8_t *a, int lda, const float *bias,
+                                    float *c, int ldc)
+{
+    int i = 0;
+    for (; i + 8 <= m; i += 8)
+    {
+        vnni_gemm_int8_rows<8>(w, a + (size_t)i * lda, lda, bias, c + (size_t)i * ldc, ldc);
+    }
+    for (; i < m; ++i)
+    {
+        vnni_gemm_int8_rows<1>(w, a + (size_t)i * lda, lda, bias, c + (size_t)i * ldc, ldc);
+    }
+}
+
+/* 每次128列，8个累加器常驻寄存器 */
+LAC_VNNI static void vnni_gemv_int8(const NativeMatrix &w, const int8_t *x, float *y)
+{
+    int n = w.cols;
+    int groups = w.padded_rows() / 4;
+    const int8_t *b = w.int8.data();
+    int j = 0;
+    for (; j + 128 <= n; j += 128)
+    {
+        __m512i acc[8];
+        for (int v = 0; v < 8; ++v)
+        {
+            acc[v] = _mm512_setzero_si512();
+        }
+        for (int g = 0; g < groups; ++g)
+        {
+            const int8_t *b_g = b + ((size_t)g * n + j) * 4;
+            __m512i x_g = broadcast4_u8(x, g);
+            for (int v = 0; v < 8; ++v)
+            {
+                acc[v] = _mm512_dpbusd_epi32(acc[v], x_g, _mm512_loadu_si512(b_g + v * 64));
+            }
+        }
+        for (int v = 0; v < 8; ++v)
+        {
+            int col = j + v * 16;
+            __m512 sum = int32_to_float(_mm512_sub_epi32(acc[v], _mm512_loadu_si512(&w.compensation[col])));
+            _mm512_storeu_ps(y + col, _mm512_fmadd_ps(sum, _mm512_loadu_ps(&w.scale[col]), _mm512_loadu_ps(y + col)));
+        }
+    }
+    for (; j < n; j += 16)
+    {
+        __mmask16 mask = tail_mask(n - j);
+        __m512i acc = _mm512_setzero_si512();
+        for (int g = 0; g < groups; ++g)
+        {
+            acc = _mm512_dpbusd_epi32(acc, broadcast4_u8(x, g), _mm512_maskz_loadu_epi32(mask, b + ((size_t)g * n + j) * 4));
+        }
+        __m512 sum = int32_to_float(_mm512_sub_epi32(acc, _mm512_maskz_loadu_epi32(mask, &w.compensation[j])));
+        __m512 y_j = _mm512_maskz_loadu_ps(mask, y + j);
+        _mm512_mask_storeu_ps(y + j, mask, _mm512_fmadd_ps(sum, _mm512_maskz_loadu_ps(mask, &w.scale[j]), y_j));
+    }
+}
+
+/* CPU不支持VNNI时int8计算核为NULL，由native_kernels以avx2的补齐 */
+const NativeKernels *native_kernels_avx512()
+{
+    static const NativeKernels kernels = {"avx512", avx512_gemm<float>, avx512_gemv<float>,
+                                          avx512_gemm<uint16_t>, avx512_gemv<uint16_t>,
+                                          NULL, NULL};
+    static const NativeKernels vnni_kernels = {"avx512-vnni", avx512_gemm<float>, avx512_gemv<float>,
+                                               avx512_gemm<uint16_t>, avx512_gemv<uint16_t>,
+                                               vnni_gemm_int8, vnni_gemv_int8};
+    if (!__builtin_cpu_supports("avx512f"))
+    {
+        return NULL;
+    }
+    return __builtin_cpu_supports("avx512vnni") ? &vnni_kernels : &kernels;
+}
+
+#else
+
+const NativeKernels *native_kernels_avx512()
+{
+    return NULL;
+}
+
+#endif  // __AVX512F__
+
+#endif  // LAC_WITH_NATIVE
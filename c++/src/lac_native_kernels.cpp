@@ -0,0 +1,228 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* 原生推理引擎的标量计算核及运行时指令集选择 */
+
+#ifdef LAC_WITH_NATIVE
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "lac_native.h"
+
+static void scalar_gemm(int m, int n, int k, const float *a, int lda, const float *b, int ldb,
+                        const float *bias, float *c, int ldc)
+{
+    for (int i = 0; i < m; ++i)
+    {
+        float *c_row = c + (size_t)i * ldc;
+        if (bias)
+        {
+            std::memcpy(c_row, bias, n * sizeof(float));
+        }
+        else
+        {
+            std::memset(c_row, 0, n * sizeof(float));
+        }
+        const float *a_row = a + (size_t)i * lda;
+        for (int p = 0; p < k; ++p)
+        {
+            float a_ip = a_row[p];
+            const float *b_row = b + (size_t)p * ldb;
+            for (int j = 0; j < n; ++j)
+            {
+                c_row[j] += a_ip * b_row[j];
+            }
+        }
+    }
+}
+
+static void scalar_gemv(int n, int k, const float *x, const float *w, int ldw, float *y)
+{
+    for (int p = 0; p < k; ++p)
+    {
+        float x_p = x[p];
+        const float *w_row = w + (size_t)p * ldw;
+        for (int j = 0; j < n; ++j)
+        {
+            y[j] += x_p * w_row[j];
+        }
+    }
+}
+
+static inline float scalar_bf16(uint16_t value)
+{
+    uint32_t bits = (uint32_t)value << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static void scalar_gemm_bf16(int m, int n, int k, const float *a, int lda, const uint16_t *b, int ldb,
+                             const float *bias, float *c, int ldc)
+{
+    for (int i = 0; i < m; ++i)
+    {
+        float *c_row = c + (size_t)i * ldc;
+        for (int j = 0; j < n; ++j)
+        {
+            c_row[j] = bias ? bias[j] : 0.0f;
+        }
+        const float *a_row = a + (size_t)i * lda;
+        for (int p = 0; p < k; ++p)
+        {
+            float a_ip = a_row[p];
+            const uint16_t *b_row = b + (size_t)p * ldb;
+            for (int j = 0; j < n; ++j)
+            {
+                c_row[j] += a_ip * scalar_bf16(b_row[j]);
+            }
+        }
+    }
+}
+
+static void scalar_gemv_bf16(int n, int k, const float *x, const uint16_t *w, int ldw, float *y)
+{
+    for (int p = 0; p < k; ++p)
+    {
+        float x_p = x[p];
+        const uint16_t *w_row = w + (size_t)p * ldw;
+        for (int j = 0; j < n; ++j)
+        {
+            y[j] += x_p * scalar_bf16(w_row[j]);
+        }
+    }
+}
+
+/* 一行量化输入与W从第j0列起cols列(不超过INT8_BLOCK)的整数点积，结果写入acc */
+static const int INT8_BLOCK = 64;
+
+static void scalar_dot_int8(const NativeMatrix &w, const int8_t *x, int j0, int cols, int32_t *acc)
+{
+    int n = w.cols;
+    for (int j = 0; j < cols; ++j)
+    {
+        acc[j] = 0;
+    }
+    for (int g = 0; g < w.padded_rows() / 4; ++g)
+    {
+        const int8_t *x_g = x + g * 4;
+        const int8_t *w_g = &w.int8[((size_t)g * n + j0) * 4];
+        for (int j = 0; j < cols; ++j)
+        {
+            acc[j] += x_g[0] * w_g[j * 4] + x_g[1] * w_g[j * 4 + 1] + x_g[2] * w_g[j * 4 + 2] +
+                      x_g[3] * w_g[j * 4 + 3];
+        }
+    }
+}
+
+static void scalar_gemm_int8(int m, const NativeMatrix &w, const int8_t *a, int lda, const float *bias,
+                             float *c, int ldc)
+{
+    int32_t acc[INT8_BLOCK];
+    for (int i = 0; i < m; ++i)
+    {
+        float *c_row = c + (size_t)i * ldc;
+        for (int j0 = 0; j0 < w.cols; j0 += INT8_BLOCK)
+        {
+            int cols = std::min(INT8_BLOCK, w.cols - j0);
+            scalar_dot_int8(w, a + (size_t)i * lda, j0, cols, acc);
+            for (int j = 0; j < cols; ++j)
+            {
+                c_row[j0 + j] = acc[j] * w.scale[j0 + j] + (bias ? bias[j0 + j] : 0.0f);
+            }
+        }
+    }
+}
+
+static void scalar_gemv_int8(const NativeMatrix &w, const int8_t *x, float *y)
+{
+    int32_t acc[INT8_BLOCK];
+    for (int j0 = 0; j0 < w.cols; j0 += INT8_BLOCK)
+    {
+        int cols = std::min(INT8_BLOCK, w.cols - j0);
+        scalar_dot_int8(w, x, j0, cols, acc);
+        for (int j = 0; j < cols; ++j)
+        {
+            y[j0 + j] += acc[j] * w.scale[j0 + j];
+        }
+    }
+}
+
+const NativeKernels *native_kernels_scalar()
+{
+    static const NativeKernels kernels = {"scalar", scalar_gemm, scalar_gemv,
+                                          scalar_gemm_bf16, scalar_gemv_bf16,
+                                          scalar_gemm_int8, scalar_gemv_int8};
+    return &kernels;
+}
+
+/* 指定指令集的计算核，缺少的int8计算核(CPU不支持VNNI)由低一级的指令集补齐 */
+static const NativeKernels *complete_kernels(const NativeKernels *kernels, const NativeKernels *fallback)
+{
+    static NativeKernels merged;
+    if (!kernels || kernels->gemm_int8)
+    {
+        return kernels;
+    }
+    merged = *kernels;
+    merged.gemm_int8 = fallback->gemm_int8;
+    merged.gemv_int8 = fallback->gemv_int8;
+    return &merged;
+}
+
+/* 按LAC_NATIVE_ISA或CPU支持的指令集选择，结果在首次调用时确定 */
+static const NativeKernels *select_kernels()
+{
+    const NativeKernels *avx2 = native_kernels_avx2();
+    const NativeKernels *avx512 = complete_kernels(native_kernels_avx512(), avx2 ? avx2 : native_kernels_scalar());
+    const char *isa = std::getenv("LAC_NATIVE_ISA");
+    if (isa && isa[0])
+    {
+        std::string name = isa;
+        if (name == "scalar")
+        {
+            return native_kernels_scalar();
+        }
+        if (name == "avx2" && avx2)
+        {
+            return avx2;
+        }
+        if (name == "avx512" && avx512)
+        {
+            return avx512;
+        }
+        std::cerr << "LAC_NATIVE_ISA " << name << " is not available" << std::endl;
+    }
+    if (avx512)
+    {
+        return avx512;
+    }
+    if (avx2)
+    {
+        return avx2;
+    }
+    return native_kernels_scalar();
+}
+
+const NativeKernels *native_kernels()
+{
+    static const NativeKernels *kernels = select_kernels();
+    return kernels;
+}
+
+#endif  // LAC_WITH_NATIVE
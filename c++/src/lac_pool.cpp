@@ -0,0 +1,145 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+
+#include "lac_pool.h"
+#include "lac_segment.h"
+
+/* 拷贝出size个会话，至少一个 */
+LACPool::LACPool(LAC &prototype, size_t size)
+    : _rank_enabled(prototype.rank_enabled()),
+      _fallback_enabled(prototype.fallback_enabled()),
+      _codetype(prototype.codetype()),
+      _tag_names(prototype.tag_names()),
+      _segment(prototype.segment()),
+      _reserved(0)
+{
+    if (prototype.custom)
+    {
+        this->_custom_layers.assign(1, prototype.custom);
+    }
+    for (size_t i = 0; i < this->_tag_names.size(); ++i)
+    {
+        this->_tag_ids.insert(std::make_pair(this->_tag_names[i], (int)i));
+    }
+    if (size == 0)
+    {
+        size = 1;
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+        this->_sessions.push_back(std::unique_ptr<LAC>(new LAC(prototype)));
+        this->_idle.push_back(this->_sessions.back().get());
+    }
+    this->_synced_tags.assign(size, this->_tag_names.size());
+}
+
+void LACPool::set_reserved(size_t reserved)
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_reserved = std::min(reserved, this->_sessions.size() - 1);
+}
+
+LAC *LACPool::acquire(TRAFFIC_CLASS cls)
+{
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    while (!can_acquire(cls))
+    {
+        this->_cond.wait(lock);
+    }
+    LAC *lac = this->_idle.back();
+    this->_idle.pop_back();
+    sync_tags(lac);
+    return lac;
+}
+
+LAC *LACPool::try_acquire(TRAFFIC_CLASS cls)
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (!can_acquire(cls))
+    {
+        return NULL;
+    }
+    LAC *lac = this->_idle.back();
+    this->_idle.pop_back();
+    sync_tags(lac);
+    return lac;
+}
+
+void LACPool::release(LAC *lac)
+{
+    if (lac == NULL)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_idle.push_back(lac);
+    }
+    // 等待者可能属于不同类别，全部唤醒后各自判断
+    this->_cond.notify_all();
+}
+
+size_t LACPool::idle()
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    return this->_idle.size();
+}
+
+size_t LACPool::index(const LAC *lac) const
+{
+    // 会话在构造后不再增减，无需加锁；会话数通常不多，直接顺序查找
+    size_t i = 0;
+    while (i < this->_sessions.size() && this->_sessions[i].get() != lac)
+    {
+        ++i;
+    }
+    return i;
+}
+
+void LACPool::sync_tags(LAC *lac)
+{
+    size_t &synced = this->_synced_tags[index(lac)];
+    if (synced < this->_tag_names.size())
+    {
+        std::vector<std::string> tags(this->_tag_names.begin() + synced, this->_tag_names.end());
+        lac->add_tags(tags);
+        synced = this->_tag_names.size();
+    }
+}
+
+void LACPool::add_tags(const std::vector<std::string> &tags)
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    for (size_t i = 0; i < tags.size(); ++i)
+    {
+        if (this->_tag_ids.insert(std::make_pair(tags[i], (int)this->_tag_names.size())).second)
+        {
+            this->_tag_names.push_back(tags[i]);
+        }
+    }
+}
+
+TagMask LACPool::compile_tag_filter(const std::vector<std::string> &tags) const
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    return ::compile_tag_filter(this->_tag_names, tags);
+}
+
+void LACPool::sync_tags(SegmentSession &segment) const
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    segment.sync_tags(this->_tag_names);
+}
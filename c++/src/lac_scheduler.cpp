@@ -0,0 +1,758 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "lac_scheduler.h"
+#include "lac_segment.h"
+#include "lac_util.h"
+
+/* rank和keyword模式及请求了rank字段的请求都需要运行rank模型，可以合并到同一个batch */
+static bool need_rank(const LACRequest &request)
+{
+    return request.mode == MODE_RANK || request.mode == MODE_KEYWORD || (request.options.fields & FIELD_RANK);
+}
+
+/* 运行request时LAC::run的选项 */
+static RunOptions run_options(const LACRequest &request)
+{
+    RunOptions options = request.options;
+    if (need_rank(request))
+    {
+        options.fields |= FIELD_RANK;
+    }
+    return options;
+}
+
+/* 选项相同的请求才能合并到同一个batch */
+static bool same_options(const LACRequest &a, const LACRequest &b)
+{
+    RunOptions x = run_options(a);
+    RunOptions y = run_options(b);
+    return x.customization == y.customization && x.segment_only == y.segment_only && x.fields == y.fields &&
+           x.tag_filter == y.tag_filter && x.dicts == y.dicts;
+}
+
+/* 降级分词只按干预的词典和词性过滤分batch */
+static bool same_fallback_options(const LACRequest &a, const LACRequest &b)
+{
+    return a.options.customization == b.options.customization && a.options.dicts == b.options.dicts &&
+           a.options.tag_filter == b.options.tag_filter;
+}
+
+static int64_t elapsed_us(LACRequest::Clock::time_point begin, LACRequest::Clock::time_point end)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+}
+
+/* 按输入编码统计query的字数，用于批量请求的字数预算 */
+static size_t count_tokens(const std::vector<std::string> &querys, CODE_TYPE codetype)
+{
+    size_t tokens = 0;
+    for (size_t i = 0; i < querys.size(); ++i)
+    {
+        const char *p = querys[i].c_str();
+        const char *end = p + querys[i].length();
+        while (p < end)
+        {
+            p += get_next_word(p, end - p, codetype);
+            ++tokens;
+        }
+    }
+    return tokens;
+}
+
+// 步长调度中权重为1的类别每运行一个batch增加的进度
+static const uint64_t STRIDE = 1 << 16;
+
+BatchScheduler::BatchScheduler(LACPool &pool, const SchedulerConfig &config)
+    : _pool(pool),
+      _config(config),
+      _queued_querys(0),
+      _stop(false),
+      _vtime(0)
+{
+    for (int cls = 0; cls < CLASS_NUM; ++cls)
+    {
+        ClassConfig &class_config = this->_config.classes[cls];
+        class_config.max_batch_size = std::max(class_config.max_batch_size, (size_t)1);
+        class_config.weight = std::max(class_config.weight, 1);
+        this->_class_querys[cls] = 0;
+        this->_class_tokens[cls] = 0;
+        this->_estimate_us[cls] = 0;
+        this->_pass[cls] = 0;
+    }
+    pool.set_reserved(this->_config.reserved_sessions);
+
+    // 可以降级时调度线程多于会话数，所有会话都在运行batch时仍有线程按时降级、丢弃排队的请求
+    size_t num_workers = this->_config.num_workers > 0 ? this->_config.num_workers : pool.size();
+    if (fallback_enabled())
+    {
+        num_workers = std::max(num_workers, pool.size() + 1);
+    }
+    for (size_t i = 0; i < num_workers; ++i)
+    {
+        this->_workers.push_back(std::thread(&BatchScheduler::worker_loop, this));
+    }
+}
+
+BatchScheduler::~BatchScheduler()
+{
+    stop();
+}
+
+/* 提交请求，队列已满时拒绝；队列为空时总是接收，避免大batch请求永远无法运行 */
+int BatchScheduler::submit(const LACRequestPtr &request)
+{
+    if (need_rank(*request) && !this->_pool.rank_enabled())
+    {
+        return SCHED_UNSUPPORTED;
+    }
+    if (request->traffic_class < 0 || request->traffic_class >= CLASS_NUM)
+    {
+        request->traffic_class = CLASS_INTERACTIVE;
+    }
+    request->tokens = count_tokens(request->querys, this->_pool.codetype());
+
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_stop)
+        {
+            return SCHED_STOPPED;
+        }
+        if (this->_queued_querys > 0 &&
+            this->_queued_querys + request->querys.size() > this->_config.max_queue_depth)
+        {
+            this->_metrics.rejected++;
+            return SCHED_REJECTED;
+        }
+        request->status = SCHED_OK;
+        request->enqueue_time = LACRequest::Clock::now();
+
+        // 已经来不及完成且无法降级的请求直接丢弃
+        int64_t estimate_us = this->_estimate_us[request->traffic_class];
+        if (request->has_deadline() &&
+            request->deadline < request->enqueue_time + std::chrono::microseconds(estimate_us) &&
+            !(fallback_enabled() && request->deadline > request->enqueue_time))
+        {
+            this->_metrics.shed++;
+            return SCHED_EXPIRED;
+        }
+        enqueue(request);
+        this->_metrics.requests++;
+        this->_metrics.classes[request->traffic_class].requests++;
+    }
+    this->_cond.notify_one();
+    return SCHED_OK;
+}
+
+/* 按截止时间插入，截止时间相同时保持到达顺序；多数请求插在队尾附近，从后向前查找 */
+void BatchScheduler::enqueue(const LACRequestPtr &request)
+{
+    std::deque<LACRequestPtr> &queue = this->_queues[request->traffic_class];
+    std::deque<LACRequestPtr>::iterator it = queue.end();
+    while (it != queue.begin() && (*(it - 1))->deadline > request->deadline)
+    {
+        --it;
+    }
+    queue.insert(it, request);
+    this->_queued_querys += request->querys.size();
+    this->_class_querys[request->traffic_class] += request->querys.size();
+    this->_class_tokens[request->traffic_class] += request->tokens;
+}
+
+void BatchScheduler::remove_queued(const LACRequest &request)
+{
+    this->_queued_querys -= request.querys.size();
+    this->_class_querys[request.traffic_class] -= request.querys.size();
+    this->_class_tokens[request.traffic_class] -= request.tokens;
+}
+
+/* 队列按截止时间排序，来不及完成的请求都在队首 */
+void BatchScheduler::take_expired(LACRequest::Clock::time_point now, std::vector<LACRequestPtr> &expired,
+                                  std::vector<LACRequestPtr> &fallback, LACRequest::Clock::time_point &wake_time)
+{
+    bool can_fallback = fallback_enabled();
+    for (int cls = 0; cls < CLASS_NUM; ++cls)
+    {
+        std::deque<LACRequestPtr> &queue = this->_queues[cls];
+        LACRequest::Clock::time_point finish = now + std::chrono::microseconds(this->_estimate_us[cls]);
+        while (!queue.empty() && queue.front()->deadline < finish)
+        {
+            const LACRequestPtr &request = queue.front();
+            if (can_fallback && request->deadline > now)
+            {
+                fallback.push_back(request);
+            }
+            else
+            {
+                expired.push_back(request);
+            }
+            remove_queued(*request);
+            queue.pop_front();
+        }
+        if (!queue.empty() && queue.front()->has_deadline())
+        {
+            wake_time = std::min(wake_time,
+                                 queue.front()->deadline - std::chrono::microseconds(this->_estimate_us[cls]));
+        }
+    }
+}
+
+/* 队列按截止时间排序，排队最久的请求不一定在队首，需要扫描整个队列 */
+void BatchScheduler::take_fallback(LACRequest::Clock::time_point now, std::vector<LACRequestPtr> &fallback,
+                                   LACRequest::Clock::time_point &wake_time)
+{
+    if (!fallback_enabled())
+    {
+        return;
+    }
+    std::chrono::microseconds fallback_queue(this->_config.fallback_queue_us);
+    LACRequest::Clock::time_point threshold = now - fallback_queue;
+    for (int cls = 0; cls < CLASS_NUM; ++cls)
+    {
+        std::deque<LACRequestPtr> &queue = this->_queues[cls];
+        for (std::deque<LACRequestPtr>::iterator it = queue.begin(); it != queue.end();)
+        {
+            if ((*it)->enqueue_time > threshold)
+            {
+                wake_time = std::min(wake_time, (*it)->enqueue_time + fallback_queue);
+                ++it;
+                continue;
+            }
+            fallback.push_back(*it);
+            remove_queued(**it);
+            it = queue.erase(it);
+        }
+    }
+}
+
+void BatchScheduler::finish_expired(std::vector<LACRequestPtr> &expired)
+{
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+        expired[i]->status = SCHED_EXPIRED;
+        expired[i]->results.clear();
+        this->_metrics.shed++;
+        if (expired[i]->done)
+        {
+            expired[i]->done(*expired[i]);
+        }
+    }
+    expired.clear();
+}
+
+/* 同步运行，在调用线程中等待调度线程完成 */
+int BatchScheduler::run(const std::vector<std::string> &querys, LAC_MODE mode,
+                        std::vector<std::vector<OutputItem>> &results)
+{
+    return run(querys, mode, results, LACRequest::Clock::time_point::max());
+}
+
+int BatchScheduler::run(const std::vector<std::string> &querys, LAC_MODE mode,
+                        std::vector<std::vector<OutputItem>> &results, LACRequest::Clock::time_point deadline)
+{
+    std::mutex done_mutex;
+    std::condition_variable done_cond;
+    bool finished = false;
+
+    LACRequestPtr request(new LACRequest());
+    request->querys = querys;
+    request->mode = mode;
+    request->deadline = deadline;
+    request->done = [&](LACRequest &) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        finished = true;
+        done_cond.notify_one();
+    };
+
+    int status = submit(request);
+    if (status != SCHED_OK)
+    {
+        return status;
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    while (!finished)
+    {
+        done_cond.wait(lock);
+    }
+    results.swap(request->results);
+    return request->status;
+}
+
+void BatchScheduler::stop()
+{
+    std::vector<LACRequestPtr> remaining;
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_stop)
+        {
+            return;
+        }
+        this->_stop = true;
+    }
+    this->_cond.notify_all();
+    for (size_t i = 0; i < this->_workers.size(); ++i)
+    {
+        this->_workers[i].join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        for (int cls = 0; cls < CLASS_NUM; ++cls)
+        {
+            remaining.insert(remaining.end(), this->_queues[cls].begin(), this->_queues[cls].end());
+            this->_queues[cls].clear();
+            this->_class_querys[cls] = 0;
+            this->_class_tokens[cls] = 0;
+        }
+        this->_queued_querys = 0;
+    }
+    for (size_t i = 0; i < remaining.size(); ++i)
+    {
+        remaining[i]->status = SCHED_STOPPED;
+        if (remaining[i]->done)
+        {
+            remaining[i]->done(*remaining[i]);
+        }
+    }
+}
+
+size_t BatchScheduler::queue_depth()
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    return this->_queued_querys;
+}
+
+size_t BatchScheduler::queue_depth(TRAFFIC_CLASS cls)
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    return this->_class_querys[cls];
+}
+
+int64_t BatchScheduler::estimate_us(TRAFFIC_CLASS cls)
+{
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    return this->_estimate_us[cls];
+}
+
+/* query数或字数已满一个batch，或队首请求已等待max_wait_us时可以运行
+ * 队首请求有截止时间时不晚于截止时间减去预计运行耗时和deadline_slack_us */
+bool BatchScheduler::batch_ready(int cls, LACRequest::Clock::time_point now,
+                                 LACRequest::Clock::time_point &wake_time)
+{
+    const std::deque<LACRequestPtr> &queue = this->_queues[cls];
+    if (queue.empty())
+    {
+        return false;
+    }
+    const ClassConfig &class_config = this->_config.classes[cls];
+    if (this->_class_querys[cls] >= class_config.max_batch_size ||
+        (class_config.max_batch_tokens > 0 && this->_class_tokens[cls] >= class_config.max_batch_tokens))
+    {
+        return true;
+    }
+
+    const LACRequest &front = *queue.front();
+    LACRequest::Clock::time_point flush_time =
+        front.enqueue_time + std::chrono::microseconds(class_config.max_wait_us);
+    if (front.has_deadline())
+    {
+        int64_t reserve_us = this->_estimate_us[cls] + this->_config.deadline_slack_us;
+        flush_time = std::min(flush_time, front.deadline - std::chrono::microseconds(reserve_us));
+    }
+    if (now >= flush_time)
+    {
+        return true;
+    }
+    wake_time = std::min(wake_time, flush_time);
+    return false;
+}
+
+/* 步长调度：进度落后于_vtime的类别(刚有新请求的空闲类别)从_vtime开始计算，避免积攒的进度一次性用完 */
+int BatchScheduler::pick_class(LACRequest::Clock::time_point now, LACRequest::Clock::time_point &wake_time,
+                               LAC *&lac)
+{
+    int ready[CLASS_NUM];
+    int count = 0;
+    for (int cls = 0; cls < CLASS_NUM; ++cls)
+    {
+        if (batch_ready(cls, now, wake_time))
+        {
+            ready[count++] = cls;
+        }
+    }
+    std::stable_sort(ready, ready + count, [this](int a, int b) {
+        return std::max(this->_pass[a], this->_vtime) < std::max(this->_pass[b], this->_vtime);
+    });
+
+    // 进度最小的类别借不到会话(批量请求不能使用保留会话)时，由下一个类别运行
+    for (int i = 0; i < count; ++i)
+    {
+        int cls = ready[i];
+        lac = this->_pool.try_acquire((TRAFFIC_CLASS)cls);
+        if (lac != NULL)
+        {
+            this->_vtime = std::max(this->_pass[cls], this->_vtime);
+            this->_pass[cls] = this->_vtime + STRIDE / this->_config.classes[cls].weight;
+            return cls;
+        }
+    }
+    return -1;
+}
+
+/* 按队列顺序取出与队首同模式、同选项的请求，query数不超过max_batch_size，字数不超过max_batch_tokens
+ * 单个请求超过限制时单独成batch */
+void BatchScheduler::take_batch(int cls, std::vector<LACRequestPtr> &batch)
+{
+    std::deque<LACRequestPtr> &queue = this->_queues[cls];
+    const ClassConfig &class_config = this->_config.classes[cls];
+    const LACRequestPtr first = queue.front();
+    size_t batch_querys = 0;
+    size_t batch_tokens = 0;
+    for (std::deque<LACRequestPtr>::iterator it = queue.begin(); it != queue.end();)
+    {
+        size_t size = (*it)->querys.size();
+        size_t tokens = (*it)->tokens;
+        bool over_budget = batch_querys + size > class_config.max_batch_size ||
+                           (class_config.max_batch_tokens > 0 &&
+                            batch_tokens + tokens > class_config.max_batch_tokens);
+        if (!same_options(**it, *first) || (!batch.empty() && over_budget))
+        {
+            ++it;
+            continue;
+        }
+        batch.push_back(*it);
+        batch_querys += size;
+        batch_tokens += tokens;
+        remove_queued(**it);
+        it = queue.erase(it);
+        if (batch_querys >= class_config.max_batch_size ||
+            (class_config.max_batch_tokens > 0 && batch_tokens >= class_config.max_batch_tokens))
+        {
+            break;
+        }
+    }
+}
+
+void BatchScheduler::worker_loop()
+{
+    std::vector<LACRequestPtr> batch;
+    std::vector<std::string> querys;
+    std::vector<std::vector<OutputItem>> results;
+    std::vector<LACRequestPtr> expired;
+    std::vector<LACRequestPtr> fallback;
+    std::vector<LACRequestPtr> fallback_batch;
+    // 降级分词在本线程的分词会话上运行，不占用预测器会话
+    SegmentSession segment(this->_pool.segment());
+
+    while (true)
+    {
+        LAC *lac = NULL;
+        {
+            std::unique_lock<std::mutex> lock(this->_mutex);
+            while (true)
+            {
+                if (this->_stop)
+                {
+                    return;
+                }
+                // 没有可以运行的batch时，等到最早可以凑成batch、需要降级或丢弃请求的时间，或被新请求、归还的会话唤醒
+                // 会话都在使用时，即使已有batch可以运行，也要按时降级和丢弃
+                LACRequest::Clock::time_point now = LACRequest::Clock::now();
+                LACRequest::Clock::time_point wake_time = LACRequest::Clock::time_point::max();
+                take_expired(now, expired, fallback, wake_time);
+                take_fallback(now, fallback, wake_time);
+                if (!expired.empty() || !fallback.empty())
+                {
+                    break;
+                }
+
+                int cls = pick_class(now, wake_time, lac);
+                if (cls >= 0)
+                {
+                    take_batch(cls, batch);
+                    break;
+                }
+                if (wake_time == LACRequest::Clock::time_point::max())
+                {
+                    this->_cond.wait(lock);
+                }
+                else
+                {
+                    this->_cond.wait_until(lock, wake_time);
+                }
+            }
+        }
+
+        finish_expired(expired);
+        if (!fallback.empty())
+        {
+            // 词典选取和词性过滤相同的请求依次合并运行，运行前加入新登记的词性
+            this->_pool.sync_tags(segment);
+            for (size_t begin = 0; begin < fallback.size(); begin += fallback_batch.size())
+            {
+                LACRequestPtr first = fallback[begin];
+                std::vector<LACRequestPtr>::iterator end =
+                    std::stable_partition(fallback.begin() + begin, fallback.end(),
+                                          [&first](const LACRequestPtr &request) {
+                                              return same_fallback_options(*request, *first);
+                                          });
+                fallback_batch.assign(fallback.begin() + begin, end);
+                run_batch(fallback_batch, NULL, &segment, querys, results);
+            }
+            fallback.clear();
+            fallback_batch.clear();
+            this->_cond.notify_all();
+        }
+        if (lac != NULL)
+        {
+            run_batch(batch, lac, NULL, querys, results);
+            batch.clear();
+            this->_pool.release(lac);
+            this->_cond.notify_all();
+        }
+    }
+}
+
+/* 降级分词的batch可以混合各种模式和类别，只按干预的词典和词性过滤区分，不输出rank，keyword模式不做过滤 */
+void BatchScheduler::run_batch(std::vector<LACRequestPtr> &batch, LAC *lac, SegmentSession *segment,
+                               std::vector<std::string> &querys,
+                               std::vector<std::vector<OutputItem>> &results)
+{
+    LAC_PATH path = lac != NULL ? PATH_MODEL : PATH_FALLBACK;
+    RunOptions options = run_options(*batch[0]);
+    LACRequest::Clock::time_point start_time = LACRequest::Clock::now();
+
+    size_t count = 0;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        for (size_t j = 0; j < batch[i]->querys.size(); ++j)
+        {
+            if (count == querys.size())
+            {
+                querys.push_back(std::string());
+            }
+            querys[count++].assign(batch[i]->querys[j]);
+        }
+    }
+    querys.resize(count);
+
+    if (path == PATH_FALLBACK)
+    {
+        segment->run(querys, this->_pool.custom_layers(options), options, results);
+    }
+    else
+    {
+        lac->run(querys, options, results);
+    }
+
+    LACRequest::Clock::time_point end_time = LACRequest::Clock::now();
+    int64_t run_us = elapsed_us(start_time, end_time);
+    this->_metrics.batches++;
+    this->_metrics.run_us += run_us;
+    if (path == PATH_MODEL)
+    {
+        // 滑动平均，新batch占1/8；预测器的batch只包含一个类别的请求
+        TRAFFIC_CLASS cls = batch[0]->traffic_class;
+        this->_metrics.classes[cls].batches++;
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        int64_t &estimate_us = this->_estimate_us[cls];
+        estimate_us = estimate_us == 0 ? run_us : estimate_us + (run_us - estimate_us) / 8;
+    }
+
+    // 按顺序分发结果，keyword模式过滤掉不重要的词
+    size_t offset = 0;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        LACRequest &request = *batch[i];
+        size_t size = request.querys.size();
+        bool keyword = request.mode == MODE_KEYWORD && path == PATH_MODEL;
+        request.results.resize(size);
+        for (size_t j = 0; j < size; ++j)
+        {
+            request.results[j].swap(results[offset + j]);
+            if (keyword)
+            {
+                std::vector<OutputItem> &items = request.results[j];
+                size_t kept = 0;
+                for (size_t k = 0; k < items.size(); ++k)
+                {
+                    if (items[k].rank >= this->_config.keyword_min_rank)
+                    {
+                        if (kept != k)
+                        {
+                            items[kept].word.swap(items[k].word);
+                            items[kept].tag.swap(items[k].tag);
+                            items[kept].rank = items[k].rank;
+                            items[kept].offset = items[k].offset;
+                            items[kept].length = items[k].length;
+                        }
+                        ++kept;
+                    }
+                }
+                items.resize(kept);
+            }
+        }
+        offset += size;
+
+        request.queue_us = elapsed_us(request.enqueue_time, start_time);
+        request.run_us = run_us;
+        request.status = SCHED_OK;
+        request.path = path;
+        if (path == PATH_FALLBACK)
+        {
+            this->_metrics.fallback++;
+        }
+        if (end_time > request.deadline)
+        {
+            this->_metrics.deadline_missed++;
+        }
+        ClassMetrics &class_metrics = this->_metrics.classes[request.traffic_class];
+        class_metrics.queue_us += request.queue_us;
+        class_metrics.completed++;
+        this->_metrics.queue_us += request.queue_us;
+        this->_metrics.querys += size;
+        this->_metrics.completed++;
+        if (request.done)
+        {
+            request.done(request);
+        }
+    }
+}
+
+/* 以Prometheus文本格式追加统计信息，按类别的统计以class标签区分 */
+void BatchScheduler::write_metrics(std::string &out)
+{
+    char buf[256];
+    struct
+    {
+        const char *name;
+        const char *type;
+        uint64_t value;
+    } items[] = {
+        {"lac_requests_total", "counter", this->_metrics.requests.load()},
+        {"lac_requests_rejected_total", "counter", this->_metrics.rejected.load()},
+        {"lac_requests_shed_total", "counter", this->_metrics.shed.load()},
+        {"lac_requests_deadline_missed_total", "counter", this->_metrics.deadline_missed.load()},
+        {"lac_requests_fallback_total", "counter", this->_metrics.fallback.load()},
+        {"lac_requests_completed_total", "counter", this->_metrics.completed.load()},
+        {"lac_querys_total", "counter", this->_metrics.querys.load()},
+        {"lac_batches_total", "counter", this->_metrics.batches.load()},
+        {"lac_queue_time_us_total", "counter", this->_metrics.queue_us.load()},
+        {"lac_batch_run_time_us_total", "counter", this->_metrics.run_us.load()},
+        {"lac_queue_depth", "gauge", (uint64_t)queue_depth()},
+        {"lac_pool_sessions", "gauge", (uint64_t)this->_pool.size()},
+        {"lac_pool_idle_sessions", "gauge", (uint64_t)this->_pool.idle()},
+        {"lac_pool_reserved_sessions", "gauge", (uint64_t)this->_pool.reserved()},
+    };
+    for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); ++i)
+    {
+        int len = snprintf(buf, sizeof(buf), "# TYPE %s %s\n%s %llu\n",
+                           items[i].name, items[i].type, items[i].name, (unsigned long long)items[i].value);
+        out.append(buf, len);
+    }
+
+    const char *class_items[][2] = {
+        {"lac_class_requests_total", "counter"},
+        {"lac_class_requests_completed_total", "counter"},
+        {"lac_class_batches_total", "counter"},
+        {"lac_class_queue_time_us_total", "counter"},
+        {"lac_class_queue_depth", "gauge"},
+        {"lac_class_batch_run_time_estimate_us", "gauge"},
+    };
+    for (size_t i = 0; i < sizeof(class_items) / sizeof(class_items[0]); ++i)
+    {
+        int len = snprintf(buf, sizeof(buf), "# TYPE %s %s\n", class_items[i][0], class_items[i][1]);
+        out.append(buf, len);
+        for (int cls = 0; cls < CLASS_NUM; ++cls)
+        {
+            const ClassMetrics &class_metrics = this->_metrics.classes[cls];
+            uint64_t values[] = {
+                class_metrics.requests.load(),
+                class_metrics.completed.load(),
+                class_metrics.batches.load(),
+                class_metrics.queue_us.load(),
+                (uint64_t)queue_depth((TRAFFIC_CLASS)cls),
+                (uint64_t)estimate_us((TRAFFIC_CLASS)cls),
+            };
+            len = snprintf(buf, sizeof(buf), "%s{class=\"%s\"} %llu\n", class_items[i][0],
+                           traffic_class_name((TRAFFIC_CLASS)cls), (unsigned long long)values[i]);
+            out.append(buf, len);
+        }
+    }
+}
+
+bool parse_lac_mode(const std::string &name, LAC_MODE &mode)
+{
+    if (name == "lac")
+    {
+        mode = MODE_LAC;
+    }
+    else if (name == "rank")
+    {
+        mode = MODE_RANK;
+    }
+    else if (name == "keyword")
+    {
+        mode = MODE_KEYWORD;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char *lac_mode_name(LAC_MODE mode)
+{
+    switch (mode)
+    {
+    case MODE_RANK:
+        return "rank";
+    case MODE_KEYWORD:
+        return "keyword";
+    default:
+        return "lac";
+    }
+}
+
+const char *lac_path_name(LAC_PATH path)
+{
+    return path == PATH_FALLBACK ? "fallback" : "model";
+}
+
+bool parse_traffic_class(const std::string &name, TRAFFIC_CLASS &cls)
+{
+    if (name == "interactive")
+    {
+        cls = CLASS_INTERACTIVE;
+    }
+    else if (name == "bulk")
+    {
+        cls = CLASS_BULK;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char *traffic_class_name(TRAFFIC_CLASS cls)
+{
+    return cls == CLASS_BULK ? "bulk" : "interactive";
+}
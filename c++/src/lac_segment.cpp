@@ -0,0 +1,276 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "lac_segment.h"
+#include "lac_custom.h"
+
+Segment::Segment(const std::string &dict_path, CODE_TYPE codetype)
+    : _nodes(1),
+      _tags(1),
+      _total(0),
+      _log_total(0),
+      _codetype(codetype)
+{
+    load_dict(dict_path);
+}
+
+RVAL Segment::load_dict(const std::string &dict_path)
+{
+    std::ifstream fin(dict_path.c_str());
+    if (!fin)
+    {
+        std::cerr << "Load segment dic failed ! -- " << dict_path << " not exist" << std::endl;
+        return _FAILD;
+    }
+
+    std::unordered_map<std::string, int> tag_ids;
+    for (size_t i = 0; i < this->_tags.size(); ++i)
+    {
+        tag_ids[this->_tags[i]] = i;
+    }
+
+    std::string line;
+    std::vector<std::string> tokens;
+    std::vector<std::string> chars;
+    while (getline(fin, line))
+    {
+        if (!line.empty() && line[line.length() - 1] == '\r')
+        {
+            line.resize(line.length() - 1);
+        }
+        if (line.empty() || split_tokens(line, " ", tokens) < _SUCCESS || tokens.size() < 2)
+        {
+            continue;
+        }
+        int64_t count = atoll(tokens[1].c_str());
+        if (count <= 0 || split_words(tokens[0], this->_codetype, chars) < _SUCCESS || chars.empty())
+        {
+            continue;
+        }
+        this->_total += count;
+
+        // 逐字插入前缀树
+        int node = 0;
+        for (size_t i = 0; i < chars.size(); ++i)
+        {
+            auto id_iter = this->_char_ids.find(chars[i]);
+            int char_id = this->_char_ids.size();
+            if (id_iter == this->_char_ids.end())
+            {
+                this->_char_ids[chars[i]] = char_id;
+            }
+            else
+            {
+                char_id = id_iter->second;
+            }
+
+            int next = child(node, char_id);
+            if (next < 0)
+            {
+                next = this->_nodes.size();
+                this->_nodes.push_back(TrieNode());
+                this->_edges[((uint64_t)node << 32) | (uint32_t)char_id] = next;
+            }
+            node = next;
+        }
+
+        int tag = 0;
+        if (tokens.size() > 2 && !tokens[2].empty())
+        {
+            auto tag_iter = tag_ids.find(tokens[2]);
+            if (tag_iter == tag_ids.end())
+            {
+                tag = this->_tags.size();
+                tag_ids[tokens[2]] = tag;
+                this->_tags.push_back(tokens[2]);
+            }
+            else
+            {
+                tag = tag_iter->second;
+            }
+        }
+        this->_nodes[node].count = count;
+        this->_nodes[node].tag = tag;
+    }
+    this->_log_total = this->_total > 0 ? std::log((double)this->_total) : 0;
+
+    std::cerr << "Loaded segment dic -- num = " << word_count() << std::endl;
+    return _SUCCESS;
+}
+
+size_t Segment::word_count() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < this->_nodes.size(); ++i)
+    {
+        if (this->_nodes[i].count > 0)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static bool is_single_alnum(const std::string &ch)
+{
+    return ch.length() == 1 && isalnum((unsigned char)ch[0]);
+}
+
+/* 由后向前动态规划，route[i]为从第i个字开始的最大对数概率及第一个词的末字下标 */
+RVAL Segment::cut(const std::vector<std::string> &chars, std::vector<std::string> &labels,
+                  std::vector<int> &char_ids, std::vector<std::pair<double, int>> &route) const
+{
+    size_t length = chars.size();
+    char_ids.resize(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        auto it = this->_char_ids.find(chars[i]);
+        char_ids[i] = it == this->_char_ids.end() ? -1 : it->second;
+    }
+
+    route.resize(length + 1);
+    route[length] = std::make_pair(0.0, 0);
+    for (size_t i = length; i-- > 0;)
+    {
+        // 单字总是候选，词典中没有的字词频按1计算
+        route[i] = std::make_pair(-this->_log_total + route[i + 1].first, (int)i);
+        int node = 0;
+        for (size_t j = i; j < length && char_ids[j] >= 0; ++j)
+        {
+            node = child(node, char_ids[j]);
+            if (node < 0)
+            {
+                break;
+            }
+            if (this->_nodes[node].count > 0)
+            {
+                double prob = std::log((double)this->_nodes[node].count) - this->_log_total + route[j + 1].first;
+                if (prob >= route[i].first)
+                {
+                    route[i] = std::make_pair(prob, (int)j);
+                }
+            }
+        }
+    }
+
+    labels.resize(length);
+    size_t begin = 0;
+    while (begin < length)
+    {
+        size_t end = route[begin].second + 1;
+        const std::string *tag = &this->_tags[0];
+        if (end == begin + 1 && is_single_alnum(chars[begin]))
+        {
+            // 合并连续的单个字母或数字
+            while (end < length && route[end].second == (int)end && is_single_alnum(chars[end]))
+            {
+                ++end;
+            }
+        }
+        else if (end > begin + 1 || char_ids[begin] >= 0)
+        {
+            int node = 0;
+            for (size_t j = begin; j < end && node >= 0; ++j)
+            {
+                node = child(node, char_ids[j]);
+            }
+            if (node >= 0)
+            {
+                tag = &this->_tags[this->_nodes[node].tag];
+            }
+        }
+        for (size_t j = begin; j < end; ++j)
+        {
+            labels[j].assign(*tag).append(j == begin ? "-B" : "-I");
+        }
+        begin = end;
+    }
+    return _SUCCESS;
+}
+
+void SegmentSession::sync_tags(const std::vector<std::string> &tag_names)
+{
+    for (; this->_tag_count < tag_names.size(); ++this->_tag_count)
+    {
+        const std::string &tag = tag_names[this->_tag_count];
+        this->_label_tag_ids.insert(std::make_pair(tag + "-B", (int)this->_tag_count));
+        this->_label_tag_ids.insert(std::make_pair(tag + "-I", (int)this->_tag_count));
+    }
+}
+
+int SegmentSession::run(const std::vector<std::string> &querys, const CustomizationLayers *layers,
+                        const RunOptions &options, std::vector<std::vector<OutputItem>> &results)
+{
+    results.resize(querys.size());
+    for (size_t i = 0; i < querys.size(); ++i)
+    {
+        split_words(querys[i], this->_segment->codetype(), this->_chars);
+        this->_segment->cut(this->_chars, this->_labels, this->_char_ids, this->_route);
+        if (layers)
+        {
+            char_codes(this->_chars, this->_char_codes);
+        }
+        for (size_t k = 0; layers && k < layers->size(); ++k)
+        {
+            (*layers)[k]->parse_customization(this->_char_codes, this->_labels, this->_ac_res);
+        }
+        append_words(options, results[i]);
+    }
+    return 0;
+}
+
+/* 同LAC::parse_targets由标签切分出词，词首标签的词性未通过tag_filter时整个词跳过
+ * result中已有的OutputItem会被复用 */
+void SegmentSession::append_words(const RunOptions &options, std::vector<OutputItem> &result) const
+{
+    size_t count = 0;
+    int offset = 0;
+    bool keep = false;
+    for (size_t i = 0; i < this->_labels.size(); ++i)
+    {
+        const std::string &label = this->_labels[i];
+        const std::string &word = this->_chars[i];
+        if (i == 0 || label.rfind("B") == label.length() - 1 || label.rfind("S") == label.length() - 1)
+        {
+            keep = options.tag_filter.empty() || options.keep(label_tag_id(label));
+            if (keep)
+            {
+                if (count == result.size())
+                {
+                    result.push_back(OutputItem());
+                }
+                OutputItem &item = result[count++];
+                item.word.assign(word);
+                item.tag.assign(label, 0, label.length() - 2);
+                item.rank = 0;
+                item.offset = offset;
+                item.length = word.length();
+            }
+        }
+        else if (keep)
+        {
+            result[count - 1].word += word;
+            result[count - 1].length += word.length();
+        }
+        offset += word.length();
+    }
+    result.resize(count);
+}
@@ -0,0 +1,742 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "lac_shm.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+/* 共享内存中的futex需跨进程，不能使用FUTEX_PRIVATE */
+static int futex_wait(std::atomic<uint32_t> *addr, uint32_t value, int timeout_ms)
+{
+    struct timespec ts;
+    struct timespec *pts = NULL;
+    if (timeout_ms > 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        pts = &ts;
+    }
+    return syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, value, pts, NULL, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t> *addr, int count)
+{
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+static const int64_t RECLAIM_INTERVAL_US = 100 * 1000;  // 检查租约的间隔
+static const int64_t CLAIM_GRACE_US = 1000 * 1000;      // 取得位置后登记进程号的宽限时间
+
+static size_t align_up(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* 结果区在请求文本之后，按8字节对齐 */
+static size_t spans_offset(uint32_t query_count, uint32_t text_bytes)
+{
+    return align_up((query_count + 1) * sizeof(uint32_t) + text_bytes, 8);
+}
+
+LACShmServer::LACShmServer(LACPool &pool, const LACShmConfig &config)
+    : _pool(pool),
+      _config(config),
+      _header(NULL),
+      _size(0),
+      _stop(false),
+      _requests(0),
+      _batches(0),
+      _reclaimed(0),
+      _last_reclaim_us(0),
+      _stalled_pos(0),
+      _stalled_since_us(0)
+{
+    // 槽位数取2的幂
+    uint32_t count = 1;
+    while (count < this->_config.slot_count)
+    {
+        count <<= 1;
+    }
+    this->_config.slot_count = count;
+    // 结果区按8字节对齐，数据区大小同样取8的倍数，结果区起点不会越过数据区末尾
+    this->_config.slot_bytes = align_up(this->_config.slot_bytes, 8);
+    if (this->_config.max_batch == 0)
+    {
+        this->_config.max_batch = 1;
+    }
+}
+
+LACShmServer::~LACShmServer()
+{
+    stop();
+}
+
+LACShmSlot *LACShmServer::slot(uint64_t pos)
+{
+    return (LACShmSlot *)((char *)(this->_header + 1) +
+                          (pos & (this->_header->slot_count - 1)) * this->_header->slot_stride);
+}
+
+int LACShmServer::start(const std::string &name, const std::vector<std::string> &tag_names, size_t num_workers)
+{
+    size_t stride = align_up(sizeof(LACShmSlot) + this->_config.slot_bytes, 64);
+    this->_size = sizeof(LACShmHeader) + stride * this->_config.slot_count;
+
+    // 不复用已存在的对象：其属主和权限可能不是本进程设置的，截断也会破坏仍在使用它的进程
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, this->_config.file_mode);
+    if (fd < 0 && errno == EEXIST && shm_unlink(name.c_str()) == 0)
+    {
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, this->_config.file_mode);
+    }
+    if (fd < 0)
+    {
+        std::cerr << "shm_open " << name << " failed: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    // shm_open的权限受umask影响，按配置重新设置
+    if (fchmod(fd, this->_config.file_mode) != 0 || ftruncate(fd, this->_size) != 0)
+    {
+        std::cerr << "ftruncate " << name << " failed: " << strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return -1;
+    }
+    void *addr = mmap(NULL, this->_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        std::cerr << "mmap " << name << " failed: " << strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return -1;
+    }
+    this->_name = name;
+    this->_header = (LACShmHeader *)addr;
+
+    // 初始化头部和槽位，magic最后写入，客户端据此判断共享内存是否可用
+    LACShmHeader *header = this->_header;
+    header->version = LAC_SHM_VERSION;
+    header->slot_count = this->_config.slot_count;
+    header->slot_bytes = this->_config.slot_bytes;
+    header->slot_stride = stride;
+    header->rank_enabled = this->_pool.rank_enabled() ? 1 : 0;
+    header->spin_us = this->_config.spin_us;
+    header->block = this->_config.block ? 1 : 0;
+    header->head.store(0);
+    header->tail.store(0);
+    header->server_seq.store(0);
+    header->server_waiters.store(0);
+
+    size_t tag_bytes = 0;
+    header->tag_count = 0;
+    for (size_t i = 0; i < tag_names.size(); ++i)
+    {
+        if (tag_bytes + tag_names[i].length() + 1 > LAC_SHM_TAG_BYTES)
+        {
+            std::cerr << "Too many tags for shared memory, keep " << i << std::endl;
+            break;
+        }
+        memcpy(header->tags + tag_bytes, tag_names[i].c_str(), tag_names[i].length() + 1);
+        tag_bytes += tag_names[i].length() + 1;
+        header->tag_count++;
+    }
+
+    for (uint32_t i = 0; i < header->slot_count; ++i)
+    {
+        LACShmSlot *s = slot(i);
+        s->seq.store(i);
+        s->state.store(SLOT_EMPTY);
+        s->waiting.store(0);
+        s->owner.store(0);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = LAC_SHM_MAGIC;
+
+    if (num_workers == 0)
+    {
+        num_workers = this->_pool.size();
+    }
+    for (size_t i = 0; i < num_workers; ++i)
+    {
+        this->_workers.push_back(std::thread(&LACShmServer::worker_loop, this));
+    }
+    return 0;
+}
+
+void LACShmServer::stop()
+{
+    if (this->_header == NULL)
+    {
+        return;
+    }
+    this->_stop = true;
+    this->_header->server_seq.fetch_add(1);
+    futex_wake(&this->_header->server_seq, (int)this->_workers.size());
+    for (size_t i = 0; i < this->_workers.size(); ++i)
+    {
+        this->_workers[i].join();
+    }
+    this->_workers.clear();
+
+    this->_header->magic = 0;
+    munmap(this->_header, this->_size);
+    shm_unlink(this->_name.c_str());
+    this->_header = NULL;
+}
+
+/* 从tail开始取出连续的已提交槽位，最多max_batch个 */
+size_t LACShmServer::take_batch(uint64_t &first)
+{
+    LACShmHeader *header = this->_header;
+    while (true)
+    {
+        uint64_t pos = header->tail.load(std::memory_order_relaxed);
+        size_t count = 0;
+        while (count < this->_config.max_batch &&
+               slot(pos + count)->seq.load(std::memory_order_acquire) == pos + count + 1)
+        {
+            ++count;
+        }
+        if (count == 0)
+        {
+            return 0;
+        }
+        if (header->tail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+        {
+            first = pos;
+            return count;
+        }
+    }
+}
+
+/* 先自旋spin_us，再在server_seq上futex等待，超时后返回以便检查停止标志 */
+void LACShmServer::wait_requests()
+{
+    LACShmHeader *header = this->_header;
+    int64_t spin_end = now_us() + this->_config.spin_us;
+    while (now_us() < spin_end)
+    {
+        uint64_t pos = header->tail.load(std::memory_order_relaxed);
+        if (slot(pos)->seq.load(std::memory_order_acquire) == pos + 1 || this->_stop)
+        {
+            return;
+        }
+    }
+    if (!this->_config.block)
+    {
+        std::this_thread::yield();
+        return;
+    }
+
+    header->server_waiters.fetch_add(1);
+    uint32_t seq = header->server_seq.load();
+    uint64_t pos = header->tail.load();
+    if (slot(pos)->seq.load() != pos + 1 && !this->_stop)
+    {
+        futex_wait(&header->server_seq, seq, 100);
+    }
+    header->server_waiters.fetch_sub(1);
+}
+
+void LACShmServer::worker_loop()
+{
+    std::vector<SlotRequest> lac_requests;
+    std::vector<SlotRequest> rank_requests;
+    std::vector<uint32_t> offsets;
+    std::vector<const char *> texts;
+    std::vector<int> lens;
+    std::vector<WordSpan> spans;
+    std::vector<size_t> span_lod;
+
+    while (!this->_stop)
+    {
+        reclaim_slots();
+        uint64_t first = 0;
+        size_t count = take_batch(first);
+        if (count == 0)
+        {
+            wait_requests();
+            continue;
+        }
+
+        // 格式错误的请求直接返回，其余按是否需要rank模型分组
+        lac_requests.clear();
+        rank_requests.clear();
+        offsets.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            LACShmSlot *s = slot(first + i);
+            SlotRequest request;
+            int status = read_request(s, request, offsets);
+            if (status == SHM_OK && request.mode != MODE_LAC && !this->_pool.rank_enabled())
+            {
+                status = SHM_UNSUPPORTED;
+            }
+            if (status != SHM_OK)
+            {
+                s->status = status;
+                s->span_count = 0;
+                continue;
+            }
+            (request.mode == MODE_LAC ? lac_requests : rank_requests).push_back(request);
+        }
+
+        {
+            LACPoolGuard lac(this->_pool);
+            if (!lac_requests.empty())
+            {
+                run_slots(*lac, lac_requests, false, offsets, texts, lens, spans, span_lod);
+            }
+            if (!rank_requests.empty())
+            {
+                run_slots(*lac, rank_requests, true, offsets, texts, lens, spans, span_lod);
+            }
+        }
+
+        this->_requests += count;
+        this->_batches++;
+        for (size_t i = 0; i < count; ++i)
+        {
+            complete(slot(first + i), first + i);
+        }
+    }
+}
+
+/* 槽位可被客户端随时改写，长度和偏移只读取一次，之后只使用复制出的值 */
+int LACShmServer::read_request(LACShmSlot *s, SlotRequest &request, std::vector<uint32_t> &offsets)
+{
+    request.slot = s;
+    request.mode = s->mode;
+    request.query_count = s->query_count;
+    request.text_bytes = s->text_bytes;
+    request.offsets = offsets.size();
+    uint64_t request_bytes = ((uint64_t)request.query_count + 1) * sizeof(uint32_t) + request.text_bytes;
+    if (request.mode > MODE_KEYWORD || request_bytes > this->_config.slot_bytes)
+    {
+        return SHM_INVALID;
+    }
+    const uint32_t *shared = (const uint32_t *)slot_data(s);
+    offsets.insert(offsets.end(), shared, shared + request.query_count + 1);
+    const uint32_t *copy = &offsets[request.offsets];
+    bool valid = copy[0] == 0 && copy[request.query_count] == request.text_bytes;
+    for (uint32_t i = 0; valid && i < request.query_count; ++i)
+    {
+        valid = copy[i] <= copy[i + 1];
+    }
+    if (!valid)
+    {
+        offsets.resize(request.offsets);
+        return SHM_INVALID;
+    }
+    return SHM_OK;
+}
+
+/* 文本直接指向共享内存，结果写回各自的槽位 */
+void LACShmServer::run_slots(LAC &lac, const std::vector<SlotRequest> &requests, bool rank,
+                             const std::vector<uint32_t> &offsets, std::vector<const char *> &texts,
+                             std::vector<int> &lens, std::vector<WordSpan> &spans, std::vector<size_t> &span_lod)
+{
+    texts.clear();
+    lens.clear();
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        const SlotRequest &request = requests[i];
+        const uint32_t *query_offsets = &offsets[request.offsets];
+        const char *text = slot_data(request.slot) + (request.query_count + 1) * sizeof(uint32_t);
+        for (uint32_t j = 0; j < request.query_count; ++j)
+        {
+            texts.push_back(text + query_offsets[j]);
+            lens.push_back(query_offsets[j + 1] - query_offsets[j]);
+        }
+    }
+
+    if (rank)
+    {
+        lac.run_rank_offsets(texts.data(), lens.data(), texts.size(), spans, span_lod);
+    }
+    else
+    {
+        lac.run_offsets(texts.data(), lens.data(), texts.size(), spans, span_lod);
+    }
+
+    size_t query_index = 0;
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        const SlotRequest &request = requests[i];
+        LACShmSlot *s = request.slot;
+        size_t out_offset = spans_offset(request.query_count, request.text_bytes);
+        WordSpan *out = (WordSpan *)(slot_data(s) + out_offset);
+
+        // 先按上限估算，keyword模式过滤后可能更少
+        size_t max_words = span_lod[query_index + request.query_count] - span_lod[query_index];
+        if (out_offset > this->_config.slot_bytes ||
+            max_words * sizeof(WordSpan) + (request.query_count + 1) * sizeof(uint32_t) >
+                this->_config.slot_bytes - out_offset)
+        {
+            s->status = SHM_TOO_LARGE;
+            s->span_count = 0;
+            query_index += request.query_count;
+            continue;
+        }
+
+        uint32_t *out_lod = (uint32_t *)(out + max_words);
+        uint32_t count = 0;
+        out_lod[0] = 0;
+        for (uint32_t j = 0; j < request.query_count; ++j, ++query_index)
+        {
+            for (size_t k = span_lod[query_index]; k < span_lod[query_index + 1]; ++k)
+            {
+                if (request.mode == MODE_KEYWORD && spans[k].rank < this->_config.keyword_min_rank)
+                {
+                    continue;
+                }
+                out[count++] = spans[k];
+            }
+            out_lod[j + 1] = count;
+        }
+        // 过滤后span_lod紧随spans之后
+        if (count < max_words)
+        {
+            memmove((char *)(out + count), out_lod, (request.query_count + 1) * sizeof(uint32_t));
+        }
+        s->span_count = count;
+        s->status = SHM_OK;
+    }
+}
+
+/* 客户端已超时放弃时由守护进程回收槽位 */
+void LACShmServer::complete(LACShmSlot *s, uint64_t pos)
+{
+    uint32_t expected = SLOT_QUEUED;
+    if (!s->state.compare_exchange_strong(expected, SLOT_DONE))
+    {
+        s->state.store(SLOT_EMPTY);
+        s->owner.store(0);
+        s->seq.store(pos + this->_header->slot_count, std::memory_order_release);
+        return;
+    }
+    if (s->waiting.load())
+    {
+        futex_wake(&s->state, 1);
+    }
+}
+
+/* 进程是否存在，无权发送信号(EPERM)时也视为存在 */
+static bool process_alive(uint32_t pid)
+{
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+}
+
+void LACShmServer::reclaim_slots()
+{
+    int64_t now = now_us();
+    std::unique_lock<std::mutex> lock(this->_reclaim_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || now - this->_last_reclaim_us < RECLAIM_INTERVAL_US)
+    {
+        return;
+    }
+    this->_last_reclaim_us = now;
+    LACShmHeader *header = this->_header;
+    uint64_t slot_count = header->slot_count;
+
+    // 队首的位置已被取得但迟迟未提交：进程已退出，或取得位置后宽限时间内仍未登记进程号
+    uint64_t pos = header->tail.load();
+    LACShmSlot *s = slot(pos);
+    if (header->head.load() > pos && s->seq.load(std::memory_order_acquire) == pos)
+    {
+        uint32_t owner = s->owner.load();
+        if (owner == 0 && pos != this->_stalled_pos)
+        {
+            this->_stalled_pos = pos;
+            this->_stalled_since_us = now;
+        }
+        bool expired = owner != 0 ? !process_alive(owner) : now - this->_stalled_since_us >= CLAIM_GRACE_US;
+        if (expired && header->tail.compare_exchange_strong(pos, pos + 1))
+        {
+            s->state.store(SLOT_EMPTY);
+            s->owner.store(0);
+            s->seq.store(pos + slot_count, std::memory_order_release);
+            this->_reclaimed++;
+        }
+    }
+
+    // 已完成但客户端已退出、不会再归还的槽位，提交时seq为位置加一
+    // 前后两次读到相同的seq说明其间没有归还，owner和state属于同一轮
+    for (uint64_t i = 0; i < slot_count; ++i)
+    {
+        s = slot(i);
+        uint64_t seq = s->seq.load();
+        uint32_t owner = s->owner.load();
+        if (s->state.load() != SLOT_DONE || owner == 0 || process_alive(owner) || s->seq.load() != seq)
+        {
+            continue;
+        }
+        uint32_t expected = SLOT_DONE;
+        if (s->state.compare_exchange_strong(expected, SLOT_EMPTY))
+        {
+            s->owner.store(0);
+            s->seq.store(seq - 1 + slot_count, std::memory_order_release);
+            this->_reclaimed++;
+        }
+    }
+}
+
+LACShmClient::LACShmClient(const LACShmConfig &config)
+    : _config(config),
+      _header(NULL),
+      _size(0)
+{
+}
+
+LACShmClient::~LACShmClient()
+{
+    disconnect();
+}
+
+LACShmSlot *LACShmClient::slot(uint64_t pos)
+{
+    return (LACShmSlot *)((char *)(this->_header + 1) +
+                          (pos & (this->_header->slot_count - 1)) * this->_header->slot_stride);
+}
+
+int LACShmClient::connect(const std::string &name)
+{
+    disconnect();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        std::cerr << "shm_open " << name << " failed: " << strerror(errno) << std::endl;
+        return SHM_NOT_CONNECTED;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LACShmHeader))
+    {
+        close(fd);
+        return SHM_NOT_CONNECTED;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        return SHM_NOT_CONNECTED;
+    }
+    this->_header = (LACShmHeader *)addr;
+    this->_size = st.st_size;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->_header->magic != LAC_SHM_MAGIC || this->_header->version != LAC_SHM_VERSION ||
+        sizeof(LACShmHeader) + (size_t)this->_header->slot_stride * this->_header->slot_count > this->_size)
+    {
+        std::cerr << name << " is not a LAC shared memory" << std::endl;
+        disconnect();
+        return SHM_NOT_CONNECTED;
+    }
+
+    if (this->_config.spin_us < 0)
+    {
+        this->_config.spin_us = this->_header->spin_us;
+        this->_config.block = this->_header->block != 0;
+    }
+    this->_tag_names.clear();
+    const char *tag = this->_header->tags;
+    for (uint32_t i = 0; i < this->_header->tag_count; ++i)
+    {
+        this->_tag_names.push_back(tag);
+        tag += this->_tag_names.back().length() + 1;
+    }
+    return SHM_OK;
+}
+
+void LACShmClient::disconnect()
+{
+    if (this->_header != NULL)
+    {
+        munmap(this->_header, this->_size);
+        this->_header = NULL;
+        this->_size = 0;
+    }
+}
+
+int LACShmClient::run(const std::vector<std::string> &querys, LAC_MODE mode, LACShmResult &result)
+{
+    std::vector<const char *> texts(querys.size());
+    std::vector<int> lens(querys.size());
+    for (size_t i = 0; i < querys.size(); ++i)
+    {
+        texts[i] = querys[i].c_str();
+        lens[i] = querys[i].length();
+    }
+    return run(texts.data(), lens.data(), querys.size(), mode, result);
+}
+
+int LACShmClient::run(const char *const *texts, const int *lens, size_t count, LAC_MODE mode, LACShmResult &result)
+{
+    LACShmHeader *header = this->_header;
+    if (header == NULL || header->magic != LAC_SHM_MAGIC)
+    {
+        return SHM_NOT_CONNECTED;
+    }
+    size_t text_bytes = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        text_bytes += lens[i];
+    }
+    if (spans_offset(count, text_bytes) + (count + 1) * sizeof(uint32_t) > header->slot_bytes)
+    {
+        return SHM_TOO_LARGE;
+    }
+
+    // 取得一个位置；队列已满时等待守护进程处理
+    int64_t deadline = this->_config.timeout_ms > 0 ? now_us() + this->_config.timeout_ms * 1000LL : 0;
+    uint64_t pos = header->head.load(std::memory_order_relaxed);
+    LACShmSlot *s = NULL;
+    while (true)
+    {
+        s = slot(pos);
+        uint64_t seq = s->seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0)
+        {
+            if (header->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                // 登记租约，进程退出后守护进程据此回收槽位
+                s->owner.store(getpid());
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            if (deadline > 0 && now_us() > deadline)
+            {
+                return SHM_TIMEOUT;
+            }
+            std::this_thread::yield();
+            pos = header->head.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            pos = header->head.load(std::memory_order_relaxed);
+        }
+    }
+
+    // 直接写入槽位
+    uint32_t *offsets = (uint32_t *)(s + 1);
+    char *text = (char *)(offsets + count + 1);
+    uint32_t offset = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        offsets[i] = offset;
+        memcpy(text + offset, texts[i], lens[i]);
+        offset += lens[i];
+    }
+    offsets[count] = offset;
+    s->mode = mode;
+    s->query_count = count;
+    s->text_bytes = text_bytes;
+    s->span_count = 0;
+    s->waiting.store(0);
+    s->state.store(SLOT_QUEUED);
+    s->seq.store(pos + 1, std::memory_order_release);
+
+    header->server_seq.fetch_add(1);
+    if (header->server_waiters.load() > 0)
+    {
+        futex_wake(&header->server_seq, 1);
+    }
+
+    // 先自旋，再在槽位状态上futex等待
+    int64_t spin_end = now_us() + this->_config.spin_us;
+    while (s->state.load(std::memory_order_acquire) != SLOT_DONE && now_us() < spin_end)
+    {
+    }
+    while (s->state.load(std::memory_order_acquire) != SLOT_DONE)
+    {
+        int wait_ms = 100;
+        if (deadline > 0)
+        {
+            int64_t left = deadline - now_us();
+            if (left <= 0)
+            {
+                // 超时放弃，守护进程完成后回收槽位；若恰好已完成则照常返回
+                uint32_t expected = SLOT_QUEUED;
+                if (s->state.compare_exchange_strong(expected, SLOT_ABANDONED))
+                {
+                    return SHM_TIMEOUT;
+                }
+                break;
+            }
+            wait_ms = left / 1000 + 1;
+        }
+        if (this->_config.block)
+        {
+            s->waiting.store(1);
+            if (s->state.load() == SLOT_QUEUED)
+            {
+                futex_wait(&s->state, SLOT_QUEUED, wait_ms);
+            }
+            s->waiting.store(0);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    result.slot = s;
+    result.ticket = pos;
+    result.query_count = count;
+    result.spans = (const WordSpan *)((char *)(s + 1) + spans_offset(count, text_bytes));
+    result.span_lod = (const uint32_t *)(result.spans + s->span_count);
+    if (s->status != SHM_OK)
+    {
+        int status = s->status;
+        release(result);
+        return status;
+    }
+    return SHM_OK;
+}
+
+void LACShmClient::release(LACShmResult &result)
+{
+    if (result.slot == NULL)
+    {
+        return;
+    }
+    result.slot->state.store(SLOT_EMPTY);
+    result.slot->owner.store(0);
+    result.slot->seq.store(result.ticket + this->_header->slot_count, std::memory_order_release);
+    result.slot = NULL;
+    result.spans = NULL;
+    result.span_lod = NULL;
+}
+
+#endif  // __linux__
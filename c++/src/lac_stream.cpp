@@ -0,0 +1,110 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "lac_stream.h"
+#include "lac_util.h"
+
+LACStream::LACStream(LAC &lac, bool rank, size_t max_pending)
+    : _lac(lac),
+      _rank(rank),
+      _max_pending(max_pending)
+{
+}
+
+/* 追加文本分片，句子一结束即进行分析 */
+int LACStream::push(const std::string &fragment)
+{
+    this->_pending.append(fragment);
+
+    size_t begin = 0;
+    while (begin < this->_pending.size())
+    {
+        const char *p = this->_pending.c_str() + begin;
+        int len = this->_pending.size() - begin;
+        int end = get_sentence_end(p, len, this->_lac.codetype());
+
+        // 长时间没有句末标点(如无标点的ASR结果)，在字边界处强制切分
+        if (end == 0 && (size_t)len > this->_max_pending)
+        {
+            int char_len = 0;
+            while ((size_t)(end + char_len) <= this->_max_pending)
+            {
+                end += char_len;
+                char_len = get_next_word(p + end, len - end, this->_lac.codetype());
+            }
+            end = end > 0 ? end : char_len;
+        }
+        // 句子恰好结束在已到达文本的末尾时，下一个分片可能以闭合引号、括号开头，保留到下次push或flush
+        if (end == 0 || end == len)
+        {
+            break;
+        }
+        this->_sentences.push_back(std::string(p, end));
+        begin += end;
+    }
+    this->_pending.erase(0, begin);
+    return analyze();
+}
+
+/* 取出已分析完成的结果 */
+std::vector<std::vector<OutputItem>> LACStream::poll()
+{
+    std::vector<std::vector<OutputItem>> results;
+    results.swap(this->_ready);
+    return results;
+}
+
+/* 将未结束的句子作为完整句子分析 */
+int LACStream::flush()
+{
+    if (!this->_pending.empty())
+    {
+        this->_sentences.push_back(this->_pending);
+        this->_pending.clear();
+    }
+    return analyze();
+}
+
+void LACStream::reset()
+{
+    this->_pending.clear();
+    this->_sentences.clear();
+    this->_ready.clear();
+}
+
+/* 同一次push中结束的多个句子合并为一个batch分析 */
+int LACStream::analyze()
+{
+    int sentence_num = this->_sentences.size();
+    if (sentence_num == 0)
+    {
+        return 0;
+    }
+
+    if (this->_rank)
+    {
+        this->_lac.run_rank(this->_sentences, this->_results_batch);
+    }
+    else
+    {
+        this->_lac.run(this->_sentences, this->_results_batch);
+    }
+    for (size_t i = 0; i < this->_results_batch.size(); ++i)
+    {
+        this->_ready.push_back(std::vector<OutputItem>());
+        this->_ready.back().swap(this->_results_batch[i]);
+    }
+    this->_sentences.clear();
+    return sentence_num;
+}
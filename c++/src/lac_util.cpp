@@ -12,6 +12,10 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License. */
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
 #include "lac_util.h"
 
 /* 以pattern作为切割符，对line进行切分并放入tokens中 */
@@ -127,20 +131,24 @@ RVAL load_id2label_dict(const std::string &filepath,
     return _SUCCESS;
 }
 
-/* 获取下一个gb18030字符的长度 */
-int get_next_gb18030(const char *str)
+/* 获取下一个gb18030字符的长度，只读取str起始的len字节，字符不完整或不合法时返回0 */
+int get_next_gb18030(const char *str, int len)
 {
     unsigned char *str_in = (unsigned char *)str;
+    if (len <= 0)
+    {
+        return 0;
+    }
     if (str_in[0] < 0x80)
     {
         return 1;
     }
-    if (str_in[0] >= 0x81 && str_in[0] <= 0xfe &&
+    if (len >= 2 && str_in[0] >= 0x81 && str_in[0] <= 0xfe &&
         str_in[1] >= 0x40 && str_in[1] <= 0xFE && str_in[1] != 0x7F)
     {
         return 2;
     }
-    if (str_in[0] >= 0x81 && str_in[0] <= 0xfe &&
+    if (len >= 4 && str_in[0] >= 0x81 && str_in[0] <= 0xfe &&
         str_in[1] >= 0x30 && str_in[1] <= 0x39 &&
         str_in[2] >= 0x81 && str_in[2] <= 0xfe &&
         str_in[3] >= 0x30 && str_in[3] <= 0x39)
@@ -150,25 +158,29 @@ int get_next_gb18030(const char *str)
     return 0;
 }
 
-/* 获取下一个UTF8字符的长度 */
-int get_next_utf8(const char *str)
+/* 获取下一个UTF8字符的长度，只读取str起始的len字节，字符不完整或不合法时返回0 */
+int get_next_utf8(const char *str, int len)
 {
     unsigned char *str_in = (unsigned char *)str;
+    if (len <= 0)
+    {
+        return 0;
+    }
     if (str_in[0] < 0x80)
     {
         return 1;
     }
-    if (str_in[0] >= 0xC2 && str_in[0] < 0xE0 &&
+    if (len >= 2 && str_in[0] >= 0xC2 && str_in[0] < 0xE0 &&
         str_in[1] >> 6 == 2)
     {
         return 2;
     }
-    if (str_in[0] >> 4 == 14 && str_in[1] >> 6 == 2 &&
+    if (len >= 3 && str_in[0] >> 4 == 14 && str_in[1] >> 6 == 2 &&
         str_in[2] >> 6 == 2 && (str_in[0] > 0xE0 || str_in[1] >= 0xA0))
     {
         return 3;
     }
-    if (str_in[0] >> 3 == 30 && str_in[1] >> 6 == 2 && str_in[2] >> 6 == 2 &&
+    if (len >= 4 && str_in[0] >> 3 == 30 && str_in[1] >> 6 == 2 && str_in[2] >> 6 == 2 &&
         str_in[3] >> 6 == 2 && str_in[0] <= 0xF4 && (str_in[0] > 0xF0 || str_in[1] >= 0x90))
     {
         return 4;
@@ -176,40 +188,120 @@ int get_next_utf8(const char *str)
     return 0;
 }
 
-/* 获取下一个codetype字符的长度 */
-int get_next_word(const char *str, CODE_TYPE codetype)
+/* 以\0结尾的字符串：\0不满足后续字节的条件，判断在\0处停止，不会越界读取 */
+int get_next_gb18030(const char *str)
 {
-    int len = 0;
+    return get_next_gb18030(str, 4);
+}
+
+int get_next_utf8(const char *str)
+{
+    return get_next_utf8(str, 4);
+}
+
+/* 获取下一个codetype字符的长度，不完整或不合法的字节按单字节字符处理 */
+int get_next_word(const char *str, int len, CODE_TYPE codetype)
+{
+    int char_len = 0;
     switch (codetype)
     {
     case CODE_GB18030:
-        len = get_next_gb18030(str);
+        char_len = get_next_gb18030(str, len);
         break;
     case CODE_UTF8:
-        len = get_next_utf8(str);
+        char_len = get_next_utf8(str, len);
         break;
     default:
-        len = 0;
+        char_len = 0;
         break;
     }
-    len = len == 0 ? 1 : len;
-    return len;
+    char_len = char_len == 0 ? 1 : char_len;
+    return char_len;
 }
 
-/* 将字符串按照中文字符的单字切分 */
+/* 获取下一个codetype字符的长度，str以\0结尾 */
+int get_next_word(const char *str, CODE_TYPE codetype)
+{
+    return get_next_word(str, 4, codetype);
+}
+
+/* str起始的len字节是否为被截断的多字节字符，即后续字节到达后可能构成完整的字符 */
+bool is_incomplete_char(const char *str, int len, CODE_TYPE codetype)
+{
+    unsigned char *str_in = (unsigned char *)str;
+    if (len <= 0)
+    {
+        return false;
+    }
+    if (codetype == CODE_GB18030)
+    {
+        // 双字节字符的第二字节不是数字，四字节字符为 首字节 数字 首字节 数字
+        if (str_in[0] < 0x81 || str_in[0] > 0xfe || len >= 4)
+        {
+            return false;
+        }
+        return len == 1 ||
+               (str_in[1] >= 0x30 && str_in[1] <= 0x39 &&
+                (len == 2 || (str_in[2] >= 0x81 && str_in[2] <= 0xfe)));
+    }
+    if (codetype != CODE_UTF8)
+    {
+        return false;
+    }
+    int char_len = 0;
+    if (str_in[0] >= 0xC2 && str_in[0] < 0xE0)
+    {
+        char_len = 2;
+    }
+    else if (str_in[0] >> 4 == 14)
+    {
+        char_len = 3;
+    }
+    else if (str_in[0] >> 3 == 30 && str_in[0] <= 0xF4)
+    {
+        char_len = 4;
+    }
+    if (len >= char_len)
+    {
+        return false;
+    }
+    for (int i = 1; i < len; ++i)
+    {
+        if (str_in[i] >> 6 != 2)
+        {
+            return false;
+        }
+    }
+    // 与get_next_utf8相同，排除E0和F0开头的过长编码
+    if (len >= 2 && ((str_in[0] == 0xE0 && str_in[1] < 0xA0) || (str_in[0] == 0xF0 && str_in[1] < 0x90)))
+    {
+        return false;
+    }
+    return true;
+}
+
+/* 将字符串按照中文字符的单字切分
+ * words中已有的string会被复用，重复调用时不再申请内存 */
 RVAL split_words(const char *input, int len, CODE_TYPE codetype, std::vector<std::string> &words)
 {
-    words.clear();
     char *p = (char *)input;
     int temp_len = 0;
-    std::string key;
+    size_t count = 0;
     for (int i = 0; i < len; i += temp_len)
     {
-        temp_len = get_next_word(p, codetype);
-        key.assign(p, temp_len);
-        words.push_back(key);
+        temp_len = get_next_word(p, len - i, codetype);
+        if (count < words.size())
+        {
+            words[count].assign(p, temp_len);
+        }
+        else
+        {
+            words.push_back(std::string(p, temp_len));
+        }
+        ++count;
         p += temp_len;
     }
+    words.resize(count);
     return _SUCCESS;
 }
 
@@ -220,3 +312,140 @@ RVAL split_words(const std::string &input, CODE_TYPE codetype, std::vector<std::
     int len = input.length();
     return split_words(p, len, codetype, words);
 }
+
+/* 字符的各字节依次拼为整数 */
+uint32_t char_code(const char *str, int len)
+{
+    uint32_t code = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        code = (code << 8) | (unsigned char)str[i];
+    }
+    return code;
+}
+
+uint32_t char_code(const std::string &ch)
+{
+    return char_code(ch.data(), ch.length());
+}
+
+void char_codes(const std::vector<std::string> &chars, std::vector<uint32_t> &codes)
+{
+    codes.resize(chars.size());
+    for (size_t i = 0; i < chars.size(); ++i)
+    {
+        codes[i] = char_code(chars[i]);
+    }
+}
+
+/* 句末标点，分别为UTF8和GB18030编码 */
+static const char *const UTF8_TERMINATORS[] = {
+    "\n", "\r", "!", "?", ";", "\xE3\x80\x82", "\xEF\xBC\x81",
+    "\xEF\xBC\x9F", "\xEF\xBC\x9B", "\xE2\x80\xA6", NULL};
+static const char *const GB18030_TERMINATORS[] = {
+    "\n", "\r", "!", "?", ";", "\xA1\xA3", "\xA3\xA1",
+    "\xA3\xBF", "\xA3\xBB", "\xA1\xAD", NULL};
+
+/* 跟随在句末标点之后、仍属于当前句子的闭合引号和括号 */
+static const char *const UTF8_CLOSERS[] = {
+    "\"", "'", ")", "\xE2\x80\x9D", "\xE2\x80\x99", "\xEF\xBC\x89",
+    "\xE3\x80\x8D", "\xE3\x80\x8F", NULL};
+static const char *const GB18030_CLOSERS[] = {
+    "\"", "'", ")", "\xA1\xB1", "\xA1\xAF", "\xA3\xA9",
+    "\xA1\xB9", "\xA1\xBB", NULL};
+
+/* 判断长度为len的字符是否在表中 */
+static bool match_char_table(const char *str, int len, const char *const *table)
+{
+    for (int i = 0; table[i] != NULL; ++i)
+    {
+        if ((int)strlen(table[i]) == len && memcmp(str, table[i], len) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 判断str起始的字符是否为句末标点 */
+bool is_sentence_terminator(const char *str, int len, CODE_TYPE codetype)
+{
+    return match_char_table(str, len,
+                            codetype == CODE_GB18030 ? GB18030_TERMINATORS : UTF8_TERMINATORS);
+}
+
+/* 判断str起始的字符是否为句末的闭合引号、括号 */
+bool is_sentence_closer(const char *str, int len, CODE_TYPE codetype)
+{
+    return match_char_table(str, len,
+                            codetype == CODE_GB18030 ? GB18030_CLOSERS : UTF8_CLOSERS);
+}
+
+/* 返回input中第一个完整句子的字节长度(含句末标点)，不存在句末标点时返回0
+ * 连续的句末标点以及紧随其后的闭合引号、括号都归入当前句子
+ * 只读取input起始的len字节，句末之前或紧随其后的字符被截断时返回0，等待后续输入 */
+int get_sentence_end(const char *input, int len, CODE_TYPE codetype)
+{
+    int pos = 0;
+    while (pos < len)
+    {
+        if (is_incomplete_char(input + pos, len - pos, codetype))
+        {
+            // 末尾字符不完整，等待后续输入
+            return 0;
+        }
+        int char_len = get_next_word(input + pos, len - pos, codetype);
+        bool terminator = is_sentence_terminator(input + pos, char_len, codetype);
+        pos += char_len;
+        if (!terminator)
+        {
+            continue;
+        }
+        while (pos < len)
+        {
+            if (is_incomplete_char(input + pos, len - pos, codetype))
+            {
+                // 句末标点之后的字符不完整，可能是闭合引号
+                return 0;
+            }
+            char_len = get_next_word(input + pos, len - pos, codetype);
+            if (!(is_sentence_terminator(input + pos, char_len, codetype) ||
+                  is_sentence_closer(input + pos, char_len, codetype)))
+            {
+                break;
+            }
+            pos += char_len;
+        }
+        return pos;
+    }
+    return 0;
+}
+
+int parallel_threads(int threads, size_t items, size_t min_items)
+{
+    if (threads <= 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::max<size_t>(1, std::min<size_t>(threads, items / std::max<size_t>(1, min_items)));
+    }
+    return threads;
+}
+
+void parallel_for(size_t count, int threads, const std::function<void(size_t, size_t, int)> &fn)
+{
+    if (threads <= 1 || count <= 1)
+    {
+        fn(0, count, 0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t step = (count + threads - 1) / threads;
+    for (int t = 0; t < threads && t * step < count; ++t)
+    {
+        workers.push_back(std::thread(fn, t * step, std::min(count, (t + 1) * step), t));
+    }
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+        workers[t].join();
+    }
+}
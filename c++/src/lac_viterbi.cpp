@@ -0,0 +1,259 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* Viterbi解码：转移矩阵的装载、按时间步交替的batch解码、标量解码核及运行时指令集选择 */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "lac_viterbi.h"
+
+static const size_t ALIGN_FLOATS = 16;      // 64字节
+
+AlignedFloats::AlignedFloats(const AlignedFloats &other) : _offset(0), _size(0)
+{
+    *this = other;
+}
+
+AlignedFloats &AlignedFloats::operator=(const AlignedFloats &other)
+{
+    if (this != &other)
+    {
+        this->assign(other._size, 0.0f);
+        if (other._size > 0)
+        {
+            std::memcpy(this->data(), other.data(), other._size * sizeof(float));
+        }
+    }
+    return *this;
+}
+
+void AlignedFloats::assign(size_t n, float value)
+{
+    if (this->_storage.size() < n + ALIGN_FLOATS)
+    {
+        this->_storage.resize(n + ALIGN_FLOATS);
+    }
+    uintptr_t address = reinterpret_cast<uintptr_t>(this->_storage.data());
+    this->_offset = (ALIGN_FLOATS - address / sizeof(float) % ALIGN_FLOATS) % ALIGN_FLOATS;
+    this->_size = n;
+    float *p = this->data();
+    for (size_t i = 0; i < n; ++i)
+    {
+        p[i] = value;
+    }
+}
+
+static void scalar_step(int L, int padded, const float *prev, const float *trans, const float *emission,
+                        float *score, int *arg)
+{
+    for (int j = 0; j < L; ++j)
+    {
+        float best = -std::numeric_limits<float>::infinity();
+        int best_i = 0;
+        for (int i = 0; i < L; ++i)
+        {
+            float s = prev[i] + trans[i * padded + j];
+            if (s > best)
+            {
+                best = s;
+                best_i = i;
+            }
+        }
+        score[j] = best + emission[j];
+        arg[j] = best_i;
+    }
+}
+
+const ViterbiKernel *viterbi_kernel_scalar()
+{
+    static const ViterbiKernel kernel = {"scalar", scalar_step};
+    return &kernel;
+}
+
+/* 按LAC_VITERBI_ISA或CPU支持的指令集选择，结果在首次调用时确定 */
+static const ViterbiKernel *select_kernel()
+{
+    const ViterbiKernel *avx512 = viterbi_kernel_avx512();
+    const ViterbiKernel *avx2 = viterbi_kernel_avx2();
+    const char *isa = std::getenv("LAC_VITERBI_ISA");
+    if (isa && isa[0])
+    {
+        std::string name = isa;
+        if (name == "scalar")
+        {
+            return viterbi_kernel_scalar();
+        }
+        if (name == "avx2" && avx2)
+        {
+            return avx2;
+        }
+        if (name == "avx512" && avx512)
+        {
+            return avx512;
+        }
+        std::cerr << "LAC_VITERBI_ISA " << name << " is not available" << std::endl;
+    }
+    if (avx512)
+    {
+        return avx512;
+    }
+    if (avx2)
+    {
+        return avx2;
+    }
+    return viterbi_kernel_scalar();
+}
+
+const ViterbiKernel *viterbi_kernel()
+{
+    static const ViterbiKernel *kernel = select_kernel();
+    return kernel;
+}
+
+void ViterbiDecoder::init(const float *transition, int num_labels)
+{
+    int L = num_labels;
+    this->_num_labels = L;
+    this->_padded = (L + ALIGN_FLOATS - 1) / ALIGN_FLOATS * ALIGN_FLOATS;
+    this->_start.assign(transition, transition + L);
+    this->_end.assign(transition + L, transition + 2 * L);
+    this->_trans.assign((size_t)L * this->_padded, -std::numeric_limits<float>::infinity());
+    for (int i = 0; i < L; ++i)
+    {
+        std::memcpy(this->_trans.data() + (size_t)i * this->_padded, transition + (size_t)(i + 2) * L,
+                    L * sizeof(float));
+    }
+    this->_kernel = viterbi_kernel();
+}
+
+/* 文件格式：magic "LACT"，int32的版本号1和标签数L，之后为float32的[(L + 2) x L]转移矩阵 */
+int ViterbiDecoder::load(const std::string &path)
+{
+    std::ifstream fin(path.c_str(), std::ios::binary);
+    if (!fin)
+    {
+        std::cerr << "crf transition not found: " << path << std::endl;
+        return -1;
+    }
+    char magic[4];
+    int32_t header[2];
+    fin.read(magic, sizeof(magic));
+    fin.read(reinterpret_cast<char *>(header), sizeof(header));
+    if (!fin || std::memcmp(magic, "LACT", sizeof(magic)) != 0 || header[0] != 1 || header[1] <= 0)
+    {
+        std::cerr << "invalid crf transition: " << path << std::endl;
+        return -1;
+    }
+    std::vector<float> transition((size_t)(header[1] + 2) * header[1]);
+    fin.read(reinterpret_cast<char *>(transition.data()), transition.size() * sizeof(float));
+    if ((size_t)fin.gcount() != transition.size() * sizeof(float))
+    {
+        std::cerr << "truncated crf transition: " << path << std::endl;
+        return -1;
+    }
+    this->init(transition.data(), header[1]);
+    return 0;
+}
+
+void ViterbiDecoder::decode(const float *emission, const std::vector<size_t> &lod, const float *const *masks,
+                            ViterbiBuffers &buffers, int64_t *tags) const
+{
+    if (lod.size() < 2 || lod.back() == lod.front())
+    {
+        return;
+    }
+    int L = this->_num_labels;
+    int padded = this->_padded;
+    size_t num_seqs = lod.size() - 1;
+    size_t max_length = 0;
+    for (size_t s = 0; s < num_seqs; ++s)
+    {
+        max_length = std::max(max_length, lod[s + 1] - lod[s]);
+    }
+    buffers.alpha.assign(num_seqs * 2 * padded, 0.0f);
+    buffers.row.assign(padded, 0.0f);
+    buffers.path.resize((lod.back() - lod.front()) * L);
+
+    // 各句按时间步交替前进，相邻的句子互不依赖，可以重叠执行
+    for (size_t t = 0; t < max_length; ++t)
+    {
+        for (size_t s = 0; s < num_seqs; ++s)
+        {
+            size_t begin = lod[s];
+            if (t >= lod[s + 1] - begin)
+            {
+                continue;
+            }
+            size_t pos = begin + t;
+            const float *e = emission + (pos - lod.front()) * L;
+            if (masks && masks[pos - lod.front()])
+            {
+                const float *mask = masks[pos - lod.front()];
+                float *row = buffers.row.data();
+                for (int j = 0; j < L; ++j)
+                {
+                    row[j] = e[j] + mask[j];
+                }
+                e = row;
+            }
+            float *cur = buffers.alpha.data() + (s * 2 + t % 2) * padded;
+            if (t == 0)
+            {
+                for (int j = 0; j < L; ++j)
+                {
+                    cur[j] = this->_start[j] + e[j];
+                }
+            }
+            else
+            {
+                const float *prev = buffers.alpha.data() + (s * 2 + (t - 1) % 2) * padded;
+                this->_kernel->step(L, padded, prev, this->_trans.data(), e, cur,
+                                    &buffers.path[(pos - lod.front()) * L]);
+            }
+        }
+    }
+
+    for (size_t s = 0; s < num_seqs; ++s)
+    {
+        size_t length = lod[s + 1] - lod[s];
+        if (length == 0)
+        {
+            continue;
+        }
+        const float *last = buffers.alpha.data() + (s * 2 + (length - 1) % 2) * padded;
+        float best = -std::numeric_limits<float>::infinity();
+        int best_j = 0;
+        for (int j = 0; j < L; ++j)
+        {
+            float score = last[j] + this->_end[j];
+            if (score > best)
+            {
+                best = score;
+                best_j = j;
+            }
+        }
+        size_t begin = lod[s] - lod.front();
+        for (size_t t = length; t-- > 0;)
+        {
+            tags[begin + t] = best_j;
+            best_j = buffers.path[(begin + t) * L + best_j];
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* Viterbi的AVX2解码核，本文件以-mavx2编译，未启用时返回NULL */
+
+#include "lac_viterbi.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+/* 第j列起8列中属于前L列的部分 */
+static inline __m256i column_mask(int L, int j)
+{
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(L - j), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+/* 一次计算B个8列的块，各块的比较与选择互不依赖 */
+template <int B>
+static inline void avx2_step_block(int L, int padded, int j, const float *prev, const float *trans,
+                                   const float *emission, float *score, int *arg)
+{
+    __m256 best[B];
+    __m256i best_i[B];
+    for (int b = 0; b < B; ++b)
+    {
+        best[b] = _mm256_set1_ps(-__builtin_inff());
+        best_i[b] = _mm256_setzero_si256();
+    }
+    for (int i = 0; i < L; ++i)
+    {
+        __m256 p = _mm256_set1_ps(prev[i]);
+        __m256i index = _mm256_set1_epi32(i);
+        const float *row = trans + (size_t)i * padded + j;
+        for (int b = 0; b < B; ++b)
+        {
+            __m256 s = _mm256_add_ps(p, _mm256_load_ps(row + b * 8));
+            // 严格大于，分数相同时保留较小的i
+            __m256 greater = _mm256_cmp_ps(s, best[b], _CMP_GT_OQ);
+            best[b] = _mm256_blendv_ps(best[b], s, greater);
+            best_i[b] = _mm256_blendv_epi8(best_i[b], index, _mm256_castps_si256(greater));
+        }
+    }
+    for (int b = 0; b < B; ++b)
+    {
+        int col = j + b * 8;
+        if (col + 8 <= L)
+        {
+            _mm256_store_ps(score + col, _mm256_add_ps(best[b], _mm256_loadu_ps(emission + col)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(arg + col), best_i[b]);
+        }
+        else if (col < L)
+        {
+            __m256i mask = column_mask(L, col);
+            __m256 e = _mm256_maskload_ps(emission + col, mask);
+            _mm256_store_ps(score + col, _mm256_add_ps(best[b], e));
+            _mm256_maskstore_epi32(arg + col, mask, best_i[b]);
+        }
+        else
+        {
+            _mm256_store_ps(score + col, best[b]);
+        }
+    }
+}
+
+static void avx2_step(int L, int padded, const float *prev, const float *trans, const float *emission,
+                      float *score, int *arg)
+{
+    int j = 0;
+    for (; j + 32 <= padded; j += 32)
+    {
+        avx2_step_block<4>(L, padded, j, prev, trans, emission, score, arg);
+    }
+    for (; j < padded; j += 8)
+    {
+        avx2_step_block<1>(L, padded, j, prev, trans, emission, score, arg);
+    }
+}
+
+const ViterbiKernel *viterbi_kernel_avx2()
+{
+    static const ViterbiKernel kernel = {"avx2", avx2_step};
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        return NULL;
+    }
+    return &kernel;
+}
+
+#else
+
+const ViterbiKernel *viterbi_kernel_avx2()
+{
+    return NULL;
+}
+
+#endif  // __AVX2__
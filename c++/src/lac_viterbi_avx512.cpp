@@ -0,0 +1,101 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* Viterbi的AVX-512解码核，本文件以-mavx512f编译，未启用时返回NULL
+ * 标签数不足16的部分使用掩码读写 */
+
+#include "lac_viterbi.h"
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+static inline __mmask16 column_mask(int L, int j)
+{
+    int cols = L - j;
+    if (cols <= 0)
+    {
+        return 0;
+    }
+    return cols >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << cols) - 1);
+}
+
+/* 一次计算B个16列的块，各块的比较与选择互不依赖 */
+template <int B>
+static inline void avx512_step_block(int L, int padded, int j, const float *prev, const float *trans,
+                                     const float *emission, float *score, int *arg)
+{
+    __m512 best[B];
+    __m512i best_i[B];
+    for (int b = 0; b < B; ++b)
+    {
+        best[b] = _mm512_set1_ps(-__builtin_inff());
+        best_i[b] = _mm512_setzero_si512();
+    }
+    for (int i = 0; i < L; ++i)
+    {
+        __m512 p = _mm512_set1_ps(prev[i]);
+        __m512i index = _mm512_set1_epi32(i);
+        const float *row = trans + (size_t)i * padded + j;
+        for (int b = 0; b < B; ++b)
+        {
+            __m512 s = _mm512_add_ps(p, _mm512_load_ps(row + b * 16));
+            // 严格大于，分数相同时保留较小的i
+            __mmask16 greater = _mm512_cmp_ps_mask(s, best[b], _CMP_GT_OQ);
+            best[b] = _mm512_mask_mov_ps(best[b], greater, s);
+            best_i[b] = _mm512_mask_mov_epi32(best_i[b], greater, index);
+        }
+    }
+    for (int b = 0; b < B; ++b)
+    {
+        int col = j + b * 16;
+        __mmask16 mask = column_mask(L, col);
+        __m512 e = _mm512_maskz_loadu_ps(mask, emission + col);
+        _mm512_store_ps(score + col, _mm512_add_ps(best[b], e));
+        _mm512_mask_storeu_epi32(arg + col, mask, best_i[b]);
+    }
+}
+
+static void avx512_step(int L, int padded, const float *prev, const float *trans, const float *emission,
+                        float *score, int *arg)
+{
+    int j = 0;
+    for (; j + 64 <= padded; j += 64)
+    {
+        avx512_step_block<4>(L, padded, j, prev, trans, emission, score, arg);
+    }
+    for (; j < padded; j += 16)
+    {
+        avx512_step_block<1>(L, padded, j, prev, trans, emission, score, arg);
+    }
+}
+
+const ViterbiKernel *viterbi_kernel_avx512()
+{
+    static const ViterbiKernel kernel = {"avx512", avx512_step};
+    if (!__builtin_cpu_supports("avx512f"))
+    {
+        return NULL;
+    }
+    return &kernel;
+}
+
+#else
+
+const ViterbiKernel *viterbi_kernel_avx512()
+{
+    return NULL;
+}
+
+#endif  // __AVX512F__
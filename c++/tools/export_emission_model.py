@@ -0,0 +1,83 @@
+# -*- coding: UTF-8 -*-
+################################################################################
+#
+#   Copyright (c) 2020  Baidu, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License"
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#################################################################################
+
+"""
+将LAC的Paddle预测模型截断在发射层导出，CRF解码改由C++的ViterbiDecoder完成
+
+用法:
+    python export_emission_model.py <model_dir>
+
+model_dir为包含conf和model目录的模型路径(如lac_model)，输出到<model_dir>/model_emission：
+    模型文件与model相同格式，输出为crf_decoding的Emission输入([字数 x 标签数]的float32)
+    crf_transition为CRF的转移矩阵，格式见c++/src/lac_viterbi.cpp中的ViterbiDecoder::load
+Paddle Inference后端检测到model_emission/crf_transition时装载该模型，并可在解码时施加用户词典约束
+"""
+
+import os
+import struct
+import sys
+
+import numpy as np
+import paddle
+import paddle.fluid as fluid
+
+MAGIC = b'LACT'
+VERSION = 1
+
+
+def find_crf(program):
+    """返回crf_decoding算子的Emission输入名与Transition参数名"""
+    for op in program.global_block().ops:
+        if op.type == 'crf_decoding':
+            return op.input('Emission')[0], op.input('Transition')[0]
+    raise ValueError('model has no crf_decoding op')
+
+
+def export(model_dir):
+    exe = fluid.Executor(fluid.CPUPlace())
+    scope = fluid.global_scope()
+    source = os.path.join(model_dir, 'model')
+    params_filename = None
+    if os.path.exists(os.path.join(source, '__params__')):
+        params_filename = '__params__'
+    program, feed_names, _ = fluid.io.load_inference_model(
+        source, exe, params_filename=params_filename)
+    emission_name, transition_name = find_crf(program)
+
+    output = os.path.join(model_dir, 'model_emission')
+    emission = program.global_block().var(emission_name)
+    fluid.io.save_inference_model(output, feed_names, [emission], exe,
+                                  main_program=program, params_filename=params_filename)
+
+    transition = np.array(scope.find_var(transition_name).get_tensor(), dtype=np.float32)
+    num_labels = transition.shape[1]
+    with open(os.path.join(output, 'crf_transition'), 'wb') as fout:
+        fout.write(MAGIC)
+        fout.write(struct.pack('<2i', VERSION, num_labels))
+        fout.write(transition.astype('<f4').tobytes())
+
+    print('exported %s: emission %s, labels %d' % (output, emission_name, num_labels))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    if hasattr(paddle, 'enable_static'):
+        paddle.enable_static()
+    export(sys.argv[1])
@@ -0,0 +1,158 @@
+# -*- coding: UTF-8 -*-
+################################################################################
+#
+#   Copyright (c) 2020  Baidu, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License"
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#################################################################################
+
+"""
+将LAC模型与rank模型合并为一个预测模型，rank模式下一次Run同时输出标签和rank权重
+
+用法:
+    python export_fused_rank_model.py <lac_model_dir> <rank_model_dir> [output]
+
+output默认为<rank_model_dir>/fused，模型位于output/model，C++的LAC::enable_rank_mode检测到后优先装载
+rank模型的words输入接LAC的输入，crf_decode输入接LAC的crf_decoding输出；
+rank模型中与LAC模型类型、属性、输入及参数取值都相同的算子(如共用的embedding和编码层)不再重复计算，
+直接使用LAC中对应算子的输出
+"""
+
+import hashlib
+import os
+import sys
+
+import numpy as np
+import paddle
+import paddle.fluid as fluid
+
+RANK_PREFIX = 'rank.'
+
+# 不影响计算结果的属性，比较算子时忽略
+IGNORED_ATTRS = ('op_role', 'op_role_var', 'op_namescope', 'op_callstack', 'op_device', 'with_quant_attr')
+
+
+def load_model(model_dir, exe, scope):
+    """装载预测模型，兼容参数合并保存(__params__)与分开保存两种格式"""
+    params_filename = None
+    if os.path.exists(os.path.join(model_dir, '__params__')):
+        params_filename = '__params__'
+    with fluid.scope_guard(scope):
+        program, feed_names, fetch_targets = fluid.io.load_inference_model(
+            model_dir, exe, params_filename=params_filename)
+    return program, feed_names, fetch_targets, params_filename
+
+
+def is_param(block, scope, name):
+    var = block.vars.get(name)
+    return var is not None and var.persistable and scope.find_var(name) is not None
+
+
+def param_digest(scope, name):
+    array = np.array(scope.find_var(name).get_tensor())
+    return '%s%s%s' % (hashlib.sha1(array.tobytes()).hexdigest(), array.shape, array.dtype)
+
+
+def op_key(op, block, scope, var_name):
+    """算子的签名：类型、属性和输入，参数以取值表示，其余输入以var_name映射后的名字表示"""
+    inputs = []
+    for slot in sorted(op.input_names):
+        names = []
+        for name in op.input(slot):
+            if is_param(block, scope, name):
+                names.append(('param', param_digest(scope, name)))
+            else:
+                names.append(('var', var_name(name)))
+        inputs.append((slot, tuple(names)))
+    attrs = tuple((name, repr(op.attr(name))) for name in sorted(op.attr_names)
+                  if name not in IGNORED_ATTRS)
+    return op.type, attrs, tuple(inputs)
+
+
+def fuse(lac_model_dir, rank_model_dir, output):
+    place = fluid.CPUPlace()
+    exe = fluid.Executor(place)
+    lac_scope = fluid.Scope()
+    rank_scope = fluid.Scope()
+    program, lac_feeds, lac_fetches, params_filename = load_model(
+        os.path.join(lac_model_dir, 'model'), exe, lac_scope)
+    rank_program, rank_feeds, rank_fetches, _ = load_model(
+        os.path.join(rank_model_dir, 'model'), exe, rank_scope)
+    if len(lac_feeds) != 1 or len(rank_feeds) != 2:
+        raise ValueError('expect 1 lac input and 2 rank inputs (words, crf_decode)')
+
+    block = program.global_block()
+    rank_block = rank_program.global_block()
+    lac_ops = {}
+    for op in block.ops:
+        if op.type not in ('feed', 'fetch'):
+            lac_ops.setdefault(op_key(op, block, lac_scope, lambda name: name), op)
+
+    # rank模型的变量到合并后变量的映射，未共用的变量加前缀，参数复制到LAC的scope
+    mapping = {rank_feeds[0]: lac_feeds[0], rank_feeds[1]: lac_fetches[0].name}
+
+    def rank_var(name):
+        if name in mapping:
+            return mapping[name]
+        var = rank_block.var(name)
+        new_name = RANK_PREFIX + name
+        kwargs = {'name': new_name, 'type': var.type, 'persistable': var.persistable}
+        if var.type == fluid.core.VarDesc.VarType.LOD_TENSOR:
+            kwargs.update(shape=var.shape, dtype=var.dtype, lod_level=var.lod_level)
+        block.create_var(**kwargs)
+        if is_param(rank_block, rank_scope, name):
+            array = np.array(rank_scope.find_var(name).get_tensor())
+            lac_scope.var(new_name).get_tensor().set(array, place)
+        mapping[name] = new_name
+        return new_name
+
+    shared = 0
+    appended = 0
+    for op in rank_block.ops:
+        if op.type in ('feed', 'fetch'):
+            continue
+        if op.has_attr('sub_block'):
+            raise ValueError('control flow op %s is not supported' % op.type)
+        key = op_key(op, rank_block, rank_scope, lambda name: mapping.get(name, RANK_PREFIX + name))
+        lac_op = lac_ops.get(key)
+        if lac_op is not None and sorted(lac_op.output_names) == sorted(op.output_names):
+            for slot in op.output_names:
+                for name, lac_name in zip(op.output(slot), lac_op.output(slot)):
+                    mapping[name] = lac_name
+            shared += 1
+            continue
+        inputs = dict((slot, [rank_var(name) for name in op.input(slot)]) for slot in op.input_names)
+        outputs = dict((slot, [rank_var(name) for name in op.output(slot)]) for slot in op.output_names)
+        attrs = dict((name, op.attr(name)) for name in op.attr_names)
+        block.append_op(type=op.type, inputs=inputs, outputs=outputs, attrs=attrs)
+        appended += 1
+
+    # 输出顺序：标签在前，rank权重在后
+    targets = [lac_fetches[0], block.var(mapping[rank_fetches[0].name])]
+    with fluid.scope_guard(lac_scope):
+        fluid.io.save_inference_model(os.path.join(output, 'model'), lac_feeds, targets, exe,
+                                      main_program=program, params_filename=params_filename)
+    print('exported %s: %d rank ops shared with lac, %d rank ops appended'
+          % (output, shared, appended))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print(__doc__)
+        sys.exit(1)
+    if hasattr(paddle, 'enable_static'):
+        paddle.enable_static()
+    lac_model_dir = sys.argv[1]
+    rank_model_dir = sys.argv[2]
+    output = sys.argv[3] if len(sys.argv) > 3 else os.path.join(rank_model_dir, 'fused')
+    fuse(lac_model_dir, rank_model_dir, output)
@@ -0,0 +1,142 @@
+# -*- coding: UTF-8 -*-
+################################################################################
+#
+#   Copyright (c) 2020  Baidu, Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License"
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#################################################################################
+
+"""
+将LAC的Paddle预测模型导出为C++原生推理引擎(BACKEND_NATIVE)使用的参数文件
+
+用法:
+    python export_native_model.py <model_dir> [output]
+
+model_dir为包含conf和model目录的模型路径(如lac_model)，output默认为<model_dir>/model.native
+按网络中算子的顺序读取参数，网络结构见python/LAC/nets.py
+"""
+
+import os
+import struct
+import sys
+
+import numpy as np
+import paddle
+import paddle.fluid as fluid
+
+MAGIC = b'LACN'
+VERSION = 1
+
+
+def load_program(model_dir, exe):
+    """装载预测模型，兼容参数合并保存(__params__)与分开保存两种格式"""
+    params_filename = None
+    if os.path.exists(os.path.join(model_dir, '__params__')):
+        params_filename = '__params__'
+    program, _, _ = fluid.io.load_inference_model(
+        model_dir, exe, params_filename=params_filename)
+    return program
+
+
+def collect_params(program, scope):
+    """按算子顺序收集embedding、fc、gru和crf的参数"""
+
+    def param(name):
+        return np.array(scope.find_var(name).get_tensor(), dtype=np.float32)
+
+    def is_param(name):
+        var = program.global_block().vars.get(name)
+        return var is not None and var.persistable
+
+    embedding = None
+    transition = None
+    fcs = []
+    grus = []
+    for op in program.global_block().ops:
+        if op.type in ('lookup_table', 'lookup_table_v2'):
+            embedding = param(op.input('W')[0])
+        elif op.type == 'fc':
+            bias = op.input('Bias')
+            fcs.append([param(op.input('W')[0]),
+                        param(bias[0]) if bias else None])
+        elif op.type in ('mul', 'matmul', 'matmul_v2'):
+            fcs.append([param(op.input('Y')[0]), None])
+        elif op.type == 'elementwise_add' and is_param(op.input('Y')[0]):
+            fcs[-1][1] = param(op.input('Y')[0])
+        elif op.type == 'gru':
+            if op.attr('gate_activation') != 'sigmoid' or op.attr('activation') != 'tanh':
+                raise ValueError('unsupported gru activation')
+            grus.append({'weight': param(op.input('Weight')[0]),
+                         'bias': param(op.input('Bias')[0]),
+                         'is_reverse': op.attr('is_reverse'),
+                         'origin_mode': op.attr('origin_mode')
+                         if op.has_attr('origin_mode') else False})
+        elif op.type == 'crf_decoding':
+            transition = param(op.input('Transition')[0])
+
+    if embedding is None or transition is None or not grus or len(grus) % 2 != 0 \
+            or len(fcs) != len(grus) + 1:
+        raise ValueError('model is not an embedding-BiGRU-CRF network')
+    return embedding, fcs, grus, transition
+
+
+def export(model_dir, output):
+    """导出参数文件，格式见c++/src/lac_native.cpp中的NativeModel::load"""
+    exe = fluid.Executor(fluid.CPUPlace())
+    scope = fluid.global_scope()
+    program = load_program(os.path.join(model_dir, 'model'), exe)
+    embedding, fcs, grus, transition = collect_params(program, scope)
+
+    vocab_size, emb_dim = embedding.shape
+    hidden_dim = grus[0]['weight'].shape[0]
+    num_layers = len(grus) // 2
+    num_labels = transition.shape[1]
+    origin_mode = int(grus[0]['origin_mode'])
+
+    with open(output, 'wb') as fout:
+        fout.write(MAGIC)
+        fout.write(struct.pack('<7i', VERSION, vocab_size, emb_dim, hidden_dim,
+                               num_layers, num_labels, origin_mode))
+        fout.write(embedding.astype('<f4').tobytes())
+        for layer in range(num_layers):
+            for direction in range(2):
+                index = layer * 2 + direction
+                if grus[index]['is_reverse'] != (direction == 1):
+                    raise ValueError('unexpected gru direction in layer %d' % layer)
+                weight, bias = fcs[index]
+                if bias is None:
+                    bias = np.zeros(weight.shape[1], dtype=np.float32)
+                fout.write(weight.astype('<f4').tobytes())
+                fout.write(bias.astype('<f4').tobytes())
+                fout.write(grus[index]['weight'].astype('<f4').tobytes())
+                fout.write(grus[index]['bias'].astype('<f4').tobytes())
+        weight, bias = fcs[-1]
+        if bias is None:
+            bias = np.zeros(weight.shape[1], dtype=np.float32)
+        fout.write(weight.astype('<f4').tobytes())
+        fout.write(bias.astype('<f4').tobytes())
+        fout.write(transition.astype('<f4').tobytes())
+
+    print('exported %s: vocab %d, emb %d, hidden %d, layers %d, labels %d'
+          % (output, vocab_size, emb_dim, hidden_dim, num_layers, num_labels))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    if hasattr(paddle, 'enable_static'):
+        paddle.enable_static()
+    model_dir = sys.argv[1]
+    output = sys.argv[2] if len(sys.argv) > 2 else os.path.join(model_dir, 'model.native')
+    export(model_dir, output)
@@ -25,7 +25,8 @@ public class LacMulti {
         model_path = args[0];
         int thread_num = Integer.parseInt(args[1]);
 
-        LAC lac = new LAC(model_path);
+        // 模型只装载一次，各线程共享thread_num个会话
+        LAC lac = new LAC(model_path, thread_num);
         LacRunnable lacrunner = new LacRunnable(lac);
 
         Thread threads[]=new Thread[thread_num];
@@ -56,7 +57,6 @@ class LacRunnable implements Runnable{
         String query = null;
         
         try {
-            LAC thread_lac = new LAC(g_lac);
             while (true) {
                 readLock.lock();
                 if ((query = stdin.readLine()) == null){
@@ -64,7 +64,7 @@ class LacRunnable implements Runnable{
                     break;
                 }
                 readLock.unlock();
-                thread_lac.run(query, words, tags);
+                g_lac.run(query, words, tags);
  
                 printLock.lock();
                 System.out.println(words);
@@ -1,16 +1,32 @@
 package com.baidu.nlp;
 
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 
 public class LAC {
 
+    // fields of each session in sessionMetrics()
+    public static final int METRIC_CALLS = 0;
+    public static final int METRIC_SENTENCES = 1;
+    public static final int METRIC_WORDS = 2;
+    public static final int METRIC_BUSY_US = 3;
+    public static final int METRIC_WAIT_US = 4;
+    public static final int METRIC_FIELDS = 5;
+
     // as c++ self pointer
     private long self_ptr;
 
     public LAC(String model_dir) {
-        init(model_dir);
+        init(model_dir, 1);
+    }
+
+    // load the model once and create pool_size native sessions sharing it,
+    // each call from any thread checks out an idle session and returns it when done
+    public LAC(String model_dir, int pool_size) {
+        init(model_dir, pool_size);
     }
 
+    // independent copy with its own session pool, not needed for multi-threading
     public LAC(LAC model){
         copy(model.self_ptr);
     }
@@ -29,7 +45,7 @@ public class LAC {
     }
 
     // load model from model_path
-    private native void init(String model_path);
+    private native void init(String model_path, int pool_size);
 
     // load model from existing model's self_ptr
     private native void copy(long self_ptr);
@@ -37,10 +53,34 @@ public class LAC {
     // release lac model
     private static native void release(long self_ptr);
 
-    // load dict from dict_path
+    // load dict from dict_path, the session pool is rebuilt and calls in flight finish on the old one
     public native int loadCustomization(String dict_path);
 
     // run lac, results save in words and tags
     public native int run(String sentence, ArrayList<String> words, ArrayList<String> tags);
 
+    // run lac on a batch of sentences, word offsets and lengths in result count Java chars
+    public native int runBatch(String[] sentences, LACResult result);
+
+    // run lac on count utf-8 sentences in a direct buffer, sentence i is bytes [offsets[i], offsets[i + 1]),
+    // word offsets and lengths in result count bytes relative to the sentence
+    public native int runUtf8(ByteBuffer buffer, int[] offsets, int count, LACResult result);
+
+    // tag names indexed by LACResult.tagIds
+    public native String[] tagNames();
+
+    // run synthetic queries on every session, sessions rebuilt later warm up when created,
+    // returns the total time in milliseconds
+    public native double warmup();
+
+    // number of native sessions
+    public native int poolSize();
+
+    // number of sessions not checked out
+    public native int idleSessions();
+
+    // METRIC_FIELDS counters per session, session i at [i * METRIC_FIELDS, (i + 1) * METRIC_FIELDS),
+    // counters restart when the pool is rebuilt
+    public native long[] sessionMetrics();
+
 }
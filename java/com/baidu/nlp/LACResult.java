@@ -0,0 +1,25 @@
+package com.baidu.nlp;
+
+// results of LAC.runBatch and LAC.runUtf8, arrays are reused across calls
+// and only grown when too small, so they may be longer than wordCount
+public class LACResult {
+
+    // number of words of all sentences
+    public int wordCount;
+
+    // number of sentences
+    public int sentenceCount;
+
+    // words of sentence i are [sentenceOffsets[i], sentenceOffsets[i + 1])
+    public int[] sentenceOffsets;
+
+    // word offset within its sentence
+    public int[] offsets;
+
+    // word length
+    public int[] lengths;
+
+    // word tag, index of LAC.tagNames()
+    public int[] tagIds;
+
+}
@@ -1,133 +1,620 @@
 #include "lac.h"
+#include "lac_pool.h"
 #include "lac_jni.h"
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* 每个会话的统计项，顺序与LAC.java中的METRIC_*一致 */
+enum JNI_METRIC
+{
+  METRIC_CALLS = 0,   // 借出次数
+  METRIC_SENTENCES,   // 处理的句子数
+  METRIC_WORDS,       // 输出的词数
+  METRIC_BUSY_US,     // 借出期间的累计耗时(微秒)
+  METRIC_WAIT_US,     // 借出前等待空闲会话的累计耗时(微秒)
+  METRIC_NUM,
+};
+
+/* 池中一个会话对应的缓冲区及统计，只由借出该会话的线程修改 */
+struct LACJniSession
+{
+  std::vector<OutputItem> items;
+  std::string text_buffer;
+  std::vector<const char *> texts;
+  std::vector<int> text_offsets;
+  std::vector<int> lens;
+  std::vector<WordSpan> spans;
+  std::vector<size_t> span_lod;
+  std::vector<jint> offsets;
+  std::vector<jint> lengths;
+  std::vector<jint> tag_ids;
+  std::vector<jint> sentence_offsets;
+  std::atomic<uint64_t> metrics[METRIC_NUM];
+
+  LACJniSession()
+  {
+    for (int i = 0; i < METRIC_NUM; ++i)
+    {
+      metrics[i] = 0;
+    }
+  }
+
+  void add(JNI_METRIC metric, uint64_t value)
+  {
+    metrics[metric].fetch_add(value, std::memory_order_relaxed);
+  }
+};
+
+/* 由原型拷贝出的会话池，以及与各会话一一对应的LACJniSession */
+struct LACJniPool
+{
+  LACPool pool;
+  std::vector<std::unique_ptr<LACJniSession>> sessions;
+
+  LACJniPool(LAC &prototype, size_t size) : pool(prototype, size)
+  {
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+      sessions.push_back(std::unique_ptr<LACJniSession>(new LACJniSession()));
+    }
+  }
+};
+
+/* Java对象的self_ptr指向的句柄：装载一次的模型(原型)及由其拷贝出的会话池
+ * 任意Java线程调用时从池中借出一个会话，用完归还，无需在Java端为每个线程拷贝
+ * 装载用户词典时修改原型并重建会话池，正在运行的调用继续使用旧池直至归还 */
+struct LACJniHandle
+{
+  LAC prototype;
+  size_t pool_size;
+  std::mutex load_mutex;   // 串行化对原型的修改及会话池的重建
+  std::mutex pool_mutex;   // 保护pool的读取与替换
+  std::shared_ptr<LACJniPool> pool;
+
+  LACJniHandle(const std::string &model_path, size_t size)
+      : prototype(model_path), pool_size(size > 0 ? size : 1)
+  {
+    rebuild();
+  }
+
+  /* 调用方需持有other.load_mutex */
+  explicit LACJniHandle(LACJniHandle &other)
+      : prototype(other.prototype), pool_size(other.pool_size)
+  {
+    rebuild();
+  }
+
+  std::shared_ptr<LACJniPool> current()
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    return pool;
+  }
+
+  /* 由原型重新拷贝出会话池，调用方需持有load_mutex(构造时除外) */
+  void rebuild()
+  {
+    std::shared_ptr<LACJniPool> fresh = std::make_shared<LACJniPool>(prototype, pool_size);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    pool.swap(fresh);
+  }
+};
+
+/* 在作用域内借出一个会话，离开作用域时归还并累计统计 */
+class LACJniCheckout
+{
+private:
+  std::shared_ptr<LACJniPool> _pool;
+  LAC *_lac;
+  LACJniSession *_session;
+  std::chrono::steady_clock::time_point _start;
+
+  static uint64_t elapsed_us(std::chrono::steady_clock::time_point since)
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - since).count();
+  }
+
+public:
+  explicit LACJniCheckout(LACJniHandle *handle) : _pool(handle->current())
+  {
+    std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+    _lac = _pool->pool.acquire();
+    _start = std::chrono::steady_clock::now();
+    _session = _pool->sessions[_pool->pool.index(_lac)].get();
+    _session->add(METRIC_WAIT_US, elapsed_us(wait_start));
+  }
+
+  ~LACJniCheckout()
+  {
+    _session->add(METRIC_CALLS, 1);
+    _session->add(METRIC_BUSY_US, elapsed_us(_start));
+    _pool->pool.release(_lac);
+  }
+
+  LAC &lac() { return *_lac; }
+  LACJniSession &session() { return *_session; }
+};
+
+/* JNI_OnLoad中查询并缓存的类和成员ID，调用时不再查询 */
+static struct
+{
+  jclass lac_class;
+  jfieldID self_ptr;
+  jclass list_class;
+  jmethodID list_add;
+  jmethodID list_clear;
+  jclass string_class;
+  jclass result_class;
+  jfieldID result_word_count;
+  jfieldID result_sentence_count;
+  jfieldID result_sentence_offsets;
+  jfieldID result_offsets;
+  jfieldID result_lengths;
+  jfieldID result_tag_ids;
+} g_jni;
+
+/* 查找类并保存为全局引用，使缓存的ID一直有效 */
+static jclass _find_class(JNIEnv *env, const char *name)
+{
+  jclass local = env->FindClass(name);
+  if (local == NULL)
+  {
+    std::cerr << "JNI_OnLoad: class " << name << " not found" << std::endl;
+    return NULL;
+  }
+  jclass global = (jclass)env->NewGlobalRef(local);
+  env->DeleteLocalRef(local);
+  return global;
+}
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved)
+{
+  JNIEnv *env = NULL;
+  if (vm->GetEnv((void **)&env, JNI_VERSION_1_6) != JNI_OK)
+  {
+    return JNI_ERR;
+  }
+  g_jni.lac_class = _find_class(env, "com/baidu/nlp/LAC");
+  g_jni.list_class = _find_class(env, "java/util/ArrayList");
+  g_jni.string_class = _find_class(env, "java/lang/String");
+  g_jni.result_class = _find_class(env, "com/baidu/nlp/LACResult");
+  if (!g_jni.lac_class || !g_jni.list_class || !g_jni.string_class || !g_jni.result_class)
+  {
+    return JNI_ERR;
+  }
+  g_jni.self_ptr = env->GetFieldID(g_jni.lac_class, "self_ptr", "J");
+  g_jni.list_add = env->GetMethodID(g_jni.list_class, "add", "(Ljava/lang/Object;)Z");
+  g_jni.list_clear = env->GetMethodID(g_jni.list_class, "clear", "()V");
+  g_jni.result_word_count = env->GetFieldID(g_jni.result_class, "wordCount", "I");
+  g_jni.result_sentence_count = env->GetFieldID(g_jni.result_class, "sentenceCount", "I");
+  g_jni.result_sentence_offsets = env->GetFieldID(g_jni.result_class, "sentenceOffsets", "[I");
+  g_jni.result_offsets = env->GetFieldID(g_jni.result_class, "offsets", "[I");
+  g_jni.result_lengths = env->GetFieldID(g_jni.result_class, "lengths", "[I");
+  g_jni.result_tag_ids = env->GetFieldID(g_jni.result_class, "tagIds", "[I");
+  if (env->ExceptionCheck())
+  {
+    return JNI_ERR;
+  }
+  return JNI_VERSION_1_6;
+}
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
- 
-  // 返回Java类别中的self_ptr地址，用于指向创建的LAC对象
-  static jfieldID _get_self_id(JNIEnv *env, jobject thisObj)
+
+  // 设置self_ptr地址，指向创建的句柄
+  static void _set_self(JNIEnv *env, jobject thisObj, LACJniHandle *self)
+  {
+    jlong selfPtr = *(jlong *)&self;
+    env->SetLongField(thisObj, g_jni.self_ptr, selfPtr);
+  }
+
+  // 返回句柄的指针
+  static LACJniHandle *_get_self(JNIEnv *env, jobject thisObj)
+  {
+    jlong selfPtr = env->GetLongField(thisObj, g_jni.self_ptr);
+    return *(LACJniHandle **)&selfPtr;
+  }
+
+  // 将jstring转为std::string，并释放GetStringUTFChars的缓冲区
+  static std::string _to_string(JNIEnv *env, jstring str)
   {
-    static int init = 0;
-    static jfieldID fidSelfPtr;
-    if (!init)
+    const char *chars = env->GetStringUTFChars(str, NULL);
+    std::string result(chars ? chars : "");
+    if (chars)
     {
-      jclass thisClass = env->GetObjectClass(thisObj);
-      fidSelfPtr = env->GetFieldID(thisClass, "self_ptr", "J");
+      env->ReleaseStringUTFChars(str, chars);
     }
-    return fidSelfPtr;
+    return result;
   }
 
-  // 设置self_ptr地址，指向创建的LAC对象
-  static void _set_self(JNIEnv *env, jobject thisObj, LAC *self)
+  // 将data写入result的int数组字段，数组不够长时新建，否则复用
+  static void _store_ints(JNIEnv *env, jobject result, jfieldID field, const std::vector<jint> &data)
   {
-    jlong selfPtr = *(jlong *)&self;
-    env->SetLongField(thisObj, _get_self_id(env, thisObj), selfPtr);
+    jsize size = data.size();
+    jintArray array = (jintArray)env->GetObjectField(result, field);
+    if (array == NULL || env->GetArrayLength(array) < size)
+    {
+      if (array != NULL)
+      {
+        env->DeleteLocalRef(array);
+      }
+      array = env->NewIntArray(size);
+      if (array == NULL)
+      {
+        return;
+      }
+      env->SetObjectField(result, field, array);
+    }
+    if (size > 0)
+    {
+      env->SetIntArrayRegion(array, 0, size, data.data());
+    }
+    env->DeleteLocalRef(array);
   }
 
-  // 返回LAC对象的指针
-  static LAC *_get_self(JNIEnv *env, jobject thisObj)
+  // 按字节计的词位置转为Java字符(UTF-16)的位置，text为modified UTF-8，补充平面字符为两个3字节的代理项
+  static void _utf16_positions(const char *text, const WordSpan *spans, size_t count, jint *offsets, jint *lengths)
   {
-    jlong selfPtr = env->GetLongField(thisObj, _get_self_id(env, thisObj));
-    return *(LAC **)&selfPtr;
+    int pos = 0;
+    int units = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+      int targets[2] = {spans[i].offset, spans[i].offset + spans[i].length};
+      int begin = 0;
+      for (int k = 0; k < 2; ++k)
+      {
+        while (pos < targets[k])
+        {
+          unsigned char c = text[pos];
+          int bytes = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : 4;
+          units += bytes == 4 ? 2 : 1;
+          pos += bytes;
+        }
+        if (k == 0)
+        {
+          begin = units;
+        }
+      }
+      offsets[i] = begin;
+      lengths[i] = units - begin;
+    }
   }
 
+  // 用借出的会话运行session.texts中的句子并写出结果，utf16为true时词的位置以Java字符计，否则以字节计
+  static jint _run_offsets(JNIEnv *env, LACJniCheckout &checkout, size_t count, bool utf16, jobject result)
+  {
+    LACJniSession &session = checkout.session();
+    if (checkout.lac().run_offsets(session.texts.data(), session.lens.data(), count,
+                                   session.spans, session.span_lod) != 0)
+    {
+      return -1;
+    }
+    size_t words = session.spans.size();
+    session.offsets.resize(words);
+    session.lengths.resize(words);
+    session.tag_ids.resize(words);
+    session.sentence_offsets.assign(session.span_lod.begin(), session.span_lod.end());
+    for (size_t i = 0; i < count; ++i)
+    {
+      size_t begin = session.span_lod[i];
+      size_t end = session.span_lod[i + 1];
+      if (utf16)
+      {
+        _utf16_positions(session.texts[i], session.spans.data() + begin, end - begin,
+                         session.offsets.data() + begin, session.lengths.data() + begin);
+      }
+      else
+      {
+        for (size_t j = begin; j < end; ++j)
+        {
+          session.offsets[j] = session.spans[j].offset;
+          session.lengths[j] = session.spans[j].length;
+        }
+      }
+      for (size_t j = begin; j < end; ++j)
+      {
+        session.tag_ids[j] = session.spans[j].tag_id;
+      }
+    }
+    session.add(METRIC_SENTENCES, count);
+    session.add(METRIC_WORDS, words);
+    env->SetIntField(result, g_jni.result_word_count, (jint)words);
+    env->SetIntField(result, g_jni.result_sentence_count, (jint)count);
+    _store_ints(env, result, g_jni.result_sentence_offsets, session.sentence_offsets);
+    _store_ints(env, result, g_jni.result_offsets, session.offsets);
+    _store_ints(env, result, g_jni.result_lengths, session.lengths);
+    _store_ints(env, result, g_jni.result_tag_ids, session.tag_ids);
+    return env->ExceptionCheck() ? -1 : 0;
+  }
 
   /*
  * Class:     LAC
  * Method:    init
- * Signature: (Ljava/lang/String;)V
+ * Signature: (Ljava/lang/String;I)V
  */
-  JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_init(JNIEnv *env, jobject thisObj, jstring model_dir)
+  JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_init(JNIEnv *env, jobject thisObj, jstring model_dir, jint pool_size)
   {
-
-    LAC *self = new LAC(env->GetStringUTFChars(model_dir, 0));
+    LACJniHandle *self = new LACJniHandle(_to_string(env, model_dir), pool_size > 0 ? pool_size : 1);
     _set_self(env, thisObj, self);
   }
 
   /*
  * Class:     LAC
  * Method:    copy
- * Signature: (Jlong)V
+ * Signature: (J)V
  */
   JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_copy(JNIEnv *env, jobject thisObj, jlong selfPtr)
   {
-    LAC *self  = *(LAC **)&selfPtr;
+    LACJniHandle *self = *(LACJniHandle **)&selfPtr;
     if (self){
-      _set_self(env, thisObj, new LAC(*self));
+      std::lock_guard<std::mutex> lock(self->load_mutex);
+      _set_self(env, thisObj, new LACJniHandle(*self));
     }
   }
 
   /*
  * Class:     LAC
  * Method:    release
- * Signature: (Jlong)V
+ * Signature: (J)V
  */
-  JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_release(JNIEnv *env, jobject thisObj, jlong selfPtr)
+  JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_release(JNIEnv *env, jclass thisClass, jlong selfPtr)
   {
     if (selfPtr){
-      delete (LAC *)selfPtr;
+      delete *(LACJniHandle **)&selfPtr;
     }
   }
 
   /*
  * Class:     LAC
  * Method:    load_customization
- * Signature: (Ljava/lang/String;)Jint
+ * Signature: (Ljava/lang/String;)I
  */
 JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_loadCustomization
   (JNIEnv *env, jobject thisObj, jstring dict_path)
   {
-    LAC *self = _get_self(env, thisObj);
-    return self->load_customization(env->GetStringUTFChars(dict_path, 0));
+    LACJniHandle *self = _get_self(env, thisObj);
+    std::lock_guard<std::mutex> lock(self->load_mutex);
+    int ret = self->prototype.load_customization(_to_string(env, dict_path));
+    if (ret == 0)
+    {
+      self->rebuild();
+    }
+    return ret;
   }
 
 /*
  * Class:     LAC
  * Method:    run
- * Signature: (Ljava/lang/String;Ljava/lang/ArrayList;Ljava/lang/ArrayList)Jint
+ * Signature: (Ljava/lang/String;Ljava/util/ArrayList;Ljava/util/ArrayList;)I
  */
 JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_run
   (JNIEnv *env, jobject thisObj, jstring sentence, jobject words, jobject tags)
   {
-    jclass list_jcs = env->FindClass("java/util/ArrayList");
-    if (list_jcs == NULL) {
-        std::cerr<<"JNICALL Java_com_baidu_nlp_LAC_run: ArrayList Not Found"<<std::endl;
+    env->CallVoidMethod(words, g_jni.list_clear);
+    env->CallVoidMethod(tags, g_jni.list_clear);
+
+    std::string query = _to_string(env, sentence);
+    LACJniCheckout checkout(_get_self(env, thisObj));
+    std::vector<OutputItem> &items = checkout.session().items;
+    if (checkout.lac().run(query, items) != 0)
+    {
+      return -1;
+    }
+    checkout.session().add(METRIC_SENTENCES, 1);
+    checkout.session().add(METRIC_WORDS, items.size());
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      jstring word = env->NewStringUTF(items[i].word.c_str());
+      jstring tag = env->NewStringUTF(items[i].tag.c_str());
+      env->CallBooleanMethod(words, g_jni.list_add, word);
+      env->CallBooleanMethod(tags, g_jni.list_add, tag);
+      env->DeleteLocalRef(word);
+      env->DeleteLocalRef(tag);
+    }
+
+    return 0;
+
+  }
+
+/*
+ * Class:     LAC
+ * Method:    runBatch
+ * Signature: ([Ljava/lang/String;Lcom/baidu/nlp/LACResult;)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_runBatch
+  (JNIEnv *env, jobject thisObj, jobjectArray sentences, jobject result)
+  {
+    LACJniCheckout checkout(_get_self(env, thisObj));
+    LACJniSession &session = checkout.session();
+    size_t count = env->GetArrayLength(sentences);
+
+    // 各句以modified UTF-8依次拷贝到会话的缓冲区，拷贝后即释放局部引用
+    session.text_buffer.clear();
+    session.text_offsets.resize(count);
+    session.lens.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      jstring sentence = (jstring)env->GetObjectArrayElement(sentences, i);
+      jsize length = sentence ? env->GetStringUTFLength(sentence) : 0;
+      size_t offset = session.text_buffer.size();
+      session.text_buffer.resize(offset + length + 1);
+      if (sentence)
+      {
+        env->GetStringUTFRegion(sentence, 0, env->GetStringLength(sentence), &session.text_buffer[offset]);
+        env->DeleteLocalRef(sentence);
+      }
+      session.text_offsets[i] = offset;
+      session.lens[i] = length;
+    }
+    session.texts.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      session.texts[i] = session.text_buffer.data() + session.text_offsets[i];
+    }
+    return _run_offsets(env, checkout, count, true, result);
+  }
+
+/*
+ * Class:     LAC
+ * Method:    runUtf8
+ * Signature: (Ljava/nio/ByteBuffer;[IILcom/baidu/nlp/LACResult;)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_runUtf8
+  (JNIEnv *env, jobject thisObj, jobject buffer, jintArray offsets, jint count, jobject result)
+  {
+    const char *base = (const char *)env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (base == NULL || count < 0 || env->GetArrayLength(offsets) < count + 1)
+    {
+      std::cerr << "runUtf8: need a direct ByteBuffer and count + 1 offsets" << std::endl;
+      return -1;
+    }
+
+    // 各句与runBatch相同，以\0结尾拷贝到会话的缓冲区，运行时不会读到ByteBuffer之外
+    // 读出第i句的起止位置后，text_offsets[i]改存该句在缓冲区中的位置
+    LACJniCheckout checkout(_get_self(env, thisObj));
+    LACJniSession &session = checkout.session();
+    session.text_offsets.resize(count + 1);
+    env->GetIntArrayRegion(offsets, 0, count + 1, session.text_offsets.data());
+    session.text_buffer.clear();
+    session.lens.resize(count);
+    for (jint i = 0; i < count; ++i)
+    {
+      int begin = session.text_offsets[i];
+      int end = session.text_offsets[i + 1];
+      if (begin < 0 || end < begin || end > capacity)
+      {
+        std::cerr << "runUtf8: invalid offsets of sentence " << i << std::endl;
         return -1;
+      }
+      session.text_offsets[i] = session.text_buffer.size();
+      session.text_buffer.append(base + begin, end - begin);
+      session.text_buffer.push_back('\0');
+      session.lens[i] = end - begin;
+    }
+    session.texts.resize(count);
+    for (jint i = 0; i < count; ++i)
+    {
+      session.texts[i] = session.text_buffer.data() + session.text_offsets[i];
     }
-    
-    //获取ArrayList构造函数id，用于Return使用
-    // jmethodID list_init = env->GetMethodID(list_jcs, "<init>", "()V");
-    //创建一个ArrayList对象
-    // jobject list_obj = env->NewObject(list_jcs, list_init, "");
+    return _run_offsets(env, checkout, count, false, result);
+  }
 
-    //获取ArrayList对象的add()的methodID
-    jmethodID list_add = env->GetMethodID(list_jcs, "add",
-              "(Ljava/lang/Object;)Z");
+/*
+ * Class:     LAC
+ * Method:    tagNames
+ * Signature: ()[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_com_baidu_nlp_LAC_tagNames
+  (JNIEnv *env, jobject thisObj)
+  {
+    // 各会话拷贝自原型，词性表一致；重建会话池时只会追加新的词性
+    LACJniHandle *self = _get_self(env, thisObj);
+    std::lock_guard<std::mutex> lock(self->load_mutex);
+    const std::vector<std::string> &names = self->prototype.tag_names();
+    jobjectArray array = env->NewObjectArray(names.size(), g_jni.string_class, NULL);
+    if (array == NULL)
+    {
+      return NULL;
+    }
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+      jstring name = env->NewStringUTF(names[i].c_str());
+      env->SetObjectArrayElement(array, i, name);
+      env->DeleteLocalRef(name);
+    }
+    return array;
+  }
 
-    //获取ArrayList对象的clear()的methodID
-    jmethodID list_clear = env->GetMethodID(list_jcs, "clear", "()V");
-    env->CallVoidMethod(words, list_clear);
-    env->CallVoidMethod(tags, list_clear);
+/*
+ * Class:     LAC
+ * Method:    warmup
+ * Signature: ()D
+ */
+JNIEXPORT jdouble JNICALL Java_com_baidu_nlp_LAC_warmup
+  (JNIEnv *env, jobject thisObj)
+  {
+    LACJniHandle *self = _get_self(env, thisObj);
+    std::lock_guard<std::mutex> lock(self->load_mutex);
 
-    LAC *self = _get_self(env, thisObj);
-    std::string input = env->GetStringUTFChars(sentence, 0);
-    auto result = self->run(input);
+    // 此后重建会话池时新会话在拷贝时自动预热
+    WarmupConfig config;
+    config.on_clone = true;
+    self->prototype.set_warmup_config(config);
 
-    for (size_t i = 0; i < result.size(); i++)
+    // 借出全部会话逐个预热，期间的调用等待预热完成
+    std::shared_ptr<LACJniPool> pool = self->current();
+    std::vector<LAC *> sessions;
+    for (size_t i = 0; i < pool->pool.size(); ++i)
     {
-      env->CallBooleanMethod(words, list_add, env->NewStringUTF(result[i].word.c_str()));
-      env->CallBooleanMethod(tags, list_add, env->NewStringUTF(result[i].tag.c_str()));
+      sessions.push_back(pool->pool.acquire());
     }
-  
-    return 0;
+    double ms = 0;
+    for (size_t i = 0; i < sessions.size(); ++i)
+    {
+      ms += sessions[i]->warmup(config);
+      pool->pool.release(sessions[i]);
+    }
+    return ms;
+  }
 
+/*
+ * Class:     LAC
+ * Method:    poolSize
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_poolSize
+  (JNIEnv *env, jobject thisObj)
+  {
+    return _get_self(env, thisObj)->current()->pool.size();
+  }
+
+/*
+ * Class:     LAC
+ * Method:    idleSessions
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_idleSessions
+  (JNIEnv *env, jobject thisObj)
+  {
+    return _get_self(env, thisObj)->current()->pool.idle();
+  }
+
+/*
+ * Class:     LAC
+ * Method:    sessionMetrics
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_com_baidu_nlp_LAC_sessionMetrics
+  (JNIEnv *env, jobject thisObj)
+  {
+    // 第i个会话的统计项为[i * METRIC_NUM, (i + 1) * METRIC_NUM)，重建会话池后重新计数
+    std::shared_ptr<LACJniPool> pool = _get_self(env, thisObj)->current();
+    std::vector<jlong> metrics;
+    for (size_t i = 0; i < pool->sessions.size(); ++i)
+    {
+      for (int k = 0; k < METRIC_NUM; ++k)
+      {
+        metrics.push_back(pool->sessions[i]->metrics[k].load(std::memory_order_relaxed));
+      }
+    }
+    jlongArray array = env->NewLongArray(metrics.size());
+    if (array != NULL && !metrics.empty())
+    {
+      env->SetLongArrayRegion(array, 0, metrics.size(), metrics.data());
+    }
+    return array;
   }
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
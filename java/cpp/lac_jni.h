@@ -10,10 +10,26 @@ extern "C" {
 /*
  * Class:     LAC
  * Method:    init
- * Signature: (Ljava/lang/String;)V
+ * Signature: (Ljava/lang/String;I)V
  */
 JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_init
-  (JNIEnv *, jobject, jstring);
+  (JNIEnv *, jobject, jstring, jint);
+
+/*
+ * Class:     LAC
+ * Method:    copy
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_copy
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     LAC
+ * Method:    release
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_baidu_nlp_LAC_release
+  (JNIEnv *, jclass, jlong);
 
 /*
  * Class:     LAC
@@ -33,6 +49,62 @@ JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_loadCustomization
 JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_run
   (JNIEnv *, jobject, jstring, jobject, jobject);
 
+/*
+ * Class:     LAC
+ * Method:    runBatch
+ * Signature: ([Ljava/lang/String;Lcom/baidu/nlp/LACResult;)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_runBatch
+  (JNIEnv *, jobject, jobjectArray, jobject);
+
+/*
+ * Class:     LAC
+ * Method:    runUtf8
+ * Signature: (Ljava/nio/ByteBuffer;[IILcom/baidu/nlp/LACResult;)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_runUtf8
+  (JNIEnv *, jobject, jobject, jintArray, jint, jobject);
+
+/*
+ * Class:     LAC
+ * Method:    tagNames
+ * Signature: ()[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_com_baidu_nlp_LAC_tagNames
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     LAC
+ * Method:    warmup
+ * Signature: ()D
+ */
+JNIEXPORT jdouble JNICALL Java_com_baidu_nlp_LAC_warmup
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     LAC
+ * Method:    poolSize
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_poolSize
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     LAC
+ * Method:    idleSessions
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_nlp_LAC_idleSessions
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     LAC
+ * Method:    sessionMetrics
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_com_baidu_nlp_LAC_sessionMetrics
+  (JNIEnv *, jobject);
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,7 +35,7 @@ from . import utils
 from . import reader
 from ._compat import *
 from .custom import Customization
-from .models import Model, SegModel, LacModel, RankModel
+from .models import Model, SegModel, LacModel, RankModel, CppModel
 
 def _get_abs_path(path): return os.path.normpath(
     os.path.join(os.getcwd(), os.path.dirname(__file__), path))
@@ -52,14 +52,22 @@ PATH_DICT = {
 
 class LAC(object):
     """Docstring for LAC"""
-    def __init__(self, model_path=None, mode='lac', use_cuda=False):
+    def __init__(self, model_path=None, mode='lac', use_cuda=False, backend='python'):
+        """
+        Args:
+            backend: "python"为Python Paddle预测及纯Python的前后处理；
+                     "paddle"、"native"、"lite"使用C++扩展LAC._lac，取值为其推理后端，
+                     多线程运行时释放GIL，"native"不依赖Paddle
+        """
         super(LAC, self).__init__()
         utils.check_cuda(use_cuda)
 
         assert mode in PATH_DICT, 'The mode should be in "lac", "seg" or "rank"'
         model_path = model_path if model_path else PATH_DICT[mode]
 
-        if mode == 'seg':
+        if backend != 'python':
+            model = CppModel(model_path, mode, backend)
+        elif mode == 'seg':
             model = SegModel(model_path, mode, use_cuda)
         elif mode == 'lac':
             model = LacModel(model_path, mode, use_cuda)
@@ -79,13 +87,41 @@ class LAC(object):
             if mode=='rank', 返回分词,词性,词语重要性结果
         """
         return self.model.run(texts)
+
+    def run_offsets(self, texts):
+        """批量运行并以NumPy数组返回结果，仅C++扩展(backend不为"python")支持
+        Args:
+            texts: 由Unicode编码字符串组成的List
+        Returns:
+            dict: sentence_offsets, offsets, lengths, tag_ids, rank模式下另有ranks，均为int32数组；
+                  第i句的词为[sentence_offsets[i], sentence_offsets[i+1])，
+                  词为texts[i][offsets[j]:offsets[j] + lengths[j]]，词性为tag_names()[tag_ids[j]]；
+                  offsets等逐词的数组是同一缓冲区的非连续视图，需要连续内存时用numpy.ascontiguousarray
+        """
+        if not isinstance(self.model, CppModel):
+            raise NotImplementedError('run_offsets requires a C++ backend')
+        return self.model.run_offsets(texts)
+
+    def tag_names(self):
+        """run_offsets结果中tag_ids对应的词性"""
+        if not isinstance(self.model, CppModel):
+            raise NotImplementedError('tag_names requires a C++ backend')
+        return self.model.tag_names()
+
+    def copy(self):
+        """拷贝出共享已装载模型的LAC对象，供其他线程并行调用，仅C++扩展支持"""
+        if not isinstance(self.model, CppModel):
+            raise NotImplementedError('copy requires a C++ backend')
+        lac = LAC.__new__(LAC)
+        lac.model = self.model.copy()
+        return lac
     
     def train(self, model_save_dir, train_data, test_data=None, iter_num=10, thread_num=10):
         """执行模型增量训练
         Args:
             model_save_dir: 训练结束后模型保存的路径
-            train_data: 训练数据路径
-            test_data: 测试数据路径，若为None则不进行测试
+            train_data: 训练数据路径，或lac_preprocess转换后的分片目录
+            test_data: 测试数据路径或分片目录，若为None则不进行测试
             iter_num: 训练数据的迭代次数
             thread_num: 执行训练的线程数
         """
@@ -98,6 +134,9 @@ class LAC(object):
             texts: 用户词典路径
             sep: 表示词典中，短语片段的分隔符，默认为空格' '或制表符'\t'
         """
+        if isinstance(self.model, CppModel):
+            self.model.load_customization(customization_file, sep)
+            return
         self.model.custom = Customization()
         self.model.custom.load_customization(customization_file, sep)
     
@@ -107,6 +146,9 @@ class LAC(object):
             texts: 用户定义词典，如："春天"、"花 开"、"春天/SEASON"、"花/n 开/v"、
             sep: 表示词典中，短语片段的分隔符，默认为空格' '或制表符'\t'
         """
+        if isinstance(self.model, CppModel):
+            self.model.add_word(word, sep)
+            return
         if self.model.custom is None:
             self.model.custom = Customization()
         self.model.custom.add_word(word, sep)
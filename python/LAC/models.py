@@ -376,3 +376,66 @@ class RankModel(Model):
     def train(self, model_save_dir, train_data, test_data, iter_num, thread_num):
         logging.info("To be continued...")
         return
+
+
+class CppModel(object):
+    """Docstring for C++ Model
+    由C++扩展(LAC._lac)完成切分、预测、解码和干预，运行期间释放GIL，backend为C++的推理后端
+    """
+    def __init__(self, model_path, mode, backend):
+        try:
+            from . import _lac
+        except ImportError:
+            raise ImportError('LAC._lac is not built, compile it with cmake -DWITH_PYLIB=ON')
+
+        self.mode = mode
+        self.model_path = model_path
+        self.custom = None
+        self.batch = False
+
+        if mode == 'rank':
+            # 与RankModel相同，lac模型位于rank模型的同级目录
+            lac_path = os.path.join(os.path.split(model_path)[0], 'lac_model')
+            self.lac = _lac.LAC(lac_path, backend)
+            self.lac.enable_rank_mode(model_path)
+        else:
+            self.lac = _lac.LAC(model_path, backend)
+
+    def run(self, texts):
+        self.batch = isinstance(texts, list) or isinstance(texts, tuple)
+        batch = list(texts) if self.batch else [texts]
+        result = self.lac.run(batch, self.mode == 'rank')
+        if self.mode == 'seg':
+            result = [words for words, tags in result]
+        return result if self.batch else result[0]
+
+    def copy(self):
+        """拷贝出共享已装载模型的新会话，供其他线程并行运行"""
+        model = CppModel.__new__(CppModel)
+        model.__dict__.update(self.__dict__)
+        model.lac = self.lac.copy()
+        return model
+
+    def run_offsets(self, texts):
+        """批量运行，结果为int32的NumPy数组，不为每个词创建Python对象
+        Returns:
+            dict: sentence_offsets, offsets, lengths, tag_ids, rank模式下另有ranks；
+                  第i句的词为[sentence_offsets[i], sentence_offsets[i+1])，offsets与lengths为str中的下标
+        """
+        return self.lac.run_offsets(list(texts), self.mode == 'rank')
+
+    def tag_names(self):
+        """run_offsets中tag_ids对应的词性"""
+        return self.lac.tag_names()
+
+    def load_customization(self, customization_file, sep=None):
+        if sep is not None and sep.strip() != '':
+            raise ValueError('the C++ backend only supports dictionaries separated by spaces')
+        if self.lac.load_customization(customization_file) != 0:
+            raise IOError('failed to load %s' % customization_file)
+
+    def add_word(self, word, sep=None):
+        raise NotImplementedError('add_word is not supported by the C++ backend, use load_customization')
+
+    def train(self, model_save_dir, train_data, test_data, iter_num, thread_num):
+        raise NotImplementedError('training is not supported by the C++ backend, use backend="python"')
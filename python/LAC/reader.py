@@ -20,10 +20,20 @@
 The file_reader converts raw corpus to input.
 """
 import io
+import os
 import logging
 import argparse
 import __future__
 
+import numpy as np
+
+# c++/lac_preprocess写出的分片：32字节的头，随后为int64的lod、ids及labels，均为小端
+SHARD_MAGIC = b'LACD'
+SHARD_VERSION = 1
+SHARD_HAS_LABELS = 1
+SHARD_HEADER = np.dtype([('magic', 'S4'), ('version', '<i4'), ('flags', '<i4'), ('reserved', '<i4'),
+                         ('num_samples', '<i8'), ('num_ids', '<i8')])
+
 
 
 def load_kv_dict(dict_path,
@@ -50,6 +60,31 @@ def load_kv_dict(dict_path,
             result_dict[key] = value
     return result_dict
 
+
+def list_shards(shard_dir):
+    """分片目录中按输入顺序排列的分片"""
+    return [os.path.join(shard_dir, name) for name in sorted(os.listdir(shard_dir))
+            if name.endswith('.shard')]
+
+
+def load_shard(path):
+    """
+    以mmap读取一个分片，返回(lod, ids, labels)，第i个样本为ids[lod[i]:lod[i+1]]，
+    分片不含标签时labels为None
+    """
+    header = np.fromfile(path, dtype=SHARD_HEADER, count=1)
+    if len(header) != 1 or header['magic'][0] != SHARD_MAGIC or header['version'][0] != SHARD_VERSION:
+        raise ValueError("%s is not a lac shard" % path)
+    num_samples = int(header['num_samples'][0])
+    num_ids = int(header['num_ids'][0])
+    has_labels = bool(header['flags'][0] & SHARD_HAS_LABELS)
+    body = np.memmap(path, dtype='<i8', mode='r', offset=SHARD_HEADER.itemsize,
+                     shape=(num_samples + 1 + num_ids * (2 if has_labels else 1),))
+    lod = body[:num_samples + 1]
+    ids = body[num_samples + 1:num_samples + 1 + num_ids]
+    labels = body[num_samples + 1 + num_ids:] if has_labels else None
+    return lod, ids, labels
+
 class Dataset(object):
     """data reader"""
 
@@ -80,7 +115,10 @@ class Dataset(object):
         return max(self.label2id_dict.values()) + 1
 
     def get_num_examples(self, filename):
-        """num of line of file"""
+        """num of line of file, or num of samples of a shard directory"""
+        if os.path.isdir(filename):
+            return sum(int(np.fromfile(path, dtype=SHARD_HEADER, count=1)['num_samples'][0])
+                       for path in list_shards(filename))
         return sum(1 for line in open(filename, "rb"))
 
     def parse_tag(self, line):
@@ -142,8 +180,31 @@ class Dataset(object):
         yield (word_idx, target_idx) one by one from file,
             or yield (word_idx, ) in `infer` mode
         """
+        def shard_samples():
+            """c++/lac_preprocess转换好的分片目录，与逐行转换的结果相同"""
+            for path in list_shards(filename):
+                lod, ids, labels = load_shard(path)
+                if mode != "infer" and labels is None:
+                    raise ValueError("%s has no labels, convert without --infer" % path)
+                for i in range(len(lod) - 1):
+                    begin, end = lod[i], lod[i + 1]
+                    if mode == "infer":
+                        yield (ids[begin:end].tolist(),)
+                    else:
+                        yield ids[begin:end].tolist(), labels[begin:end].tolist()
+
         def wrapper():
             """the wrapper of data generator"""
+            if os.path.isdir(filename):
+                cnt = 0
+                for sample in shard_samples():
+                    yield sample
+                    cnt += 1
+                if mode == 'train':
+                    for sample in self.pad_samples(cnt):
+                        yield sample
+                return
+
             fread = io.open(filename, "r", encoding="utf-8")
             if mode == "infer":
                 for line in fread:
@@ -173,17 +234,22 @@ class Dataset(object):
                     cnt += 1
 
                 if mode == 'train':
-                    pad_num = self.dev_count - \
-                        (cnt % self.args.batch_size) % self.dev_count
-                    for i in range(pad_num):
-                        if self.model == 'seg':
-                            yield [self.oov_id], [self.label2id_dict['-S']]
-                        elif self.model == 'lac':
-                            yield [self.oov_id], [self.label2id_dict['O']]
+                    for sample in self.pad_samples(cnt):
+                        yield sample
             fread.close()
 
         return wrapper
 
+    def pad_samples(self, cnt):
+        """train模式下在cnt个样本之后补齐的样本"""
+        pad_num = self.dev_count - \
+            (cnt % self.args.batch_size) % self.dev_count
+        for i in range(pad_num):
+            if self.model == 'seg':
+                yield [self.oov_id], [self.label2id_dict['-S']]
+            elif self.model == 'lac':
+                yield [self.oov_id], [self.label2id_dict['O']]
+
 class SegDataset(Dataset):
     """seg model data reader"""
     def __init__(self, args, dev_count=10):
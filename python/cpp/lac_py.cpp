@@ -0,0 +1,301 @@
+/* Copyright (c) 2020 Baidu, Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+/* LAC的Python扩展(LAC._lac)：切分、预测、解码和干预都在C++中完成，运行期间释放GIL
+ * 结果可以是Python列表，也可以是不经拷贝、直接引用C++内存的NumPy数组 */
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lac.h"
+
+namespace py = pybind11;
+
+/* run_offsets结果的唯一缓冲区：逐词的WordSpan原样接管自LAC，另有各句的起始下标
+ * 各NumPy数组都是它的视图，共用一个capsule，最后一个数组释放时一并释放 */
+struct OffsetsBuffer
+{
+    std::vector<WordSpan> spans;
+    std::vector<int32_t> sentence_offsets;
+};
+
+static_assert(sizeof(int) == sizeof(int32_t) && sizeof(WordSpan) % sizeof(int32_t) == 0,
+              "WordSpan fields are viewed as int32 columns");
+
+/* WordSpan某一字段的列视图，步长为sizeof(WordSpan)，不拷贝 */
+static py::array_t<int32_t> span_column(const OffsetsBuffer &buffer, size_t field, const py::capsule &owner)
+{
+    if (buffer.spans.empty())
+    {
+        return py::array_t<int32_t>(0);
+    }
+    const char *base = reinterpret_cast<const char *>(buffer.spans.data());
+    return py::array_t<int32_t>({(py::ssize_t)buffer.spans.size()}, {(py::ssize_t)sizeof(WordSpan)},
+                                reinterpret_cast<const int32_t *>(base + field), owner);
+}
+
+/* Python端的LAC对象，持有一个C++的LAC会话
+ * 释放GIL后其他线程可以调用同一对象，以互斥锁串行化；多线程并行时各线程使用copy()得到的对象 */
+class PyLAC
+{
+private:
+    LAC _lac;
+    std::mutex _mutex;
+    py::object _texts_ref;               // 运行期间持有输入的tuple，保证UTF-8缓冲区有效
+    std::vector<const char *> _texts;
+    std::vector<int> _lens;
+    std::vector<WordSpan> _spans;
+    std::vector<size_t> _span_lod;
+    std::vector<py::str> _tag_strs;      // 与tag_names()对应的词性字符串，复用而不逐词创建
+    py::object _empty_tag;               // 无词性(tag_id为-1)时的空字符串，首次用到时创建
+
+    /* 离开作用域时释放collect持有的输入，异常退出时同样释放，析构时须持有GIL */
+    struct TextsGuard
+    {
+        py::object &texts_ref;
+
+        explicit TextsGuard(py::object &ref) : texts_ref(ref) {}
+        ~TextsGuard() { texts_ref = py::object(); }
+    };
+
+    /* 等待互斥锁期间释放GIL，避免与持有锁、等待GIL的线程死锁 */
+    std::unique_lock<std::mutex> lock()
+    {
+        std::unique_lock<std::mutex> guard(this->_mutex, std::defer_lock);
+        py::gil_scoped_release release;
+        guard.lock();
+        return guard;
+    }
+
+    /* 取得各句的UTF-8视图，须持有GIL */
+    void collect(const py::sequence &texts)
+    {
+        this->_texts_ref = py::tuple(texts);
+        size_t count = PyTuple_GET_SIZE(this->_texts_ref.ptr());
+        this->_texts.resize(count);
+        this->_lens.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            PyObject *text = PyTuple_GET_ITEM(this->_texts_ref.ptr(), i);
+            if (!PyUnicode_Check(text))
+            {
+                throw py::type_error("texts must be a list of str");
+            }
+            Py_ssize_t size = 0;
+            const char *data = PyUnicode_AsUTF8AndSize(text, &size);
+            if (data == NULL)
+            {
+                throw py::error_already_set();
+            }
+            this->_texts[i] = data;
+            this->_lens[i] = (int)size;
+        }
+    }
+
+    /* 对已取得视图的句子运行，期间释放GIL */
+    void run_spans(bool rank)
+    {
+        int ret = 0;
+        {
+            py::gil_scoped_release release;
+            ret = rank ? this->_lac.run_rank_offsets(this->_texts.data(), this->_lens.data(), this->_texts.size(),
+                                                     this->_spans, this->_span_lod)
+                       : this->_lac.run_offsets(this->_texts.data(), this->_lens.data(), this->_texts.size(),
+                                                this->_spans, this->_span_lod);
+        }
+        if (ret != 0)
+        {
+            throw std::runtime_error("lac run failed");
+        }
+    }
+
+    /* tag_id对应的词性，负数或越界时为空字符串，须持有GIL */
+    const py::object &tag_str(int tag_id)
+    {
+        const std::vector<std::string> &names = this->_lac.tag_names();
+        for (size_t i = this->_tag_strs.size(); i < names.size(); ++i)
+        {
+            this->_tag_strs.push_back(py::str(names[i]));
+        }
+        if (tag_id < 0 || (size_t)tag_id >= this->_tag_strs.size())
+        {
+            if (!this->_empty_tag)
+            {
+                this->_empty_tag = py::str("");
+            }
+            return this->_empty_tag;
+        }
+        return this->_tag_strs[tag_id];
+    }
+
+public:
+    PyLAC(const std::string &model_path, const std::string &backend)
+        : _lac(model_path, CODE_TYPE::CODE_UTF8, parse_backend_name(backend))
+    {
+        if (!this->_lac.model_loaded())
+        {
+            throw std::runtime_error("failed to load model from " + model_path);
+        }
+    }
+
+    /* 拷贝会话，共享已装载的模型；可在不持有GIL时调用 */
+    PyLAC(PyLAC &other) : _lac(other._lac) {}
+
+    static LAC_BACKEND parse_backend_name(const std::string &name)
+    {
+        LAC_BACKEND type = default_backend();
+        if (!name.empty() && !parse_backend(name, type))
+        {
+            throw py::value_error("unknown backend " + name);
+        }
+        return type;
+    }
+
+    std::unique_ptr<PyLAC> copy()
+    {
+        std::unique_lock<std::mutex> guard = lock();
+        py::gil_scoped_release release;
+        return std::unique_ptr<PyLAC>(new PyLAC(*this));
+    }
+
+    int load_customization(const std::string &path)
+    {
+        std::unique_lock<std::mutex> guard = lock();
+        py::gil_scoped_release release;
+        return this->_lac.load_customization(path);
+    }
+
+    void enable_rank_mode(const std::string &rank_model_path)
+    {
+        std::unique_lock<std::mutex> guard = lock();
+        py::gil_scoped_release release;
+        this->_lac.enable_rank_mode(rank_model_path);
+    }
+
+    bool rank_enabled()
+    {
+        return this->_lac.rank_enabled();
+    }
+
+    py::list tag_names()
+    {
+        std::unique_lock<std::mutex> guard = lock();
+        py::list names;
+        for (size_t i = 0; i < this->_lac.tag_names().size(); ++i)
+        {
+            names.append(tag_str(i));
+        }
+        return names;
+    }
+
+    /* 每句返回[words, tags]，rank为true时为[words, tags, ranks]，词为输入str的切片 */
+    py::list run(const py::sequence &texts, bool rank)
+    {
+        std::unique_lock<std::mutex> guard = lock();
+        TextsGuard texts_guard(this->_texts_ref);
+        collect(texts);
+        run_spans(rank);
+
+        py::list results;
+        for (size_t i = 0; i + 1 < this->_span_lod.size(); ++i)
+        {
+            PyObject *text = PyTuple_GET_ITEM(this->_texts_ref.ptr(), i);
+            size_t begin = this->_span_lod[i];
+            size_t end = this->_span_lod[i + 1];
+            py::list words(end - begin);
+            py::list tags(end - begin);
+            py::list ranks(rank ? end - begin : 0);
+            for (size_t j = begin; j < end; ++j)
+            {
+                const WordSpan &span = this->_spans[j];
+                PyObject *word = PyUnicode_Substring(text, span.char_offset, span.char_offset + span.char_length);
+                if (word == NULL)
+                {
+                    throw py::error_already_set();
+                }
+                words[j - begin] = py::reinterpret_steal<py::object>(word);
+                tags[j - begin] = tag_str(span.tag_id);
+                if (rank)
+                {
+                    ranks[j - begin] = py::int_(span.rank);
+                }
+            }
+            py::list result;
+            result.append(words);
+            result.append(tags);
+            if (rank)
+            {
+                result.append(ranks);
+            }
+            results.append(result);
+        }
+        return results;
+    }
+
+    /* 以int32的NumPy数组返回：第i句的词为[sentence_offsets[i], sentence_offsets[i+1])，
+     * offsets和lengths按字符计(即str的下标)，tag_ids对应tag_names()，rank为true时含ranks
+     * 词的各列是同一个WordSpan缓冲区按字段取的视图(非连续，步长为sizeof(WordSpan))，不逐词拷贝 */
+    py::dict run_offsets(const py::sequence &texts, bool rank)
+    {
+        std::unique_lock<std::mutex> guard = lock();
+        {
+            TextsGuard texts_guard(this->_texts_ref);
+            collect(texts);
+            run_spans(rank);
+        }
+
+        OffsetsBuffer *buffer = new OffsetsBuffer();
+        py::capsule owner(buffer, [](void *p) { delete reinterpret_cast<OffsetsBuffer *>(p); });
+        buffer->spans.swap(this->_spans);
+        buffer->sentence_offsets.assign(this->_span_lod.begin(), this->_span_lod.end());
+
+        py::dict result;
+        result["sentence_offsets"] = py::array_t<int32_t>(buffer->sentence_offsets.size(),
+                                                          buffer->sentence_offsets.data(), owner);
+        result["offsets"] = span_column(*buffer, offsetof(WordSpan, char_offset), owner);
+        result["lengths"] = span_column(*buffer, offsetof(WordSpan, char_length), owner);
+        result["tag_ids"] = span_column(*buffer, offsetof(WordSpan, tag_id), owner);
+        if (rank)
+        {
+            result["ranks"] = span_column(*buffer, offsetof(WordSpan, rank), owner);
+        }
+        return result;
+    }
+};
+
+PYBIND11_MODULE(_lac, m)
+{
+    m.doc() = "C++ core of LAC";
+
+    py::class_<PyLAC>(m, "LAC")
+        .def(py::init<const std::string &, const std::string &>(),
+             py::arg("model_path"), py::arg("backend") = "")
+        .def("copy", &PyLAC::copy,
+             "new session sharing the loaded model, for running in another thread")
+        .def("load_customization", &PyLAC::load_customization, py::arg("path"))
+        .def("enable_rank_mode", &PyLAC::enable_rank_mode, py::arg("rank_model_path"))
+        .def("rank_enabled", &PyLAC::rank_enabled)
+        .def("tag_names", &PyLAC::tag_names)
+        .def("run", &PyLAC::run, py::arg("texts"), py::arg("rank") = false,
+             "run a list of str, returns [words, tags] or [words, tags, ranks] per sentence")
+        .def("run_offsets", &PyLAC::run_offsets, py::arg("texts"), py::arg("rank") = false,
+             "run a list of str, returns int32 numpy arrays sentence_offsets, offsets, lengths, tag_ids[, ranks]");
+}